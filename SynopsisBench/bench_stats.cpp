@@ -0,0 +1,105 @@
+#include "bench_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// ============================================================================
+// Allocation counting
+// ============================================================================
+static std::atomic<uint64_t> g_allocCount{ 0 };
+static std::atomic<uint64_t> g_allocBytes{ 0 };
+
+void* operator new(size_t size)
+{
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    g_allocCount.fetch_add(1, std::memory_order_relaxed);
+    g_allocBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+AllocCounters allocSnapshot()
+{
+    AllocCounters c;
+    c.count = g_allocCount.load(std::memory_order_relaxed);
+    c.bytes = g_allocBytes.load(std::memory_order_relaxed);
+    return c;
+}
+
+uint64_t peakRssKb()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return static_cast<uint64_t>(pmc.PeakWorkingSetSize / 1024);
+    return 0;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+        return static_cast<uint64_t>(ru.ru_maxrss);   // already KiB on Linux
+    return 0;
+#endif
+}
+
+// ============================================================================
+// LatencySamples
+// ============================================================================
+static double percentile(const std::vector<double>& sorted, double q)
+{
+    if (sorted.empty())
+        return 0.0;
+    const double rank = q * (sorted.size() - 1);
+    const size_t lo = static_cast<size_t>(rank);
+    const size_t hi = std::min(lo + 1, sorted.size() - 1);
+    return sorted[lo] + (sorted[hi] - sorted[lo]) * (rank - lo);
+}
+
+void LatencySamples::writeJson(std::ostream& os) const
+{
+    std::vector<double> sorted(us_);
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0.0;
+    for (double v : sorted)
+        sum += v;
+
+    os << "{\"count\":" << sorted.size()
+        << ",\"mean_us\":" << (sorted.empty() ? 0.0 : sum / sorted.size())
+        << ",\"p50_us\":" << percentile(sorted, 0.50)
+        << ",\"p90_us\":" << percentile(sorted, 0.90)
+        << ",\"p99_us\":" << percentile(sorted, 0.99)
+        << ",\"p999_us\":" << percentile(sorted, 0.999)
+        << ",\"max_us\":" << (sorted.empty() ? 0.0 : sorted.back())
+        << "}";
+}
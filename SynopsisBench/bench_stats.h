@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief Exact latency summary over all recorded samples (the bench keeps every sample,
+ *        the engine side uses bucketed histograms, see vs_metrics.h).
+ */
+class LatencySamples {
+public:
+    void reserve(size_t n) { us_.reserve(n); }
+    void add(double micros) { us_.push_back(micros); }
+    size_t count() const { return us_.size(); }
+    bool empty() const { return us_.empty(); }
+
+    // {"count":..,"mean_us":..,"p50_us":..,"p90_us":..,"p99_us":..,"p999_us":..,"max_us":..}
+    void writeJson(std::ostream& os) const;
+
+private:
+    std::vector<double> us_;
+};
+
+struct AllocCounters {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+// Global operator new counters of this executable. On Linux the engine's allocations are
+// included as well, on Windows the engine DLL has its own heap and is not counted.
+AllocCounters allocSnapshot();
+
+// Peak resident set size of the process in KiB (0 if unavailable)
+uint64_t peakRssKb();
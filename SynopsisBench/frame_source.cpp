@@ -0,0 +1,138 @@
+#include "frame_source.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+class VideoSource : public FrameSource {
+public:
+    explicit VideoSource(const std::string& path) : path_(path), cap_(path) {}
+
+    bool opened() const { return cap_.isOpened(); }
+    bool next(cv::Mat& frame) override { return cap_.read(frame) && !frame.empty(); }
+    double fps() const override { return cap_.get(cv::CAP_PROP_FPS); }
+    int64_t frameCount() const override { return static_cast<int64_t>(cap_.get(cv::CAP_PROP_FRAME_COUNT)); }
+    std::string describe() const override { return "video:" + path_; }
+
+private:
+    std::string path_;
+    mutable cv::VideoCapture cap_;
+};
+
+class ImageDirSource : public FrameSource {
+public:
+    explicit ImageDirSource(const std::string& dir) : dir_(dir) {
+        std::vector<cv::String> files;
+        cv::glob(dir + "/*", files, false);
+        std::sort(files.begin(), files.end());
+        static const char* exts[] = { ".jpg", ".jpeg", ".png", ".bmp", ".tif", ".tiff", ".webp" };
+        for (const auto& f : files) {
+            std::string lower = f;
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            for (const char* e : exts) {
+                const size_t n = strlen(e);
+                if (lower.size() > n && lower.compare(lower.size() - n, n, e) == 0) {
+                    files_.push_back(f);
+                    break;
+                }
+            }
+        }
+    }
+
+    bool next(cv::Mat& frame) override {
+        while (pos_ < files_.size()) {
+            frame = cv::imread(files_[pos_++], cv::IMREAD_COLOR);
+            if (!frame.empty())
+                return true;
+        }
+        return false;
+    }
+    double fps() const override { return 0.0; }
+    int64_t frameCount() const override { return static_cast<int64_t>(files_.size()); }
+    std::string describe() const override { return "images:" + dir_; }
+
+private:
+    std::string dir_;
+    std::vector<std::string> files_;
+    size_t pos_ = 0;
+};
+
+// Pool of frames with a textured background and moving blobs, so NMS and masks have work
+class SyntheticSource : public FrameSource {
+public:
+    static constexpr int kPoolSize = 16;
+
+    SyntheticSource(const cv::Size& size, int64_t count) : size_(size), count_(count) {
+        cv::RNG rng(12345);
+        cv::Mat background(size, CV_8UC3);
+        rng.fill(background, cv::RNG::UNIFORM, cv::Scalar::all(40), cv::Scalar::all(200));
+        cv::GaussianBlur(background, background, cv::Size(0, 0), 3.0);
+
+        const int blobs = 12;
+        std::vector<cv::Point2f> pos(blobs), vel(blobs);
+        std::vector<cv::Scalar> colors(blobs);
+        for (int i = 0; i < blobs; ++i) {
+            pos[i] = cv::Point2f(rng.uniform(0.f, static_cast<float>(size.width)), rng.uniform(0.f, static_cast<float>(size.height)));
+            vel[i] = cv::Point2f(rng.uniform(-12.f, 12.f), rng.uniform(-6.f, 6.f));
+            colors[i] = cv::Scalar(rng.uniform(0, 255), rng.uniform(0, 255), rng.uniform(0, 255));
+        }
+        for (int k = 0; k < kPoolSize; ++k) {
+            cv::Mat f = background.clone();
+            for (int i = 0; i < blobs; ++i) {
+                const cv::Point2f p = pos[i] + vel[i] * static_cast<float>(k);
+                const cv::Size axes(size.width / 40 + i * 3, size.height / 12 + i * 2);
+                cv::ellipse(f, p, axes, 0, 0, 360, colors[i], cv::FILLED, cv::LINE_AA);
+            }
+            pool_.push_back(f);
+        }
+    }
+
+    bool next(cv::Mat& frame) override {
+        if (count_ >= 0 && pos_ >= count_)
+            return false;
+        frame = pool_[static_cast<size_t>(pos_++ % kPoolSize)];
+        return true;
+    }
+    double fps() const override { return 30.0; }
+    int64_t frameCount() const override { return count_; }
+    std::string describe() const override {
+        return "synthetic:" + std::to_string(size_.width) + "x" + std::to_string(size_.height);
+    }
+
+private:
+    cv::Size size_;
+    int64_t count_;
+    int64_t pos_ = 0;
+    std::vector<cv::Mat> pool_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> FrameSource::Create(const std::string& spec, int64_t maxFrames)
+{
+    if (spec.compare(0, 6, "video:") == 0) {
+        auto src = std::make_unique<VideoSource>(spec.substr(6));
+        if (!src->opened())
+            return nullptr;
+        return src;
+    }
+    if (spec.compare(0, 7, "images:") == 0) {
+        auto src = std::make_unique<ImageDirSource>(spec.substr(7));
+        if (src->frameCount() == 0)
+            return nullptr;
+        return src;
+    }
+    if (spec.compare(0, 9, "synthetic") == 0) {
+        cv::Size size(1280, 720);
+        if (spec.size() > 10 && spec[9] == ':') {
+            int w = 0, h = 0;
+            if (std::sscanf(spec.c_str() + 10, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)
+                return nullptr;
+            size = cv::Size(w, h);
+        }
+        return std::make_unique<SyntheticSource>(size, maxFrames > 0 ? maxFrames : 300);
+    }
+    return nullptr;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Frame provider for synopsis_bench.
+ *
+ * Spec strings:
+ *   video:<path>          decoded with cv::VideoCapture
+ *   images:<dir>          every image cv::imread can open, in name order
+ *   synthetic[:WxH]       generated frames (default 1280x720), cycled from a small pool
+ */
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    // Returns false at the end of the source
+    virtual bool next(cv::Mat& frame) = 0;
+    // Native frame rate, 0 if the source has none
+    virtual double fps() const = 0;
+    // Number of frames if known, -1 otherwise
+    virtual int64_t frameCount() const = 0;
+    virtual std::string describe() const = 0;
+
+    static std::unique_ptr<FrameSource> Create(const std::string& spec, int64_t maxFrames);
+};
@@ -0,0 +1,482 @@
+// synopsis_bench.cpp : headless end-to-end benchmark of the engine C API.
+//
+//   synopsis_bench --app <dir with model/ and cfg/> [--task detect|classify|segment|pose|obb]
+//                  [--source video:<path>|images:<dir>|synthetic[:WxH]] [--frames N] [--warmup N]
+//                  [--threads N] [--batch N] [--precision fp32|fp16|int8]
+//                  [--mode timed|continuous|pipeline] [--fps F] [--gpu] [--out report.json]
+//                  [--annotate out.mp4]
+//
+// --mode pipeline hands a video: source to the engine (vsOpenVideo) and only polls results,
+// which is how files are processed headless on servers. --annotate makes the engine write an
+// annotated copy of the analysed frames as well (pipeline mode only).
+// Prints one JSON report (stdout unless --out is given).
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+#include <opencv2/opencv.hpp>
+#include "SynopsisEngine.h"
+#include "frame_source.h"
+#include "bench_stats.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Same semantics as PlayMode of the MFC player
+enum class BenchMode {
+    Timed,          // every frame, in order
+    Continuous,     // paced source, always the latest frame
+    Pipeline        // engine-side decode and inference via vsOpenVideo
+};
+
+struct BenchConfig {
+    std::string appPath = ".";
+    YoloTask task = YT_DETECT;
+    std::string source = "synthetic";
+    int64_t frames = -1;        // -1: whole source
+    int warmup = 5;
+    int threads = 0;            // ORT intra-op threads, 0 = engine default
+    int batch = 1;
+    vsPrecision precision = VS_PRECISION_FP32;
+    BenchMode mode = BenchMode::Timed;
+    double fps = 0.0;           // continuous pacing, 0 = source fps (30 if unknown)
+    bool gpu = false;
+    std::string out;
+    std::string annotate;       // pipeline mode: annotated output video
+};
+
+static const char* TASK_NAMES[YT_MAX] = { "detect", "classify", "segment", "pose", "obb" };
+static const char* PRECISION_NAMES[] = { "fp32", "fp16", "int8" };
+static const char* MODE_NAMES[] = { "timed", "continuous", "pipeline" };
+
+static void usage()
+{
+    std::cerr <<
+        "usage: synopsis_bench --app <dir> [--task detect|classify|segment|pose|obb]\n"
+        "                      [--source video:<path>|images:<dir>|synthetic[:WxH]]\n"
+        "                      [--frames N] [--warmup N] [--threads N] [--batch N]\n"
+        "                      [--precision fp32|fp16|int8] [--mode timed|continuous|pipeline]\n"
+        "                      [--fps F] [--gpu] [--out report.json] [--annotate out.mp4]\n";
+}
+
+static bool parseArgs(int argc, char** argv, BenchConfig& cfg)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (a == "--gpu") {
+            cfg.gpu = true;
+            continue;
+        }
+        if (!hasValue)
+            return false;
+        const std::string v = argv[++i];
+        if (a == "--app") cfg.appPath = v;
+        else if (a == "--source") cfg.source = v;
+        else if (a == "--frames") cfg.frames = std::atoll(v.c_str());
+        else if (a == "--warmup") cfg.warmup = std::max(0, std::atoi(v.c_str()));
+        else if (a == "--threads") cfg.threads = std::max(0, std::atoi(v.c_str()));
+        else if (a == "--batch") cfg.batch = std::max(1, std::atoi(v.c_str()));
+        else if (a == "--fps") cfg.fps = std::atof(v.c_str());
+        else if (a == "--out") cfg.out = v;
+        else if (a == "--annotate") cfg.annotate = v;
+        else if (a == "--task") {
+            int t = 0;
+            while (t < YT_MAX && v != TASK_NAMES[t]) ++t;
+            if (t == YT_MAX)
+                return false;
+            cfg.task = static_cast<YoloTask>(t);
+        }
+        else if (a == "--precision") {
+            if (v == "fp32") cfg.precision = VS_PRECISION_FP32;
+            else if (v == "fp16") cfg.precision = VS_PRECISION_FP16;
+            else if (v == "int8") cfg.precision = VS_PRECISION_INT8;
+            else return false;
+        }
+        else if (a == "--mode") {
+            if (v == "timed") cfg.mode = BenchMode::Timed;
+            else if (v == "continuous") cfg.mode = BenchMode::Continuous;
+            else if (v == "pipeline") cfg.mode = BenchMode::Pipeline;
+            else return false;
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+static JString toJString(const std::string& s)
+{
+#if defined(_WIN32) && defined(UNICODE)
+    int n = MultiByteToWideChar(CP_ACP, 0, s.c_str(), -1, NULL, 0);
+    std::wstring w(n > 0 ? n - 1 : 0, L'\0');
+    if (n > 1)
+        MultiByteToWideChar(CP_ACP, 0, s.c_str(), -1, &w[0], n);
+    return w;
+#else
+    return s;
+#endif
+}
+
+// Runs the task entry point matching the handle; returns the number of objects or -1 on error
+static int runOnce(vsHandle handle, YoloTask task, const cv::Mat& img)
+{
+    const int w = img.cols, h = img.rows, c = img.channels();
+    if (task == YT_DETECT) {
+        Detection* dets = nullptr;
+        int count = 0;
+        if (vsDetectObjects(handle, img.data, w, h, c, &dets, &count) != VS_SUCCESS)
+            return -1;
+        vsReleaseDetections(dets);
+        return count;
+    }
+
+    vsResultHeader* block = nullptr;
+    vsCode rc = VS_ERROR_UNKNOWN;
+    switch (task) {
+    case YT_SEGMENT:  rc = vsSegment(handle, img.data, w, h, c, VS_MASK_RLE, &block); break;
+    case YT_POSE:     rc = vsEstimatePose(handle, img.data, w, h, c, &block); break;
+    case YT_OBB:      rc = vsDetectOriented(handle, img.data, w, h, c, &block); break;
+    case YT_CLASSIFY: rc = vsClassify(handle, img.data, w, h, c, &block); break;
+    default: break;
+    }
+    if (rc != VS_SUCCESS)
+        return -1;
+    const int count = static_cast<int>(block->count);
+    vsReleaseResult(block);
+    return count;
+}
+
+struct RunStats {
+    int64_t frames = 0;
+    int64_t objects = 0;
+    int64_t errors = 0;
+    int64_t dropped = 0;
+    double elapsedSec = 0.0;
+    LatencySamples decode;   // source read
+    LatencySamples call;     // one engine call (end to end inside the engine)
+    LatencySamples batch;    // one group of --batch calls
+    LatencySamples wait;     // continuous mode: frame age when picked up
+    LatencySamples interval; // pipeline mode: time between consecutive results
+};
+
+// Timed mode: every frame in order, as fast as possible. Frames are read in groups of
+// --batch and then submitted back to back.
+static void runTimed(vsHandle handle, const BenchConfig& cfg, FrameSource& src, int64_t limit, RunStats& st)
+{
+    std::vector<cv::Mat> group(cfg.batch);
+    const auto t0 = Clock::now();
+    bool more = true;
+    while (more && (limit < 0 || st.frames < limit)) {
+        int n = 0;
+        while (n < cfg.batch && (limit < 0 || st.frames + n < limit)) {
+            const auto d0 = Clock::now();
+            if (!src.next(group[n])) {
+                more = false;
+                break;
+            }
+            st.decode.add(std::chrono::duration<double, std::micro>(Clock::now() - d0).count());
+            ++n;
+        }
+        if (n == 0)
+            break;
+
+        const auto b0 = Clock::now();
+        for (int i = 0; i < n; ++i) {
+            const auto c0 = Clock::now();
+            const int objs = runOnce(handle, cfg.task, group[i]);
+            st.call.add(std::chrono::duration<double, std::micro>(Clock::now() - c0).count());
+            if (objs < 0) ++st.errors;
+            else st.objects += objs;
+        }
+        st.batch.add(std::chrono::duration<double, std::micro>(Clock::now() - b0).count());
+        st.frames += n;
+    }
+    st.elapsedSec = std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Continuous mode: a producer replays the source at its frame rate into a single latest-frame
+// slot, the consumer always takes the newest frame. Overwritten frames count as dropped.
+static void runContinuous(vsHandle handle, const BenchConfig& cfg, FrameSource& src, int64_t limit, RunStats& st)
+{
+    std::mutex m;
+    std::condition_variable cv;
+    cv::Mat slot;
+    Clock::time_point slotTime;
+    bool slotFull = false;
+    bool done = false;
+    int64_t produced = 0;
+
+    const double fps = cfg.fps > 0 ? cfg.fps : (src.fps() > 0 ? src.fps() : 30.0);
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+
+    std::thread producer([&] {
+        auto due = Clock::now();
+        cv::Mat f;
+        while (limit < 0 || produced < limit) {
+            const auto d0 = Clock::now();
+            if (!src.next(f))
+                break;
+            const double decodeUs = std::chrono::duration<double, std::micro>(Clock::now() - d0).count();
+            std::this_thread::sleep_until(due);
+            due += period;
+            {
+                std::lock_guard<std::mutex> lock(m);
+                st.decode.add(decodeUs);
+                if (slotFull)
+                    ++st.dropped;
+                slot = f.clone();
+                slotTime = Clock::now();
+                slotFull = true;
+                ++produced;
+            }
+            cv.notify_one();
+        }
+        std::lock_guard<std::mutex> lock(m);
+        done = true;
+        cv.notify_one();
+    });
+
+    const auto t0 = Clock::now();
+    int64_t lastDropped = 0;
+    for (;;) {
+        cv::Mat frame;
+        Clock::time_point queuedAt;
+        int64_t droppedNow = 0;
+        {
+            std::unique_lock<std::mutex> lock(m);
+            cv.wait(lock, [&] { return slotFull || done; });
+            if (!slotFull)
+                break;
+            frame = std::move(slot);
+            queuedAt = slotTime;
+            slotFull = false;
+            droppedNow = st.dropped;
+        }
+        const auto c0 = Clock::now();
+        const double waitUs = std::chrono::duration<double, std::micro>(c0 - queuedAt).count();
+        st.wait.add(waitUs);
+        vsRecordMetric(handle, 0, VS_STAGE_QUEUE_WAIT, waitUs);
+        if (droppedNow > lastDropped) {
+            vsRecordDrops(handle, 0, static_cast<unsigned int>(droppedNow - lastDropped));
+            lastDropped = droppedNow;
+        }
+
+        const int objs = runOnce(handle, cfg.task, frame);
+        st.call.add(std::chrono::duration<double, std::micro>(Clock::now() - c0).count());
+        if (objs < 0) ++st.errors;
+        else st.objects += objs;
+        ++st.frames;
+    }
+    producer.join();
+    st.elapsedSec = std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Pipeline mode: the engine decodes and analyses the file itself, the bench only polls
+static void runPipeline(vsHandle handle, const BenchConfig& cfg, int64_t limit, RunStats& st)
+{
+    const JString url = toJString(cfg.source.substr(6));
+    vsWriterOptions output = {};
+    output.pathUtf8 = cfg.annotate.c_str();
+    vsVideoOptions options = {};
+    options.pacing = VS_VIDEO_ALL_FRAMES;
+    options.maskEncoding = VS_MASK_RLE;
+    options.output = cfg.annotate.empty() ? nullptr : &output;
+    if (vsOpenVideoEx(handle, 0, url.c_str(), &options, nullptr, nullptr) != VS_SUCCESS) {
+        std::cerr << "[synopsis_bench] vsOpenVideo failed for " << cfg.source << std::endl;
+        ++st.errors;
+        return;
+    }
+
+    const auto t0 = Clock::now();
+    auto last = t0;
+    while (limit < 0 || st.frames < limit) {
+        vsFrameResult frame = {};
+        const vsCode rc = vsPollVideo(handle, 0, &frame, 1000);
+        if (rc == VS_ERROR_TIMEOUT)
+            continue;
+        if (rc != VS_SUCCESS)
+            break;
+        const auto now = Clock::now();
+        st.interval.add(std::chrono::duration<double, std::micro>(now - last).count());
+        last = now;
+        if (frame.result) {
+            st.objects += frame.result->count;
+            vsReleaseResult(frame.result);
+        }
+        else {
+            ++st.errors;
+        }
+        ++st.frames;
+    }
+    st.elapsedSec = std::chrono::duration<double>(Clock::now() - t0).count();
+
+    vsVideoInfo info = {};
+    if (vsGetVideoInfo(handle, 0, &info) == VS_SUCCESS)
+        st.dropped = info.framesDropped;
+    vsWriterStats ws = {};
+    if (!cfg.annotate.empty() && vsGetVideoWriterStats(handle, 0, &ws) == VS_SUCCESS) {
+        std::cerr << "[synopsis_bench] " << cfg.annotate << ": " << ws.framesWritten << " written, "
+            << ws.backlog << " still queued, " << ws.framesDropped << " dropped, "
+            << ws.avgEncodeMs << " ms/frame" << (ws.failed ? " (writer failed)" : "") << std::endl;
+    }
+    vsCloseVideo(handle, 0);     // encodes what is still queued and finalizes the file
+}
+
+static std::string jsonEscape(const std::string& s)
+{
+    std::string out;
+    for (char ch : s) {
+        if (ch == '"' || ch == '\\') { out += '\\'; out += ch; }
+        else if (static_cast<unsigned char>(ch) < 0x20) out += ' ';
+        else out += ch;
+    }
+    return out;
+}
+
+int main(int argc, char** argv)
+{
+    BenchConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        usage();
+        return 2;
+    }
+
+    vsModelOptions options = {};
+    options.task = cfg.task;
+    options.intraOpThreads = cfg.threads;
+    options.useGPU = cfg.gpu ? 1 : 0;
+    options.precision = cfg.precision;
+
+    const auto l0 = Clock::now();
+    vsHandle handle = nullptr;
+    const JString appPath = toJString(cfg.appPath);
+    if (vsInitYoloModelEx(&handle, appPath.c_str(), &options) != VS_SUCCESS) {
+        std::cerr << "[synopsis_bench] Failed to load " << TASK_NAMES[cfg.task] << " model from " << cfg.appPath << std::endl;
+        return 1;
+    }
+    const double loadMs = std::chrono::duration<double, std::milli>(Clock::now() - l0).count();
+
+    // Warm-up runs on the first frame of a separate source instance so the measured source is untouched
+    if (cfg.warmup > 0) {
+        auto warm = FrameSource::Create(cfg.source, 1);
+        cv::Mat f;
+        if (warm && warm->next(f)) {
+            for (int i = 0; i < cfg.warmup; ++i)
+                runOnce(handle, cfg.task, f);
+        }
+    }
+    vsResetMetrics(handle, VS_METRICS_ALL_STREAMS);
+
+    auto src = FrameSource::Create(cfg.source, cfg.frames);
+    if (!src) {
+        std::cerr << "[synopsis_bench] Cannot open source " << cfg.source << std::endl;
+        vsReleaseYoloModel(handle);
+        return 1;
+    }
+
+    if (cfg.mode == BenchMode::Pipeline && cfg.source.compare(0, 6, "video:") != 0) {
+        std::cerr << "[synopsis_bench] --mode pipeline needs a video: source" << std::endl;
+        vsReleaseYoloModel(handle);
+        return 2;
+    }
+
+    RunStats st;
+    const int64_t expected = cfg.frames > 0 ? cfg.frames : std::max<int64_t>(src->frameCount(), 0);
+    st.call.reserve(static_cast<size_t>(expected));
+    st.decode.reserve(static_cast<size_t>(expected));
+    st.wait.reserve(static_cast<size_t>(expected));
+    st.interval.reserve(static_cast<size_t>(expected));
+    st.batch.reserve(static_cast<size_t>(expected / cfg.batch + 1));
+
+    const AllocCounters a0 = allocSnapshot();
+    if (cfg.mode == BenchMode::Timed)
+        runTimed(handle, cfg, *src, cfg.frames, st);
+    else if (cfg.mode == BenchMode::Continuous)
+        runContinuous(handle, cfg, *src, cfg.frames, st);
+    else
+        runPipeline(handle, cfg, cfg.frames, st);
+    const AllocCounters a1 = allocSnapshot();
+
+    std::string engineJson;
+    int len = 0;
+    vsGetMetricsJson(handle, VS_METRICS_ALL_STREAMS, nullptr, 0, &len);
+    if (len > 0) {
+        std::vector<char> buf(static_cast<size_t>(len) + 1);
+        if (vsGetMetricsJson(handle, VS_METRICS_ALL_STREAMS, buf.data(), static_cast<int>(buf.size()), &len) == VS_SUCCESS)
+            engineJson.assign(buf.data(), static_cast<size_t>(len));
+    }
+    vsReleaseYoloModel(handle);
+
+    const uint64_t allocs = a1.count - a0.count;
+    std::ostringstream os;
+    os.setf(std::ios::fixed);
+    os.precision(1);
+    os << "{\"config\":{"
+        << "\"task\":\"" << TASK_NAMES[cfg.task] << "\""
+        << ",\"source\":\"" << jsonEscape(src->describe()) << "\""
+        << ",\"mode\":\"" << MODE_NAMES[static_cast<int>(cfg.mode)] << "\""
+        << ",\"threads\":" << cfg.threads
+        << ",\"batch\":" << cfg.batch
+        << ",\"precision\":\"" << PRECISION_NAMES[cfg.precision] << "\""
+        << ",\"gpu\":" << (cfg.gpu ? "true" : "false")
+        << ",\"warmup\":" << cfg.warmup
+        << "}"
+        << ",\"model_load_ms\":" << loadMs
+        << ",\"frames\":" << st.frames
+        << ",\"errors\":" << st.errors
+        << ",\"dropped\":" << st.dropped
+        << ",\"objects_per_frame\":" << (st.frames ? static_cast<double>(st.objects) / st.frames : 0.0)
+        << ",\"elapsed_s\":" << st.elapsedSec
+        << ",\"throughput_fps\":" << (st.elapsedSec > 0 ? st.frames / st.elapsedSec : 0.0)
+        << ",\"latency\":{\"call\":";
+    st.call.writeJson(os);
+    os << ",\"decode\":";
+    st.decode.writeJson(os);
+    if (cfg.batch > 1) {
+        os << ",\"batch\":";
+        st.batch.writeJson(os);
+    }
+    if (cfg.mode == BenchMode::Continuous) {
+        os << ",\"queue_wait\":";
+        st.wait.writeJson(os);
+    }
+    if (cfg.mode == BenchMode::Pipeline) {
+        os << ",\"result_interval\":";
+        st.interval.writeJson(os);
+    }
+    os << "}"
+        << ",\"engine\":" << (engineJson.empty() ? "null" : engineJson)
+        << ",\"peak_rss_kb\":" << peakRssKb()
+        << ",\"allocations\":{\"count\":" << allocs
+        << ",\"bytes\":" << (a1.bytes - a0.bytes)
+        << ",\"per_frame\":" << (st.frames ? static_cast<double>(allocs) / st.frames : 0.0)
+        << "}}";
+
+    if (cfg.out.empty()) {
+        std::cout << os.str() << std::endl;
+    }
+    else {
+        std::ofstream f(cfg.out);
+        f << os.str() << std::endl;
+        if (!f) {
+            std::cerr << "[synopsis_bench] Cannot write " << cfg.out << std::endl;
+            return 1;
+        }
+    }
+    return st.errors == 0 ? 0 : 1;
+}
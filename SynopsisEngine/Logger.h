@@ -8,11 +8,20 @@
 #include <string>
 #include <sstream>
 #include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
 #include <fstream>
 #include <memory>
 #include <iomanip>
 #include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <ctime>
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <algorithm>  // For std::min, std::max
 
 // Log levels
@@ -24,7 +33,24 @@ enum class LogLevel {
     Fatal = 4
 };
 
+// Compile-time minimum level (0 = Debug ... 4 = Fatal). Calls below it compile to nothing.
+// Release builds drop LOG_DEBUG* unless the project defines LOG_COMPILE_MIN_LEVEL=0.
+#ifndef LOG_COMPILE_MIN_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILE_MIN_LEVEL 1
+#else
+#define LOG_COMPILE_MIN_LEVEL 0
+#endif
+#endif
+
 // Logger class - thread-safe, works in both DLL and EXE
+//
+// Callers only check the level, build the message and push it into a bounded lock-free
+// MPSC ring (Vyukov-style sequence slots). A background thread stamps, formats and
+// writes whole batches: one OutputDebugStringA / file write / flush per batch instead
+// of per line. When the ring is full the message is dropped and counted rather than
+// blocking the caller; the writer reports the count. Error and Fatal wake the writer
+// immediately and Fatal waits until its line has been written.
 class Logger {
 public:
     static Logger& Instance() {
@@ -32,17 +58,29 @@ public:
         return instance;
     }
 
+    // The logger if Instance() has already created it, else nullptr. For teardown paths that
+    // must not construct it (and start its writer) just to stop it.
+    static Logger* Existing() {
+        return existing_.load(std::memory_order_acquire);
+    }
+
     // Set minimum log level (messages below this level are ignored)
     void SetLogLevel(LogLevel level) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        minLevel_ = level;
+        minLevel_.store(static_cast<int>(level), std::memory_order_relaxed);
+    }
+
+    // Cheap check used by the LOG_* macros before any formatting happens
+    bool IsEnabled(LogLevel level) const {
+        return static_cast<int>(level) >= minLevel_.load(std::memory_order_relaxed);
     }
 
     // Enable/disable file logging
     void SetFileLogging(bool enable, const std::string& filename = "") {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<std::mutex> lock(sinkMutex_);
         fileLoggingEnabled_ = enable;
         if (enable && !filename.empty()) {
+            if (logFile_.is_open())
+                logFile_.close();
             logFile_.open(filename, std::ios::app);
         } else if (!enable && logFile_.is_open()) {
             logFile_.close();
@@ -51,91 +89,140 @@ public:
 
     // Enable/disable stdout redirection (redirects stdout/stderr to OutputDebugString)
     void SetStdoutRedirection(bool enable) {
-        std::lock_guard<std::mutex> lock(mutex_);
+        std::lock_guard<std::mutex> lock(sinkMutex_);
         stdoutRedirectionEnabled_ = enable;
     }
 
     // Log a message
-    void Log(LogLevel level, const std::string& message, const char* file = nullptr, int line = 0) {
-        if (level < minLevel_) {
+    void Log(LogLevel level, std::string message, const char* file = nullptr, int line = 0) {
+        if (!IsEnabled(level)) {
             return;
         }
 
-        std::lock_guard<std::mutex> lock(mutex_);
-        
-        // Build log message
-        std::ostringstream oss;
-        
-        // Add timestamp
-        SYSTEMTIME st;
-        GetLocalTime(&st);
-        oss << "[" << std::setfill('0') << std::setw(2) << st.wHour << ":"
-            << std::setw(2) << st.wMinute << ":" << std::setw(2) << st.wSecond << "."
-            << std::setw(3) << st.wMilliseconds << "] ";
-        
-        // Add log level
-        const char* levelStr = GetLevelString(level);
-        oss << "[" << levelStr << "] ";
-        
-        // Add file and line if provided
-        if (file && line > 0) {
-            // Extract just the filename from the path
-            const char* filename = strrchr(file, '\\');
-            if (!filename) filename = strrchr(file, '/');
-            if (filename) filename++;
-            else filename = file;
-            oss << "[" << filename << ":" << line << "] ";
-        }
-        
-        // Add message
-        oss << message;
-        
-        // Ensure newline
-        std::string fullMessage = oss.str();
-        if (!fullMessage.empty() && fullMessage.back() != '\n') {
-            fullMessage += "\n";
+        // Claim a slot
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots_[pos & (kCapacity - 1)];
+            const size_t seq = slot->seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
         }
-        
-        // Output to debug window (works in both DLL and EXE when debugger is attached)
-        OutputDebugStringA(fullMessage.c_str());
-        
-        // Output to file if enabled
-        if (fileLoggingEnabled_ && logFile_.is_open()) {
-            logFile_ << fullMessage;
-            logFile_.flush();
+
+        slot->level = level;
+        slot->file = file;
+        slot->line = line;
+        slot->time = std::chrono::system_clock::now();
+        slot->message = std::move(message);
+        slot->seq.store(pos + 1, std::memory_order_release);
+
+        if (stopped_.load(std::memory_order_acquire)) {
+            Drain();
+            return;
         }
-        
-        // Output to stdout if redirection is enabled (for console apps)
-        if (stdoutRedirectionEnabled_) {
-            std::cout << fullMessage;
-            std::cout.flush();
+        // Bursts wake the writer every half ring so it keeps up without per-line signalling
+        if (level >= LogLevel::Error || (pos & (kCapacity / 2 - 1)) == 0) {
+            wakeCv_.notify_one();
+            if (level == LogLevel::Fatal)
+                Flush();
         }
     }
 
     // Convenience methods
-    void Debug(const std::string& message, const char* file = nullptr, int line = 0) {
-        Log(LogLevel::Debug, message, file, line);
+    void Debug(std::string message, const char* file = nullptr, int line = 0) {
+        Log(LogLevel::Debug, std::move(message), file, line);
+    }
+
+    void Info(std::string message, const char* file = nullptr, int line = 0) {
+        Log(LogLevel::Info, std::move(message), file, line);
     }
 
-    void Info(const std::string& message, const char* file = nullptr, int line = 0) {
-        Log(LogLevel::Info, message, file, line);
+    void Warning(std::string message, const char* file = nullptr, int line = 0) {
+        Log(LogLevel::Warning, std::move(message), file, line);
     }
 
-    void Warning(const std::string& message, const char* file = nullptr, int line = 0) {
-        Log(LogLevel::Warning, message, file, line);
+    void Error(std::string message, const char* file = nullptr, int line = 0) {
+        Log(LogLevel::Error, std::move(message), file, line);
+    }
+
+    void Fatal(std::string message, const char* file = nullptr, int line = 0) {
+        Log(LogLevel::Fatal, std::move(message), file, line);
+    }
+
+    // Block until everything logged before this call has been written
+    void Flush() {
+        if (stopped_.load(std::memory_order_acquire)) {
+            Drain();
+            return;
+        }
+        const size_t target = enqueuePos_.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        flushRequested_ = true;
+        wakeCv_.notify_one();
+        flushedCv_.wait_for(lock, std::chrono::seconds(2), [&] {
+            return writtenPos_.load(std::memory_order_acquire) >= target || stopped_.load(std::memory_order_acquire);
+        });
     }
 
-    void Error(const std::string& message, const char* file = nullptr, int line = 0) {
-        Log(LogLevel::Error, message, file, line);
+    // True until Shutdown(): the writer thread still runs
+    bool IsRunning() const {
+        return !stopped_.load(std::memory_order_acquire);
     }
 
-    void Fatal(const std::string& message, const char* file = nullptr, int line = 0) {
-        Log(LogLevel::Fatal, message, file, line);
+    // Stop the writer thread after writing what is queued. Call from the owning
+    // module's shutdown path; later messages are written synchronously by the caller.
+    // wait = false detaches the writer instead of joining it, for callers holding the
+    // loader lock (DllMain), where the thread could never finish exiting.
+    void Shutdown(bool wait = true) {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            stop_ = true;
+        }
+        wakeCv_.notify_one();
+        if (writer_.joinable() && writer_.get_id() != std::this_thread::get_id()) {
+            if (wait)
+                writer_.join();
+            else
+                writer_.detach();
+        }
+        stopped_.store(true, std::memory_order_release);
+        Drain();
     }
 
 private:
-    Logger() : minLevel_(LogLevel::Debug), fileLoggingEnabled_(false), stdoutRedirectionEnabled_(false) {}
+    static constexpr size_t kCapacity = 4096;   // power of two
+    static constexpr auto kIdleWait = std::chrono::milliseconds(20);
+
+    struct Slot {
+        std::atomic<size_t> seq{ 0 };
+        LogLevel level = LogLevel::Info;
+        const char* file = nullptr;
+        int line = 0;
+        std::chrono::system_clock::time_point time;
+        std::string message;
+    };
+
+    Logger() : minLevel_(static_cast<int>(LogLevel::Debug)), fileLoggingEnabled_(false), stdoutRedirectionEnabled_(false),
+        slots_(std::make_unique<Slot[]>(kCapacity)) {
+        for (size_t i = 0; i < kCapacity; ++i)
+            slots_[i].seq.store(i, std::memory_order_relaxed);
+        writer_ = std::thread(&Logger::WriterLoop, this);
+        existing_.store(this, std::memory_order_release);
+    }
     ~Logger() {
+        // At process exit the writer may already have been terminated by the OS;
+        // join returns at once and the remaining lines are drained here. A DLL stops
+        // the writer before its static destructors run (DllMain / explicit teardown).
+        existing_.store(nullptr, std::memory_order_release);
+        Shutdown();
         if (logFile_.is_open()) {
             logFile_.close();
         }
@@ -155,24 +242,163 @@ private:
         }
     }
 
-    std::mutex mutex_;
-    LogLevel minLevel_;
+    void WriterLoop() {
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        while (!stop_) {
+            if (!flushRequested_)
+                wakeCv_.wait_for(lock, kIdleWait);
+            flushRequested_ = false;
+            lock.unlock();
+            Drain();
+            lock.lock();
+            flushedCv_.notify_all();
+        }
+    }
+
+    // Single consumer: the writer thread, or the caller once the writer has stopped
+    void Drain() {
+        std::lock_guard<std::mutex> drainLock(drainMutex_);
+        batch_.clear();
+
+        const size_t lost = dropped_.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            batch_ += "[Logger] ";
+            batch_ += std::to_string(lost);
+            batch_ += " message(s) dropped, log ring full\n";
+        }
+
+        for (;;) {
+            Slot& slot = slots_[dequeuePos_ & (kCapacity - 1)];
+            if (slot.seq.load(std::memory_order_acquire) != dequeuePos_ + 1)
+                break;
+            AppendLine(slot);
+            slot.message.clear();
+            slot.seq.store(dequeuePos_ + kCapacity, std::memory_order_release);
+            ++dequeuePos_;
+        }
+
+        if (!batch_.empty())
+            WriteBatch(batch_);
+        writtenPos_.store(dequeuePos_, std::memory_order_release);
+    }
+
+    void AppendLine(const Slot& slot) {
+        char prefix[64];
+        const std::time_t tt = std::chrono::system_clock::to_time_t(slot.time);
+        const int ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            slot.time.time_since_epoch()).count() % 1000);
+        std::tm tmLocal;
+#ifdef _WIN32
+        localtime_s(&tmLocal, &tt);
+#else
+        localtime_r(&tt, &tmLocal);
+#endif
+        snprintf(prefix, sizeof(prefix), "[%02d:%02d:%02d.%03d] [%s] ",
+            tmLocal.tm_hour, tmLocal.tm_min, tmLocal.tm_sec, ms, GetLevelString(slot.level));
+        batch_ += prefix;
+
+        // Add file and line if provided
+        if (slot.file && slot.line > 0) {
+            // Extract just the filename from the path
+            const char* filename = strrchr(slot.file, '\\');
+            if (!filename) filename = strrchr(slot.file, '/');
+            if (filename) filename++;
+            else filename = slot.file;
+            batch_ += "[";
+            batch_ += filename;
+            batch_ += ":";
+            batch_ += std::to_string(slot.line);
+            batch_ += "] ";
+        }
+
+        batch_ += slot.message;
+
+        // Ensure newline
+        if (batch_.back() != '\n') {
+            batch_ += "\n";
+        }
+    }
+
+    void WriteBatch(const std::string& text) {
+        // Output to debug window (works in both DLL and EXE when debugger is attached)
+#ifdef _WIN32
+        OutputDebugStringA(text.c_str());
+#endif
+
+        std::lock_guard<std::mutex> lock(sinkMutex_);
+        // Output to file if enabled
+        if (fileLoggingEnabled_ && logFile_.is_open()) {
+            logFile_.write(text.data(), static_cast<std::streamsize>(text.size()));
+            logFile_.flush();
+        }
+
+        // Output to stdout if redirection is enabled (for console apps)
+        if (stdoutRedirectionEnabled_) {
+            std::cout.write(text.data(), static_cast<std::streamsize>(text.size()));
+            std::cout.flush();
+        }
+    }
+
+    std::atomic<int> minLevel_;
     bool fileLoggingEnabled_;
     bool stdoutRedirectionEnabled_;
     std::ofstream logFile_;
+    std::mutex sinkMutex_;          // sinks and their settings, never taken by Log()
+
+    // Ring buffer; producers touch only enqueuePos_ and their slot
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<size_t> enqueuePos_{ 0 };
+    alignas(64) size_t dequeuePos_ = 0;
+    std::atomic<size_t> writtenPos_{ 0 };
+    std::atomic<size_t> dropped_{ 0 };
+    std::string batch_;
+    std::mutex drainMutex_;
+
+    // Writer thread
+    std::thread writer_;
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    std::condition_variable flushedCv_;
+    bool stop_ = false;
+    std::atomic<bool> stopped_{ false };
+    bool flushRequested_ = false;
+
+    static inline std::atomic<Logger*> existing_{ nullptr };
 };
 
-// Convenience macros for logging with file and line information
-#define LOG_DEBUG(msg)   Logger::Instance().Debug(msg, __FILE__, __LINE__)
-#define LOG_INFO(msg)    Logger::Instance().Info(msg, __FILE__, __LINE__)
-#define LOG_WARNING(msg) Logger::Instance().Warning(msg, __FILE__, __LINE__)
-#define LOG_ERROR(msg)   Logger::Instance().Error(msg, __FILE__, __LINE__)
-#define LOG_FATAL(msg)   Logger::Instance().Fatal(msg, __FILE__, __LINE__)
+// Convenience macros for logging with file and line information.
+// The level is checked before the message expression is evaluated.
+#define LOG_AT_LEVEL(level, msg) \
+    do { if (Logger::Instance().IsEnabled(level)) Logger::Instance().Log(level, msg, __FILE__, __LINE__); } while(0)
+#define LOG_STREAM_AT_LEVEL(level, stream) \
+    do { if (Logger::Instance().IsEnabled(level)) { std::ostringstream oss; oss << stream; Logger::Instance().Log(level, oss.str(), __FILE__, __LINE__); } } while(0)
 
-// Stream-based logging macros (for formatted output)
-#define LOG_DEBUG_STREAM(stream)   do { std::ostringstream oss; oss << stream; Logger::Instance().Debug(oss.str(), __FILE__, __LINE__); } while(0)
-#define LOG_INFO_STREAM(stream)    do { std::ostringstream oss; oss << stream; Logger::Instance().Info(oss.str(), __FILE__, __LINE__); } while(0)
-#define LOG_WARNING_STREAM(stream) do { std::ostringstream oss; oss << stream; Logger::Instance().Warning(oss.str(), __FILE__, __LINE__); } while(0)
-#define LOG_ERROR_STREAM(stream)   do { std::ostringstream oss; oss << stream; Logger::Instance().Error(oss.str(), __FILE__, __LINE__); } while(0)
-#define LOG_FATAL_STREAM(stream)   do { std::ostringstream oss; oss << stream; Logger::Instance().Fatal(oss.str(), __FILE__, __LINE__); } while(0)
+#if LOG_COMPILE_MIN_LEVEL <= 0
+#define LOG_DEBUG(msg)             LOG_AT_LEVEL(LogLevel::Debug, msg)
+#define LOG_DEBUG_STREAM(stream)   LOG_STREAM_AT_LEVEL(LogLevel::Debug, stream)
+#else
+#define LOG_DEBUG(msg)             ((void)0)
+#define LOG_DEBUG_STREAM(stream)   ((void)0)
+#endif
+
+#if LOG_COMPILE_MIN_LEVEL <= 1
+#define LOG_INFO(msg)              LOG_AT_LEVEL(LogLevel::Info, msg)
+#define LOG_INFO_STREAM(stream)    LOG_STREAM_AT_LEVEL(LogLevel::Info, stream)
+#else
+#define LOG_INFO(msg)              ((void)0)
+#define LOG_INFO_STREAM(stream)    ((void)0)
+#endif
+
+#if LOG_COMPILE_MIN_LEVEL <= 2
+#define LOG_WARNING(msg)           LOG_AT_LEVEL(LogLevel::Warning, msg)
+#define LOG_WARNING_STREAM(stream) LOG_STREAM_AT_LEVEL(LogLevel::Warning, stream)
+#else
+#define LOG_WARNING(msg)           ((void)0)
+#define LOG_WARNING_STREAM(stream) ((void)0)
+#endif
 
+// Errors and fatals are never compiled out
+#define LOG_ERROR(msg)             LOG_AT_LEVEL(LogLevel::Error, msg)
+#define LOG_FATAL(msg)             LOG_AT_LEVEL(LogLevel::Fatal, msg)
+#define LOG_ERROR_STREAM(stream)   LOG_STREAM_AT_LEVEL(LogLevel::Error, stream)
+#define LOG_FATAL_STREAM(stream)   LOG_STREAM_AT_LEVEL(LogLevel::Fatal, stream)
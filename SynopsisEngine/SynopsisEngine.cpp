@@ -1,13 +1,88 @@
 #include "pch.h"
 #include "SynopsisEngine.h"
 
-#include "third_party\yolo_runner.h"
+#include "third_party/yolo_runner.h"
+#include "result_block.h"
+#include "video_pipeline.h"
+#include "stream_scheduler.h"
+#include "synopsis_job.h"
+#include "event_engine.h"
+#include "Logger.h"
 #include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
+#include <vector>
 
 static std::mutex g_mutex;
-static std::map<vsHandle, std::unique_ptr<YoloRunner>> g_instances;
+// Shared so a synopsis job keeps its runner (and the metrics its extra sessions report
+// into) alive when the handle is released while the job runs
+static std::map<vsHandle, std::shared_ptr<YoloRunner>> g_instances;
+// g_mutex also serialises inference, so it is held for whole model runs. Handles are added
+// and removed under both locks (g_mutex first); metric calls look up under this one alone.
+static std::shared_mutex g_registryMutex;
+// How each handle was loaded, for jobs that need more sessions of the same model
+static std::map<vsHandle, std::pair<std::basic_string<TCHAR>, vsModelOptions>> g_modelSources;
+
+// Open video sources keyed by (handle, source id). Separate lock: pipelines call back
+// into g_mutex from their inference threads and are joined without holding it.
+static std::mutex g_videoMutex;
+static std::map<std::pair<vsHandle, int>, std::unique_ptr<VideoPipeline>> g_videos;
+
+// Schedulers own their sessions, so they never touch g_mutex or g_instances.
+static std::mutex g_schedulerMutex;
+static std::map<vsHandle, std::unique_ptr<StreamScheduler>> g_schedulers;
+
+// Event engines are plain rule state, independent of any model handle.
+static std::mutex g_eventMutex;
+static std::map<vsHandle, std::unique_ptr<EventEngine>> g_eventEngines;
+
+// Wraps caller memory as a 3-channel BGR image; only 1/4 channel input is converted.
+static bool wrapImage(const unsigned char* imgData, int width, int height, int channels, cv::Mat& out)
+{
+	if (!imgData || width <= 0 || height <= 0)
+		return false;
+	if (channels == 3) {
+		out = cv::Mat(height, width, CV_8UC3, const_cast<unsigned char*>(imgData));
+	}
+	else if (channels == 4) {
+		cv::cvtColor(cv::Mat(height, width, CV_8UC4, const_cast<unsigned char*>(imgData)), out, cv::COLOR_BGRA2BGR);
+	}
+	else if (channels == 1) {
+		cv::cvtColor(cv::Mat(height, width, CV_8UC1, const_cast<unsigned char*>(imgData)), out, cv::COLOR_GRAY2BGR);
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// Common path of the block returning entry points: validate, look up the runner under
+// g_mutex, check its task and hand the wrapped image to the task specific builder.
+template <typename Fn>
+static vsCode runToBlock(vsHandle yoloHandle, YoloTask task, const unsigned char* imgData, int width, int height, int channels,
+	vsResultHeader** outResult, Fn&& build)
+{
+	if (!yoloHandle || !outResult)
+		return VS_ERROR_INVALID_HANDLE;
+	*outResult = nullptr;
+
+	cv::Mat img;
+	if (!wrapImage(imgData, width, height, channels, img))
+		return VS_ERROR_INVALID_HANDLE;
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+	auto it = g_instances.find(yoloHandle);
+	if (it == g_instances.end())
+		return VS_ERROR_INVALID_HANDLE;
+
+	YoloRunner* runner = it->second.get();
+	if (runner->task() != task)
+		return VS_ERROR_TASK_MISMATCH;
+
+	*outResult = build(runner, img);
+	return *outResult ? VS_SUCCESS : VS_ERROR_UNKNOWN;
+}
 
 /*
 vsCode VSENGINE_API vsInitializeEngine(vsHandle* outHandle, const TCHAR* app_path)
@@ -23,36 +98,47 @@ vsCode VSENGINE_API vsShutdownEngine(vsHandle handle)
 	delete reinterpret_cast<int*>(handle);
 	return VS_SUCCESS;
 }
+*/
 
-vsCode VSENGINE_API vsOpenVideo(vsHandle handle, int source_id, const TCHAR* url)
+vsCode vsInitYoloModel(vsHandle* outYolo, const TCHAR* appPath, YoloTask task)
 {
-	// Placeholder implementation
-	return VS_SUCCESS;
+	vsModelOptions options = {};
+	options.task = task;
+	options.useGPU = 1;
+	options.precision = VS_PRECISION_FP32;
+	return vsInitYoloModelEx(outYolo, appPath, &options);
 }
 
-vsCode VSENGINE_API vsCloseVideo(vsHandle handle, int source_id)
+// Loads one runner for the given options, nullptr on failure
+static std::unique_ptr<YoloRunner> createRunner(const TCHAR* appPath, const vsModelOptions* options)
 {
-	// Placeholder implementation
-	return VS_SUCCESS;
+	const TCHAR* variant = nullptr;
+	if (options->precision == VS_PRECISION_FP16)
+		variant = _T("-fp16");
+	else if (options->precision == VS_PRECISION_INT8)
+		variant = _T("-int8");
+
+	auto runner = std::make_unique<YoloRunner>();
+	if (!runner->Init(options->task, appPath, options->intraOpThreads, options->useGPU != 0, variant))
+		return nullptr;
+	return runner;
 }
-*/
 
-vsCode vsInitYoloModel(vsHandle* outYolo, const TCHAR* appPath, YoloTask task)
+vsCode vsInitYoloModelEx(vsHandle* outYolo, const TCHAR* appPath, const vsModelOptions* options)
 {
-	if (!outYolo || !appPath)
+	if (!outYolo || !appPath || !options)
 		return VS_ERROR_INVALID_HANDLE;
 
-	
-
-	auto runner = std::make_unique<YoloRunner>();
-
-	if (!runner->Init(task, appPath))
+	auto runner = createRunner(appPath, options);
+	if (!runner)
 		return VS_ERROR_INITIALIZATION_FAILED;
 
 	vsHandle handle = reinterpret_cast<vsHandle>(runner.get());
 
 	std::lock_guard<std::mutex> lock(g_mutex);
+	std::unique_lock<std::shared_mutex> registryLock(g_registryMutex);
 	g_instances[handle] = std::move(runner);
+	g_modelSources[handle] = std::make_pair(std::basic_string<TCHAR>(appPath), *options);
 	*outYolo = handle;
 
 	return VS_SUCCESS;
@@ -60,12 +146,68 @@ vsCode vsInitYoloModel(vsHandle* outYolo, const TCHAR* appPath, YoloTask task)
 
 vsCode VSENGINE_API vsReleaseYoloModel(vsHandle yoloHandle)
 {
-	std::lock_guard<std::mutex> lock(g_mutex);
-	auto it = g_instances.find(yoloHandle);
-	if (it == g_instances.end())
-		return VS_ERROR_INVALID_HANDLE;
+	// The runner and its sources leave the maps under both locks (g_videoMutex first), so
+	// vsOpenVideoEx cannot add a source in between. The sources are stopped outside the
+	// locks, before the runner whose metrics they record into is destroyed. A running
+	// vsRunSynopsis holds its own reference, so then the runner goes when the job ends.
+	std::shared_ptr<YoloRunner> runner;
+	std::vector<std::unique_ptr<VideoPipeline>> sources;
+	{
+		std::lock_guard<std::mutex> videoLock(g_videoMutex);
+		std::lock_guard<std::mutex> lock(g_mutex);
+		std::unique_lock<std::shared_mutex> registryLock(g_registryMutex);
+		auto it = g_instances.find(yoloHandle);
+		if (it == g_instances.end())
+			return VS_ERROR_INVALID_HANDLE;
+		runner = std::move(it->second);
+		g_instances.erase(it);
+		g_modelSources.erase(yoloHandle);
+
+		for (auto v = g_videos.begin(); v != g_videos.end();) {
+			if (v->first.first == yoloHandle) {
+				sources.push_back(std::move(v->second));
+				v = g_videos.erase(v);
+			}
+			else {
+				++v;
+			}
+		}
+	}
+	sources.clear();
+	runner.reset();
+	return VS_SUCCESS;
+}
+
+vsCode vsShutdown()
+{
+	// Same order as the single releases: sources first, then what they run on
+	std::map<std::pair<vsHandle, int>, std::unique_ptr<VideoPipeline>> videos;
+	std::map<vsHandle, std::unique_ptr<StreamScheduler>> schedulers;
+	std::map<vsHandle, std::unique_ptr<EventEngine>> events;
+	std::map<vsHandle, std::shared_ptr<YoloRunner>> instances;
+	{
+		std::lock_guard<std::mutex> videoLock(g_videoMutex);
+		std::lock_guard<std::mutex> lock(g_mutex);
+		std::unique_lock<std::shared_mutex> registryLock(g_registryMutex);
+		videos.swap(g_videos);
+		instances.swap(g_instances);
+		g_modelSources.clear();
+	}
+	{
+		std::lock_guard<std::mutex> lock(g_schedulerMutex);
+		schedulers.swap(g_schedulers);
+	}
+	{
+		std::lock_guard<std::mutex> lock(g_eventMutex);
+		events.swap(g_eventEngines);
+	}
+	videos.clear();
+	schedulers.clear();
+	events.clear();
+	instances.clear();
 
-	g_instances.erase(it);
+	LOG_INFO_STREAM("[SynopsisEngine] Shut down");
+	Logger::Instance().Shutdown();
 	return VS_SUCCESS;
 }
 
@@ -82,18 +224,8 @@ vsCode vsDetectObjects(vsHandle yoloHandle, const unsigned char* imgData, int wi
 	YoloRunner* runner = it->second.get();
 
 	cv::Mat img;
-	if (channels == 3) {
-		img = cv::Mat(height, width, CV_8UC3, const_cast<unsigned char*>(imgData)).clone();
-	}
-	else if (channels == 4) {
-		img = cv::Mat(height, width, CV_8UC4, const_cast<unsigned char*>(imgData)).clone();
-	}
-	else if (channels == 1) {
-		img = cv::Mat(height, width, CV_8UC1, const_cast<unsigned char*>(imgData)).clone();
-	}
-	else {
+	if (!wrapImage(imgData, width, height, channels, img))
 		return VS_ERROR_INVALID_HANDLE;
-	}
 
 	std::vector<Detection> detections = runner->runDetect(img);
 
@@ -109,4 +241,593 @@ vsCode vsDetectObjects(vsHandle yoloHandle, const unsigned char* imgData, int wi
 	}
 
 	return VS_SUCCESS;
-}
\ No newline at end of file
+}
+
+vsCode vsReleaseDetections(Detection* detections)
+{
+	delete[] detections;
+	return VS_SUCCESS;
+}
+
+vsCode vsSegment(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsMaskEncoding maskEncoding, vsResultHeader** outResult)
+{
+	return runToBlock(yoloHandle, YT_SEGMENT, imgData, width, height, channels, outResult,
+		[maskEncoding](YoloRunner* runner, const cv::Mat& img) {
+			return BuildSegmentBlock(runner->runSegment(img), img.size(), maskEncoding);
+		});
+}
+
+vsCode vsEstimatePose(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsResultHeader** outResult)
+{
+	return runToBlock(yoloHandle, YT_POSE, imgData, width, height, channels, outResult,
+		[](YoloRunner* runner, const cv::Mat& img) {
+			return BuildPoseBlock(runner->runPose(img), img.size());
+		});
+}
+
+vsCode vsDetectOriented(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsResultHeader** outResult)
+{
+	return runToBlock(yoloHandle, YT_OBB, imgData, width, height, channels, outResult,
+		[](YoloRunner* runner, const cv::Mat& img) {
+			return BuildObbBlock(runner->runOBB(img), img.size());
+		});
+}
+
+vsCode vsClassify(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsResultHeader** outResult)
+{
+	return runToBlock(yoloHandle, YT_CLASSIFY, imgData, width, height, channels, outResult,
+		[](YoloRunner* runner, const cv::Mat& img) {
+			ClassificationResult res;
+			bool ok = runner->runClassify(img, res);
+			return BuildClassifyBlock(ok ? &res : nullptr, img.size());
+		});
+}
+
+vsCode vsReleaseResult(vsResultHeader* result)
+{
+	if (!result)
+		return VS_SUCCESS;
+	if (result->magic != VS_RESULT_MAGIC)
+		return VS_ERROR_INVALID_HANDLE;
+	FreeResultBlock(result);
+	return VS_SUCCESS;
+}
+
+// Looks up the runner of a handle; caller must hold g_mutex (to run it) or g_registryMutex.
+static YoloRunner* findRunner(vsHandle yoloHandle)
+{
+	auto it = g_instances.find(yoloHandle);
+	return it == g_instances.end() ? nullptr : it->second.get();
+}
+
+vsCode vsSetThreadStream(int streamId)
+{
+	if (streamId < 0 || streamId >= MetricsRegistry::kMaxStreams)
+		return VS_ERROR_UNKNOWN;
+	metrics::setThreadStream(streamId);
+	return VS_SUCCESS;
+}
+
+vsCode vsGetModelInfo(vsHandle yoloHandle, vsModelInfo* outInfo)
+{
+	if (!yoloHandle || !outInfo)
+		return VS_ERROR_INVALID_HANDLE;
+
+	std::lock_guard<std::mutex> lock(g_mutex);
+	YoloRunner* runner = findRunner(yoloHandle);
+	if (!runner)
+		return VS_ERROR_INVALID_HANDLE;
+
+	*outInfo = {};
+	const std::string path = ToUtf8(runner->modelPath());
+	if (path.size() >= sizeof(outInfo->modelPathUtf8))
+		return VS_ERROR_UNKNOWN;
+	memcpy(outInfo->modelPathUtf8, path.c_str(), path.size() + 1);
+	outInfo->confThreshold = runner->confThreshold();
+	outInfo->iouThreshold = runner->iouThreshold();
+	return VS_SUCCESS;
+}
+
+vsCode vsGetMetrics(vsHandle yoloHandle, int streamId, vsMetricsSnapshot* outSnapshot)
+{
+	if (!yoloHandle || !outSnapshot)
+		return VS_ERROR_INVALID_HANDLE;
+
+	std::shared_lock<std::shared_mutex> lock(g_registryMutex);
+	YoloRunner* runner = findRunner(yoloHandle);
+	if (!runner)
+		return VS_ERROR_INVALID_HANDLE;
+
+	runner->metrics().snapshot(streamId, *outSnapshot);
+	return VS_SUCCESS;
+}
+
+vsCode vsGetMetricsJson(vsHandle yoloHandle, int streamId, char* buffer, int bufferSize, int* outLength)
+{
+	if (!yoloHandle || !outLength)
+		return VS_ERROR_INVALID_HANDLE;
+
+	std::string json;
+	{
+		std::shared_lock<std::shared_mutex> lock(g_registryMutex);
+		YoloRunner* runner = findRunner(yoloHandle);
+		if (!runner)
+			return VS_ERROR_INVALID_HANDLE;
+		json = runner->metrics().toJson(streamId);
+	}
+
+	*outLength = static_cast<int>(json.size());
+	if (!buffer || bufferSize <= *outLength)
+		return VS_ERROR_UNKNOWN;
+	memcpy(buffer, json.c_str(), json.size() + 1);
+	return VS_SUCCESS;
+}
+
+vsCode vsResetMetrics(vsHandle yoloHandle, int streamId)
+{
+	std::shared_lock<std::shared_mutex> lock(g_registryMutex);
+	YoloRunner* runner = findRunner(yoloHandle);
+	if (!runner)
+		return VS_ERROR_INVALID_HANDLE;
+
+	runner->metrics().reset(streamId);
+	return VS_SUCCESS;
+}
+
+vsCode vsRecordMetric(vsHandle yoloHandle, int streamId, vsMetricStage stage, double micros)
+{
+	if (stage < 0 || stage >= VS_STAGE_MAX || micros < 0)
+		return VS_ERROR_UNKNOWN;
+
+	std::shared_lock<std::shared_mutex> lock(g_registryMutex);
+	YoloRunner* runner = findRunner(yoloHandle);
+	if (!runner)
+		return VS_ERROR_INVALID_HANDLE;
+
+	runner->metrics().record(streamId, static_cast<MetricStage>(stage), static_cast<uint64_t>(micros * 1000.0));
+	return VS_SUCCESS;
+}
+
+vsCode vsRecordDrops(vsHandle yoloHandle, int streamId, unsigned int count)
+{
+	std::shared_lock<std::shared_mutex> lock(g_registryMutex);
+	YoloRunner* runner = findRunner(yoloHandle);
+	if (!runner)
+		return VS_ERROR_INVALID_HANDLE;
+
+	runner->metrics().addDropped(streamId, count);
+	return VS_SUCCESS;
+}
+
+// Runs whatever task the runner was created for and packs the result block; caller holds g_mutex.
+static vsResultHeader* runTask(YoloRunner* runner, const cv::Mat& img, vsMaskEncoding maskEncoding)
+{
+	switch (runner->task()) {
+	case YT_DETECT:
+		return BuildDetectBlock(runner->runDetect(img), img.size());
+	case YT_SEGMENT:
+		return BuildSegmentBlock(runner->runSegment(img), img.size(), maskEncoding);
+	case YT_POSE:
+		return BuildPoseBlock(runner->runPose(img), img.size());
+	case YT_OBB:
+		return BuildObbBlock(runner->runOBB(img), img.size());
+	case YT_CLASSIFY: {
+		ClassificationResult res;
+		bool ok = runner->runClassify(img, res);
+		return BuildClassifyBlock(ok ? &res : nullptr, img.size());
+	}
+	default:
+		return nullptr;
+	}
+}
+
+// Looks up an open source; caller must hold g_videoMutex.
+static VideoPipeline* findVideo(vsHandle handle, int sourceId)
+{
+	auto it = g_videos.find(std::make_pair(handle, sourceId));
+	return it == g_videos.end() ? nullptr : it->second.get();
+}
+
+vsCode vsOpenVideo(vsHandle handle, int source_id, const TCHAR* url)
+{
+	vsVideoOptions options = {};
+	options.pacing = VS_VIDEO_ALL_FRAMES;
+	options.maskEncoding = VS_MASK_RLE;
+	return vsOpenVideoEx(handle, source_id, url, &options, nullptr, nullptr);
+}
+
+vsCode vsOpenVideoEx(vsHandle handle, int source_id, const TCHAR* url, const vsVideoOptions* options,
+	vsFrameResultCallback callback, void* userData)
+{
+	if (!handle || !url || !options)
+		return VS_ERROR_INVALID_HANDLE;
+
+	MetricsRegistry* registry = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(g_mutex);
+		YoloRunner* runner = findRunner(handle);
+		if (!runner)
+			return VS_ERROR_INVALID_HANDLE;
+		registry = &runner->metrics();
+	}
+
+	const vsMaskEncoding maskEncoding = options->maskEncoding;
+	auto infer = [handle, maskEncoding](const cv::Mat& frame) -> vsResultHeader* {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		YoloRunner* runner = findRunner(handle);
+		return runner ? runTask(runner, frame, maskEncoding) : nullptr;
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(g_videoMutex);
+		if (findVideo(handle, source_id))
+			return VS_ERROR_OPEN_FAILED;
+	}
+
+	// Opening a network stream can take a while, so it happens outside the lock
+	auto pipeline = std::make_unique<VideoPipeline>(source_id, *options, infer, registry, callback, userData);
+	if (!pipeline->Open(ToUtf8(JString(url))))
+		return VS_ERROR_OPEN_FAILED;
+
+	{
+		// The handle may have been released while the source opened, taking registry with it.
+		// Checked and started under both locks, so release either sees this source or wins first.
+		std::lock_guard<std::mutex> videoLock(g_videoMutex);
+		std::lock_guard<std::mutex> lock(g_mutex);
+		if (!findRunner(handle))
+			return VS_ERROR_INVALID_HANDLE;
+		auto& slot = g_videos[std::make_pair(handle, source_id)];
+		if (!slot) {
+			slot = std::move(pipeline);
+			slot->Start();
+			return VS_SUCCESS;
+		}
+	}
+	return VS_ERROR_OPEN_FAILED;   // same id opened concurrently
+}
+
+vsCode vsPollVideo(vsHandle handle, int source_id, vsFrameResult* outFrame, int timeoutMs)
+{
+	if (!outFrame)
+		return VS_ERROR_INVALID_HANDLE;
+
+	// The pipeline stays alive while polling: only vsCloseVideo/vsReleaseYoloModel remove it,
+	// and they must not race with a poll on the same source.
+	VideoPipeline* pipeline = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(g_videoMutex);
+		pipeline = findVideo(handle, source_id);
+	}
+	if (!pipeline || pipeline->usesCallback())
+		return VS_ERROR_INVALID_HANDLE;
+
+	switch (pipeline->Poll(*outFrame, timeoutMs)) {
+	case VideoPipeline::PollStatus::Frame:
+		return VS_SUCCESS;
+	case VideoPipeline::PollStatus::Timeout:
+		return VS_ERROR_TIMEOUT;
+	default:
+		return VS_ERROR_END_OF_STREAM;
+	}
+}
+
+vsCode vsGetVideoInfo(vsHandle handle, int source_id, vsVideoInfo* outInfo)
+{
+	if (!outInfo)
+		return VS_ERROR_INVALID_HANDLE;
+
+	std::lock_guard<std::mutex> lock(g_videoMutex);
+	VideoPipeline* pipeline = findVideo(handle, source_id);
+	if (!pipeline)
+		return VS_ERROR_INVALID_HANDLE;
+	pipeline->GetInfo(*outInfo);
+	return VS_SUCCESS;
+}
+
+vsCode vsGetVideoWriterStats(vsHandle handle, int source_id, vsWriterStats* outStats)
+{
+	if (!outStats)
+		return VS_ERROR_INVALID_HANDLE;
+
+	std::lock_guard<std::mutex> lock(g_videoMutex);
+	VideoPipeline* pipeline = findVideo(handle, source_id);
+	if (!pipeline || !pipeline->GetWriterStats(*outStats))
+		return VS_ERROR_INVALID_HANDLE;
+	return VS_SUCCESS;
+}
+
+vsCode vsCloseVideo(vsHandle handle, int source_id)
+{
+	std::unique_ptr<VideoPipeline> pipeline;
+	{
+		std::lock_guard<std::mutex> lock(g_videoMutex);
+		auto it = g_videos.find(std::make_pair(handle, source_id));
+		if (it == g_videos.end())
+			return VS_ERROR_INVALID_HANDLE;
+		pipeline = std::move(it->second);
+		g_videos.erase(it);
+	}
+	pipeline->Stop();
+	return VS_SUCCESS;
+}
+
+// Looks up a scheduler; the caller must not race the lookup with vsDestroyScheduler.
+static StreamScheduler* findScheduler(vsHandle scheduler)
+{
+	std::lock_guard<std::mutex> lock(g_schedulerMutex);
+	auto it = g_schedulers.find(scheduler);
+	return it == g_schedulers.end() ? nullptr : it->second.get();
+}
+
+vsCode vsCreateScheduler(vsHandle* outScheduler, const TCHAR* appPath, const vsModelOptions* model,
+	const vsSchedulerOptions* options)
+{
+	if (!outScheduler || !appPath || !model || !options)
+		return VS_ERROR_INVALID_HANDLE;
+
+	const int count = options->sessions > 0 ? options->sessions : 1;
+	std::vector<std::unique_ptr<YoloRunner>> sessions;
+	for (int i = 0; i < count; ++i) {
+		auto runner = createRunner(appPath, model);
+		if (!runner)
+			return VS_ERROR_INITIALIZATION_FAILED;
+		sessions.push_back(std::move(runner));
+	}
+
+	auto scheduler = std::make_unique<StreamScheduler>(*options, std::move(sessions),
+		[](YoloRunner& session, const cv::Mat& frame, vsMaskEncoding maskEncoding) {
+			return runTask(&session, frame, maskEncoding);
+		});
+	scheduler->Start();
+
+	vsHandle handle = reinterpret_cast<vsHandle>(scheduler.get());
+	std::lock_guard<std::mutex> lock(g_schedulerMutex);
+	g_schedulers[handle] = std::move(scheduler);
+	*outScheduler = handle;
+	return VS_SUCCESS;
+}
+
+vsCode vsDestroyScheduler(vsHandle scheduler)
+{
+	std::unique_ptr<StreamScheduler> owned;
+	{
+		std::lock_guard<std::mutex> lock(g_schedulerMutex);
+		auto it = g_schedulers.find(scheduler);
+		if (it == g_schedulers.end())
+			return VS_ERROR_INVALID_HANDLE;
+		owned = std::move(it->second);
+		g_schedulers.erase(it);
+	}
+	owned->Stop();
+	return VS_SUCCESS;
+}
+
+vsCode vsAddStream(vsHandle scheduler, int streamId, const vsStreamOptions* options)
+{
+	StreamScheduler* sched = findScheduler(scheduler);
+	if (!sched || !options)
+		return VS_ERROR_INVALID_HANDLE;
+	return sched->AddStream(streamId, *options) ? VS_SUCCESS : VS_ERROR_UNKNOWN;
+}
+
+vsCode vsRemoveStream(vsHandle scheduler, int streamId)
+{
+	StreamScheduler* sched = findScheduler(scheduler);
+	if (!sched)
+		return VS_ERROR_INVALID_HANDLE;
+	return sched->RemoveStream(streamId) ? VS_SUCCESS : VS_ERROR_UNKNOWN;
+}
+
+vsCode vsSubmitFrame(vsHandle scheduler, int streamId, const unsigned char* imgData, int width, int height,
+	int channels, int64_t frameIndex, double timestampMs, int timeoutMs)
+{
+	StreamScheduler* sched = findScheduler(scheduler);
+	if (!sched)
+		return VS_ERROR_INVALID_HANDLE;
+
+	cv::Mat img;
+	if (!wrapImage(imgData, width, height, channels, img))
+		return VS_ERROR_INVALID_HANDLE;
+
+	switch (sched->Submit(streamId, img, frameIndex, timestampMs, timeoutMs)) {
+	case StreamScheduler::SubmitStatus::Queued:
+		return VS_SUCCESS;
+	case StreamScheduler::SubmitStatus::Full:
+	case StreamScheduler::SubmitStatus::Dropped:
+		return VS_ERROR_TIMEOUT;
+	default:
+		return VS_ERROR_INVALID_HANDLE;
+	}
+}
+
+vsCode vsGetStreamStats(vsHandle scheduler, int streamId, vsStreamStats* outStats)
+{
+	StreamScheduler* sched = findScheduler(scheduler);
+	if (!sched || !outStats)
+		return VS_ERROR_INVALID_HANDLE;
+	return sched->GetStats(streamId, *outStats) ? VS_SUCCESS : VS_ERROR_INVALID_HANDLE;
+}
+
+vsCode vsGetSchedulerMetricsJson(vsHandle scheduler, int streamId, char* buffer, int bufferSize, int* outLength)
+{
+	StreamScheduler* sched = findScheduler(scheduler);
+	if (!sched || !outLength)
+		return VS_ERROR_INVALID_HANDLE;
+
+	const std::string json = sched->metrics().toJson(streamId);
+	*outLength = static_cast<int>(json.size());
+	if (!buffer || bufferSize <= *outLength)
+		return VS_ERROR_UNKNOWN;
+	memcpy(buffer, json.c_str(), json.size() + 1);
+	return VS_SUCCESS;
+}
+
+vsCode vsRunSynopsis(vsHandle handle, const TCHAR* url, const vsSynopsisOptions* options,
+	vsSynopsisProgressCallback progress, void* userData)
+{
+	if (!handle || !url || !options || !options->workDirUtf8 || !options->outputUtf8)
+		return VS_ERROR_INVALID_HANDLE;
+	std::basic_string<TCHAR> appPath;
+	vsModelOptions model{};
+	// Held for the whole job: the extra sessions below report into its metrics, which must
+	// outlive them even if the handle is released or the engine shut down meanwhile. The
+	// handle's own session is looked up per frame, so a released handle stops the job.
+	std::shared_ptr<YoloRunner> owner;
+	{
+		std::lock_guard<std::mutex> lock(g_mutex);
+		auto it = g_instances.find(handle);
+		auto source = g_modelSources.find(handle);
+		if (it == g_instances.end() || source == g_modelSources.end())
+			return VS_ERROR_INVALID_HANDLE;
+		appPath = source->second.first;
+		model = source->second.second;
+		owner = it->second;
+	}
+	MetricsRegistry* metrics = &owner->metrics();
+
+	// The handle's own session serves one segment; every further segment gets a private
+	// session of the same model, reporting into the handle's metrics
+	const vsMaskEncoding maskEncoding = options->maskEncoding;
+	const int segments = options->segments > 1 ? options->segments : 1;
+	std::vector<SynopsisJob::InferFn> infer;
+	infer.push_back([handle, maskEncoding](const cv::Mat& frame) -> vsResultHeader* {
+		std::lock_guard<std::mutex> lock(g_mutex);
+		YoloRunner* runner = findRunner(handle);
+		return runner ? runTask(runner, frame, maskEncoding) : nullptr;
+	});
+	for (int i = 1; i < segments; ++i) {
+		std::shared_ptr<YoloRunner> session = createRunner(appPath.c_str(), &model);
+		if (!session)
+			return VS_ERROR_INITIALIZATION_FAILED;
+		session->setMetricsSink(metrics);
+		infer.push_back([session, maskEncoding](const cv::Mat& frame) {
+			return runTask(session.get(), frame, maskEncoding);
+		});
+	}
+	// The re-ID model gets a session of its own for the merge pass
+	TubeMerger::EmbedFn embed;
+	std::shared_ptr<YoloRunner> reid;
+	if (options->reid) {
+		reid = std::make_shared<YoloRunner>();
+		if (!reid->InitReId(appPath.c_str(), model.intraOpThreads, model.useGPU != 0))
+			return VS_ERROR_INITIALIZATION_FAILED;
+		reid->setMetricsSink(metrics);
+		embed = [reid](const std::vector<cv::Mat>& crops, cv::Mat& embeddings) {
+			return reid->runEmbed(crops, embeddings);
+		};
+	}
+	SynopsisJob::ProgressFn onProgress;
+	if (progress)
+		onProgress = [progress, userData](int pass, double fraction) { return progress(userData, pass, fraction) != 0; };
+
+	SynopsisJob::Options jobOptions;
+	jobOptions.frameStride = options->frameStride;
+	jobOptions.segments = segments;
+	if (options->memoryLimitMB > 0)
+		jobOptions.memoryLimitMB = static_cast<size_t>(options->memoryLimitMB);
+	if (options->checkpointSeconds > 0)
+		jobOptions.checkpointSeconds = options->checkpointSeconds;
+	jobOptions.batchSeconds = options->batchSeconds;
+	if (options->classIds && options->classCount > 0)
+		jobOptions.query.classes.assign(options->classIds, options->classIds + options->classCount);
+	if (options->zoneXY && options->zonePointCount >= 3) {
+		for (int i = 0; i < options->zonePointCount; ++i)
+			jobOptions.query.zone.emplace_back(options->zoneXY[2 * i], options->zoneXY[2 * i + 1]);
+	}
+	jobOptions.query.colors = options->colorMask;
+	jobOptions.fromSeconds = options->fromSeconds;
+	jobOptions.toSeconds = options->toSeconds;
+	if (options->reidMinSimilarity > 0.0f)
+		jobOptions.merger.minSimilarity = options->reidMinSimilarity;
+	if (options->reidMaxGapSeconds > 0.0)
+		jobOptions.merger.maxGapSeconds = options->reidMaxGapSeconds;
+	if (reid)
+		jobOptions.merger.modelPathUtf8 = ToUtf8(reid->reidModelPath());
+
+	SynopsisJob job(jobOptions);
+	if (!job.Run(ToUtf8(JString(url)), options->workDirUtf8, options->outputUtf8, std::move(infer), onProgress, embed))
+		return VS_ERROR_UNKNOWN;
+	return job.placedTubes() > 0 ? VS_SUCCESS : VS_ERROR_NO_MATCHES;
+}
+
+// Looks up an event engine; the caller must not race the lookup with vsDestroyEventEngine.
+static EventEngine* findEventEngine(vsHandle engine)
+{
+	std::lock_guard<std::mutex> lock(g_eventMutex);
+	auto it = g_eventEngines.find(engine);
+	return it == g_eventEngines.end() ? nullptr : it->second.get();
+}
+
+vsCode vsCreateEventEngine(vsHandle* outEngine, const vsEventEngineOptions* options)
+{
+	if (!outEngine)
+		return VS_ERROR_INVALID_HANDLE;
+
+	const vsEventEngineOptions defaults = {};
+	auto engine = std::make_unique<EventEngine>(options ? *options : defaults);
+	vsHandle handle = reinterpret_cast<vsHandle>(engine.get());
+	std::lock_guard<std::mutex> lock(g_eventMutex);
+	g_eventEngines[handle] = std::move(engine);
+	*outEngine = handle;
+	return VS_SUCCESS;
+}
+
+vsCode vsDestroyEventEngine(vsHandle engine)
+{
+	std::lock_guard<std::mutex> lock(g_eventMutex);
+	return g_eventEngines.erase(engine) ? VS_SUCCESS : VS_ERROR_INVALID_HANDLE;
+}
+
+vsCode vsSetEventRule(vsHandle engine, int streamId, const vsEventRule* rule)
+{
+	EventEngine* events = findEventEngine(engine);
+	if (!events || !rule)
+		return VS_ERROR_INVALID_HANDLE;
+	return events->SetRule(streamId, *rule) ? VS_SUCCESS : VS_ERROR_UNKNOWN;
+}
+
+vsCode vsRemoveEventRule(vsHandle engine, int streamId, int ruleId)
+{
+	EventEngine* events = findEventEngine(engine);
+	if (!events)
+		return VS_ERROR_INVALID_HANDLE;
+	return events->RemoveRule(streamId, ruleId) ? VS_SUCCESS : VS_ERROR_UNKNOWN;
+}
+
+vsCode vsUpdateTracks(vsHandle engine, int streamId, int64_t frameIndex, double timestampMs,
+	const vsTrackBox* tracks, int count)
+{
+	EventEngine* events = findEventEngine(engine);
+	if (!events || (count > 0 && !tracks))
+		return VS_ERROR_INVALID_HANDLE;
+	events->Update(streamId, frameIndex, timestampMs, tracks, count);
+	return VS_SUCCESS;
+}
+
+vsCode vsUpdateEventsFromResult(vsHandle engine, int streamId, int64_t frameIndex, double timestampMs,
+	const vsResultHeader* result)
+{
+	EventEngine* events = findEventEngine(engine);
+	if (!events || !result)
+		return VS_ERROR_INVALID_HANDLE;
+	events->UpdateFromResult(streamId, frameIndex, timestampMs, result);
+	return VS_SUCCESS;
+}
+
+vsCode vsPollEvents(vsHandle engine, vsEvent* outEvents, int maxEvents, int* outCount)
+{
+	EventEngine* events = findEventEngine(engine);
+	if (!events || !outEvents || !outCount)
+		return VS_ERROR_INVALID_HANDLE;
+	*outCount = events->Poll(outEvents, maxEvents);
+	return VS_SUCCESS;
+}
+
+vsCode vsGetEventStats(vsHandle engine, vsEventStats* outStats)
+{
+	EventEngine* events = findEventEngine(engine);
+	if (!events || !outStats)
+		return VS_ERROR_INVALID_HANDLE;
+	events->GetStats(*outStats);
+	return VS_SUCCESS;
+}
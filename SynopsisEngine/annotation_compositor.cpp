@@ -0,0 +1,417 @@
+#include "pch.h"
+#include "annotation_compositor.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <opencv2/core/hal/intrin.hpp>
+#include "yolo_define.h"
+#include "result_block.h"
+
+// ============================================================================
+// Helpers
+// ============================================================================
+namespace {
+
+// COCO keypoint pairs, 0-based
+const std::pair<int, int> kSkeleton[] = {
+    {0,1}, {0,2}, {1,3}, {2,4}, {3,5}, {4,6},
+    {5,7}, {7,9}, {6,8}, {8,10},
+    {5,6}, {5,11}, {6,12}, {11,12},
+    {11,13}, {13,15}, {12,14}, {14,16}
+};
+
+cv::Scalar classColor(int classId)
+{
+    const unsigned c = static_cast<unsigned>(classId) + 1;
+    return cv::Scalar((c * 97) % 200 + 55, (c * 57) % 200 + 55, (c * 37) % 200 + 55);
+}
+
+// Opaque overlay colour (premultiplied with alpha 255)
+cv::Scalar opaque(const cv::Scalar& color)
+{
+    return cv::Scalar(color[0], color[1], color[2], 255);
+}
+
+template <typename T>
+const T* record(const vsResultHeader* r, int i)
+{
+    return reinterpret_cast<const T*>(reinterpret_cast<const uint8_t*>(r) + r->objectsOffset + static_cast<size_t>(i) * r->objectStride);
+}
+
+const uint8_t* payloadAt(const vsResultHeader* r, uint32_t offset, uint32_t size)
+{
+    if (static_cast<uint64_t>(offset) + size > r->totalSize)
+        return nullptr;
+    return reinterpret_cast<const uint8_t*>(r) + offset;
+}
+
+// alpha 0..255 -> 0..256 so that 255 fully replaces the pixel
+inline int widenAlpha(int a)
+{
+    return a + (a >> 7);
+}
+
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+inline cv::v_uint8 scaleByInverse(const cv::v_uint8& value, const cv::v_uint16& inv0, const cv::v_uint16& inv1)
+{
+    cv::v_uint16 v0, v1;
+    cv::v_expand(value, v0, v1);
+    return cv::v_pack(cv::v_shr<8>(cv::v_mul_wrap(v0, inv0)), cv::v_shr<8>(cv::v_mul_wrap(v1, inv1)));
+}
+#endif
+
+// dst = dst * (1 - a) + overlay for n BGR pixels under n premultiplied BGRA pixels
+void blendRow(uint8_t* dst, const uint8_t* ov, int n)
+{
+    int x = 0;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+    const int lanes = cv::VTraits<cv::v_uint8>::vlanes();
+    const cv::v_uint16 k256 = cv::vx_setall_u16(256);
+    for (; x <= n - lanes; x += lanes) {
+        cv::v_uint8 ob, og, orr, oa;
+        cv::v_load_deinterleave(ov + 4 * x, ob, og, orr, oa);
+        cv::v_uint8 db, dg, dr;
+        cv::v_load_deinterleave(dst + 3 * x, db, dg, dr);
+
+        cv::v_uint16 a0, a1;
+        cv::v_expand(oa, a0, a1);
+        const cv::v_uint16 inv0 = cv::v_sub(k256, cv::v_add(a0, cv::v_shr<7>(a0)));
+        const cv::v_uint16 inv1 = cv::v_sub(k256, cv::v_add(a1, cv::v_shr<7>(a1)));
+
+        // u8 addition saturates
+        db = cv::v_add(scaleByInverse(db, inv0, inv1), ob);
+        dg = cv::v_add(scaleByInverse(dg, inv0, inv1), og);
+        dr = cv::v_add(scaleByInverse(dr, inv0, inv1), orr);
+        cv::v_store_interleave(dst + 3 * x, db, dg, dr);
+    }
+#endif
+    for (; x < n; ++x) {
+        const uint8_t* o = ov + 4 * x;
+        uint8_t* d = dst + 3 * x;
+        const int inv = 256 - widenAlpha(o[3]);
+        for (int k = 0; k < 3; ++k)
+            d[k] = static_cast<uint8_t>(std::min(255, ((d[k] * inv) >> 8) + o[k]));
+    }
+}
+
+// Below this many rows the thread hand-off costs more than the blend
+const int kParallelRows = 64;
+
+} // namespace
+
+// ============================================================================
+// Overlay
+// ============================================================================
+cv::Scalar AnnotationCompositor::ClassColor(int classId)
+{
+    return classColor(classId);
+}
+
+void AnnotationCompositor::Begin(cv::Size frameSize)
+{
+    if (overlay_.size() != frameSize || overlay_.type() != CV_8UC4) {
+        overlay_.create(frameSize, CV_8UC4);
+        overlay_.setTo(cv::Scalar::all(0));
+        spanBegin_.assign(frameSize.height, INT_MAX);
+        spanEnd_.assign(frameSize.height, 0);
+        return;
+    }
+    // A frame that was never composited leaves its spans behind
+    for (int y = 0; y < overlay_.rows; ++y) {
+        if (spanEnd_[y] > spanBegin_[y])
+            std::memset(overlay_.ptr<uint8_t>(y) + spanBegin_[y] * 4, 0, static_cast<size_t>(spanEnd_[y] - spanBegin_[y]) * 4);
+        spanBegin_[y] = INT_MAX;
+        spanEnd_[y] = 0;
+    }
+}
+
+void AnnotationCompositor::touch(cv::Rect area)
+{
+    area &= cv::Rect(0, 0, overlay_.cols, overlay_.rows);
+    for (int y = area.y; y < area.y + area.height; ++y) {
+        spanBegin_[y] = std::min(spanBegin_[y], area.x);
+        spanEnd_[y] = std::max(spanEnd_[y], area.x + area.width);
+    }
+}
+
+void AnnotationCompositor::AddBox(const cv::Rect& box, const cv::Scalar& color, int thickness)
+{
+    cv::rectangle(overlay_, box, opaque(color), thickness);
+    const int pad = thickness / 2 + 1;
+    touch(cv::Rect(box.x - pad, box.y - pad, box.width + 2 * pad, box.height + 2 * pad));
+}
+
+void AnnotationCompositor::AddPolygon(const cv::Point* points, int count, const cv::Scalar& color, int thickness)
+{
+    if (!points || count < 2)
+        return;
+    const cv::Point* pts[] = { points };
+    cv::polylines(overlay_, pts, &count, 1, true, opaque(color), thickness, cv::LINE_AA);
+    const int pad = thickness / 2 + 2;
+    const cv::Rect bounds = cv::boundingRect(std::vector<cv::Point>(points, points + count));
+    touch(cv::Rect(bounds.x - pad, bounds.y - pad, bounds.width + 2 * pad, bounds.height + 2 * pad));
+}
+
+void AnnotationCompositor::AddLine(cv::Point from, cv::Point to, const cv::Scalar& color, int thickness)
+{
+    cv::line(overlay_, from, to, opaque(color), thickness, cv::LINE_AA);
+    const int pad = thickness / 2 + 2;
+    const cv::Rect bounds(cv::Point(std::min(from.x, to.x), std::min(from.y, to.y)),
+        cv::Point(std::max(from.x, to.x) + 1, std::max(from.y, to.y) + 1));
+    touch(cv::Rect(bounds.x - pad, bounds.y - pad, bounds.width + 2 * pad, bounds.height + 2 * pad));
+}
+
+void AnnotationCompositor::AddDot(cv::Point center, int radius, const cv::Scalar& color)
+{
+    cv::circle(overlay_, center, radius, opaque(color), cv::FILLED, cv::LINE_AA);
+    touch(cv::Rect(center.x - radius - 2, center.y - radius - 2, 2 * radius + 5, 2 * radius + 5));
+}
+
+void AnnotationCompositor::AddMask(const cv::Rect& roi, const cv::Mat& mask, const cv::Scalar& color, float alpha)
+{
+    if (mask.type() != CV_8UC1 || mask.cols != roi.width || mask.rows != roi.height)
+        return;
+    const cv::Rect clipped = roi & cv::Rect(0, 0, overlay_.cols, overlay_.rows);
+    if (clipped.empty())
+        return;
+
+    const int a = std::clamp(static_cast<int>(alpha * 255.0f + 0.5f), 0, 255);
+    const int inv = 256 - widenAlpha(a);
+    const uint8_t pm[4] = {
+        static_cast<uint8_t>(static_cast<int>(color[0]) * a / 255),
+        static_cast<uint8_t>(static_cast<int>(color[1]) * a / 255),
+        static_cast<uint8_t>(static_cast<int>(color[2]) * a / 255),
+        static_cast<uint8_t>(a)
+    };
+    for (int y = 0; y < clipped.height; ++y) {
+        const uint8_t* m = mask.ptr<uint8_t>(clipped.y - roi.y + y) + (clipped.x - roi.x);
+        uint8_t* px = overlay_.ptr<uint8_t>(clipped.y + y) + clipped.x * 4;
+        for (int x = 0; x < clipped.width; ++x, px += 4) {
+            if (!m[x])
+                continue;
+            for (int k = 0; k < 4; ++k)
+                px[k] = static_cast<uint8_t>(std::min(255, pm[k] + ((px[k] * inv) >> 8)));
+        }
+    }
+    touch(clipped);
+}
+
+// ============================================================================
+// Labels
+// ============================================================================
+void AnnotationCompositor::prepareFont(double fontScale)
+{
+    if (fontScale == fontScale_ && !glyphs_.empty())
+        return;
+    fontScale_ = fontScale;
+    fontThickness_ = std::max(1, static_cast<int>(fontScale * 2));
+    const cv::Size size = cv::getTextSize("0A", cv::FONT_HERSHEY_SIMPLEX, fontScale, fontThickness_, &baseline_);
+    ascent_ = size.height;
+    glyphs_.assign(127 - 32, Glyph());
+}
+
+const AnnotationCompositor::Glyph& AnnotationCompositor::glyph(char c)
+{
+    if (c < 32 || c > 126)
+        c = '?';
+    Glyph& g = glyphs_[c - 32];
+    if (g.coverage.empty()) {
+        const char text[2] = { c, 0 };
+        int baseline = 0;
+        const cv::Size size = cv::getTextSize(text, cv::FONT_HERSHEY_SIMPLEX, fontScale_, fontThickness_, &baseline);
+        // getTextSize adds the stroke thickness once per string, not per character
+        g.advance = std::max(1, size.width - fontThickness_);
+        g.coverage = cv::Mat::zeros(ascent_ + baseline_ + 2 * kGlyphPad, size.width + 2 * kGlyphPad, CV_8UC1);
+        cv::putText(g.coverage, text, cv::Point(kGlyphPad, kGlyphPad + ascent_), cv::FONT_HERSHEY_SIMPLEX, fontScale_,
+            cv::Scalar(255), fontThickness_, cv::LINE_AA);
+    }
+    return g;
+}
+
+void AnnotationCompositor::AddLabel(const std::string& text, cv::Point anchor, const cv::Scalar& background, double fontScale)
+{
+    prepareFont(fontScale);
+    int width = fontThickness_;
+    for (char c : text)
+        width += glyph(c).advance;
+
+    int top = anchor.y - ascent_ - baseline_ - 2;
+    if (top < 0)
+        top = anchor.y + 2;
+    const cv::Rect frame(0, 0, overlay_.cols, overlay_.rows);
+    const cv::Rect bg = cv::Rect(anchor.x, top, width + 4, ascent_ + baseline_ + 2) & frame;
+    if (bg.empty())
+        return;
+    overlay_(bg).setTo(opaque(background));
+    touch(bg);
+
+    // White text over whatever is below, weighted by glyph coverage
+    int pen = anchor.x + 2;
+    const int originY = top + ascent_ + 1;
+    for (char c : text) {
+        const Glyph& g = glyph(c);
+        const cv::Rect tile(pen - kGlyphPad, originY - ascent_ - kGlyphPad, g.coverage.cols, g.coverage.rows);
+        const cv::Rect clipped = tile & frame;
+        for (int y = 0; y < clipped.height; ++y) {
+            const uint8_t* cov = g.coverage.ptr<uint8_t>(clipped.y - tile.y + y) + (clipped.x - tile.x);
+            uint8_t* px = overlay_.ptr<uint8_t>(clipped.y + y) + clipped.x * 4;
+            for (int x = 0; x < clipped.width; ++x, px += 4) {
+                if (!cov[x])
+                    continue;
+                for (int k = 0; k < 4; ++k)
+                    px[k] = static_cast<uint8_t>(px[k] + ((255 - px[k]) * cov[x] + 127) / 255);
+            }
+        }
+        touch(clipped);
+        pen += g.advance;
+    }
+}
+
+// ============================================================================
+// Compositing
+// ============================================================================
+void AnnotationCompositor::Composite(cv::Mat& image)
+{
+    if (image.type() != CV_8UC3 || image.size() != overlay_.size())
+        return;
+
+    dirtyRows_.clear();
+    for (int y = 0; y < overlay_.rows; ++y) {
+        if (spanEnd_[y] > spanBegin_[y])
+            dirtyRows_.push_back(y);
+    }
+
+    auto blendRows = [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            const int y = dirtyRows_[i];
+            const int x0 = spanBegin_[y];
+            const int n = spanEnd_[y] - x0;
+            uint8_t* ov = overlay_.ptr<uint8_t>(y) + x0 * 4;
+            blendRow(image.ptr<uint8_t>(y) + x0 * 3, ov, n);
+            std::memset(ov, 0, static_cast<size_t>(n) * 4);
+            spanBegin_[y] = INT_MAX;
+            spanEnd_[y] = 0;
+        }
+    };
+    const int rows = static_cast<int>(dirtyRows_.size());
+    if (rows < kParallelRows)
+        blendRows(cv::Range(0, rows));
+    else
+        cv::parallel_for_(cv::Range(0, rows), blendRows);
+}
+
+// ============================================================================
+// Result blocks
+// ============================================================================
+void AnnotationCompositor::Draw(cv::Mat& image, const vsResultHeader* r, int flags, float maskAlpha)
+{
+    if (!r || image.empty() || image.type() != CV_8UC3 || r->magic != VS_RESULT_MAGIC)
+        return;
+    if (flags == 0)
+        flags = VS_DRAW_ALL;
+    Begin(image.size());
+
+    // Line and text sizes follow the image, like the detectors' own drawing helpers
+    const int minDim = std::min(image.rows, image.cols);
+    const int thickness = std::max(1, minDim / 400);
+    const double fontScale = std::max(0.4, minDim / 1600.0);
+
+    auto addBox = [&](const vsRect& box, float conf, int classId) {
+        const cv::Scalar color = classColor(classId);
+        const cv::Rect rect(box.x, box.y, box.width, box.height);
+        if (flags & VS_DRAW_BOXES)
+            AddBox(rect, color, thickness);
+        if (flags & VS_DRAW_LABELS) {
+            char text[48];
+            std::snprintf(text, sizeof(text), "%d %.2f", classId, conf);
+            AddLabel(text, rect.tl(), color, fontScale);
+        }
+    };
+
+    switch (r->task) {
+    case YT_DETECT:
+        for (int i = 0; i < r->count; ++i) {
+            const vsDetObject& d = *record<vsDetObject>(r, i);
+            addBox(d.box, d.conf, d.classId);
+        }
+        break;
+    case YT_SEGMENT:
+        // Masks first so boxes and labels stay readable on top
+        for (int i = 0; i < r->count; ++i) {
+            const vsSegObject& s = *record<vsSegObject>(r, i);
+            if ((flags & VS_DRAW_MASKS) && DecodeSegmentMask(r, s, maskScratch_))
+                AddMask(cv::Rect(s.maskRoi.x, s.maskRoi.y, s.maskRoi.width, s.maskRoi.height), maskScratch_,
+                    classColor(s.classId), maskAlpha);
+        }
+        for (int i = 0; i < r->count; ++i) {
+            const vsSegObject& s = *record<vsSegObject>(r, i);
+            addBox(s.box, s.conf, s.classId);
+        }
+        break;
+    case YT_POSE: {
+        const float kMinConf = 0.5f;
+        const int radius = std::max(2, thickness + 1);
+        for (int i = 0; i < r->count; ++i) {
+            const vsPoseObject& p = *record<vsPoseObject>(r, i);
+            addBox(p.box, p.conf, p.classId);
+            if (!(flags & VS_DRAW_KEYPOINTS) || p.keypointCount == 0)
+                continue;
+            const uint8_t* data = payloadAt(r, p.keypointOffset, static_cast<uint32_t>(p.keypointCount * sizeof(vsKeypoint)));
+            if (!data)
+                continue;
+            const int count = static_cast<int>(p.keypointCount);
+            auto keypoint = [data](int k) {
+                vsKeypoint kp;
+                std::memcpy(&kp, data + static_cast<size_t>(k) * sizeof(vsKeypoint), sizeof(kp));
+                return kp;
+            };
+            for (const auto& [a, b] : kSkeleton) {
+                if (a >= count || b >= count)
+                    continue;
+                const vsKeypoint ka = keypoint(a);
+                const vsKeypoint kb = keypoint(b);
+                if (ka.conf >= kMinConf && kb.conf >= kMinConf)
+                    AddLine(cv::Point(cvRound(ka.x), cvRound(ka.y)), cv::Point(cvRound(kb.x), cvRound(kb.y)),
+                        cv::Scalar(255, 153, 51), thickness);
+            }
+            for (int k = 0; k < count; ++k) {
+                const vsKeypoint kp = keypoint(k);
+                if (kp.conf >= kMinConf)
+                    AddDot(cv::Point(cvRound(kp.x), cvRound(kp.y)), radius, cv::Scalar(0, 255, 0));
+            }
+        }
+        break;
+    }
+    case YT_OBB:
+        for (int i = 0; i < r->count; ++i) {
+            const vsObbObject& o = *record<vsObbObject>(r, i);
+            const cv::Scalar color = classColor(o.classId);
+            cv::Point pts[4];
+            for (int k = 0; k < 4; ++k)
+                pts[k] = cv::Point(cvRound(o.corners[2 * k]), cvRound(o.corners[2 * k + 1]));
+            if (flags & VS_DRAW_BOXES)
+                AddPolygon(pts, 4, color, thickness);
+            if (flags & VS_DRAW_LABELS) {
+                char text[48];
+                std::snprintf(text, sizeof(text), "%d %.2f", o.classId, o.conf);
+                AddLabel(text, pts[0], color, fontScale);
+            }
+        }
+        break;
+    case YT_CLASSIFY:
+        if ((flags & VS_DRAW_LABELS) && r->count > 0) {
+            const vsClassObject& c = *record<vsClassObject>(r, 0);
+            const uint8_t* name = payloadAt(r, c.nameOffset, c.nameLength);
+            char conf[16];
+            std::snprintf(conf, sizeof(conf), " %.2f", c.conf);
+            const std::string text = (name ? std::string(reinterpret_cast<const char*>(name), c.nameLength)
+                : std::to_string(c.classId)) + conf;
+            AddLabel(text, cv::Point(8, static_cast<int>(40 * fontScale) + 8), classColor(c.classId), fontScale);
+        }
+        break;
+    default:
+        break;
+    }
+
+    Composite(image);
+}
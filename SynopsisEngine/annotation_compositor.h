@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_video.h"
+
+/**
+ * @brief Draws boxes, labels, masks and skeletons into one overlay, then blends it in one pass.
+ *
+ * Primitives are rasterized into a premultiplied BGRA overlay the size of the frame; every
+ * primitive records the column span it touched on each row. Composite() blends only those
+ * spans into the BGR frame, rows in parallel with SIMD, and clears them for the next frame.
+ * Masks are written inside their ROI only, so N masks cost their own area plus one blend
+ * instead of N full-frame blends. Label text is stamped from per-character coverage tiles
+ * rendered once per font size.
+ *
+ * Not thread-safe; keep one compositor per drawing thread. Primitives are composed in call
+ * order (later ones cover earlier ones).
+ */
+class AnnotationCompositor {
+public:
+    // Starts a frame; the overlay is reallocated only when the size changes
+    void Begin(cv::Size frameSize);
+
+    void AddBox(const cv::Rect& box, const cv::Scalar& color, int thickness);
+    void AddPolygon(const cv::Point* points, int count, const cv::Scalar& color, int thickness);
+    void AddLine(cv::Point from, cv::Point to, const cv::Scalar& color, int thickness);
+    void AddDot(cv::Point center, int radius, const cv::Scalar& color);
+    // mask is CV_8UC1 of roi's size, non-zero = inside; roi may extend past the frame
+    void AddMask(const cv::Rect& roi, const cv::Mat& mask, const cv::Scalar& color, float alpha);
+    // White text on a filled background; anchor is the top-left of the box the label belongs to
+    void AddLabel(const std::string& text, cv::Point anchor, const cv::Scalar& background, double fontScale);
+
+    // Blends everything added since Begin() into image (CV_8UC3, the Begin() size)
+    void Composite(cv::Mat& image);
+
+    // Begin() + the overlays of one result block (drawFlags is a vsDrawFlags mask) + Composite()
+    void Draw(cv::Mat& image, const vsResultHeader* result, int drawFlags, float maskAlpha);
+
+    // The colour Draw() uses for a class
+    static cv::Scalar ClassColor(int classId);
+
+private:
+    struct Glyph {
+        cv::Mat coverage;       // CV_8UC1, kGlyphPad around the character cell
+        int advance = 0;
+    };
+    static constexpr int kGlyphPad = 2;
+
+    void touch(cv::Rect area);
+    void prepareFont(double fontScale);
+    const Glyph& glyph(char c);
+
+    cv::Mat overlay_;                   // CV_8UC4, premultiplied, zero outside the spans
+    std::vector<int> spanBegin_;        // per row, first touched column
+    std::vector<int> spanEnd_;          // per row, one past the last touched column (0 = untouched)
+    std::vector<int> dirtyRows_;
+    cv::Mat maskScratch_;               // decoded segmentation mask, reused across objects
+
+    double fontScale_ = 0.0;
+    int fontThickness_ = 1;
+    int ascent_ = 0;
+    int baseline_ = 0;
+    std::vector<Glyph> glyphs_;         // printable ASCII, rendered on first use
+};
@@ -0,0 +1,164 @@
+#include "pch.h"
+#include "annotation_writer.h"
+#include <algorithm>
+#include <cstring>
+#include "Logger.h"
+
+using Clock = std::chrono::steady_clock;
+
+// ============================================================================
+// AnnotationWriter
+// ============================================================================
+bool AnnotationWriter::Open(const std::string& pathUtf8, cv::Size frameSize, double fps, const vsWriterOptions& options)
+{
+    Close();
+
+    const int fourcc = options.fourcc ? options.fourcc : cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+    if (fps <= 0.0)
+        fps = 25.0;
+    path_ = pathUtf8;
+    frameSize_ = frameSize;
+    drawFlags_ = options.drawFlags ? options.drawFlags : VS_DRAW_ALL;
+    maskAlpha_ = options.maskAlpha > 0.0f ? std::min(options.maskAlpha, 1.0f) : 0.4f;
+
+    failed_ = false;
+    if (frameSize.area() <= 0 || !writer_.open(pathUtf8, fourcc, fps, frameSize, true)) {
+        LOG_ERROR_STREAM("[AnnotationWriter] Cannot open " << pathUtf8 << " for " << frameSize.width << "x"
+            << frameSize.height << " @ " << fps << " fps");
+        failed_ = true;
+        return false;
+    }
+
+    // Frame buffers are allocated up front; a job is reused as soon as it is encoded
+    const size_t depth = options.queueDepth > 0 ? static_cast<size_t>(options.queueDepth) : 32;
+    jobs_.assign(depth, Job());
+    free_.clear();
+    for (size_t i = 0; i < depth; ++i) {
+        jobs_[i].frame.create(frameSize, CV_8UC3);
+        free_.push_back(depth - 1 - i);
+    }
+    queued_.clear();
+    closing_ = false;
+    submitted_ = 0;
+    written_ = 0;
+    dropped_ = 0;
+    peakBacklog_ = 0;
+    encodeMsTotal_ = 0.0;
+
+    thread_ = std::thread(&AnnotationWriter::encodeLoop, this);
+    LOG_INFO_STREAM("[AnnotationWriter] Writing " << pathUtf8 << ": " << frameSize.width << "x" << frameSize.height
+        << " @ " << fps << " fps, backlog " << depth << " frames");
+    return true;
+}
+
+bool AnnotationWriter::Submit(const cv::Mat& frame, const vsResultHeader* result)
+{
+    ++submitted_;
+    size_t job;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_ || failed_ || free_.empty()) {
+            ++dropped_;
+            return false;
+        }
+        job = free_.back();
+        free_.pop_back();
+    }
+
+    // The copy happens outside the lock; the job belongs to this thread until it is queued
+    Job& j = jobs_[job];
+    if (frame.size() == frameSize_ && frame.type() == CV_8UC3)
+        frame.copyTo(j.frame);
+    else
+        cv::resize(frame, j.frame, frameSize_);
+    if (result && result->magic == VS_RESULT_MAGIC) {
+        j.result.resize(result->totalSize);
+        std::memcpy(j.result.data(), result, result->totalSize);
+    }
+    else {
+        j.result.clear();
+    }
+
+    int32_t backlog;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.push_back(job);
+        backlog = static_cast<int32_t>(queued_.size());
+    }
+    ready_.notify_one();
+
+    int32_t peak = peakBacklog_.load(std::memory_order_relaxed);
+    while (backlog > peak && !peakBacklog_.compare_exchange_weak(peak, backlog, std::memory_order_relaxed)) {}
+    return true;
+}
+
+void AnnotationWriter::encodeLoop()
+{
+    for (;;) {
+        size_t job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this] { return closing_ || !queued_.empty(); });
+            if (queued_.empty())
+                break;          // closing and drained
+            job = queued_.front();
+        }
+
+        Job& j = jobs_[job];
+        const auto t0 = Clock::now();
+        if (!j.result.empty())
+            compositor_.Draw(j.frame, reinterpret_cast<const vsResultHeader*>(j.result.data()), drawFlags_, maskAlpha_);
+        try {
+            writer_.write(j.frame);
+            ++written_;
+        }
+        catch (const cv::Exception& e) {
+            LOG_ERROR_STREAM("[AnnotationWriter] Encode failed for " << path_ << ": " << e.what());
+            failed_ = true;
+        }
+        const double ms = std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+        double total = encodeMsTotal_.load(std::memory_order_relaxed);
+        while (!encodeMsTotal_.compare_exchange_weak(total, total + ms, std::memory_order_relaxed)) {}
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.pop_front();
+        free_.push_back(job);
+        if (failed_) {
+            // Nothing more can be written; hand every queued job back as dropped
+            dropped_ += static_cast<int64_t>(queued_.size());
+            for (size_t q : queued_)
+                free_.push_back(q);
+            queued_.clear();
+        }
+    }
+}
+
+void AnnotationWriter::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    ready_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+    if (writer_.isOpened()) {
+        writer_.release();
+        LOG_INFO_STREAM("[AnnotationWriter] Closed " << path_ << ": " << written_.load() << " written, "
+            << dropped_.load() << " dropped, peak backlog " << peakBacklog_.load());
+    }
+}
+
+void AnnotationWriter::GetStats(vsWriterStats& out) const
+{
+    out.framesSubmitted = submitted_.load();
+    out.framesWritten = written_.load();
+    out.framesDropped = dropped_.load();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        out.backlog = static_cast<int32_t>(queued_.size());
+    }
+    out.peakBacklog = peakBacklog_.load();
+    out.avgEncodeMs = out.framesWritten > 0 ? encodeMsTotal_.load() / static_cast<double>(out.framesWritten) : 0.0;
+    out.failed = failed_.load() ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_video.h"
+#include "annotation_compositor.h"
+
+/**
+ * @brief Encoder stage writing an annotated copy of analysed frames.
+ *
+ * Submit() copies the frame and its result block into one of queueDepth pooled jobs and
+ * returns at once; a dedicated thread draws the overlays and encodes with cv::VideoWriter.
+ * When every job is waiting for the encoder the frame is dropped instead, so the caller
+ * (the inference thread) never stalls on encoding.
+ */
+class AnnotationWriter {
+public:
+    AnnotationWriter() = default;
+    ~AnnotationWriter() { Close(); }
+
+    AnnotationWriter(const AnnotationWriter&) = delete;
+    AnnotationWriter& operator=(const AnnotationWriter&) = delete;
+
+    bool Open(const std::string& pathUtf8, cv::Size frameSize, double fps, const vsWriterOptions& options);
+    // Returns false if the frame was dropped (backlog full, or the writer failed)
+    bool Submit(const cv::Mat& frame, const vsResultHeader* result);
+    // Encodes what is still queued and finalizes the file; safe to call twice
+    void Close();
+
+    void GetStats(vsWriterStats& out) const;
+
+private:
+    struct Job {
+        cv::Mat frame;
+        std::vector<uint8_t> result;    // copy of the result block, empty if there was none
+    };
+
+    void encodeLoop();
+
+    std::string path_;
+    cv::VideoWriter writer_;
+    cv::Size frameSize_;
+    AnnotationCompositor compositor_;   // encoder thread only
+    int drawFlags_ = VS_DRAW_ALL;
+    float maskAlpha_ = 0.4f;
+
+    std::vector<Job> jobs_;
+    std::vector<size_t> free_;          // job indices the producer may fill
+    std::deque<size_t> queued_;         // job indices waiting for the encoder
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    bool closing_ = false;
+    std::thread thread_;
+
+    std::atomic<int64_t> submitted_{ 0 };
+    std::atomic<int64_t> written_{ 0 };
+    std::atomic<int64_t> dropped_{ 0 };
+    std::atomic<int32_t> peakBacklog_{ 0 };
+    std::atomic<double> encodeMsTotal_{ 0.0 };
+    std::atomic<bool> failed_{ false };
+};
@@ -0,0 +1,252 @@
+#include "pch.h"
+#include "background_model.h"
+#include <algorithm>
+#include <cstring>
+#include <opencv2/core/hal/intrin.hpp>
+#include "Logger.h"
+
+namespace {
+
+// Channels per parallel_for_ stripe; a multiple of every SIMD width
+const size_t kStripe = 1 << 16;
+
+template <typename Body>
+void forEachStripe(size_t total, const Body& body)
+{
+    const int stripes = static_cast<int>((total + kStripe - 1) / kStripe);
+    cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+        for (int s = range.start; s < range.end; ++s) {
+            const size_t begin = static_cast<size_t>(s) * kStripe;
+            body(begin, std::min(total, begin + kStripe));
+        }
+    });
+}
+
+} // namespace
+
+BackgroundModel::BackgroundModel()
+    : BackgroundModel(Options())
+{
+}
+
+BackgroundModel::BackgroundModel(const Options& options)
+    : options_(options)
+{
+    options_.sampleEvery = std::max(1, options_.sampleEvery);
+    options_.window = std::clamp(options_.window, 2, 127);     // keeps every count below 255
+    options_.warmupSamples = std::max(1, options_.warmupSamples);
+    options_.checkEvery = std::max(1, options_.checkEvery);
+}
+
+void BackgroundModel::reset()
+{
+    size_ = cv::Size();
+    channels_ = 0;
+    counts_.clear();
+    counts_.shrink_to_fit();
+    level_.clear();
+    valid_.clear();
+    candidate_.release();
+    samples_ = 0;
+    sinceHalving_ = 0;
+    sinceCheck_ = 0;
+    plate_ = BackgroundPlate();
+}
+
+bool BackgroundModel::wantsFrame(int64_t frameIndex) const
+{
+    return frameIndex >= 0 && frameIndex % options_.sampleEvery == 0;
+}
+
+void BackgroundModel::allocate(cv::Size size)
+{
+    reset();
+    size_ = size;
+    channels_ = static_cast<size_t>(size.area()) * 3;
+    counts_.assign(channels_ * kBins, 0);
+    level_.assign(channels_, 0);
+    valid_.assign(channels_, 0xFF);
+    LOG_INFO_STREAM("[BackgroundModel] " << size.width << "x" << size.height << ", "
+        << (counts_.size() + level_.size() + valid_.size()) / (1024 * 1024) << " MB of statistics");
+}
+
+// ============================================================================
+// Per-pixel passes
+// ============================================================================
+void BackgroundModel::accumulate(const uint8_t* pixels)
+{
+    uint8_t* counts = counts_.data();
+    uint8_t* level = level_.data();
+    const uint8_t* valid = valid_.data();
+    const size_t plane = channels_;
+
+    forEachStripe(channels_, [&](size_t begin, size_t end) {
+        size_t i = begin;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const size_t lanes = static_cast<size_t>(cv::VTraits<cv::v_uint8>::vlanes());
+        const cv::v_uint8 highNibble = cv::vx_setall_u8(0xF0);
+        const cv::v_uint8 one = cv::vx_setall_u8(1);
+        for (; i + lanes <= end; i += lanes) {
+            const cv::v_uint8 v = cv::vx_load(pixels + i);
+            const cv::v_uint8 ok = cv::vx_load(valid + i);
+            const cv::v_uint8 bin = cv::v_and(v, highNibble);
+            for (int b = 0; b < kBins; ++b) {
+                // Lanes in bin b are 0xFF; subtracting it adds one
+                const cv::v_uint8 hit = cv::v_and(cv::v_eq(bin, cv::vx_setall_u8(static_cast<uint8_t>(b << 4))), ok);
+                uint8_t* c = counts + b * plane + i;
+                cv::v_store(c, cv::v_sub_wrap(cv::vx_load(c), hit));
+            }
+            const cv::v_uint8 l = cv::vx_load(level + i);
+            const cv::v_uint8 up = cv::v_and(cv::v_and(cv::v_gt(v, l), ok), one);
+            const cv::v_uint8 down = cv::v_and(cv::v_and(cv::v_lt(v, l), ok), one);
+            cv::v_store(level + i, cv::v_sub_wrap(cv::v_add_wrap(l, up), down));
+        }
+#endif
+        for (; i < end; ++i) {
+            if (!valid[i])
+                continue;
+            const uint8_t v = pixels[i];
+            ++counts[(v >> 4) * plane + i];
+            level[i] = static_cast<uint8_t>(level[i] + (v > level[i]) - (v < level[i]));
+        }
+    });
+}
+
+void BackgroundModel::halve()
+{
+    uint8_t* counts = counts_.data();
+    forEachStripe(counts_.size(), [&](size_t begin, size_t end) {
+        size_t i = begin;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const size_t lanes = static_cast<size_t>(cv::VTraits<cv::v_uint8>::vlanes());
+        for (; i + lanes <= end; i += lanes) {
+            cv::v_uint16 lo, hi;
+            cv::v_expand(cv::vx_load(counts + i), lo, hi);
+            cv::v_store(counts + i, cv::v_pack(cv::v_shr<1>(lo), cv::v_shr<1>(hi)));
+        }
+#endif
+        for (; i < end; ++i)
+            counts[i] >>= 1;
+    });
+}
+
+void BackgroundModel::estimate(cv::Mat& out) const
+{
+    out.create(size_, CV_8UC3);
+    uint8_t* dst = out.ptr<uint8_t>();
+    const uint8_t* counts = counts_.data();
+    const uint8_t* level = level_.data();
+    const size_t plane = channels_;
+
+    forEachStripe(channels_, [&](size_t begin, size_t end) {
+        size_t i = begin;
+#if (CV_SIMD || CV_SIMD_SCALABLE)
+        const size_t lanes = static_cast<size_t>(cv::VTraits<cv::v_uint8>::vlanes());
+        const cv::v_uint8 zero = cv::vx_setzero_u8();
+        const cv::v_uint8 binWidth = cv::vx_setall_u8(16);
+        const cv::v_uint8 binTop = cv::vx_setall_u8(15);
+        for (; i + lanes <= end; i += lanes) {
+            cv::v_uint8 total = zero;
+            for (int b = 0; b < kBins; ++b)
+                total = cv::v_add(total, cv::vx_load(counts + b * plane + i));
+
+            // Lower edge of the median bin: 16 for every bin whose running sum is still below
+            // half the total (sum + sum saturates, which still compares as not below)
+            cv::v_uint8 sum = zero;
+            cv::v_uint8 low = zero;
+            for (int b = 0; b < kBins - 1; ++b) {
+                sum = cv::v_add(sum, cv::vx_load(counts + b * plane + i));
+                low = cv::v_add(low, cv::v_and(cv::v_lt(cv::v_add(sum, sum), total), binWidth));
+            }
+            const cv::v_uint8 l = cv::vx_load(level + i);
+            const cv::v_uint8 inBin = cv::v_min(cv::v_max(l, low), cv::v_add(low, binTop));
+            // Never seen uncovered: keep the running estimate
+            cv::v_store(dst + i, cv::v_select(cv::v_eq(total, zero), l, inBin));
+        }
+#endif
+        for (; i < end; ++i) {
+            int total = 0;
+            for (int b = 0; b < kBins; ++b)
+                total += counts[b * plane + i];
+            if (total == 0) {
+                dst[i] = level[i];
+                continue;
+            }
+            int sum = 0;
+            int bin = 0;
+            while (bin < kBins - 1 && 2 * (sum += counts[bin * plane + i]) < total)
+                ++bin;
+            dst[i] = static_cast<uint8_t>(std::clamp<int>(level[i], bin * 16, bin * 16 + 15));
+        }
+    });
+}
+
+// ============================================================================
+// Sampling
+// ============================================================================
+bool BackgroundModel::update(const cv::Mat& frame, const std::vector<cv::Rect>& foreground, int64_t frameIndex, double timestampMs)
+{
+    if (!wantsFrame(frameIndex) || frame.empty() || frame.type() != CV_8UC3)
+        return false;
+    if (frame.size() != size_)
+        allocate(frame.size());
+    const cv::Mat pixels = frame.isContinuous() ? frame : frame.clone();
+
+    // Foreground boxes do not count towards this sample
+    std::fill(valid_.begin(), valid_.end(), static_cast<uint8_t>(0xFF));
+    const cv::Rect full(0, 0, size_.width, size_.height);
+    for (const cv::Rect& box : foreground) {
+        const cv::Rect r = box & full;
+        for (int y = r.y; y < r.y + r.height; ++y)
+            std::memset(valid_.data() + (static_cast<size_t>(y) * size_.width + r.x) * 3, 0, static_cast<size_t>(r.width) * 3);
+    }
+
+    if (samples_ == 0)
+        std::memcpy(level_.data(), pixels.data, channels_);
+    accumulate(pixels.ptr<uint8_t>());
+    ++samples_;
+    if (++sinceHalving_ >= options_.window) {
+        halve();
+        sinceHalving_ = 0;
+    }
+
+    if (plate_.image.empty()) {
+        if (samples_ < options_.warmupSamples)
+            return false;
+        estimate(candidate_);
+        return emit(frameIndex, timestampMs, 0.0);
+    }
+    if (++sinceCheck_ < options_.checkEvery)
+        return false;
+    sinceCheck_ = 0;
+    estimate(candidate_);
+    const double drift = cv::norm(candidate_, plate_.image, cv::NORM_L1) / static_cast<double>(channels_);
+    if (drift <= options_.driftThreshold)
+        return false;
+    return emit(frameIndex, timestampMs, drift);
+}
+
+bool BackgroundModel::flush(int64_t frameIndex, double timestampMs)
+{
+    if (samples_ == 0)
+        return false;
+    estimate(candidate_);
+    const double drift = plate_.image.empty() ? 0.0
+        : cv::norm(candidate_, plate_.image, cv::NORM_L1) / static_cast<double>(channels_);
+    sinceCheck_ = 0;
+    return emit(frameIndex, timestampMs, drift);
+}
+
+bool BackgroundModel::emit(int64_t frameIndex, double timestampMs, double drift)
+{
+    // A fresh buffer: the sink may keep a reference to the previous plate
+    plate_.image = candidate_.clone();
+    plate_.frameIndex = frameIndex;
+    plate_.timestampMs = timestampMs;
+    plate_.samples = samples_;
+    plate_.drift = drift;
+    LOG_DEBUG_STREAM("[BackgroundModel] Plate at frame " << frameIndex << ", " << samples_ << " samples, drift " << drift);
+    if (sink_)
+        sink_(plate_);
+    return true;
+}
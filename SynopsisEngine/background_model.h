@@ -0,0 +1,89 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Clean background plate of a time window, as emitted by BackgroundModel.
+ */
+struct BackgroundPlate {
+    cv::Mat image;                  // CV_8UC3, source resolution
+    int64_t frameIndex = 0;         // sampled frame the plate was computed at
+    double timestampMs = 0.0;
+    int64_t samples = 0;            // frames the model had taken in by then
+    double drift = 0.0;             // mean absolute difference to the previous plate, 0 for the first
+};
+
+/**
+ * @brief Incremental temporal-median background of a fixed camera.
+ *
+ * Every sampled frame is quantized into kBins levels per channel and counted in a per-pixel
+ * histogram; pixels under foreground boxes are not counted. The median bin of each pixel
+ * comes from a running sum over the bin planes, and a per-pixel estimate that steps one
+ * level towards every sample places the value inside that bin. Histograms are halved every
+ * `window` samples so old lighting fades out. All passes are SIMD over planar 8-bit counts.
+ *
+ * Memory is (kBins + 2) bytes per pixel channel (kBins counts, the level estimate and the
+ * valid mask; about 112 MB at 1080p) whatever the length of the video; no frame is kept. A new plate is emitted once the model is warm and then
+ * whenever the candidate plate has drifted more than driftThreshold from the last one.
+ *
+ * Not thread-safe; one model per source.
+ */
+class BackgroundModel {
+public:
+    static constexpr int kBins = 16;
+
+    struct Options {
+        int sampleEvery = 25;           // frames between samples
+        int window = 120;               // samples between histogram halvings (at most 127)
+        int warmupSamples = 15;         // samples before the first plate
+        int checkEvery = 10;            // samples between drift checks
+        double driftThreshold = 6.0;    // mean absolute difference, in 8-bit levels
+    };
+
+    using PlateSink = std::function<void(const BackgroundPlate&)>;
+
+    BackgroundModel();
+    explicit BackgroundModel(const Options& options);
+
+    // Drops all statistics; the next sampled frame sets the size
+    void reset();
+    void setPlateSink(PlateSink sink) { sink_ = std::move(sink); }
+
+    // True if frameIndex is one the model samples (callers may skip decoding the others)
+    bool wantsFrame(int64_t frameIndex) const;
+
+    // Takes in one BGR frame. Boxes are excluded from the statistics. Returns true if a
+    // plate was emitted (also passed to the sink).
+    bool update(const cv::Mat& frame, const std::vector<cv::Rect>& foreground, int64_t frameIndex, double timestampMs);
+
+    // Emits the current estimate regardless of drift (end of a window, end of the video)
+    bool flush(int64_t frameIndex, double timestampMs);
+
+    // Last emitted plate (empty image before the first)
+    const BackgroundPlate& plate() const { return plate_; }
+    int64_t samples() const { return samples_; }
+
+private:
+    void allocate(cv::Size size);
+    void accumulate(const uint8_t* pixels);
+    void halve();
+    void estimate(cv::Mat& out) const;
+    bool emit(int64_t frameIndex, double timestampMs, double drift);
+
+    Options options_;
+    PlateSink sink_;
+
+    cv::Size size_;
+    size_t channels_ = 0;               // width * height * 3
+    std::vector<uint8_t> counts_;       // kBins planes of channels_ counts
+    std::vector<uint8_t> level_;        // per channel estimate, moves one level per sample
+    std::vector<uint8_t> valid_;        // 0xFF where the current sample counts
+    cv::Mat candidate_;
+
+    int64_t samples_ = 0;
+    int64_t sinceHalving_ = 0;
+    int64_t sinceCheck_ = 0;
+    BackgroundPlate plate_;
+};
@@ -1,6 +1,9 @@
 // dllmain.cpp : Defines the entry point for the DLL application.
 #include "pch.h"
+#include "Logger.h"
+#include <cassert>
 
+#ifdef _WIN32
 BOOL APIENTRY DllMain( HMODULE hModule,
                        DWORD  ul_reason_for_call,
                        LPVOID lpReserved
@@ -11,9 +14,22 @@ BOOL APIENTRY DllMain( HMODULE hModule,
     case DLL_PROCESS_ATTACH:
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
+        break;
     case DLL_PROCESS_DETACH:
+        // Under the loader lock: joining the log writer here (or in the Logger's static
+        // destructor) deadlocks on FreeLibrary, and a detached writer would run on in
+        // unmapped code. So vsShutdown must join it before the DLL is freed; here only a
+        // logger that already exists is touched, never created (that would start a thread).
+        // On process exit (lpReserved set) the writer is already gone and only drains.
+        if (Logger* logger = Logger::Existing()) {
+            if (!lpReserved && logger->IsRunning()) {
+                OutputDebugStringA("[SynopsisEngine] Unloaded without vsShutdown; the log writer is still running\n");
+                assert(!"vsShutdown must be called before FreeLibrary");
+            }
+            logger->Shutdown(false);
+        }
         break;
     }
     return TRUE;
 }
-
+#endif
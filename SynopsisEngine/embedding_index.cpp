@@ -0,0 +1,56 @@
+#include "pch.h"
+#include "embedding_index.h"
+#include <algorithm>
+
+EmbeddingIndex::EmbeddingIndex()
+    : EmbeddingIndex(Options())
+{
+}
+
+EmbeddingIndex::EmbeddingIndex(const Options& options)
+    : options_(options)
+{
+}
+
+void EmbeddingIndex::Build(const cv::Mat& embeddings)
+{
+    index_.reset();
+    if (embeddings.type() == CV_32F && embeddings.isContinuous())
+        data_ = embeddings;
+    else
+        embeddings.convertTo(data_, CV_32F);
+    if (data_.empty())
+        return;
+    data_ = data_.isContinuous() ? data_ : data_.clone();
+
+    const cvflann::Matrix<float> dataset(data_.ptr<float>(), data_.rows, data_.cols);
+    if (data_.rows < options_.linearBelow)
+        index_ = std::make_unique<cvflann::Index<cvflann::L2<float>>>(dataset, cvflann::LinearIndexParams());
+    else
+        index_ = std::make_unique<cvflann::Index<cvflann::L2<float>>>(dataset, cvflann::KDTreeIndexParams(options_.trees));
+    index_->buildIndex();
+}
+
+int EmbeddingIndex::Search(const float* query, int k, int* rows, float* similarity)
+{
+    k = std::min(k, data_.rows);
+    if (!index_ || k <= 0)
+        return 0;
+    indices_.assign(k, -1);
+    distances_.assign(k, 0.0f);
+    cvflann::Matrix<float> q(const_cast<float*>(query), 1, data_.cols);
+    cvflann::Matrix<int> indices(indices_.data(), 1, k);
+    cvflann::Matrix<float> distances(distances_.data(), 1, k);
+    index_->knnSearch(q, indices, distances, k, cvflann::SearchParams(options_.checks));
+
+    // L2 squares the distance; for unit vectors |a - b|^2 = 2 - 2 cos
+    int found = 0;
+    for (int i = 0; i < k; ++i) {
+        if (indices_[i] < 0)
+            continue;
+        rows[found] = indices_[i];
+        similarity[found] = 1.0f - distances_[i] * 0.5f;
+        ++found;
+    }
+    return found;
+}
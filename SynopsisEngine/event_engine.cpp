@@ -0,0 +1,426 @@
+#include "pch.h"
+#include "event_engine.h"
+#include <algorithm>
+#include <chrono>
+#include "yolo_define.h"
+#include "Logger.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+size_t roundUpPow2(size_t v)
+{
+    size_t p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+
+// Bounding box of object i of a result block; false for blocks without boxes
+bool objectBox(const vsResultHeader* r, int i, cv::Rect& box, int& classId)
+{
+    const uint8_t* rec = reinterpret_cast<const uint8_t*>(r) + r->objectsOffset + static_cast<size_t>(i) * r->objectStride;
+    switch (r->task) {
+    case YT_DETECT: {
+        const vsDetObject& d = *reinterpret_cast<const vsDetObject*>(rec);
+        box = cv::Rect(d.box.x, d.box.y, d.box.width, d.box.height);
+        classId = d.classId;
+        return true;
+    }
+    case YT_SEGMENT: {
+        const vsSegObject& s = *reinterpret_cast<const vsSegObject*>(rec);
+        box = cv::Rect(s.box.x, s.box.y, s.box.width, s.box.height);
+        classId = s.classId;
+        return true;
+    }
+    case YT_POSE: {
+        const vsPoseObject& p = *reinterpret_cast<const vsPoseObject*>(rec);
+        box = cv::Rect(p.box.x, p.box.y, p.box.width, p.box.height);
+        classId = p.classId;
+        return true;
+    }
+    case YT_OBB: {
+        const vsObbObject& b = *reinterpret_cast<const vsObbObject*>(rec);
+        float x0 = b.corners[0], y0 = b.corners[1], x1 = x0, y1 = y0;
+        for (int k = 1; k < 4; ++k) {
+            x0 = std::min(x0, b.corners[2 * k]);
+            x1 = std::max(x1, b.corners[2 * k]);
+            y0 = std::min(y0, b.corners[2 * k + 1]);
+            y1 = std::max(y1, b.corners[2 * k + 1]);
+        }
+        box = cv::Rect(cv::Point(cvFloor(x0), cvFloor(y0)), cv::Point(cvCeil(x1), cvCeil(y1)));
+        classId = b.classId;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+EventEngine::EventEngine(const vsEventEngineOptions& options)
+    : options_(options)
+{
+    options_.maxAge = options_.maxAge > 0 ? options_.maxAge : 30;
+    trackerOptions_.maxAge = options_.maxAge;
+    capacity_ = roundUpPow2(static_cast<size_t>(options_.queueCapacity > 0 ? options_.queueCapacity : 4096));
+    slots_ = std::make_unique<Slot[]>(capacity_);
+    for (size_t i = 0; i < capacity_; ++i)
+        slots_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+// ============================================================================
+// Rules
+// ============================================================================
+std::shared_ptr<EventEngine::Stream> EventEngine::findStream(int streamId, bool create)
+{
+    std::lock_guard<std::mutex> lock(streamsMutex_);
+    auto it = streams_.find(streamId);
+    if (it != streams_.end())
+        return it->second;
+    if (!create)
+        return nullptr;
+    auto stream = std::make_shared<Stream>();
+    stream->tracker = IouTracker(trackerOptions_);
+    streams_[streamId] = stream;
+    return stream;
+}
+
+bool EventEngine::SetRule(int streamId, const vsEventRule& rule)
+{
+    const int minPoints = rule.kind == VS_RULE_ZONE ? 3 : 2;
+    if (!rule.pointsXY || rule.pointCount < minPoints || (rule.kind != VS_RULE_LINE && rule.kind != VS_RULE_ZONE))
+        return false;
+
+    Rule r;
+    r.id = rule.ruleId;
+    r.kind = rule.kind;
+    for (int i = 0; i < rule.pointCount; ++i)
+        r.points.emplace_back(rule.pointsXY[2 * i], rule.pointsXY[2 * i + 1]);
+    if (rule.classIds && rule.classCount > 0)
+        r.classes.assign(rule.classIds, rule.classIds + rule.classCount);
+    r.direction = rule.direction > 0 ? 1 : rule.direction < 0 ? -1 : 0;
+    r.dwellMs = std::max(0.0, rule.dwellSeconds) * 1000.0;
+
+    std::shared_ptr<Stream> stream = findStream(streamId, true);
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    auto it = std::find_if(stream->rules.begin(), stream->rules.end(), [&](const Rule& x) { return x.id == r.id; });
+    if (it != stream->rules.end())
+        *it = std::move(r);
+    else
+        stream->rules.push_back(std::move(r));
+    rebuild(*stream);
+    return true;
+}
+
+bool EventEngine::RemoveRule(int streamId, int ruleId)
+{
+    std::shared_ptr<Stream> stream = findStream(streamId, false);
+    if (!stream)
+        return false;
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    auto it = std::find_if(stream->rules.begin(), stream->rules.end(), [&](const Rule& x) { return x.id == ruleId; });
+    if (it == stream->rules.end())
+        return false;
+    stream->rules.erase(it);
+    rebuild(*stream);
+    return true;
+}
+
+void EventEngine::RemoveStream(int streamId)
+{
+    std::lock_guard<std::mutex> lock(streamsMutex_);
+    streams_.erase(streamId);
+}
+
+void EventEngine::rebuild(Stream& s)
+{
+    s.segAx.clear();
+    s.segAy.clear();
+    s.segDx.clear();
+    s.segDy.clear();
+    s.segRule.clear();
+    s.edgeX0.clear();
+    s.edgeY0.clear();
+    s.edgeY1.clear();
+    s.edgeSlope.clear();
+    s.zoneRule.clear();
+    s.zoneFirstEdge.assign(1, 0);
+
+    for (size_t r = 0; r < s.rules.size(); ++r) {
+        const std::vector<cv::Point2f>& pts = s.rules[r].points;
+        if (s.rules[r].kind == VS_RULE_LINE) {
+            for (size_t i = 0; i + 1 < pts.size(); ++i) {
+                s.segAx.push_back(pts[i].x);
+                s.segAy.push_back(pts[i].y);
+                s.segDx.push_back(pts[i + 1].x - pts[i].x);
+                s.segDy.push_back(pts[i + 1].y - pts[i].y);
+                s.segRule.push_back(static_cast<int>(r));
+            }
+        }
+        else {
+            for (size_t i = 0; i < pts.size(); ++i) {
+                const cv::Point2f& a = pts[i];
+                const cv::Point2f& b = pts[(i + 1) % pts.size()];
+                s.edgeX0.push_back(a.x);
+                s.edgeY0.push_back(a.y);
+                s.edgeY1.push_back(b.y);
+                // Horizontal edges never pass the straddle test, their slope is never used
+                s.edgeSlope.push_back(b.y != a.y ? (b.x - a.x) / (b.y - a.y) : 0.0f);
+            }
+            s.zoneRule.push_back(static_cast<int>(r));
+            s.zoneFirstEdge.push_back(static_cast<int>(s.edgeX0.size()));
+        }
+    }
+    s.hits.resize(std::max(s.segRule.size(), s.edgeX0.size()));
+    for (auto& t : s.tracks)
+        t.second.zones.assign(s.zoneRule.size(), ZoneState());
+}
+
+bool EventEngine::appliesTo(const Rule& rule, int classId) const
+{
+    return rule.classes.empty() || std::find(rule.classes.begin(), rule.classes.end(), classId) != rule.classes.end();
+}
+
+cv::Point2f EventEngine::anchorOf(const vsRect& box) const
+{
+    const float y = options_.anchor == VS_ANCHOR_CENTER ? box.y + box.height * 0.5f : static_cast<float>(box.y + box.height);
+    return cv::Point2f(box.x + box.width * 0.5f, y);
+}
+
+// ============================================================================
+// Update
+// ============================================================================
+void EventEngine::Update(int streamId, int64_t frameIndex, double timestampMs, const vsTrackBox* tracks, int count)
+{
+    std::shared_ptr<Stream> stream = findStream(streamId, false);
+    if (!stream)
+        return;
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    updateLocked(*stream, streamId, frameIndex, timestampMs, tracks, count);
+}
+
+void EventEngine::UpdateFromResult(int streamId, int64_t frameIndex, double timestampMs, const vsResultHeader* result)
+{
+    std::shared_ptr<Stream> stream = findStream(streamId, false);
+    if (!stream)
+        return;
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    Stream& s = *stream;
+    s.boxes.clear();
+    s.classIds.clear();
+    if (result && result->magic == VS_RESULT_MAGIC) {
+        for (int i = 0; i < result->count; ++i) {
+            cv::Rect box;
+            int classId = -1;
+            if (!objectBox(result, i, box, classId))
+                break;
+            s.boxes.push_back(box);
+            s.classIds.push_back(classId);
+        }
+    }
+    s.tracker.update(frameIndex, s.boxes, s.classIds, s.trackIds);
+    s.fromBlock.resize(s.boxes.size());
+    for (size_t i = 0; i < s.boxes.size(); ++i) {
+        s.fromBlock[i].trackId = s.trackIds[i];
+        s.fromBlock[i].classId = s.classIds[i];
+        s.fromBlock[i].box = { s.boxes[i].x, s.boxes[i].y, s.boxes[i].width, s.boxes[i].height };
+    }
+    updateLocked(s, streamId, frameIndex, timestampMs, s.fromBlock.data(), static_cast<int>(s.fromBlock.size()));
+}
+
+void EventEngine::updateLocked(Stream& s, int streamId, int64_t frameIndex, double timestampMs, const vsTrackBox* tracks, int count)
+{
+    const Clock::time_point t0 = Clock::now();
+    const size_t segments = s.segRule.size();
+    const size_t zones = s.zoneRule.size();
+    const size_t edges = s.edgeX0.size();
+    int32_t* hits = s.hits.data();
+
+    vsEvent ev = {};
+    ev.streamId = streamId;
+    ev.frameIndex = frameIndex;
+    ev.timestampMs = timestampMs;
+
+    for (int i = 0; i < count; ++i) {
+        const vsTrackBox& tb = tracks[i];
+        auto found = s.tracks.find(tb.trackId);
+        const bool isNew = found == s.tracks.end();
+        if (isNew) {
+            found = s.tracks.emplace(tb.trackId, Track()).first;
+            found->second.zones.assign(zones, ZoneState());
+        }
+        Track& t = found->second;
+        const cv::Point2f q = anchorOf(tb.box);
+        t.classId = tb.classId;
+        ev.trackId = tb.trackId;
+        ev.classId = tb.classId;
+        ev.x = q.x;
+        ev.y = q.y;
+        ev.insideSeconds = 0.0;
+
+        // Lines: the displacement since the track's previous frame against every segment
+        if (!isNew && segments > 0 && q != t.anchor) {
+            const float px = t.anchor.x, py = t.anchor.y;
+            const float mx = q.x - px, my = q.y - py;
+            const float* ax = s.segAx.data();
+            const float* ay = s.segAy.data();
+            const float* dx = s.segDx.data();
+            const float* dy = s.segDy.data();
+            for (size_t k = 0; k < segments; ++k) {
+                const float d1 = dx[k] * (py - ay[k]) - dy[k] * (px - ax[k]);
+                const float d2 = dx[k] * (q.y - ay[k]) - dy[k] * (q.x - ax[k]);
+                const float d3 = mx * (ay[k] - py) - my * (ax[k] - px);
+                const float d4 = mx * (ay[k] + dy[k] - py) - my * (ax[k] + dx[k] - px);
+                hits[k] = static_cast<int32_t>(((d1 > 0.0f) != (d2 > 0.0f)) & ((d3 > 0.0f) != (d4 > 0.0f)));
+            }
+            s.crossedRules.clear();
+            for (size_t k = 0; k < segments; ++k) {
+                if (!hits[k])
+                    continue;
+                const int r = s.segRule[k];
+                if (std::find(s.crossedRules.begin(), s.crossedRules.end(), r) != s.crossedRules.end())
+                    continue;               // one Cross per polyline and frame
+                s.crossedRules.push_back(r);
+                const Rule& rule = s.rules[r];
+                // Positive side = right of the drawn direction (image y points down)
+                const float d2 = dx[k] * (q.y - ay[k]) - dy[k] * (q.x - ax[k]);
+                const int direction = d2 > 0.0f ? -1 : 1;
+                if (!appliesTo(rule, tb.classId) || (rule.direction != 0 && rule.direction != direction))
+                    continue;
+                ev.ruleId = rule.id;
+                ev.type = VS_EVENT_CROSS;
+                ev.direction = direction;
+                emit(ev);
+            }
+        }
+
+        // Zones: one crossing-number step per edge, the parity per zone says inside
+        if (zones > 0) {
+            const float* x0 = s.edgeX0.data();
+            const float* y0 = s.edgeY0.data();
+            const float* y1 = s.edgeY1.data();
+            const float* slope = s.edgeSlope.data();
+            for (size_t k = 0; k < edges; ++k)
+                hits[k] = static_cast<int32_t>(((y0[k] > q.y) != (y1[k] > q.y)) & (q.x < x0[k] + (q.y - y0[k]) * slope[k]));
+            ev.direction = 0;
+            for (size_t z = 0; z < zones; ++z) {
+                int32_t inside = 0;
+                for (int k = s.zoneFirstEdge[z]; k < s.zoneFirstEdge[z + 1]; ++k)
+                    inside ^= hits[k];
+                const Rule& rule = s.rules[s.zoneRule[z]];
+                ZoneState& zs = t.zones[z];
+                if (!appliesTo(rule, tb.classId))
+                    continue;
+                ev.ruleId = rule.id;
+                if (inside && !zs.inside) {
+                    zs.inside = 1;
+                    zs.dwellReported = 0;
+                    zs.enteredMs = timestampMs;
+                    ev.type = VS_EVENT_ENTER;
+                    ev.insideSeconds = 0.0;
+                    emit(ev);
+                }
+                else if (!inside && zs.inside) {
+                    zs.inside = 0;
+                    ev.type = VS_EVENT_EXIT;
+                    ev.insideSeconds = (timestampMs - zs.enteredMs) / 1000.0;
+                    emit(ev);
+                }
+                if (zs.inside && !zs.dwellReported && rule.dwellMs > 0.0 && timestampMs - zs.enteredMs >= rule.dwellMs) {
+                    zs.dwellReported = 1;
+                    ev.type = VS_EVENT_DWELL;
+                    ev.insideSeconds = (timestampMs - zs.enteredMs) / 1000.0;
+                    emit(ev);
+                }
+            }
+        }
+
+        t.anchor = q;
+        t.lastFrame = frameIndex;
+        t.lastMs = timestampMs;
+    }
+
+    // Lost tracks leave the zones they were in
+    for (auto it = s.tracks.begin(); it != s.tracks.end();) {
+        Track& t = it->second;
+        if (frameIndex - t.lastFrame <= options_.maxAge) {
+            ++it;
+            continue;
+        }
+        for (size_t z = 0; z < t.zones.size() && z < zones; ++z) {
+            if (!t.zones[z].inside)
+                continue;
+            ev.ruleId = s.rules[s.zoneRule[z]].id;
+            ev.trackId = it->first;
+            ev.classId = t.classId;
+            ev.type = VS_EVENT_EXIT;
+            ev.direction = 0;
+            ev.insideSeconds = (t.lastMs - t.zones[z].enteredMs) / 1000.0;
+            ev.x = t.anchor.x;
+            ev.y = t.anchor.y;
+            emit(ev);
+        }
+        it = s.tracks.erase(it);
+    }
+
+    const int64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+    frames_.fetch_add(1, std::memory_order_relaxed);
+    updateNanos_.fetch_add(nanos, std::memory_order_relaxed);
+    int64_t peak = maxUpdateNanos_.load(std::memory_order_relaxed);
+    while (nanos > peak && !maxUpdateNanos_.compare_exchange_weak(peak, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+// ============================================================================
+// Event queue
+// ============================================================================
+void EventEngine::emit(const vsEvent& event)
+{
+    size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots_[pos & (capacity_ - 1)];
+        const size_t seq = slot->seq.load(std::memory_order_acquire);
+        const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+    slot->event = event;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    events_.fetch_add(1, std::memory_order_relaxed);
+}
+
+int EventEngine::Poll(vsEvent* out, int maxEvents)
+{
+    std::lock_guard<std::mutex> lock(pollMutex_);
+    int n = 0;
+    while (n < maxEvents) {
+        Slot& slot = slots_[dequeuePos_ & (capacity_ - 1)];
+        if (slot.seq.load(std::memory_order_acquire) != dequeuePos_ + 1)
+            break;
+        out[n++] = slot.event;
+        slot.seq.store(dequeuePos_ + capacity_, std::memory_order_release);
+        ++dequeuePos_;
+    }
+    return n;
+}
+
+void EventEngine::GetStats(vsEventStats& out) const
+{
+    out = {};
+    out.frames = frames_.load(std::memory_order_relaxed);
+    out.events = events_.load(std::memory_order_relaxed);
+    out.dropped = dropped_.load(std::memory_order_relaxed);
+    out.avgUpdateMicros = out.frames > 0 ? updateNanos_.load(std::memory_order_relaxed) / 1000.0 / out.frames : 0.0;
+    out.maxUpdateMicros = maxUpdateNanos_.load(std::memory_order_relaxed) / 1000.0;
+}
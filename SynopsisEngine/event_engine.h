@@ -0,0 +1,126 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_events.h"
+#include "iou_tracker.h"
+
+/**
+ * @brief Streaming line-crossing / zone-intrusion rules over tracked boxes.
+ *
+ * A stream's rules are flattened into structure-of-arrays tables: every line segment
+ * (start point, direction vector, rule) and every zone edge (start point, slope, zone).
+ * An update gathers the anchor points of the frame's tracks and their previous anchors,
+ * then runs two branch-free loops per track over those tables, which the compiler turns
+ * into SIMD: a segment/segment orientation test of the track's last displacement against
+ * every line segment, and a crossing-number step of the anchor against every zone edge.
+ * Only the hits are looked at afterwards; each track's per-zone state (inside, since
+ * when, dwell reported) then drives Enter / Exit / Dwell.
+ *
+ * Events go to a bounded lock-free ring (Vyukov sequence slots, as in Logger), so updates
+ * on many streams never wait for the consumer; a full ring drops and counts. Changing a
+ * stream's rules restarts the zone state of its tracks.
+ */
+class EventEngine {
+public:
+    explicit EventEngine(const vsEventEngineOptions& options);
+
+    EventEngine(const EventEngine&) = delete;
+    EventEngine& operator=(const EventEngine&) = delete;
+
+    // Adds or replaces (same ruleId) a rule of the stream
+    bool SetRule(int streamId, const vsEventRule& rule);
+    bool RemoveRule(int streamId, int ruleId);
+    void RemoveStream(int streamId);
+
+    // One frame of a stream's tracked objects; frames of a stream come in order
+    void Update(int streamId, int64_t frameIndex, double timestampMs, const vsTrackBox* tracks, int count);
+    // Same for an untracked result block: boxes get ids from the stream's IouTracker
+    void UpdateFromResult(int streamId, int64_t frameIndex, double timestampMs, const vsResultHeader* result);
+
+    // Moves up to maxEvents queued events to out; single consumer
+    int Poll(vsEvent* out, int maxEvents);
+    void GetStats(vsEventStats& out) const;
+
+private:
+    struct Rule {
+        int id;
+        vsRuleKind kind;
+        std::vector<cv::Point2f> points;
+        std::vector<int> classes;
+        int direction;
+        double dwellMs;
+    };
+
+    struct ZoneState {
+        double enteredMs = 0.0;
+        uint8_t inside = 0;
+        uint8_t dwellReported = 0;
+    };
+
+    struct Track {
+        int classId = -1;
+        cv::Point2f anchor;
+        int64_t lastFrame = 0;
+        double lastMs = 0.0;
+        std::vector<ZoneState> zones;
+    };
+
+    struct Stream {
+        std::mutex mutex;               // one updater at a time; rule changes
+        std::vector<Rule> rules;
+        // Line segments of all line rules
+        std::vector<float> segAx, segAy, segDx, segDy;
+        std::vector<int> segRule;
+        // Edges of all zone rules, each zone's edges contiguous
+        std::vector<float> edgeX0, edgeY0, edgeY1, edgeSlope;
+        std::vector<int> zoneRule;      // rule index per zone
+        std::vector<int> zoneFirstEdge; // per zone, plus one past the last edge
+        std::unordered_map<int, Track> tracks;
+        IouTracker tracker;
+        // Scratch, reused every frame
+        std::vector<int32_t> hits;      // same width as the float tables, so the loops vectorise
+        std::vector<int> crossedRules;
+        std::vector<cv::Rect> boxes;
+        std::vector<int> classIds;
+        std::vector<int> trackIds;
+        std::vector<vsTrackBox> fromBlock;
+    };
+
+    struct Slot {
+        std::atomic<size_t> seq{ 0 };
+        vsEvent event;
+    };
+
+    // Shared so RemoveStream cannot pull a stream from under an update
+    std::shared_ptr<Stream> findStream(int streamId, bool create);
+    void rebuild(Stream& stream);
+    void updateLocked(Stream& stream, int streamId, int64_t frameIndex, double timestampMs, const vsTrackBox* tracks, int count);
+    bool appliesTo(const Rule& rule, int classId) const;
+    void emit(const vsEvent& event);
+    cv::Point2f anchorOf(const vsRect& box) const;
+
+    vsEventEngineOptions options_;
+    IouTracker::Options trackerOptions_;
+
+    mutable std::mutex streamsMutex_;
+    std::map<int, std::shared_ptr<Stream>> streams_;
+
+    // Ring buffer; producers touch only enqueuePos_ and their slot
+    std::unique_ptr<Slot[]> slots_;
+    size_t capacity_ = 0;
+    alignas(64) std::atomic<size_t> enqueuePos_{ 0 };
+    alignas(64) size_t dequeuePos_ = 0;
+    std::mutex pollMutex_;
+
+    std::atomic<int64_t> frames_{ 0 };
+    std::atomic<int64_t> events_{ 0 };
+    std::atomic<int64_t> dropped_{ 0 };
+    std::atomic<int64_t> updateNanos_{ 0 };
+    std::atomic<int64_t> maxUpdateNanos_{ 0 };
+};
@@ -0,0 +1,74 @@
+#include "pch.h"
+#include "iou_tracker.h"
+#include <algorithm>
+
+namespace {
+
+float iou(const cv::Rect& a, const cv::Rect& b)
+{
+    const int inter = (a & b).area();
+    if (inter <= 0)
+        return 0.0f;
+    return static_cast<float>(inter) / static_cast<float>(a.area() + b.area() - inter);
+}
+
+} // namespace
+
+IouTracker::IouTracker()
+    : IouTracker(Options())
+{
+}
+
+IouTracker::IouTracker(const Options& options)
+    : options_(options)
+{
+}
+
+void IouTracker::reset()
+{
+    tracks_.clear();
+    nextId_ = 0;
+}
+
+void IouTracker::update(int64_t frameIndex, const std::vector<cv::Rect>& boxes, const std::vector<int>& classIds,
+    std::vector<int>& trackIds)
+{
+    const int n = static_cast<int>(boxes.size());
+    trackIds.assign(n, -1);
+
+    // Retire tracks that have been gone too long
+    tracks_.erase(std::remove_if(tracks_.begin(), tracks_.end(), [&](const Track& t) {
+        return frameIndex - t.lastSeen > options_.maxAge;
+    }), tracks_.end());
+
+    candidates_.clear();
+    for (int t = 0; t < static_cast<int>(tracks_.size()); ++t) {
+        for (int b = 0; b < n; ++b) {
+            if (b < static_cast<int>(classIds.size()) && classIds[b] != tracks_[t].classId)
+                continue;
+            const float overlap = iou(tracks_[t].box, boxes[b]);
+            if (overlap >= options_.minIou)
+                candidates_.push_back({ overlap, t, b });
+        }
+    }
+    std::sort(candidates_.begin(), candidates_.end(), [](const Candidate& a, const Candidate& b) { return a.iou > b.iou; });
+
+    trackTaken_.assign(tracks_.size(), 0);
+    for (const Candidate& c : candidates_) {
+        if (trackTaken_[c.track] || trackIds[c.box] >= 0)
+            continue;
+        trackTaken_[c.track] = 1;
+        Track& t = tracks_[c.track];
+        t.box = boxes[c.box];
+        t.lastSeen = frameIndex;
+        trackIds[c.box] = t.id;
+    }
+
+    for (int b = 0; b < n; ++b) {
+        if (trackIds[b] >= 0)
+            continue;
+        const int classId = b < static_cast<int>(classIds.size()) ? classIds[b] : -1;
+        tracks_.push_back({ nextId_, classId, boxes[b], frameIndex });
+        trackIds[b] = nextId_++;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief Frame-to-frame track ids by greedy IoU association.
+ *
+ * Each frame's boxes are matched to the live tracks of the same class, best overlap
+ * first; unmatched boxes start new tracks and tracks unseen for more than maxAge frames
+ * are retired. State is one entry per live track, so memory follows the number of
+ * objects on screen, not the length of the video. Ids are never reused.
+ */
+class IouTracker {
+public:
+    struct Options {
+        float minIou = 0.3f;
+        int maxAge = 15;            // frames a track may go unseen before it is retired
+    };
+
+    IouTracker();
+    explicit IouTracker(const Options& options);
+
+    void reset();
+
+    // Assigns a track id to each box (trackIds has boxes.size() entries on return)
+    void update(int64_t frameIndex, const std::vector<cv::Rect>& boxes, const std::vector<int>& classIds,
+        std::vector<int>& trackIds);
+
+    int liveTracks() const { return static_cast<int>(tracks_.size()); }
+    int nextId() const { return nextId_; }
+    // Continues numbering after ids handed out elsewhere (e.g. an earlier run of the same video)
+    void setNextId(int id) { nextId_ = id; }
+
+private:
+    struct Track {
+        int id;
+        int classId;
+        cv::Rect box;
+        int64_t lastSeen;
+    };
+    struct Candidate {
+        float iou;
+        int track;
+        int box;
+    };
+
+    Options options_;
+    std::vector<Track> tracks_;
+    std::vector<Candidate> candidates_;     // scratch, reused every frame
+    std::vector<char> trackTaken_;
+    int nextId_ = 0;
+};
@@ -0,0 +1,270 @@
+#include "pch.h"
+#include "metrics_registry.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static const char* STAGE_NAMES[VS_STAGE_MAX] = {
+    "preprocess",
+    "inference",
+    "postprocess",
+    "nms",
+    "queue_wait",
+    "total"
+};
+
+static inline int highestBit(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, v);
+    return static_cast<int>(idx);
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static int shardIndex()
+{
+    static std::atomic<unsigned> next{ 0 };
+    thread_local int idx = static_cast<int>(next.fetch_add(1, std::memory_order_relaxed) % LatencyHistogram::kShards);
+    return idx;
+}
+
+// ============================================================================
+// LatencyHistogram
+// ============================================================================
+int LatencyHistogram::bucketIndex(uint64_t ns)
+{
+    if (ns < static_cast<uint64_t>(kSubCount))
+        return static_cast<int>(ns);
+    const uint64_t maxValue = (1ull << (kMaxBit + 1)) - 1;
+    if (ns > maxValue)
+        ns = maxValue;
+    const int shift = highestBit(ns) - kSubBits;
+    return (shift + 1) * kSubCount + static_cast<int>((ns >> shift) - kSubCount);
+}
+
+uint64_t LatencyHistogram::bucketLow(int index)
+{
+    if (index < kSubCount)
+        return static_cast<uint64_t>(index);
+    const int shift = index / kSubCount - 1;
+    return static_cast<uint64_t>(index % kSubCount + kSubCount) << shift;
+}
+
+uint64_t LatencyHistogram::bucketHigh(int index)
+{
+    if (index < kSubCount)
+        return static_cast<uint64_t>(index);
+    const int shift = index / kSubCount - 1;
+    return bucketLow(index) + (1ull << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns)
+{
+    Shard& s = shards_[shardIndex()];
+    s.buckets[bucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+    s.count.fetch_add(1, std::memory_order_relaxed);
+    s.sum.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t prev = s.max.load(std::memory_order_relaxed);
+    while (ns > prev && !s.max.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (Shard& s : shards_) {
+        s.count.store(0, std::memory_order_relaxed);
+        s.sum.store(0, std::memory_order_relaxed);
+        s.max.store(0, std::memory_order_relaxed);
+        for (auto& b : s.buckets)
+            b.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::collect(uint64_t* buckets, uint64_t& count, uint64_t& sum, uint64_t& maxValue) const
+{
+    for (const Shard& s : shards_) {
+        count += s.count.load(std::memory_order_relaxed);
+        sum += s.sum.load(std::memory_order_relaxed);
+        maxValue = std::max(maxValue, s.max.load(std::memory_order_relaxed));
+        for (int i = 0; i < kBuckets; ++i)
+            buckets[i] += s.buckets[i].load(std::memory_order_relaxed);
+    }
+}
+
+void StreamMetrics::reset()
+{
+    for (auto& h : stages)
+        h.reset();
+    dropped.store(0, std::memory_order_relaxed);
+}
+
+// ============================================================================
+// MetricsRegistry
+// ============================================================================
+MetricsRegistry::~MetricsRegistry()
+{
+    for (auto& slot : streams_)
+        delete slot.load();
+}
+
+StreamMetrics* MetricsRegistry::stream(int streamId)
+{
+    if (streamId < 0 || streamId >= kMaxStreams)
+        streamId = 0;
+    StreamMetrics* s = streams_[streamId].load(std::memory_order_acquire);
+    if (s)
+        return s;
+
+    // First use of this stream: publish a new block, the loser of a race frees its copy
+    StreamMetrics* created = new StreamMetrics();
+    if (streams_[streamId].compare_exchange_strong(s, created, std::memory_order_acq_rel))
+        return created;
+    delete created;
+    return s;
+}
+
+const StreamMetrics* MetricsRegistry::findStream(int streamId) const
+{
+    if (streamId < 0 || streamId >= kMaxStreams)
+        return nullptr;
+    return streams_[streamId].load(std::memory_order_acquire);
+}
+
+void MetricsRegistry::record(int streamId, MetricStage stage, uint64_t ns)
+{
+    if (stage == MetricStage::None)
+        return;
+    stream(streamId)->stages[static_cast<int>(stage)].record(ns);
+}
+
+void MetricsRegistry::addDropped(int streamId, uint64_t count)
+{
+    if (count == 0)
+        return;
+    stream(streamId)->dropped.fetch_add(count, std::memory_order_relaxed);
+}
+
+static void fillStats(const uint64_t* buckets, uint64_t count, uint64_t sum, uint64_t maxValue, vsLatencyStats& out)
+{
+    out = vsLatencyStats{};
+    out.count = count;
+    if (count == 0)
+        return;
+    out.meanUs = static_cast<double>(sum) / count / 1000.0;
+    out.maxUs = maxValue / 1000.0;
+
+    const double quantiles[4] = { 0.50, 0.90, 0.99, 0.999 };
+    double* targets[4] = { &out.p50Us, &out.p90Us, &out.p99Us, &out.p999Us };
+    int q = 0;
+    uint64_t seen = 0;
+    for (int i = 0; i < LatencyHistogram::kBuckets && q < 4; ++i) {
+        seen += buckets[i];
+        while (q < 4 && seen >= static_cast<uint64_t>(quantiles[q] * count + 0.5) && seen > 0) {
+            const uint64_t mid = (LatencyHistogram::bucketLow(i) + LatencyHistogram::bucketHigh(i)) / 2;
+            *targets[q] = std::min(mid, maxValue) / 1000.0;
+            ++q;
+        }
+    }
+}
+
+void MetricsRegistry::snapshot(int streamId, vsMetricsSnapshot& out) const
+{
+    out = vsMetricsSnapshot{};
+    out.version = VS_METRICS_VERSION;
+    out.streamId = streamId;
+
+    std::vector<uint64_t> buckets(LatencyHistogram::kBuckets);
+    for (int st = 0; st < VS_STAGE_MAX; ++st) {
+        std::fill(buckets.begin(), buckets.end(), 0);
+        uint64_t count = 0, sum = 0, maxValue = 0;
+        for (int i = 0; i < kMaxStreams; ++i) {
+            if (streamId != VS_METRICS_ALL_STREAMS && i != streamId)
+                continue;
+            const StreamMetrics* s = findStream(i);
+            if (s)
+                s->stages[st].collect(buckets.data(), count, sum, maxValue);
+        }
+        fillStats(buckets.data(), count, sum, maxValue, out.stages[st]);
+    }
+
+    for (int i = 0; i < kMaxStreams; ++i) {
+        if (streamId != VS_METRICS_ALL_STREAMS && i != streamId)
+            continue;
+        const StreamMetrics* s = findStream(i);
+        if (s)
+            out.dropped += s->dropped.load(std::memory_order_relaxed);
+    }
+    out.frames = out.stages[VS_STAGE_TOTAL].count;
+}
+
+std::string MetricsRegistry::toJson(int streamId) const
+{
+    vsMetricsSnapshot snap;
+    snapshot(streamId, snap);
+
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss.precision(1);
+    oss << "{\"version\":" << snap.version
+        << ",\"stream\":" << snap.streamId
+        << ",\"frames\":" << snap.frames
+        << ",\"dropped\":" << snap.dropped
+        << ",\"stages\":{";
+    for (int st = 0; st < VS_STAGE_MAX; ++st) {
+        const vsLatencyStats& s = snap.stages[st];
+        if (st > 0)
+            oss << ",";
+        oss << "\"" << STAGE_NAMES[st] << "\":{"
+            << "\"count\":" << s.count
+            << ",\"mean_us\":" << s.meanUs
+            << ",\"p50_us\":" << s.p50Us
+            << ",\"p90_us\":" << s.p90Us
+            << ",\"p99_us\":" << s.p99Us
+            << ",\"p999_us\":" << s.p999Us
+            << ",\"max_us\":" << s.maxUs
+            << "}";
+    }
+    oss << "}}";
+    return oss.str();
+}
+
+void MetricsRegistry::reset(int streamId)
+{
+    for (int i = 0; i < kMaxStreams; ++i) {
+        if (streamId != VS_METRICS_ALL_STREAMS && i != streamId)
+            continue;
+        StreamMetrics* s = streams_[i].load(std::memory_order_acquire);
+        if (s)
+            s->reset();
+    }
+}
+
+// ============================================================================
+// Thread-local context
+// ============================================================================
+namespace metrics {
+    static thread_local Context t_context;
+    static thread_local int t_streamId = 0;
+
+    Context& current()
+    {
+        return t_context;
+    }
+
+    void setThreadStream(int streamId)
+    {
+        t_streamId = streamId;
+    }
+
+    int threadStream()
+    {
+        return t_streamId;
+    }
+}
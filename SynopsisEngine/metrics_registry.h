@@ -0,0 +1,145 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include "vs_metrics.h"
+
+enum class MetricStage {
+    Preprocess = VS_STAGE_PREPROCESS,
+    Inference = VS_STAGE_INFERENCE,
+    Postprocess = VS_STAGE_POSTPROCESS,
+    NMS = VS_STAGE_NMS,
+    QueueWait = VS_STAGE_QUEUE_WAIT,
+    Total = VS_STAGE_TOTAL,
+    None = VS_STAGE_MAX
+};
+
+/**
+ * @brief Log-linear (HDR style) latency histogram with lock-free recording.
+ *
+ * Values are nanoseconds. Below 16ns every value has its own bucket, above that each
+ * power of two is split in 16 sub-buckets. Recording is a handful of relaxed atomic
+ * adds into one of kShards per-thread shards, so concurrent writers do not bounce
+ * the same cache lines.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBits = 4;
+    static constexpr int kSubCount = 1 << kSubBits;
+    static constexpr int kMaxBit = 44;                         // ~4.8h in ns, larger values are clamped
+    static constexpr int kBuckets = (kMaxBit - kSubBits + 2) * kSubCount;
+    static constexpr int kShards = 4;
+
+    LatencyHistogram() { reset(); }
+
+    void record(uint64_t ns);
+    void reset();
+
+    // Merges all shards into plain counters (used by snapshots, not on the hot path)
+    void collect(uint64_t* buckets, uint64_t& count, uint64_t& sum, uint64_t& maxValue) const;
+
+    static int bucketIndex(uint64_t ns);
+    static uint64_t bucketLow(int index);
+    static uint64_t bucketHigh(int index);
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+        std::atomic<uint64_t> buckets[kBuckets];
+    };
+    Shard shards_[kShards];
+};
+
+/**
+ * @brief Counters and stage histograms of one stream.
+ */
+struct StreamMetrics {
+    LatencyHistogram stages[VS_STAGE_MAX];
+    std::atomic<uint64_t> dropped{ 0 };
+
+    void reset();
+};
+
+/**
+ * @brief Per handle metrics registry. Streams are created lazily on first use and
+ *        never move, so recording never takes a lock.
+ */
+class MetricsRegistry {
+public:
+    static constexpr int kMaxStreams = 64;
+
+    MetricsRegistry() = default;
+    ~MetricsRegistry();
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    void record(int streamId, MetricStage stage, uint64_t ns);
+    void addDropped(int streamId, uint64_t count);
+
+    // streamId == VS_METRICS_ALL_STREAMS aggregates every stream
+    void snapshot(int streamId, vsMetricsSnapshot& out) const;
+    std::string toJson(int streamId) const;
+    void reset(int streamId);
+
+private:
+    StreamMetrics* stream(int streamId);
+    const StreamMetrics* findStream(int streamId) const;
+
+    std::atomic<StreamMetrics*> streams_[kMaxStreams] = {};
+};
+
+namespace metrics {
+    /**
+     * @brief Thread-local sink the detectors record into.
+     *
+     * YoloRunner installs its registry for the duration of a call with ContextScope,
+     * so third party detector code only needs a StageTimer and no handle plumbing.
+     */
+    struct Context {
+        MetricsRegistry* registry = nullptr;
+        int streamId = 0;
+    };
+
+    Context& current();
+
+    // Stream id used for calls made from this thread (set once by a pipeline/worker thread)
+    void setThreadStream(int streamId);
+    int threadStream();
+
+    class ContextScope {
+    public:
+        explicit ContextScope(MetricsRegistry* registry)
+            : prev_(current()) {
+            current().registry = registry;
+            current().streamId = threadStream();
+        }
+        ~ContextScope() { current() = prev_; }
+    private:
+        Context prev_;
+    };
+
+    inline uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    /**
+     * @brief Records the lifetime of the scope into the current context, if any.
+     */
+    class StageTimer {
+    public:
+        explicit StageTimer(MetricStage stage)
+            : stage_(stage), start_(current().registry ? nowNs() : 0) {}
+        ~StageTimer() {
+            Context& ctx = current();
+            if (ctx.registry && start_ != 0)
+                ctx.registry->record(ctx.streamId, stage_, nowNs() - start_);
+        }
+    private:
+        MetricStage stage_;
+        uint64_t start_;
+    };
+}
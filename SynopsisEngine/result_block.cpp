@@ -0,0 +1,298 @@
+#include "pch.h"
+#include "result_block.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include "yolo_define.h"
+
+static inline uint32_t alignUp(size_t v)
+{
+    return static_cast<uint32_t>((v + 7) & ~static_cast<size_t>(7));
+}
+
+static inline vsRect toRect(const BoundingBox& b)
+{
+    return vsRect{ b.x, b.y, b.width, b.height };
+}
+
+// Allocates the block and fills the common header. Payload follows the object records.
+static vsResultHeader* allocBlock(YoloTask task, const cv::Size& imageSize, int count, size_t stride, size_t payloadSize)
+{
+    const uint32_t objectsOffset = alignUp(sizeof(vsResultHeader));
+    const uint32_t payloadOffset = alignUp(objectsOffset + stride * count);
+    const uint32_t totalSize = alignUp(payloadOffset + payloadSize);
+
+    uint8_t* mem = new (std::nothrow) uint8_t[totalSize];
+    if (!mem)
+        return nullptr;
+    std::memset(mem, 0, totalSize);
+
+    vsResultHeader* hdr = reinterpret_cast<vsResultHeader*>(mem);
+    hdr->magic = VS_RESULT_MAGIC;
+    hdr->version = VS_RESULT_VERSION;
+    hdr->task = static_cast<uint16_t>(task);
+    hdr->totalSize = totalSize;
+    hdr->imageWidth = imageSize.width;
+    hdr->imageHeight = imageSize.height;
+    hdr->count = count;
+    hdr->objectsOffset = objectsOffset;
+    hdr->objectStride = static_cast<uint32_t>(stride);
+    hdr->payloadOffset = payloadOffset;
+    hdr->payloadSize = static_cast<uint32_t>(payloadSize);
+    return hdr;
+}
+
+template <typename T>
+static inline T* objectsOf(vsResultHeader* hdr)
+{
+    return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(hdr) + hdr->objectsOffset);
+}
+
+static inline uint8_t* payloadOf(vsResultHeader* hdr)
+{
+    return reinterpret_cast<uint8_t*>(hdr) + hdr->payloadOffset;
+}
+
+void EncodeMaskRLE(const cv::Mat& roiMask, std::vector<uint32_t>& runs)
+{
+    bool fg = false;
+    uint32_t run = 0;
+    for (int y = 0; y < roiMask.rows; ++y) {
+        const uint8_t* p = roiMask.ptr<uint8_t>(y);
+        for (int x = 0; x < roiMask.cols; ++x) {
+            const bool v = p[x] != 0;
+            if (v != fg) {
+                runs.push_back(run);
+                run = 0;
+                fg = v;
+            }
+            ++run;
+        }
+    }
+    runs.push_back(run);
+}
+
+void DecodeMaskRLE(const uint8_t* data, size_t bytes, cv::Size size, cv::Mat& mask)
+{
+    mask.create(size, CV_8UC1);
+    mask.setTo(0);
+    const size_t total = static_cast<size_t>(size.area());
+    const size_t runs = bytes / sizeof(uint32_t);
+    size_t pos = 0;
+    for (size_t i = 0; i < runs && pos < total; ++i) {
+        uint32_t len;
+        std::memcpy(&len, data + i * sizeof(uint32_t), sizeof(len));
+        const size_t n = std::min<size_t>(len, total - pos);
+        if (i & 1)
+            std::memset(mask.data + pos, 255, n);
+        pos += n;
+    }
+}
+
+bool DecodeSegmentMask(const vsResultHeader* block, const vsSegObject& seg, cv::Mat& mask)
+{
+    const int w = seg.maskRoi.width;
+    const int h = seg.maskRoi.height;
+    if (w <= 0 || h <= 0 || static_cast<uint64_t>(seg.maskOffset) + seg.maskSize > block->totalSize)
+        return false;
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(block) + seg.maskOffset;
+
+    if (seg.maskEncoding == VS_MASK_ROI) {
+        if (seg.maskSize < static_cast<uint32_t>(w) * h)
+            return false;
+        mask.create(h, w, CV_8UC1);
+        std::memcpy(mask.data, data, static_cast<size_t>(w) * h);
+        return true;
+    }
+    if (seg.maskEncoding != VS_MASK_RLE)
+        return false;
+    DecodeMaskRLE(data, seg.maskSize, cv::Size(w, h), mask);
+    return true;
+}
+
+vsResultHeader* BuildDetectBlock(const std::vector<Detection>& dets, const cv::Size& imageSize)
+{
+    const int count = static_cast<int>(dets.size());
+    vsResultHeader* hdr = allocBlock(YT_DETECT, imageSize, count, sizeof(vsDetObject), 0);
+    if (!hdr)
+        return nullptr;
+
+    vsDetObject* objs = objectsOf<vsDetObject>(hdr);
+    for (int i = 0; i < count; ++i) {
+        objs[i].box = toRect(dets[i].box);
+        objs[i].conf = dets[i].conf;
+        objs[i].classId = dets[i].classId;
+    }
+    return hdr;
+}
+
+vsResultHeader* BuildSegmentBlock(const std::vector<Segmentation>& segs, const cv::Size& imageSize, vsMaskEncoding maskEncoding)
+{
+    const int count = static_cast<int>(segs.size());
+    const cv::Rect imageRect(0, 0, imageSize.width, imageSize.height);
+
+    // Pass 1: crop every mask to its box and encode it into one scratch buffer
+    std::vector<cv::Rect> rois(count);
+    std::vector<size_t> maskStart(count, 0), maskBytes(count, 0);
+    std::vector<uint32_t> runs;
+    std::vector<uint8_t> bitmaps;
+    size_t payloadSize = 0;
+
+    for (int i = 0; i < count; ++i) {
+        const Segmentation& s = segs[i];
+        cv::Rect roi = cv::Rect(s.box.x, s.box.y, s.box.width, s.box.height) & imageRect;
+        if (!s.mask.empty())
+            roi &= cv::Rect(0, 0, s.mask.cols, s.mask.rows);
+        rois[i] = roi;
+        if (maskEncoding == VS_MASK_NONE || s.mask.empty() || roi.area() <= 0)
+            continue;
+
+        const cv::Mat roiMask = s.mask(roi);
+        if (maskEncoding == VS_MASK_RLE) {
+            const size_t first = runs.size();
+            EncodeMaskRLE(roiMask, runs);
+            maskStart[i] = first * sizeof(uint32_t);
+            maskBytes[i] = (runs.size() - first) * sizeof(uint32_t);
+        }
+        else {
+            const size_t first = bitmaps.size();
+            bitmaps.resize(first + static_cast<size_t>(roi.area()));
+            for (int y = 0; y < roi.height; ++y)
+                std::memcpy(&bitmaps[first + static_cast<size_t>(y) * roi.width], roiMask.ptr<uint8_t>(y), roi.width);
+            maskStart[i] = first;
+            maskBytes[i] = static_cast<size_t>(roi.area());
+        }
+    }
+    payloadSize = (maskEncoding == VS_MASK_RLE) ? runs.size() * sizeof(uint32_t) : bitmaps.size();
+
+    // Pass 2: one allocation, copy records and the scratch payload verbatim
+    vsResultHeader* hdr = allocBlock(YT_SEGMENT, imageSize, count, sizeof(vsSegObject), payloadSize);
+    if (!hdr)
+        return nullptr;
+
+    vsSegObject* objs = objectsOf<vsSegObject>(hdr);
+    for (int i = 0; i < count; ++i) {
+        vsSegObject& o = objs[i];
+        o.box = toRect(segs[i].box);
+        o.conf = segs[i].conf;
+        o.classId = segs[i].classId;
+        o.maskRoi = vsRect{ rois[i].x, rois[i].y, rois[i].width, rois[i].height };
+        if (maskBytes[i] > 0) {
+            o.maskEncoding = maskEncoding;
+            o.maskOffset = hdr->payloadOffset + static_cast<uint32_t>(maskStart[i]);
+            o.maskSize = static_cast<uint32_t>(maskBytes[i]);
+        }
+        else {
+            o.maskEncoding = VS_MASK_NONE;
+        }
+    }
+
+    if (payloadSize > 0) {
+        const void* src = (maskEncoding == VS_MASK_RLE)
+            ? static_cast<const void*>(runs.data())
+            : static_cast<const void*>(bitmaps.data());
+        std::memcpy(payloadOf(hdr), src, payloadSize);
+    }
+    return hdr;
+}
+
+vsResultHeader* BuildPoseBlock(const std::vector<PoseDetection>& poses, const cv::Size& imageSize)
+{
+    const int count = static_cast<int>(poses.size());
+    size_t totalKpts = 0;
+    for (const auto& p : poses)
+        totalKpts += p.keypoints.size();
+
+    vsResultHeader* hdr = allocBlock(YT_POSE, imageSize, count, sizeof(vsPoseObject), totalKpts * sizeof(vsKeypoint));
+    if (!hdr)
+        return nullptr;
+
+    vsPoseObject* objs = objectsOf<vsPoseObject>(hdr);
+    vsKeypoint* kpts = reinterpret_cast<vsKeypoint*>(payloadOf(hdr));
+    uint32_t kptOffset = hdr->payloadOffset;
+    for (int i = 0; i < count; ++i) {
+        const PoseDetection& p = poses[i];
+        vsPoseObject& o = objs[i];
+        o.box = toRect(p.box);
+        o.conf = p.conf;
+        o.classId = p.classId;
+        o.keypointOffset = kptOffset;
+        o.keypointCount = static_cast<uint32_t>(p.keypoints.size());
+        for (const KeyPoint& k : p.keypoints)
+            *kpts++ = vsKeypoint{ k.x, k.y, k.confidence };
+        kptOffset += static_cast<uint32_t>(p.keypoints.size() * sizeof(vsKeypoint));
+    }
+    return hdr;
+}
+
+vsResultHeader* BuildObbBlock(const std::vector<ObbDetection>& obbs, const cv::Size& imageSize)
+{
+    const int count = static_cast<int>(obbs.size());
+    vsResultHeader* hdr = allocBlock(YT_OBB, imageSize, count, sizeof(vsObbObject), 0);
+    if (!hdr)
+        return nullptr;
+
+    vsObbObject* objs = objectsOf<vsObbObject>(hdr);
+    for (int i = 0; i < count; ++i) {
+        const ObbDetection& d = obbs[i];
+        vsObbObject& o = objs[i];
+        o.cx = d.box.x;
+        o.cy = d.box.y;
+        o.width = d.box.width;
+        o.height = d.box.height;
+        o.angle = d.box.angle;
+        o.conf = d.conf;
+        o.classId = d.classId;
+
+        cv::Point2f pts[4];
+        cv::RotatedRect(cv::Point2f(d.box.x, d.box.y), cv::Size2f(d.box.width, d.box.height),
+            d.box.angle * 180.0f / static_cast<float>(CV_PI)).points(pts);
+        for (int k = 0; k < 4; ++k) {
+            o.corners[2 * k] = pts[k].x;
+            o.corners[2 * k + 1] = pts[k].y;
+        }
+    }
+    return hdr;
+}
+
+std::string ToUtf8(const JString& s)
+{
+#if defined(UNICODE)
+    if (s.empty())
+        return std::string();
+    int n = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), static_cast<int>(s.size()), NULL, 0, NULL, NULL);
+    if (n <= 0)
+        return std::string();
+    std::string out(n, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, s.c_str(), static_cast<int>(s.size()), &out[0], n, NULL, NULL);
+    return out;
+#else
+    return s;
+#endif
+}
+
+vsResultHeader* BuildClassifyBlock(const ClassificationResult* result, const cv::Size& imageSize)
+{
+    const int count = result ? 1 : 0;
+    const std::string name = result ? ToUtf8(result->className) : std::string();
+
+    vsResultHeader* hdr = allocBlock(YT_CLASSIFY, imageSize, count, sizeof(vsClassObject), name.size());
+    if (!hdr)
+        return nullptr;
+
+    if (result) {
+        vsClassObject& o = objectsOf<vsClassObject>(hdr)[0];
+        o.classId = result->classId;
+        o.conf = result->confidence;
+        o.nameOffset = hdr->payloadOffset;
+        o.nameLength = static_cast<uint32_t>(name.size());
+        if (!name.empty())
+            std::memcpy(payloadOf(hdr), name.data(), name.size());
+    }
+    return hdr;
+}
+
+void FreeResultBlock(vsResultHeader* block)
+{
+    delete[] reinterpret_cast<uint8_t*>(block);
+}
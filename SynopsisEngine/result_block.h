@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_result.h"
+#include "third_party/yolo/YOLO-common.h"
+
+// Builders for the flat result blocks declared in vs_result.h.
+// Each returns a single allocation (or nullptr on allocation failure) that must be
+// released with FreeResultBlock(), which is what vsReleaseResult() forwards to.
+
+vsResultHeader* BuildDetectBlock(const std::vector<Detection>& dets, const cv::Size& imageSize);
+vsResultHeader* BuildSegmentBlock(const std::vector<Segmentation>& segs, const cv::Size& imageSize, vsMaskEncoding maskEncoding);
+vsResultHeader* BuildPoseBlock(const std::vector<PoseDetection>& poses, const cv::Size& imageSize);
+vsResultHeader* BuildObbBlock(const std::vector<ObbDetection>& obbs, const cv::Size& imageSize);
+vsResultHeader* BuildClassifyBlock(const ClassificationResult* result, const cv::Size& imageSize);
+
+void FreeResultBlock(vsResultHeader* block);
+
+// Row-major run-length encoding of a binary ROI (non-zero = foreground).
+// Runs alternate background/foreground and always start with a (possibly empty) background run.
+void EncodeMaskRLE(const cv::Mat& roiMask, std::vector<uint32_t>& runs);
+// Inverse of EncodeMaskRLE into a 0/255 bitmap of size. data holds bytes / 4 uint32 runs and
+// need not be aligned; runs past the end of the bitmap are ignored.
+void DecodeMaskRLE(const uint8_t* data, size_t bytes, cv::Size size, cv::Mat& mask);
+// The mask of a segmentation record (RLE or ROI) as a 0/255 bitmap of maskRoi's size.
+// False if the record has no mask or its payload is out of the block.
+bool DecodeSegmentMask(const vsResultHeader* block, const vsSegObject& seg, cv::Mat& mask);
+
+// TCHAR string (UTF-16 in UNICODE builds) to UTF-8
+std::string ToUtf8(const JString& s);
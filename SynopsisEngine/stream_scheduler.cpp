@@ -0,0 +1,382 @@
+#include "pch.h"
+#include "stream_scheduler.h"
+#include "result_block.h"
+#include "SynopsisEngine.h"
+#include "third_party/yolo_runner.h"
+#include "Logger.h"
+#include <algorithm>
+
+static vsSchedulerOptions withDefaults(const vsSchedulerOptions& in, size_t sessions)
+{
+    vsSchedulerOptions o = in;
+    o.sessions = static_cast<int>(sessions);
+    if (o.maxBatch <= 0)
+        o.maxBatch = 8;
+    if (o.batchWindowUs == 0)
+        o.batchWindowUs = 5000;
+    return o;
+}
+
+StreamScheduler::StreamScheduler(const vsSchedulerOptions& options, std::vector<std::unique_ptr<YoloRunner>> sessions, RunFn run)
+    : options_(withDefaults(options, sessions.size()))
+    , sessions_(std::move(sessions))
+    , run_(std::move(run))
+{
+    for (auto& session : sessions_)
+        session->setMetricsSink(&metrics_);
+}
+
+StreamScheduler::~StreamScheduler()
+{
+    Stop();
+}
+
+void StreamScheduler::Start()
+{
+    LOG_INFO_STREAM("[StreamScheduler] Starting " << sessions_.size() << " sessions, batch " << options_.maxBatch
+        << ", window " << options_.batchWindowUs << "us, batched inference "
+        << (!sessions_.empty() && sessions_[0]->supportsBatch() ? "yes" : "no"));
+    for (size_t i = 0; i < sessions_.size(); ++i)
+        workers_.emplace_back(&StreamScheduler::workerLoop, this, i);
+}
+
+void StreamScheduler::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_ && workers_.empty())
+            return;
+        stop_ = true;
+        for (auto& st : streams_) {
+            if (st)
+                st->space.notify_all();
+        }
+    }
+    work_.notify_all();
+    for (auto& t : workers_)
+        t.join();
+    workers_.clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& st : streams_) {
+        if (st) {
+            st->stats.dropped += static_cast<int64_t>(st->queue.size());
+            st->queue.clear();
+        }
+    }
+    queued_ = 0;
+    LOG_INFO_STREAM("[StreamScheduler] Stopped after " << batches_ << " batches, "
+        << batchedFrames_ << " frames");
+}
+
+bool StreamScheduler::AddStream(int streamId, const vsStreamOptions& options)
+{
+    if (streamId < 0 || streamId >= MetricsRegistry::kMaxStreams || !options.callback)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ || streams_[streamId])
+        return false;
+
+    auto st = std::make_unique<Stream>();
+    st->id = streamId;
+    st->options = options;
+    if (st->options.weight <= 0)
+        st->options.weight = 1;
+    if (st->options.queueDepth <= 0)
+        st->options.queueDepth = 4;
+    streams_[streamId] = std::move(st);
+    return true;
+}
+
+bool StreamScheduler::RemoveStream(int streamId)
+{
+    if (streamId < 0 || streamId >= MetricsRegistry::kMaxStreams)
+        return false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    Stream* st = streams_[streamId].get();
+    if (!st || st->removing)
+        return false;
+
+    st->removing = true;
+    if (!st->queue.empty()) {
+        st->stats.dropped += static_cast<int64_t>(st->queue.size());
+        metrics_.addDropped(streamId, st->queue.size());
+        queued_ -= st->queue.size();
+        st->queue.clear();
+    }
+    st->space.notify_all();
+    idle_.wait(lock, [st] { return st->inFlight == 0 && st->users == 0; });
+
+    std::unique_ptr<Stream> owned = std::move(streams_[streamId]);
+    lock.unlock();
+
+    vsFrameResult end = {};
+    end.sourceId = streamId;
+    end.endOfStream = 1;
+    end.frameIndex = -1;
+    owned->options.callback(owned->options.userData, &end);
+    return true;
+}
+
+StreamScheduler::SubmitStatus StreamScheduler::Submit(int streamId, const cv::Mat& image, int64_t frameIndex, double timestampMs, int timeoutMs)
+{
+    if (streamId < 0 || streamId >= MetricsRegistry::kMaxStreams || image.empty())
+        return SubmitStatus::NoStream;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    Stream* st = streams_[streamId].get();
+    if (!st || st->removing || stop_)
+        return SubmitStatus::NoStream;
+
+    const size_t depth = static_cast<size_t>(st->options.queueDepth);
+    auto full = [st, depth] { return st->queue.size() + st->reserved >= depth; };
+    // Keeps the stream alive across the unlocked copy; released under the lock on every return
+    ++st->users;
+    struct UserGuard {
+        StreamScheduler* self; Stream* st;
+        ~UserGuard() { --st->users; self->idle_.notify_all(); }
+    } guard{ this, st };
+
+    if (full()) {
+        if (st->options.dropPolicy == VS_DROP_OLDEST) {
+            if (st->queue.empty()) {
+                // Every slot is claimed by other Submit calls still copying: this frame is
+                // the one that goes
+                ++st->stats.dropped;
+                metrics_.addDropped(streamId, 1);
+                return SubmitStatus::Dropped;
+            }
+            recycle(*st, std::move(st->queue.front().frame));
+            st->queue.pop_front();
+            --queued_;
+            ++st->stats.dropped;
+            metrics_.addDropped(streamId, 1);
+        }
+        else {
+            auto room = [&] { return stop_ || st->removing || !full(); };
+            if (timeoutMs < 0)
+                st->space.wait(lock, room);
+            else if (!st->space.wait_for(lock, std::chrono::milliseconds(timeoutMs), room))
+                return SubmitStatus::Full;
+            if (stop_ || st->removing)
+                return SubmitStatus::NoStream;
+        }
+    }
+
+    // Reuse a buffer of the same geometry if the stream has one, then copy unlocked
+    cv::Mat buffer;
+    for (size_t i = 0; i < st->spare.size(); ++i) {
+        if (st->spare[i].size() == image.size() && st->spare[i].type() == image.type()) {
+            buffer = std::move(st->spare[i]);
+            st->spare[i] = std::move(st->spare.back());
+            st->spare.pop_back();
+            break;
+        }
+    }
+    ++st->reserved;
+    lock.unlock();
+    image.copyTo(buffer);
+    lock.lock();
+    --st->reserved;
+
+    if (stop_ || st->removing)
+        return SubmitStatus::NoStream;
+
+    Pending p;
+    p.frame = std::move(buffer);
+    p.index = frameIndex;
+    p.timestampMs = timestampMs;
+    p.queuedAt = Clock::now();
+    st->queue.push_back(std::move(p));
+    ++st->stats.submitted;
+    ++queued_;
+    work_.notify_one();
+    return SubmitStatus::Queued;
+}
+
+bool StreamScheduler::GetStats(int streamId, vsStreamStats& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    out = {};
+    if (streamId < 0) {
+        for (const auto& st : streams_) {
+            if (!st)
+                continue;
+            out.submitted += st->stats.submitted;
+            out.analysed += st->stats.analysed;
+            out.dropped += st->stats.dropped;
+        }
+        out.queued = static_cast<int32_t>(queued_);
+        out.batches = batches_;
+        out.batchedFrames = batchedFrames_;
+        return true;
+    }
+    if (streamId >= MetricsRegistry::kMaxStreams || !streams_[streamId])
+        return false;
+    const Stream& st = *streams_[streamId];
+    out = st.stats;
+    out.queued = static_cast<int32_t>(st.queue.size());
+    return true;
+}
+
+void StreamScheduler::recycle(Stream& stream, cv::Mat&& frame)
+{
+    if (!frame.empty() && stream.spare.size() < static_cast<size_t>(stream.options.queueDepth) + 2)
+        stream.spare.push_back(std::move(frame));
+}
+
+// A batch goes out when it is full or the oldest waiting frame has used up the window
+bool StreamScheduler::batchReady(Clock::time_point now, Clock::time_point& deadline) const
+{
+    if (queued_ >= static_cast<size_t>(options_.maxBatch) || options_.batchWindowUs < 0)
+        return true;
+
+    // A full stream cannot add to the batch any more (and would start dropping), so go now
+    Clock::time_point oldest = Clock::time_point::max();
+    for (const auto& st : streams_) {
+        if (!st || st->queue.empty())
+            continue;
+        if (st->queue.size() >= static_cast<size_t>(st->options.queueDepth))
+            return true;
+        oldest = std::min(oldest, st->queue.front().queuedAt);
+    }
+    if (oldest == Clock::time_point::max())
+        return true;
+    deadline = oldest + std::chrono::microseconds(options_.batchWindowUs);
+    return now >= deadline;
+}
+
+// Deficit round robin: each stream with frames gets `weight` frames per turn, a turn
+// cut short by a full batch resumes with the same stream next time.
+void StreamScheduler::takeBatch(std::vector<Job>& batch)
+{
+    const size_t n = streams_.size();
+    const size_t maxBatch = static_cast<size_t>(options_.maxBatch);
+    const int64_t batchId = batches_;
+    const Clock::time_point now = Clock::now();
+
+    bool took = true;
+    while (took && batch.size() < maxBatch && queued_ > 0) {
+        took = false;
+        for (size_t k = 0; k < n && batch.size() < maxBatch; ++k) {
+            const size_t i = (cursor_ + k) % n;
+            Stream* st = streams_[i].get();
+            if (!st)
+                continue;
+            if (st->queue.empty()) {
+                st->credit = 0;
+                continue;
+            }
+            if (st->credit <= 0)
+                st->credit = st->options.weight;
+
+            while (st->credit > 0 && !st->queue.empty() && batch.size() < maxBatch) {
+                Job job{ st, std::move(st->queue.front()) };
+                st->queue.pop_front();
+                --queued_;
+                --st->credit;
+                ++st->inFlight;
+                metrics_.record(st->id, MetricStage::QueueWait,
+                    static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - job.pending.queuedAt).count()));
+                st->space.notify_one();
+                batch.push_back(std::move(job));
+                took = true;
+            }
+            if (st->lastBatch != batchId) {
+                st->lastBatch = batchId;
+                ++st->stats.batches;
+            }
+            if (batch.size() >= maxBatch) {
+                cursor_ = st->credit > 0 && !st->queue.empty() ? i : (i + 1) % n;
+                break;
+            }
+        }
+    }
+    if (batch.size() < maxBatch && !batch.empty())
+        cursor_ = (cursor_ + 1) % n;
+}
+
+void StreamScheduler::runBatch(YoloRunner& session, std::vector<Job>& batch)
+{
+    std::vector<vsResultHeader*> results(batch.size(), nullptr);
+    int32_t status = VS_SUCCESS;
+
+    try {
+        if (session.task() == YT_DETECT && batch.size() > 1 && session.supportsBatch()) {
+            std::vector<cv::Mat> frames;
+            std::vector<int> ids;
+            frames.reserve(batch.size());
+            ids.reserve(batch.size());
+            for (const Job& job : batch) {
+                frames.push_back(job.pending.frame);
+                ids.push_back(job.stream->id);
+            }
+            std::vector<std::vector<Detection>> dets = session.runDetectBatch(frames, ids.data());
+            for (size_t i = 0; i < batch.size(); ++i)
+                results[i] = BuildDetectBlock(dets[i], frames[i].size());
+        }
+        else {
+            for (size_t i = 0; i < batch.size(); ++i) {
+                metrics::setThreadStream(batch[i].stream->id);
+                results[i] = run_(session, batch[i].pending.frame, batch[i].stream->options.maskEncoding);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR_STREAM("[StreamScheduler] Batch of " << batch.size() << " frames failed: " << e.what());
+        status = VS_ERROR_UNKNOWN;
+    }
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const Job& job = batch[i];
+        vsFrameResult frame = {};
+        frame.sourceId = job.stream->id;
+        frame.frameIndex = job.pending.index;
+        frame.timestampMs = job.pending.timestampMs;
+        frame.result = results[i];
+        frame.status = results[i] ? VS_SUCCESS : status;
+        job.stream->options.callback(job.stream->options.userData, &frame);
+    }
+}
+
+void StreamScheduler::workerLoop(size_t session)
+{
+    YoloRunner& runner = *sessions_[session];
+    std::vector<Job> batch;
+    batch.reserve(static_cast<size_t>(options_.maxBatch));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        if (queued_ == 0) {
+            work_.wait(lock);
+            continue;
+        }
+        Clock::time_point deadline;
+        if (!batchReady(Clock::now(), deadline)) {
+            work_.wait_until(lock, deadline);
+            continue;
+        }
+
+        takeBatch(batch);
+        if (batch.empty())
+            continue;
+        ++batches_;
+        batchedFrames_ += static_cast<int64_t>(batch.size());
+        for (const Job& job : batch)
+            job.stream->stats.batchedFrames += static_cast<int64_t>(batch.size());
+
+        lock.unlock();
+        runBatch(runner, batch);
+        lock.lock();
+
+        for (Job& job : batch) {
+            ++job.stream->stats.analysed;
+            --job.stream->inFlight;
+            recycle(*job.stream, std::move(job.pending.frame));
+        }
+        batch.clear();
+        idle_.notify_all();
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_scheduler.h"
+#include "metrics_registry.h"
+
+class YoloRunner;
+
+/**
+ * @brief Cross-stream micro-batching scheduler over a pool of sessions.
+ *
+ * Frames are copied into per-stream queues (buffers are recycled per stream). Every
+ * session has its own worker thread; a worker waits until maxBatch frames are queued
+ * or the oldest queued frame has waited batchWindowUs, then takes a batch in deficit
+ * round robin over the streams (weight frames per turn) and runs it on its session.
+ * Sessions are never shared between workers, so no engine-wide lock is involved.
+ */
+class StreamScheduler {
+public:
+    // Runs one frame on a session and packs the result (non-batched path)
+    using RunFn = std::function<vsResultHeader*(YoloRunner& session, const cv::Mat& frame, vsMaskEncoding maskEncoding)>;
+
+    enum class SubmitStatus { Queued, Full, Dropped, NoStream };
+
+    StreamScheduler(const vsSchedulerOptions& options, std::vector<std::unique_ptr<YoloRunner>> sessions, RunFn run);
+    ~StreamScheduler();
+
+    StreamScheduler(const StreamScheduler&) = delete;
+    StreamScheduler& operator=(const StreamScheduler&) = delete;
+
+    void Start();
+    // Joins the workers; queued frames are dropped
+    void Stop();
+
+    bool AddStream(int streamId, const vsStreamOptions& options);
+    // Drops queued frames, waits for in-flight ones, then sends the endOfStream notification
+    bool RemoveStream(int streamId);
+
+    // image is copied before returning. VS_DROP_NONE streams wait up to timeoutMs (-1 = forever) for room;
+    // a VS_DROP_OLDEST stream whose slots are all claimed by concurrent calls drops image instead.
+    SubmitStatus Submit(int streamId, const cv::Mat& image, int64_t frameIndex, double timestampMs, int timeoutMs);
+
+    // streamId < 0 sums all streams
+    bool GetStats(int streamId, vsStreamStats& out) const;
+    MetricsRegistry& metrics() { return metrics_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Pending {
+        cv::Mat frame;
+        int64_t index = 0;
+        double timestampMs = 0.0;
+        Clock::time_point queuedAt;
+    };
+
+    struct Stream {
+        int id = 0;
+        vsStreamOptions options = {};
+        std::deque<Pending> queue;
+        std::vector<cv::Mat> spare;     // recycled frame buffers
+        int reserved = 0;               // queue slots claimed by Submit calls still copying
+        int users = 0;                  // Submit calls holding this stream
+        int credit = 0;                 // deficit round robin
+        int inFlight = 0;
+        int64_t lastBatch = -1;
+        bool removing = false;
+        std::condition_variable space;
+        vsStreamStats stats = {};
+    };
+
+    struct Job {
+        Stream* stream;
+        Pending pending;
+    };
+
+    void workerLoop(size_t session);
+    bool batchReady(Clock::time_point now, Clock::time_point& deadline) const;
+    void takeBatch(std::vector<Job>& batch);
+    void runBatch(YoloRunner& session, std::vector<Job>& batch);
+    void recycle(Stream& stream, cv::Mat&& frame);
+
+    vsSchedulerOptions options_;
+    std::vector<std::unique_ptr<YoloRunner>> sessions_;
+    RunFn run_;
+    MetricsRegistry metrics_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_;      // frames arrived / stop
+    std::condition_variable idle_;      // in-flight frames finished
+    std::array<std::unique_ptr<Stream>, MetricsRegistry::kMaxStreams> streams_;
+    size_t cursor_ = 0;                 // stream the next round robin turn starts at
+    size_t queued_ = 0;                 // frames queued over all streams
+    int64_t batches_ = 0;
+    int64_t batchedFrames_ = 0;
+    bool stop_ = false;
+    std::vector<std::thread> workers_;
+};
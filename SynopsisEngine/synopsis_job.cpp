@@ -0,0 +1,791 @@
+#include "pch.h"
+#include "synopsis_job.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include "result_block.h"
+#include "tube_stitcher.h"
+#include "video_pipeline.h"
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* kCheckpointFile = "job.ckpt";
+const char* kTubeFile = "tubes.vstube";
+const char* kMergedTubeFile = "tubes_merged.vstube";
+const char* kEmbeddingFile = "embeddings.bin";
+const char* kPlacementFile = "placements.bin";
+const char* kPlateDir = "plates";
+
+const char* stageName(int stage)
+{
+    static const char* names[] = { "analyse", "merge", "place", "render", "done" };
+    return stage >= 0 && stage < 5 ? names[stage] : "";
+}
+
+fs::path platePath(const fs::path& dir, int64_t frameIndex)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%012lld.jpg", static_cast<long long>(frameIndex));
+    return dir / name;
+}
+
+// Frame indices of the plates in dir, ascending
+std::vector<int64_t> listPlates(const fs::path& dir)
+{
+    std::vector<int64_t> frames;
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() != ".jpg")
+            continue;
+        try {
+            frames.push_back(std::stoll(it->path().stem().string()));
+        }
+        catch (const std::exception&) {
+        }
+    }
+    std::sort(frames.begin(), frames.end());
+    return frames;
+}
+
+// Hash of everything that decides which tubes are placed and how they are batched; placed
+// batches of another key do not belong to this job
+uint64_t placementKey(const SynopsisJob::Options& o)
+{
+    std::ostringstream text;
+    const TubeQuery& q = o.query;
+    text << q.fromFrame << ';' << q.toFrame << ';' << q.colors << ';' << q.minFrames << ';';
+    for (int c : q.classes)
+        text << c << ',';
+    text << ';';
+    for (uint32_t a : q.attributes)
+        text << a << ',';
+    text << ';';
+    for (const cv::Point& p : q.zone)
+        text << p.x << ' ' << p.y << ',';
+    text << ';' << o.fromSeconds << ';' << o.toSeconds << ';' << o.batchSeconds << ';' << o.memoryLimitMB << ';'
+        << o.optimizer.targetFrames << ';' << o.optimizer.timeStep << ';' << o.optimizer.cellsX << ';'
+        << o.optimizer.cellsY << ';' << o.optimizer.minTubeFrames;
+    uint64_t hash = 14695981039346656037ull;    // FNV-1a
+    for (unsigned char ch : text.str()) {
+        hash ^= ch;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Bytes the optimizer holds for a tube: its sparse cells plus its dense scratch while loading
+size_t tubeFootprint(const TubeSummary& t, const SynopsisOptimizer::Options& o, cv::Size frameSize)
+{
+    const int64_t bins = (t.lastFrame - t.firstFrame + o.timeStep) / o.timeStep;
+    const int words = (o.cellsX * o.cellsY + 63) / 64;
+    const int rows = frameSize.height > 0 ? (t.y1 - t.y0) * o.cellsY / frameSize.height + 2 : o.cellsY;
+    const int wordsPerBin = std::min(words, rows * o.cellsX / 64 + 1);
+    return static_cast<size_t>(bins) * (wordsPerBin * 16 + words * sizeof(uint64_t)) + 128;
+}
+
+// Encoded records of a tube the renderer holds at once: its records of about three chunks
+// (the one shown, the one read ahead and an older one a frame in flight may still use)
+size_t renderWindowBytes(const TubeStoreReader& store, const TubeSummary& t)
+{
+    uint64_t bytes = 0;
+    uint64_t records = 0;
+    for (uint32_t c = t.firstChunk; c <= t.lastChunk; ++c) {
+        uint64_t chunkBytes = 0;
+        uint32_t chunkRecords = 0;
+        if (!store.chunkSize(c, chunkBytes, chunkRecords))
+            break;
+        bytes += chunkBytes;
+        records += chunkRecords;
+    }
+    const uint64_t perRecord = (records ? bytes / records : 0) + sizeof(TubeFrame);
+    const uint64_t span = t.lastChunk - t.firstChunk + 1;
+    const uint64_t window = std::min<uint64_t>(t.frameCount, (3 * static_cast<uint64_t>(t.frameCount) + span - 1) / span);
+    return static_cast<size_t>(window * perRecord);
+}
+
+} // namespace
+
+SynopsisJob::SynopsisJob()
+    : SynopsisJob(Options())
+{
+}
+
+SynopsisJob::SynopsisJob(const Options& options)
+    : options_(options)
+{
+    options_.frameStride = std::max(1, options_.frameStride);
+}
+
+std::string SynopsisJob::path(const char* name) const
+{
+    return (fs::u8path(workDir_) / name).u8string();
+}
+
+// ============================================================================
+// Checkpoint
+// ============================================================================
+bool SynopsisJob::loadCheckpoint(Checkpoint& out) const
+{
+    std::ifstream in(fs::u8path(path(kCheckpointFile)));
+    if (!in)
+        return false;
+    std::string line;
+    int version = 0;
+    SegmentState whole;         // version 1 analysed the file as one segment
+    while (std::getline(in, line)) {
+        const size_t eq = line.find('=');
+        if (eq == std::string::npos)
+            continue;
+        const std::string key = line.substr(0, eq);
+        const std::string value = line.substr(eq + 1);
+        try {
+            if (key == "version")
+                version = std::stoi(value);
+            else if (key == "source")
+                out.source = value;
+            else if (key == "stage") {
+                int stage = 0;
+                while (stage <= static_cast<int>(Stage::Done) && value != stageName(stage))
+                    ++stage;
+                out.stage = static_cast<Stage>(stage);     // past Done = unknown, rejected below
+            }
+            else if (key == "segment") {
+                // begin,end,decodeFrom,nextFrame,storeBytes,done
+                SegmentState seg;
+                long long begin = 0, end = 0, decodeFrom = 0, nextFrame = 0;
+                unsigned long long storeBytes = 0;
+                int done = 0;
+                if (std::sscanf(value.c_str(), "%lld,%lld,%lld,%lld,%llu,%d", &begin, &end, &decodeFrom, &nextFrame, &storeBytes, &done) != 6)
+                    return false;
+                seg.range.begin = begin;
+                seg.range.end = end;
+                seg.range.decodeFrom = decodeFrom;
+                seg.nextFrame = nextFrame;
+                seg.storeBytes = storeBytes;
+                seg.done = done != 0;
+                out.segments.push_back(seg);
+            }
+            else if (key == "nextFrame")
+                whole.nextFrame = std::stoll(value);
+            else if (key == "storeBytes")
+                whole.storeBytes = std::stoull(value);
+            else if (key == "batchesDone")
+                out.batchesDone = std::stoi(value);
+            else if (key == "synopsisFrames")
+                out.synopsisFrames = std::stoll(value);
+            else if (key == "placementCount")
+                out.placementCount = std::stoull(value);
+            else if (key == "placementKey")
+                out.placementKey = std::stoull(value, nullptr, 16);
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+    }
+    if (version == 1) {
+        whole.done = out.stage != Stage::Analyse;
+        out.segments.assign(1, whole);
+    }
+    return (version == 1 || version == 2) && static_cast<int>(out.stage) <= static_cast<int>(Stage::Done);
+}
+
+bool SynopsisJob::saveCheckpoint(const Checkpoint& ckpt) const
+{
+    // Written aside and renamed over the old one, so a crash leaves one or the other
+    const fs::path target = fs::u8path(path(kCheckpointFile));
+    fs::path temp = target;
+    temp += ".tmp";
+    {
+        std::ofstream out(temp, std::ios::trunc);
+        out << "version=2\n"
+            << "source=" << ckpt.source << "\n"
+            << "stage=" << stageName(static_cast<int>(ckpt.stage)) << "\n";
+        for (const SegmentState& seg : ckpt.segments) {
+            out << "segment=" << seg.range.begin << "," << seg.range.end << "," << seg.range.decodeFrom << ","
+                << seg.nextFrame << "," << seg.storeBytes << "," << (seg.done ? 1 : 0) << "\n";
+        }
+        out << "batchesDone=" << ckpt.batchesDone << "\n"
+            << "synopsisFrames=" << ckpt.synopsisFrames << "\n"
+            << "placementCount=" << ckpt.placementCount << "\n"
+            << "placementKey=" << std::hex << ckpt.placementKey << std::dec << "\n";
+        out.flush();
+        if (!out) {
+            LOG_ERROR_STREAM("[SynopsisJob] Cannot write " << temp.u8string());
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(temp, target, ec);
+    if (ec) {
+        LOG_ERROR_STREAM("[SynopsisJob] Cannot replace " << target.u8string() << ": " << ec.message());
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Run
+// ============================================================================
+bool SynopsisJob::Run(const std::string& sourceUtf8, const std::string& workDirUtf8, const std::string& outputUtf8,
+    std::vector<InferFn> infer, ProgressFn progress, TubeMerger::EmbedFn embed)
+{
+    workDir_ = workDirUtf8;
+    stop_ = false;
+    placedTubes_ = 0;
+    std::error_code ec;
+    fs::create_directories(fs::u8path(path(kPlateDir)), ec);
+    if (ec) {
+        LOG_ERROR_STREAM("[SynopsisJob] Cannot create " << workDirUtf8 << ": " << ec.message());
+        return false;
+    }
+
+    Checkpoint ckpt;
+    if (loadCheckpoint(ckpt) && ckpt.source == sourceUtf8) {
+        LOG_INFO_STREAM("[SynopsisJob] Resuming " << sourceUtf8 << " at stage " << stageName(static_cast<int>(ckpt.stage))
+            << ", " << ckpt.segments.size() << " segments, batch " << ckpt.batchesDone);
+    }
+    else {
+        // Another source (or no job yet): drop whatever an earlier job left
+        ckpt = Checkpoint();
+        ckpt.source = sourceUtf8;
+        for (fs::directory_iterator it(fs::u8path(workDir_), ec), end; !ec && it != end; it.increment(ec)) {
+            if (it->path().extension() == ".vstube") {
+                std::error_code removeEc;
+                fs::remove(it->path(), removeEc);
+            }
+        }
+        fs::remove(fs::u8path(path(kPlacementFile)), ec);
+        fs::remove(fs::u8path(path(kEmbeddingFile)), ec);
+        for (int64_t f : listPlates(fs::u8path(path(kPlateDir))))
+            fs::remove(platePath(fs::u8path(path(kPlateDir)), f), ec);
+        if (!saveCheckpoint(ckpt))
+            return false;
+    }
+
+    // Batches placed for another query (or batch settings) start over; the tubes stay
+    const uint64_t key = placementKey(options_);
+    if (ckpt.placementKey != key) {
+        if (static_cast<int>(ckpt.stage) > static_cast<int>(Stage::Place) || ckpt.batchesDone > 0) {
+            LOG_INFO("[SynopsisJob] The tube selection changed since the last run; placing again");
+            ckpt.stage = Stage::Place;
+        }
+        ckpt.batchesDone = 0;
+        ckpt.synopsisFrames = 0;
+        ckpt.placementCount = 0;
+        ckpt.placementKey = key;
+        fs::remove(fs::u8path(path(kPlacementFile)), ec);
+        if (!saveCheckpoint(ckpt))
+            return false;
+    }
+
+    if (ckpt.stage == Stage::Analyse && !analyse(sourceUtf8, infer, progress, ckpt))
+        return false;
+    if (ckpt.stage == Stage::Merge && !merge(embed, progress, ckpt))
+        return false;
+    if (ckpt.stage == Stage::Place && !place(progress, ckpt))
+        return false;
+    if (ckpt.stage == Stage::Render && !render(outputUtf8, progress, ckpt))
+        return false;
+    placedTubes_ = ckpt.placementCount;
+    LOG_INFO_STREAM("[SynopsisJob] " << sourceUtf8 << " done: " << ckpt.placementCount << " tubes in "
+        << ckpt.synopsisFrames << " frames");
+    return true;
+}
+
+std::string SynopsisJob::segmentStorePath(const Checkpoint& ckpt, size_t segment) const
+{
+    // A single segment writes the final store directly
+    if (ckpt.segments.size() <= 1)
+        return path(kTubeFile);
+    char name[32];
+    std::snprintf(name, sizeof(name), "tubes_%03zu.vstube", segment);
+    return path(name);
+}
+
+// ============================================================================
+// Pass one: analyse
+// ============================================================================
+bool SynopsisJob::analyse(const std::string& source, std::vector<InferFn>& infer, ProgressFn& progress, Checkpoint& ckpt)
+{
+    // Interrupted after the last segment: only the stitch is left, which needs no source
+    const bool analysed = !ckpt.segments.empty()
+        && std::all_of(ckpt.segments.begin(), ckpt.segments.end(), [](const SegmentState& seg) { return seg.done; });
+    int64_t frameCount = 0;
+    if (!analysed) {
+        cv::VideoCapture cap;
+        if (!cap.open(source)) {
+            LOG_ERROR_STREAM("[SynopsisJob] Cannot open " << source);
+            return false;
+        }
+        frameCount = static_cast<int64_t>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+        if (ckpt.segments.empty()) {
+            const double fps = cap.get(cv::CAP_PROP_FPS) > 0.0 ? cap.get(cv::CAP_PROP_FPS) : 25.0;
+            const int stride = options_.frameStride;
+            // Whole strides, and enough of them for the stitcher to compare a few boxes
+            int64_t overlap = std::max<int64_t>(4 * stride, static_cast<int64_t>(options_.overlapSeconds * fps));
+            overlap = (overlap + stride - 1) / stride * stride;
+            const int count = frameCount > 0 ? std::max(1, options_.segments) : 1;
+            for (const VideoSegment& range : PlanVideoSegments(source, frameCount, count, overlap)) {
+                SegmentState seg;
+                seg.range = range;
+                seg.nextFrame = range.decodeFrom;
+                ckpt.segments.push_back(seg);
+            }
+            if (!saveCheckpoint(ckpt))
+                return false;
+            LOG_INFO_STREAM("[SynopsisJob] Analysing " << source << " in " << ckpt.segments.size() << " segments");
+        }
+    }
+
+    // Segments are handed to one thread per model session as they free up
+    std::vector<size_t> pending;
+    for (size_t k = 0; k < ckpt.segments.size(); ++k) {
+        if (!ckpt.segments[k].done)
+            pending.push_back(k);
+    }
+    std::vector<std::atomic<int64_t>> positions(ckpt.segments.size());
+    for (size_t k = 0; k < ckpt.segments.size(); ++k)
+        positions[k] = ckpt.segments[k].done ? ckpt.segments[k].range.end : ckpt.segments[k].nextFrame;
+
+    std::atomic<size_t> nextPending{ 0 };
+    std::atomic<bool> failed{ false };
+    std::atomic<int> running{ 0 };
+    const size_t threadCount = std::min(pending.size(), std::max<size_t>(1, infer.size()));
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadCount; ++i) {
+        ++running;
+        threads.emplace_back([&, i] {
+            InferFn none;
+            InferFn& fn = i < infer.size() ? infer[i] : none;
+            while (!stop_) {
+                const size_t p = nextPending++;
+                if (p >= pending.size())
+                    break;
+                if (!analyseSegment(source, pending[p], fn, positions[pending[p]], ckpt)) {
+                    failed = true;
+                    stop_ = true;
+                }
+            }
+            --running;
+        });
+    }
+
+    // Progress is reported from here, the caller's thread, over the frames each segment decodes
+    auto fraction = [&] {
+        if (frameCount <= 0)
+            return 0.0;
+        int64_t total = 0, done = 0;
+        for (size_t k = 0; k < ckpt.segments.size(); ++k) {
+            const VideoSegment& range = ckpt.segments[k].range;
+            const int64_t end = std::min(range.end, frameCount);
+            total += std::max<int64_t>(0, end - range.decodeFrom);
+            done += std::max<int64_t>(0, std::min<int64_t>(positions[k], end) - range.decodeFrom);
+        }
+        return total > 0 ? static_cast<double>(done) / total : 0.0;
+    };
+    while (running > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (progress && !stop_ && !progress(VS_SYNOPSIS_ANALYSE, fraction()))
+            stop_ = true;
+    }
+    for (std::thread& t : threads)
+        t.join();
+
+    if (stop_) {
+        LOG_INFO_STREAM("[SynopsisJob] Analysis " << (failed ? "failed" : "stopped") << "; resumable from the checkpoint");
+        return false;
+    }
+    if (ckpt.segments.size() > 1 && !stitch(ckpt))
+        return false;
+    ckpt.stage = Stage::Merge;
+    LOG_INFO_STREAM("[SynopsisJob] Analysed " << source);
+    return saveCheckpoint(ckpt);
+}
+
+bool SynopsisJob::analyseSegment(const std::string& source, size_t segment, InferFn& infer, std::atomic<int64_t>& position,
+    Checkpoint& ckpt)
+{
+    SegmentState seg;
+    {
+        std::lock_guard<std::mutex> lock(checkpointMutex_);
+        seg = ckpt.segments[segment];
+    }
+    const VideoSegment range = seg.range;
+    const std::string storePath = segmentStorePath(ckpt, segment);
+
+    cv::VideoCapture cap;
+    if (!cap.open(source)) {
+        LOG_ERROR_STREAM("[SynopsisJob] Cannot open " << source);
+        return false;
+    }
+    const cv::Size frameSize(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)), static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    const double fps = cap.get(cv::CAP_PROP_FPS) > 0.0 ? cap.get(cv::CAP_PROP_FPS) : 25.0;
+    const int stride = options_.frameStride;
+
+    // Track ids of different segments never meet, even before stitching
+    TubeBuilder::Options tubeOptions = options_.tubes;
+    tubeOptions.firstTrackId += static_cast<int>(segment) << 24;
+    TubeBuilder builder(tubeOptions);
+    const fs::path plateDir = fs::u8path(path(kPlateDir));
+    if (seg.nextFrame > range.decodeFrom) {
+        if (!builder.Resume(storePath, seg.storeBytes))
+            return false;
+        // Plates past the checkpoint come again
+        std::error_code ec;
+        for (int64_t f : listPlates(plateDir)) {
+            if (f >= std::max(seg.nextFrame, range.begin) && f < range.end)
+                fs::remove(platePath(plateDir, f), ec);
+        }
+    }
+    else if (!builder.Open(storePath, frameSize, fps)) {
+        return false;
+    }
+    const int64_t first = SeekToFrame(cap, seg.nextFrame);
+
+    // Sampling must land on analysed frames; the overlap only warms the model up
+    BackgroundModel::Options bgOptions = options_.background;
+    bgOptions.sampleEvery = (std::max(bgOptions.sampleEvery, stride) + stride - 1) / stride * stride;
+    BackgroundModel background(bgOptions);
+    const std::vector<int> jpegParams = { cv::IMWRITE_JPEG_QUALITY, 95 };
+    background.setPlateSink([&](const BackgroundPlate& plate) {
+        if (plate.frameIndex < range.begin)
+            return;
+        if (!cv::imwrite(platePath(plateDir, plate.frameIndex).u8string(), plate.image, jpegParams))
+            LOG_WARNING_STREAM("[SynopsisJob] Cannot write the plate of frame " << plate.frameIndex);
+    });
+
+    // Decoding runs ahead on its own thread, as in VideoPipeline
+    PrefetchRing ring(static_cast<size_t>(std::max(2, options_.prefetchFrames)));
+    std::atomic<bool> decodeFailed{ false };
+    std::thread decoder([&] {
+        int64_t index = first;
+        for (; index >= 0 && index < range.end;) {
+            bool more = true;
+            while (stride > 1 && index % stride != 0) {
+                if (!cap.grab()) {
+                    more = false;
+                    break;
+                }
+                ++index;
+            }
+            PrefetchRing::Slot* slot = more && index < range.end ? ring.beginWrite() : nullptr;
+            if (!slot)
+                break;
+            try {
+                if (!cap.read(slot->frame) || slot->frame.empty())
+                    break;
+            }
+            catch (const cv::Exception& e) {
+                LOG_ERROR_STREAM("[SynopsisJob] Decode error at frame " << index << ": " << e.what());
+                decodeFailed = true;
+                break;
+            }
+            if (slot->frame.type() != CV_8UC3)
+                cv::cvtColor(slot->frame, slot->frame, slot->frame.channels() == 1 ? cv::COLOR_GRAY2BGR : cv::COLOR_BGRA2BGR);
+            slot->index = index++;
+            slot->timestampMs = cap.get(cv::CAP_PROP_POS_MSEC);
+            ring.commitWrite();
+        }
+        ring.finish();
+    });
+
+    auto record = [&](int64_t nextFrame, uint64_t storeBytes, bool done) {
+        std::lock_guard<std::mutex> lock(checkpointMutex_);
+        SegmentState& state = ckpt.segments[segment];
+        state.nextFrame = nextFrame;
+        state.storeBytes = storeBytes;
+        state.done = done;
+        return saveCheckpoint(ckpt);
+    };
+    auto checkpoint = [&](int64_t nextFrame) {
+        const uint64_t bytes = builder.Checkpoint();
+        return bytes != 0 && record(nextFrame, bytes, false);
+    };
+
+    const int64_t checkpointEvery = std::max<int64_t>(1, static_cast<int64_t>(options_.checkpointSeconds * fps));
+    int64_t nextCheckpoint = seg.nextFrame + checkpointEvery;
+    int64_t lastFrame = seg.nextFrame - 1;
+    double lastMs = 0.0;
+    bool ok = true;
+    std::vector<cv::Rect> foreground;
+
+    for (;;) {
+        int skipped = 0;
+        PrefetchRing::Slot* slot = ring.beginRead(false, skipped);
+        if (!slot)
+            break;
+        vsResultHeader* result = infer ? infer(slot->frame) : nullptr;
+        builder.AddResult(slot->frame, result, slot->index, slot->timestampMs);
+        if (background.wantsFrame(slot->index)) {
+            foreground.clear();
+            for (const TubeObservation& o : builder.lastObjects())
+                foreground.push_back(o.box);
+            background.update(slot->frame, foreground, slot->index, slot->timestampMs);
+        }
+        FreeResultBlock(result);
+        lastFrame = slot->index;
+        lastMs = slot->timestampMs;
+        ring.commitRead();
+        position = lastFrame + 1;
+
+        if (stop_ || lastFrame + 1 >= nextCheckpoint) {
+            if (!checkpoint(lastFrame + 1)) {
+                ok = false;
+                break;
+            }
+            nextCheckpoint = lastFrame + 1 + checkpointEvery;
+        }
+        if (stop_)
+            break;
+    }
+    ring.close();
+    decoder.join();
+
+    if (!ok || stop_ || decodeFailed) {
+        if (decodeFailed)
+            checkpoint(lastFrame + 1);
+        LOG_INFO_STREAM("[SynopsisJob] Segment " << segment << (ok && !decodeFailed ? " stopped" : " failed") << " at frame "
+            << lastFrame + 1 << "; resumable from the checkpoint");
+        return ok && !decodeFailed;
+    }
+
+    background.flush(lastFrame, lastMs);
+    if (!builder.Close() || !record(lastFrame + 1, builder.store().bytesWritten(), true))
+        return false;
+    LOG_INFO_STREAM("[SynopsisJob] Segment " << segment << " analysed, frames " << range.decodeFrom << " to " << lastFrame);
+    return true;
+}
+
+bool SynopsisJob::stitch(Checkpoint& ckpt)
+{
+    // Redone from the segment stores if interrupted; they go once the result is in place
+    std::vector<std::string> stores;
+    std::vector<VideoSegment> ranges;
+    for (size_t k = 0; k < ckpt.segments.size(); ++k) {
+        stores.push_back(segmentStorePath(ckpt, k));
+        ranges.push_back(ckpt.segments[k].range);
+    }
+    TubeStitcher::Options stitchOptions;
+    stitchOptions.chunkBytes = options_.tubes.chunkBytes;
+    TubeStitcher stitcher(stitchOptions);
+    if (!stitcher.Merge(stores, ranges, path(kTubeFile))) {
+        LOG_ERROR_STREAM("[SynopsisJob] Cannot join the segment stores into " << path(kTubeFile));
+        return false;
+    }
+    ckpt.stage = Stage::Merge;
+    if (!saveCheckpoint(ckpt))
+        return false;
+    std::error_code ec;
+    for (const std::string& store : stores)
+        fs::remove(fs::u8path(store), ec);
+    return true;
+}
+
+bool SynopsisJob::merge(TubeMerger::EmbedFn& embed, ProgressFn& progress, Checkpoint& ckpt)
+{
+    if (embed) {
+        // The cache goes before the merged store replaces the one its tube ids refer to; a
+        // crash in between merges the merged store again, which only costs time
+        TubeMerger merger(options_.merger);
+        auto onProgress = [&](double fraction) { return !progress || progress(VS_SYNOPSIS_MERGE, fraction); };
+        if (!merger.Merge(path(kTubeFile), path(kEmbeddingFile), path(kMergedTubeFile), embed, onProgress)) {
+            LOG_INFO("[SynopsisJob] Fragment merge stopped or failed; resumable from the cached embeddings");
+            return false;
+        }
+        std::error_code ec;
+        fs::remove(fs::u8path(path(kEmbeddingFile)), ec);
+        fs::rename(fs::u8path(path(kMergedTubeFile)), fs::u8path(path(kTubeFile)), ec);
+        if (ec) {
+            LOG_ERROR_STREAM("[SynopsisJob] Cannot replace " << path(kTubeFile) << ": " << ec.message());
+            return false;
+        }
+    }
+    ckpt.stage = Stage::Place;
+    return saveCheckpoint(ckpt);
+}
+
+// ============================================================================
+// Pass two: place and render
+// ============================================================================
+bool SynopsisJob::place(ProgressFn& progress, Checkpoint& ckpt)
+{
+    TubeStoreReader store;
+    if (!store.Open(path(kTubeFile)))
+        return false;
+    const std::vector<TubeSummary>& tubes = store.tubes();
+    const double fps = store.info().fps > 0.0 ? store.info().fps : 25.0;
+
+    SynopsisOptimizer::Options optOptions = options_.optimizer;
+    if (options_.batchSeconds > 0.0)
+        optOptions.targetFrames = static_cast<int64_t>(options_.batchSeconds * fps);
+
+    TubeQuery query = options_.query;
+    query.minFrames = std::max(query.minFrames, optOptions.minTubeFrames);
+    if (options_.fromSeconds > 0.0)
+        query.fromFrame = std::max(query.fromFrame, static_cast<int64_t>(options_.fromSeconds * fps));
+    if (options_.toSeconds > 0.0)
+        query.toFrame = std::min(query.toFrame, static_cast<int64_t>(options_.toSeconds * fps));
+    TubeIndex index;
+    index.Build(store);
+    std::vector<uint32_t> order = index.Query(query);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return tubes[a].firstFrame < tubes[b].firstFrame; });
+
+    // Nothing matched: an empty placement, not one batch of every tube (LoadTubes reads an
+    // empty id list as the whole store)
+    if (order.empty()) {
+        LOG_INFO("[SynopsisJob] The query matches no tubes; the synopsis is empty");
+        std::ofstream empty(fs::u8path(path(kPlacementFile)), std::ios::binary | std::ios::trunc);
+        if (!empty) {
+            LOG_ERROR_STREAM("[SynopsisJob] Cannot write " << path(kPlacementFile));
+            return false;
+        }
+        ckpt.batchesDone = 0;
+        ckpt.synopsisFrames = 0;
+        ckpt.placementCount = 0;
+        ckpt.stage = Stage::Render;
+        return saveCheckpoint(ckpt);
+    }
+
+    // Batches of consecutive tubes whose footprint, plus the count volume over the longest
+    // of them, fits half the budget after the store's index and one chunk read. Batches follow
+    // each other in the synopsis, so the renderer only ever holds tubes of one batch: their
+    // record windows must fit the same half (the frame pool gets a quarter, see render()).
+    // The split only depends on the store, so a resumed job finds the same batches.
+    uint64_t largestChunk = 0;
+    for (size_t c = 0; c < store.chunkCount(); ++c) {
+        uint64_t bytes = 0;
+        uint32_t records = 0;
+        if (store.chunkSize(c, bytes, records))
+            largestChunk = std::max(largestChunk, bytes);
+    }
+    const size_t half = options_.memoryLimitMB * (1u << 20) / 2;
+    const size_t fixed = tubes.size() * sizeof(TubeSummary) * 2 + static_cast<size_t>(2 * largestChunk);
+    const size_t budget = half > fixed ? half - fixed : 0;
+    const int words = (optOptions.cellsX * optOptions.cellsY + 63) / 64;
+    std::vector<size_t> batchStart = { 0 };
+    size_t used = 0;
+    size_t records = 0;
+    int64_t longest = 0;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const TubeSummary& t = tubes[order[i]];
+        const size_t tube = tubeFootprint(t, optOptions, store.info().frameSize);
+        const size_t window = renderWindowBytes(store, t);
+        const int64_t length = std::max(optOptions.targetFrames, std::max(longest, t.lastFrame - t.firstFrame + 1));
+        const size_t volume = static_cast<size_t>(length / optOptions.timeStep + 1) * 6 * words * sizeof(uint64_t);
+        if (i > batchStart.back() && (used + tube + volume > budget || records + window > budget)) {
+            batchStart.push_back(i);
+            used = 0;
+            records = 0;
+            longest = 0;
+        }
+        used += tube;
+        records += window;
+        longest = std::max(longest, t.lastFrame - t.firstFrame + 1);
+    }
+    batchStart.push_back(order.size());
+    const int batches = static_cast<int>(batchStart.size()) - 1;
+    LOG_INFO_STREAM("[SynopsisJob] Placing " << order.size() << " tubes in " << batches << " batches");
+
+    // Placements of unfinished batches are cut off
+    const fs::path placementPath = fs::u8path(path(kPlacementFile));
+    std::error_code ec;
+    if (fs::exists(placementPath, ec))
+        fs::resize_file(placementPath, ckpt.placementCount * sizeof(TubePlacement), ec);
+    std::ofstream out(placementPath, std::ios::binary | std::ios::app);
+    if (!out) {
+        LOG_ERROR_STREAM("[SynopsisJob] Cannot write " << placementPath.u8string());
+        return false;
+    }
+
+    std::vector<TubePlacement> placements;
+    for (int b = ckpt.batchesDone; b < batches; ++b) {
+        const std::vector<uint32_t> ids(order.begin() + batchStart[b], order.begin() + batchStart[b + 1]);
+        SynopsisOptimizer optimizer(optOptions);
+        if (!optimizer.LoadTubes(store, ids) || !optimizer.Solve(placements))
+            return false;
+        for (TubePlacement& p : placements)
+            p.start += ckpt.synopsisFrames;
+        out.write(reinterpret_cast<const char*>(placements.data()), static_cast<std::streamsize>(placements.size() * sizeof(TubePlacement)));
+        out.flush();
+        if (!out) {
+            LOG_ERROR_STREAM("[SynopsisJob] Cannot write " << placementPath.u8string());
+            return false;
+        }
+
+        ckpt.batchesDone = b + 1;
+        ckpt.synopsisFrames += optimizer.stats().lengthFrames;
+        ckpt.placementCount += placements.size();
+        if (!saveCheckpoint(ckpt))
+            return false;
+        if (progress && !progress(VS_SYNOPSIS_PLACE, static_cast<double>(b + 1) / batches)) {
+            LOG_INFO_STREAM("[SynopsisJob] Placement stopped after batch " << b + 1 << " of " << batches);
+            return false;
+        }
+    }
+
+    ckpt.stage = Stage::Render;
+    return saveCheckpoint(ckpt);
+}
+
+bool SynopsisJob::render(const std::string& output, ProgressFn& progress, Checkpoint& ckpt)
+{
+    TubeStoreReader store;
+    if (!store.Open(path(kTubeFile)))
+        return false;
+
+    std::vector<TubePlacement> placements(static_cast<size_t>(ckpt.placementCount));
+    if (!placements.empty()) {
+        std::ifstream in(fs::u8path(path(kPlacementFile)), std::ios::binary);
+        if (!in.read(reinterpret_cast<char*>(placements.data()), static_cast<std::streamsize>(placements.size() * sizeof(TubePlacement)))) {
+            LOG_ERROR_STREAM("[SynopsisJob] " << path(kPlacementFile) << " is shorter than the checkpoint says");
+            return false;
+        }
+    }
+
+    // One plate in memory at a time; the renderer asks in synopsis order from one thread
+    const fs::path plateDir = fs::u8path(path(kPlateDir));
+    const std::vector<int64_t> plateFrames = listPlates(plateDir);
+    int64_t cachedFrame = -1;
+    cv::Mat cached;
+    auto plates = [&](int64_t sourceFrame) {
+        if (plateFrames.empty())
+            return cv::Mat();
+        auto it = std::upper_bound(plateFrames.begin(), plateFrames.end(), sourceFrame);
+        const int64_t frame = it == plateFrames.begin() ? *it : *std::prev(it);
+        if (frame != cachedFrame) {
+            cached = cv::imread(platePath(plateDir, frame).u8string(), cv::IMREAD_COLOR);
+            cachedFrame = frame;
+        }
+        return cached;
+    };
+
+    // A quarter of the budget goes to frame buffers; the tubes' record windows fit half of
+    // it, as place() cut the batches to
+    SynopsisRenderer::Options renderOptions = options_.renderer;
+    const cv::Size frameSize = store.info().frameSize;
+    const size_t frameBytes = std::max<size_t>(1, static_cast<size_t>(frameSize.area()) * 3);
+    const int maxPool = static_cast<int>(std::max<size_t>(2, options_.memoryLimitMB * (1u << 20) / 4 / frameBytes));
+    int threads = renderOptions.threads > 0 ? renderOptions.threads
+        : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    threads = std::min(threads, maxPool - 1);
+    renderOptions.threads = threads;
+    renderOptions.poolFrames = renderOptions.poolFrames > 0 ? std::min(renderOptions.poolFrames, maxPool) : std::min(3 * threads, maxPool);
+
+    SynopsisRenderer renderer(renderOptions);
+    if (progress)
+        renderer.setProgress([&](double fraction) { return progress(VS_SYNOPSIS_RENDER, fraction); });
+    if (!renderer.Render(store, placements, plates, output))
+        return false;
+
+    ckpt.stage = Stage::Done;
+    return saveCheckpoint(ckpt);
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_synopsis.h"
+#include "background_model.h"
+#include "tube_builder.h"
+#include "tube_index.h"
+#include "tube_merger.h"
+#include "synopsis_optimizer.h"
+#include "synopsis_renderer.h"
+#include "video_segments.h"
+
+/**
+ * @brief Two-pass synopsis of a long file with everything bulky spilled to a work directory.
+ *
+ * Pass one (analyse) splits a seekable file at keyframes into `segments` ranges analysed
+ * side by side, each with its own decoder, PrefetchRing, model session, TubeBuilder and
+ * BackgroundModel; plates are written as JPEGs as soon as they are emitted. A segment also
+ * decodes overlapSeconds in front of its range so a TubeStitcher can join the tracks cut by
+ * the boundary once every segment is done. Every checkpointSeconds of source a segment
+ * flushes its tube store and rewrites its line of the checkpoint (temp file + rename), so a
+ * crash loses at most that much analysis per segment: Resume cuts each store back to its
+ * checkpointed size and seeks that segment's decoder.
+ *
+ * With a re-ID model (embed), a TubeMerger then joins the fragments of objects whose track
+ * broke, caching the tube embeddings in the work directory so an interrupted merge resumes.
+ *
+ * Pass two (place) picks the tubes matching `query` through a TubeIndex, then splits them,
+ * in source order, into batches whose optimizer
+ * footprint fits half of memoryLimitMB, solves each batch on its own and appends its
+ * placements, shifted behind the previous batches, to placements.bin. The render step
+ * then streams the whole placement through a SynopsisRenderer, loading one plate at a time;
+ * only one batch is on screen at once, and batches are also cut so their tubes' record
+ * windows fit half of memoryLimitMB, next to a quarter for the frame pool.
+ *
+ * One job per work directory; Run() blocks and calls progress from the calling thread.
+ */
+class SynopsisJob {
+public:
+    struct Options {
+        int frameStride = 1;
+        int segments = 1;               // ranges analysed in parallel; 1 for streams and unknown lengths
+        double overlapSeconds = 2.0;    // decoded twice at each boundary for stitching
+        double checkpointSeconds = 300.0;
+        size_t memoryLimitMB = 1024;
+        double batchSeconds = 0.0;      // 0 = the optimizer's default (longest tube)
+        TubeQuery query;                // tubes to place, default all
+        double fromSeconds = 0.0;       // source window narrowing query, toSeconds 0 = to the end
+        double toSeconds = 0.0;
+        TubeMerger::Options merger;     // fragment merging, when Run() gets a re-ID model
+        int prefetchFrames = 8;
+        TubeBuilder::Options tubes;
+        BackgroundModel::Options background;
+        SynopsisOptimizer::Options optimizer;
+        SynopsisRenderer::Options renderer;
+    };
+
+    // Runs the model on a BGR frame; the block is released with FreeResultBlock
+    using InferFn = std::function<vsResultHeader*(const cv::Mat& frame)>;
+    // Pass (VS_SYNOPSIS_*) and fraction done; false stops the job
+    using ProgressFn = std::function<bool(int pass, double fraction)>;
+
+    SynopsisJob();
+    explicit SynopsisJob(const Options& options);
+
+    // infer[i] serves one analysis thread at a time, so segments run concurrently up to
+    // infer.size(); the rest wait for a free one. Without embed, fragments are not merged.
+    bool Run(const std::string& sourceUtf8, const std::string& workDirUtf8, const std::string& outputUtf8,
+        std::vector<InferFn> infer, ProgressFn progress, TubeMerger::EmbedFn embed = nullptr);
+    // Tubes in the synopsis of the last successful Run(); 0 = the query matched nothing and
+    // no output was written
+    uint64_t placedTubes() const { return placedTubes_; }
+
+private:
+    enum class Stage { Analyse, Merge, Place, Render, Done };
+
+    struct SegmentState {
+        VideoSegment range;
+        int64_t nextFrame = 0;          // first source frame not analysed yet
+        uint64_t storeBytes = 0;        // tube store size covering frames before nextFrame
+        bool done = false;
+    };
+
+    // Contents of job.ckpt
+    struct Checkpoint {
+        std::string source;
+        Stage stage = Stage::Analyse;
+        std::vector<SegmentState> segments;     // empty until planned
+        int32_t batchesDone = 0;
+        int64_t synopsisFrames = 0;     // length of the placed batches
+        uint64_t placementCount = 0;    // TubePlacement records in placements.bin
+        uint64_t placementKey = 0;      // hash of the settings the batches were placed with
+    };
+
+    bool loadCheckpoint(Checkpoint& out) const;
+    bool saveCheckpoint(const Checkpoint& ckpt) const;
+
+    bool analyse(const std::string& source, std::vector<InferFn>& infer, ProgressFn& progress, Checkpoint& ckpt);
+    bool analyseSegment(const std::string& source, size_t segment, InferFn& infer, std::atomic<int64_t>& position, Checkpoint& ckpt);
+    bool stitch(Checkpoint& ckpt);
+    bool merge(TubeMerger::EmbedFn& embed, ProgressFn& progress, Checkpoint& ckpt);
+    bool place(ProgressFn& progress, Checkpoint& ckpt);
+    bool render(const std::string& output, ProgressFn& progress, Checkpoint& ckpt);
+
+    std::string path(const char* name) const;
+    std::string segmentStorePath(const Checkpoint& ckpt, size_t segment) const;
+
+    Options options_;
+    std::string workDir_;
+    std::mutex checkpointMutex_;        // analysis threads share the checkpoint
+    std::atomic<bool> stop_{ false };
+    uint64_t placedTubes_ = 0;
+};
@@ -0,0 +1,447 @@
+#include "pch.h"
+#include "synopsis_optimizer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "Logger.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+inline int popcount64(uint64_t v)
+{
+#ifdef _MSC_VER
+    return static_cast<int>(__popcnt64(v));
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+inline int ctz64(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+} // namespace
+
+SynopsisOptimizer::SynopsisOptimizer()
+    : SynopsisOptimizer(Options())
+{
+}
+
+SynopsisOptimizer::SynopsisOptimizer(const Options& options)
+    : options_(options)
+{
+    options_.timeStep = std::max(1, options_.timeStep);
+    options_.cellsX = std::max(1, options_.cellsX);
+    options_.cellsY = std::max(1, options_.cellsY);
+    words_ = (options_.cellsX * options_.cellsY + 63) / 64;
+}
+
+// ============================================================================
+// Footprints
+// ============================================================================
+void SynopsisOptimizer::setCells(Tube& tube, std::vector<uint64_t>& scratch, int bin, const cv::Rect& box, cv::Size frameSize)
+{
+    if (bin < 0 || bin >= tube.bins || box.empty() || frameSize.area() <= 0)
+        return;
+    const int cx0 = std::clamp(box.x * options_.cellsX / frameSize.width, 0, options_.cellsX - 1);
+    const int cx1 = std::clamp((box.x + box.width - 1) * options_.cellsX / frameSize.width, 0, options_.cellsX - 1);
+    const int cy0 = std::clamp(box.y * options_.cellsY / frameSize.height, 0, options_.cellsY - 1);
+    const int cy1 = std::clamp((box.y + box.height - 1) * options_.cellsY / frameSize.height, 0, options_.cellsY - 1);
+    uint64_t* words = scratch.data() + static_cast<size_t>(bin) * words_;
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            const int cell = cy * options_.cellsX + cx;
+            words[cell >> 6] |= uint64_t(1) << (cell & 63);
+        }
+    }
+}
+
+void SynopsisOptimizer::finishTube(Tube& tube, const std::vector<uint64_t>& scratch)
+{
+    tube.firstEntry = entries_.size();
+    for (int bin = 0; bin < tube.bins && !scratch.empty(); ++bin) {
+        for (int w = 0; w < words_; ++w) {
+            const uint64_t bits = scratch[static_cast<size_t>(bin) * words_ + w];
+            if (bits)
+                entries_.push_back({ bin, w, bits });
+        }
+    }
+    tube.entryCount = entries_.size() - tube.firstEntry;
+}
+
+bool SynopsisOptimizer::LoadTubes(const TubeStoreReader& store, const std::vector<uint32_t>& tubeIds)
+{
+    const auto t0 = Clock::now();
+    const std::vector<TubeSummary>& all = store.tubes();
+    const cv::Size frameSize = store.info().frameSize;
+
+    // Local slot of every selected tube; the store is then read once, chunk by chunk
+    std::vector<int> slot(all.size(), -1);
+    auto select = [&](uint32_t id) {
+        if (id >= all.size() || slot[id] >= 0 || all[id].frameCount < options_.minTubeFrames)
+            return;
+        const TubeSummary& s = all[id];
+        Tube t;
+        t.tubeId = id;
+        t.sourceStart = s.firstFrame;
+        t.length = s.lastFrame - s.firstFrame + 1;
+        t.bins = static_cast<int32_t>((t.length + options_.timeStep - 1) / options_.timeStep);
+        slot[id] = static_cast<int>(tubes_.size());
+        tubes_.push_back(t);
+    };
+    const size_t firstNew = tubes_.size();
+    if (tubeIds.empty()) {
+        for (uint32_t id = 0; id < all.size(); ++id)
+            select(id);
+    }
+    else {
+        for (uint32_t id : tubeIds)
+            select(id);
+    }
+
+    // Only the chunks of the selected tubes are read. A tube's dense scratch lives from its
+    // first chunk to its last, so memory follows the tubes spanning one chunk, not all of them.
+    std::vector<size_t> byLast(tubes_.size() - firstNew);
+    uint32_t firstChunk = UINT32_MAX;
+    uint32_t lastChunk = 0;
+    for (size_t i = firstNew; i < tubes_.size(); ++i) {
+        byLast[i - firstNew] = i;
+        firstChunk = std::min(firstChunk, all[tubes_[i].tubeId].firstChunk);
+        lastChunk = std::max(lastChunk, all[tubes_[i].tubeId].lastChunk);
+    }
+    std::sort(byLast.begin(), byLast.end(), [&](size_t a, size_t b) {
+        return all[tubes_[a].tubeId].lastChunk < all[tubes_[b].tubeId].lastChunk;
+    });
+
+    std::vector<std::vector<uint64_t>> scratch(tubes_.size() - firstNew);
+    std::vector<TubeFrame> records;
+    size_t finished = 0;
+    for (size_t c = firstChunk; c <= lastChunk && c < store.chunkCount() && finished < byLast.size(); ++c) {
+        if (!store.ReadChunk(c, records)) {
+            LOG_ERROR_STREAM("[SynopsisOptimizer] Cannot read tube chunk " << c);
+            return false;
+        }
+        for (const TubeFrame& f : records) {
+            if (f.tubeId >= slot.size() || slot[f.tubeId] < 0)
+                continue;
+            Tube& t = tubes_[slot[f.tubeId]];
+            std::vector<uint64_t>& bits = scratch[slot[f.tubeId] - firstNew];
+            if (bits.empty())
+                bits.assign(static_cast<size_t>(t.bins) * words_, 0);
+            setCells(t, bits, static_cast<int>((f.frameIndex - t.sourceStart) / options_.timeStep), f.box, frameSize);
+        }
+        for (; finished < byLast.size() && all[tubes_[byLast[finished]].tubeId].lastChunk <= c; ++finished) {
+            const size_t i = byLast[finished];
+            finishTube(tubes_[i], scratch[i - firstNew]);
+            std::vector<uint64_t>().swap(scratch[i - firstNew]);
+        }
+    }
+    for (; finished < byLast.size(); ++finished) {
+        const size_t i = byLast[finished];
+        finishTube(tubes_[i], scratch[i - firstNew]);
+        std::vector<uint64_t>().swap(scratch[i - firstNew]);
+    }
+    stats_.footprintMs += msSince(t0);
+    return true;
+}
+
+void SynopsisOptimizer::AddTube(uint32_t tubeId, const std::vector<int64_t>& frames, const std::vector<cv::Rect>& boxes, cv::Size frameSize)
+{
+    if (frames.empty() || frames.size() != boxes.size() || frames.size() < options_.minTubeFrames)
+        return;
+    Tube t;
+    t.tubeId = tubeId;
+    t.sourceStart = frames.front();
+    t.length = frames.back() - frames.front() + 1;
+    t.bins = static_cast<int32_t>((t.length + options_.timeStep - 1) / options_.timeStep);
+    std::vector<uint64_t> scratch(static_cast<size_t>(t.bins) * words_, 0);
+    for (size_t i = 0; i < frames.size(); ++i)
+        setCells(t, scratch, static_cast<int>((frames[i] - t.sourceStart) / options_.timeStep), boxes[i], frameSize);
+    finishTube(t, scratch);
+    tubes_.push_back(t);
+}
+
+// ============================================================================
+// Bit-sliced count volume
+// ============================================================================
+double SynopsisOptimizer::collisions(const Tube& tube, int start, double limit) const
+{
+    double sum = 0.0;
+    const Entry* e = entries_.data() + tube.firstEntry;
+    for (size_t i = 0; i < tube.entryCount; ++i, ++e) {
+        const int bin = start + e->bin;
+        int cells = 0;
+        for (int k = 0; k < kPlanes; ++k)
+            cells += popcount64(e->bits & plane(bin, k)[e->word]) << k;
+        for (uint64_t deep = e->bits & saturated_[static_cast<size_t>(bin) * words_ + e->word]; deep; deep &= deep - 1)
+            cells += static_cast<int>(overflow_.at(overflowKey(bin, e->word, ctz64(deep))));
+        sum += cells;
+        if (sum > limit)
+            break;          // already worse than what the caller has
+    }
+    return sum;
+}
+
+double SynopsisOptimizer::cost(const Tube& tube, int start, double limit) const
+{
+    const double chronology = options_.chronologyWeight * std::abs(start - tube.preferredStart);
+    return chronology + collisions(tube, start, limit - chronology);
+}
+
+void SynopsisOptimizer::place(const Tube& tube, int start)
+{
+    const Entry* e = entries_.data() + tube.firstEntry;
+    for (size_t i = 0; i < tube.entryCount; ++i, ++e) {
+        // Ripple-carry add of one to every cell in bits
+        uint64_t carry = e->bits;
+        for (int k = 0; k < kPlanes && carry; ++k) {
+            uint64_t& p = plane(start + e->bin, k)[e->word];
+            const uint64_t next = p & carry;
+            p ^= carry;
+            carry = next;
+        }
+        if (carry) {
+            // Overflowed cells stay at 63 in the planes and count the rest on the side
+            for (int k = 0; k < kPlanes; ++k)
+                plane(start + e->bin, k)[e->word] |= carry;
+            saturated_[static_cast<size_t>(start + e->bin) * words_ + e->word] |= carry;
+            for (; carry; carry &= carry - 1)
+                ++overflow_[overflowKey(start + e->bin, e->word, ctz64(carry))];
+        }
+    }
+}
+
+void SynopsisOptimizer::remove(const Tube& tube, int start)
+{
+    const Entry* e = entries_.data() + tube.firstEntry;
+    for (size_t i = 0; i < tube.entryCount; ++i, ++e) {
+        uint64_t borrow = e->bits;
+        uint64_t& saturated = saturated_[static_cast<size_t>(start + e->bin) * words_ + e->word];
+        // Cells above 63 give back their side count first and leave the planes at 63
+        for (uint64_t deep = borrow & saturated; deep; deep &= deep - 1) {
+            const int bit = ctz64(deep);
+            auto it = overflow_.find(overflowKey(start + e->bin, e->word, bit));
+            if (--it->second == 0) {
+                overflow_.erase(it);
+                saturated &= ~(uint64_t(1) << bit);
+            }
+            borrow &= ~(uint64_t(1) << bit);
+        }
+        for (int k = 0; k < kPlanes && borrow; ++k) {
+            uint64_t& p = plane(start + e->bin, k)[e->word];
+            const uint64_t next = ~p & borrow;
+            p ^= borrow;
+            borrow = next;
+        }
+    }
+}
+
+// ============================================================================
+// Solve
+// ============================================================================
+bool SynopsisOptimizer::Solve(std::vector<TubePlacement>& out)
+{
+    out.clear();
+    const size_t n = tubes_.size();
+    stats_.tubes = n;
+    if (n == 0)
+        return true;
+
+    // Synopsis length in bins; a tube longer than that starts at 0 and runs past the end
+    int64_t longest = 0;
+    int64_t sourceFirst = std::numeric_limits<int64_t>::max();
+    int64_t sourceLast = 0;
+    for (const Tube& t : tubes_) {
+        longest = std::max(longest, t.length);
+        sourceFirst = std::min(sourceFirst, t.sourceStart);
+        sourceLast = std::max(sourceLast, t.sourceStart + t.length);
+    }
+    const int64_t target = options_.targetFrames > 0 ? options_.targetFrames : longest;
+    totalBins_ = static_cast<int32_t>((target + options_.timeStep - 1) / options_.timeStep);
+    const double sourceBins = std::max(1.0, static_cast<double>(sourceLast - sourceFirst) / options_.timeStep);
+    int32_t volumeBins = totalBins_;
+    for (Tube& t : tubes_) {
+        t.maxStart = std::max(0, totalBins_ - t.bins);
+        t.preferredStart = std::min<double>(t.maxStart,
+            (t.sourceStart - sourceFirst) / static_cast<double>(options_.timeStep) * totalBins_ / sourceBins);
+        volumeBins = std::max(volumeBins, t.maxStart + t.bins);
+    }
+    volume_.assign(static_cast<size_t>(volumeBins) * kPlanes * words_, 0);
+    saturated_.assign(static_cast<size_t>(volumeBins) * words_, 0);
+    overflow_.clear();
+
+    // Greedy: longest first, every start of a tube evaluated in parallel
+    auto t0 = Clock::now();
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return tubes_[a].bins > tubes_[b].bins; });
+
+    const int stripes = std::max(1, cv::getNumThreads()) * 4;
+    std::vector<std::pair<double, int>> best(stripes);
+    for (size_t i : order) {
+        Tube& t = tubes_[i];
+        const int starts = t.maxStart + 1;
+        const int perStripe = (starts + stripes - 1) / stripes;
+        cv::parallel_for_(cv::Range(0, stripes), [&](const cv::Range& range) {
+            for (int s = range.start; s < range.end; ++s) {
+                std::pair<double, int> local(std::numeric_limits<double>::max(), -1);
+                const int end = std::min(starts, (s + 1) * perStripe);
+                for (int start = s * perStripe; start < end; ++start) {
+                    const double c = cost(t, start, local.first);
+                    if (c < local.first)
+                        local = { c, start };
+                }
+                best[s] = local;
+            }
+        });
+        std::pair<double, int> chosen(std::numeric_limits<double>::max(), 0);
+        for (const auto& b : best) {
+            if (b.second >= 0 && b.first < chosen.first)
+                chosen = b;
+        }
+        t.start = chosen.second;
+        place(t, t.start);
+    }
+    stats_.greedyMs = msSince(t0);
+
+    auto totalCollisions = [&]() {
+        double sum = 0.0;
+        for (const Tube& t : tubes_) {
+            remove(t, t.start);
+            sum += collisions(t, t.start, std::numeric_limits<double>::max());
+            place(t, t.start);
+        }
+        return sum / 2.0;   // every overlap was counted from both tubes
+    };
+    auto chronology = [&]() {
+        double sum = 0.0;
+        for (const Tube& t : tubes_)
+            sum += options_.chronologyWeight * std::abs(t.start - t.preferredStart);
+        return sum;
+    };
+    stats_.greedyCollisions = totalCollisions();
+    stats_.greedyCost = stats_.greedyCollisions + chronology();
+
+    // Simulated annealing on single-tube moves
+    t0 = Clock::now();
+    std::mt19937 rng(options_.seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    const int64_t moves = options_.annealMoves > 0 ? options_.annealMoves : static_cast<int64_t>(n) * 200;
+
+    auto propose = [&](const Tube& t) {
+        if (t.maxStart == 0)
+            return 0;
+        if (rng() & 1)
+            return static_cast<int>(rng() % static_cast<uint32_t>(t.maxStart + 1));
+        const int shift = std::max(1, t.maxStart / 20);
+        const int delta = static_cast<int>(rng() % static_cast<uint32_t>(2 * shift + 1)) - shift;
+        return std::clamp(t.start + delta, 0, t.maxStart);
+    };
+
+    // Starting temperature: a fraction of the mean uphill step of a few random moves. The
+    // greedy result is already good, so the walk only needs to get out of its local minima.
+    double uphill = 0.0;
+    int uphillCount = 0;
+    for (int probe = 0; probe < 200; ++probe) {
+        const Tube& t = tubes_[rng() % n];
+        const int to = propose(t);
+        if (to == t.start)
+            continue;
+        remove(t, t.start);
+        const double delta = cost(t, to, std::numeric_limits<double>::max()) - cost(t, t.start, std::numeric_limits<double>::max());
+        place(t, t.start);
+        if (delta > 0.0) {
+            uphill += delta;
+            ++uphillCount;
+        }
+    }
+    const double t0Temp = 0.05 * (uphillCount > 0 ? uphill / uphillCount : 1.0);
+    const double tEnd = t0Temp * 1e-3;
+
+    // The energy is tracked through the accepted deltas; the best state is snapshotted now and then
+    double energy = stats_.greedyCost;
+    double bestEnergy = energy;
+    std::vector<int32_t> bestStarts(n);
+    for (size_t i = 0; i < n; ++i)
+        bestStarts[i] = tubes_[i].start;
+
+    stats_.moves = 0;
+    stats_.accepted = 0;
+    for (int64_t m = 0; m < moves; ++m) {
+        if ((m & 1023) == 0) {
+            if (energy < bestEnergy) {
+                bestEnergy = energy;
+                for (size_t i = 0; i < n; ++i)
+                    bestStarts[i] = tubes_[i].start;
+            }
+            if (msSince(t0) > options_.annealSeconds * 1000.0)
+                break;
+        }
+        ++stats_.moves;
+        Tube& t = tubes_[rng() % n];
+        const int to = propose(t);
+        if (to == t.start)
+            continue;
+        const double temp = t0Temp * std::pow(tEnd / t0Temp, static_cast<double>(m) / moves);
+
+        remove(t, t.start);
+        const double current = cost(t, t.start, std::numeric_limits<double>::max());
+        // Largest increase this draw would still accept; the new cost stops counting past it
+        const double allowed = -temp * std::log(std::max(unit(rng), 1e-300));
+        const double candidate = cost(t, to, current + allowed);
+        if (candidate - current <= allowed) {
+            t.start = to;
+            energy += candidate - current;
+            ++stats_.accepted;
+        }
+        place(t, t.start);
+    }
+    if (bestEnergy < energy) {
+        for (size_t i = 0; i < n; ++i) {
+            remove(tubes_[i], tubes_[i].start);
+            tubes_[i].start = bestStarts[i];
+            place(tubes_[i], tubes_[i].start);
+        }
+    }
+    stats_.annealMs = msSince(t0);
+    stats_.finalCollisions = totalCollisions();
+    stats_.finalCost = stats_.finalCollisions + chronology();
+
+    int64_t length = 0;
+    out.reserve(n);
+    for (const Tube& t : tubes_) {
+        TubePlacement p;
+        p.tubeId = t.tubeId;
+        p.start = static_cast<int64_t>(t.start) * options_.timeStep;
+        p.sourceStart = t.sourceStart;
+        p.length = t.length;
+        length = std::max(length, p.start + p.length);
+        out.push_back(p);
+    }
+    stats_.lengthFrames = length;
+    LOG_INFO_STREAM("[SynopsisOptimizer] " << n << " tubes into " << length << " frames: collisions "
+        << stats_.greedyCollisions << " after greedy (" << stats_.greedyMs << " ms), " << stats_.finalCollisions
+        << " after " << stats_.moves << " annealing moves (" << stats_.annealMs << " ms); cost " << stats_.greedyCost
+        << " -> " << stats_.finalCost);
+    return true;
+}
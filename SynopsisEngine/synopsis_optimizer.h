@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "tube_store.h"
+
+/**
+ * @brief Where one tube starts in the synopsis.
+ */
+struct TubePlacement {
+    uint32_t tubeId = 0;
+    int64_t start = 0;              // first synopsis frame of the tube
+    int64_t sourceStart = 0;        // first source frame of the tube
+    int64_t length = 0;             // source frames spanned by the tube
+};
+
+/**
+ * @brief Chooses a synopsis start time for every tube: short summary, few collisions.
+ *
+ * Tubes are rasterized onto a coarse space-time grid (cellsX x cellsY cells, timeStep
+ * frames per bin) as one bit per cell and bin. Placed tubes are summed into a bit-sliced
+ * count volume, so the collision cost of a tube at a start is the sum over its bins of
+ * popcount(tube & plane_k) << k: the number of (tube, placed tube, cell, bin) overlaps,
+ * i.e. every pairwise cost at once. Only the words a tube touches are visited. The planes
+ * count to 63; cells stacked deeper keep the rest in a side table, so counts stay exact.
+ *
+ * Solve() places tubes longest first, each at the start with the lowest cost (all starts
+ * evaluated in parallel), then refines with simulated annealing: move one tube, accept by
+ * the Metropolis rule on the exact cost change. Every start keeps the tube inside
+ * targetFrames, and a chronology term keeps tubes near their scaled original time.
+ */
+class SynopsisOptimizer {
+public:
+    struct Options {
+        int64_t targetFrames = 0;       // synopsis length; 0 = longest tube
+        int timeStep = 5;               // source frames per time bin
+        int cellsX = 32;
+        int cellsY = 18;
+        uint32_t minTubeFrames = 5;     // shorter tubes are left out
+        double chronologyWeight = 0.05; // cost per bin of distance from the scaled original start
+        int64_t annealMoves = 0;        // 0 = 200 per tube
+        double annealSeconds = 60.0;    // time budget of the refinement
+        uint32_t seed = 1;
+    };
+
+    struct Stats {
+        size_t tubes = 0;
+        int64_t lengthFrames = 0;
+        double greedyCollisions = 0.0;  // cell-bin overlaps after the greedy pass
+        double finalCollisions = 0.0;
+        double greedyCost = 0.0;        // collisions plus the chronology term
+        double finalCost = 0.0;
+        int64_t moves = 0;
+        int64_t accepted = 0;
+        double footprintMs = 0.0;
+        double greedyMs = 0.0;
+        double annealMs = 0.0;
+    };
+
+    SynopsisOptimizer();
+    explicit SynopsisOptimizer(const Options& options);
+
+    // Rasterizes the given tubes (all of the store if tubeIds is empty) in one pass over the store
+    bool LoadTubes(const TubeStoreReader& store, const std::vector<uint32_t>& tubeIds = {});
+    // Adds one tube from its per-frame boxes (frame order), for callers without a store
+    void AddTube(uint32_t tubeId, const std::vector<int64_t>& frames, const std::vector<cv::Rect>& boxes, cv::Size frameSize);
+
+    bool Solve(std::vector<TubePlacement>& out);
+    const Stats& stats() const { return stats_; }
+
+private:
+    static constexpr int kPlanes = 6;   // counts up to 63 per cell and bin; the rest goes to overflow_
+
+    // One non-empty 64-cell word of a tube at a time bin
+    struct Entry {
+        int32_t bin;
+        int32_t word;
+        uint64_t bits;
+    };
+    struct Tube {
+        uint32_t tubeId;
+        int64_t sourceStart;
+        int64_t length;                 // frames
+        int32_t bins;
+        size_t firstEntry;
+        size_t entryCount;
+        int32_t maxStart;               // last allowed start bin
+        double preferredStart;          // original start scaled into the synopsis, in bins
+        int32_t start = 0;              // current start bin
+    };
+
+    void setCells(Tube& tube, std::vector<uint64_t>& scratch, int bin, const cv::Rect& box, cv::Size frameSize);
+    void finishTube(Tube& tube, const std::vector<uint64_t>& scratch);
+    uint64_t overflowKey(int bin, int word, int bit) const { return (static_cast<uint64_t>(bin) * words_ + word) * 64 + bit; }
+    uint64_t* plane(int bin, int k) { return volume_.data() + (static_cast<size_t>(bin) * kPlanes + k) * words_; }
+    const uint64_t* plane(int bin, int k) const { return volume_.data() + (static_cast<size_t>(bin) * kPlanes + k) * words_; }
+
+    double collisions(const Tube& tube, int start, double limit) const;
+    double cost(const Tube& tube, int start, double limit) const;
+    void place(const Tube& tube, int start);
+    void remove(const Tube& tube, int start);
+
+    Options options_;
+    int words_ = 1;
+    std::vector<Tube> tubes_;
+    std::vector<Entry> entries_;
+    std::vector<uint64_t> volume_;      // [bin][plane][word]
+    std::vector<uint64_t> saturated_;   // [bin][word]: cells whose planes are full (count > 63)
+    std::unordered_map<uint64_t, uint32_t> overflow_;   // count above 63 of each saturated cell
+    int32_t totalBins_ = 0;
+    Stats stats_;
+};
@@ -0,0 +1,378 @@
+#include "pch.h"
+#include "synopsis_renderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <thread>
+#include "Logger.h"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+double msSince(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+std::string formatTime(double ms)
+{
+    const int64_t s = static_cast<int64_t>(ms / 1000.0);
+    char text[32];
+    std::snprintf(text, sizeof(text), "%02lld:%02d:%02d", static_cast<long long>(s / 3600),
+        static_cast<int>(s / 60 % 60), static_cast<int>(s % 60));
+    return text;
+}
+
+// dst = src where alpha is 255, dst where it is 0, linear in between (all three the same size)
+void blendThroughMask(const cv::Mat& src, const cv::Mat& alpha, cv::Mat dst)
+{
+    for (int y = 0; y < dst.rows; ++y) {
+        const uint8_t* s = src.ptr<uint8_t>(y);
+        const uint8_t* a = alpha.ptr<uint8_t>(y);
+        uint8_t* d = dst.ptr<uint8_t>(y);
+        for (int x = 0; x < dst.cols; ++x, s += 3, d += 3) {
+            const int w = a[x];
+            if (w == 0)
+                continue;
+            if (w == 255) {
+                d[0] = s[0];
+                d[1] = s[1];
+                d[2] = s[2];
+                continue;
+            }
+            for (int k = 0; k < 3; ++k)
+                d[k] = static_cast<uint8_t>((s[k] * w + d[k] * (255 - w) + 127) / 255);
+        }
+    }
+}
+
+} // namespace
+
+SynopsisRenderer::SynopsisRenderer()
+    : SynopsisRenderer(Options())
+{
+}
+
+SynopsisRenderer::SynopsisRenderer(const Options& options)
+    : options_(options)
+{
+}
+
+SynopsisRenderer::PlateFn SynopsisRenderer::PlatesFromList(std::vector<BackgroundPlate> plates)
+{
+    std::sort(plates.begin(), plates.end(), [](const BackgroundPlate& a, const BackgroundPlate& b) {
+        return a.frameIndex < b.frameIndex;
+    });
+    return [plates = std::move(plates)](int64_t sourceFrame) {
+        if (plates.empty())
+            return cv::Mat();
+        auto it = std::upper_bound(plates.begin(), plates.end(), sourceFrame, [](int64_t f, const BackgroundPlate& p) {
+            return f < p.frameIndex;
+        });
+        return it == plates.begin() ? it->image : std::prev(it)->image;
+    };
+}
+
+void SynopsisRenderer::Cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cancel_ = true;
+    }
+    jobReady_.notify_all();
+    frameDone_.notify_all();
+    bufferFree_.notify_all();
+}
+
+// ============================================================================
+// Render
+// ============================================================================
+bool SynopsisRenderer::Render(const TubeStoreReader& store, const std::vector<TubePlacement>& placements,
+    const PlateFn& plates, const std::string& outputPathUtf8)
+{
+    const auto t0 = Clock::now();
+    stats_ = Stats();
+    cancel_ = false;
+    frameSize_ = store.info().frameSize;
+    if (frameSize_.area() <= 0) {
+        LOG_ERROR_STREAM("[SynopsisRenderer] The tube store has no frame size");
+        return false;
+    }
+
+    const std::vector<TubeSummary>& summaries = store.tubes();
+    std::vector<const TubePlacement*> order;
+    for (const TubePlacement& p : placements) {
+        if (p.tubeId < summaries.size() && p.length > 0 && p.start >= 0)
+            order.push_back(&p);
+    }
+    if (order.empty()) {
+        LOG_INFO_STREAM("[SynopsisRenderer] No tubes placed, " << outputPathUtf8 << " not written");
+        stats_.totalMs = msSince(t0);
+        return true;
+    }
+    std::sort(order.begin(), order.end(), [](const TubePlacement* a, const TubePlacement* b) {
+        return a->start != b->start ? a->start < b->start : a->tubeId < b->tubeId;
+    });
+
+    // The background follows the synopsis through the source time it covers
+    int64_t length = 0;
+    int64_t sourceFirst = order.front()->sourceStart;
+    int64_t sourceLast = sourceFirst;
+    for (const TubePlacement* p : order) {
+        length = std::max(length, p->start + p->length);
+        sourceFirst = std::min(sourceFirst, p->sourceStart);
+        sourceLast = std::max(sourceLast, p->sourceStart + p->length);
+    }
+
+    const int fourcc = options_.fourcc ? options_.fourcc : cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+    double fps = options_.fps > 0.0 ? options_.fps : store.info().fps;
+    if (fps <= 0.0)
+        fps = 25.0;
+    if (!writer_.open(outputPathUtf8, fourcc, fps, frameSize_, true)) {
+        LOG_ERROR_STREAM("[SynopsisRenderer] Cannot open " << outputPathUtf8);
+        return false;
+    }
+
+    const int threads = options_.threads > 0 ? options_.threads
+        : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    const int pool = options_.poolFrames > 0 ? std::max(options_.poolFrames, threads + 1) : 3 * threads;
+    buffers_.assign(pool, cv::Mat());
+    free_.clear();
+    for (int i = 0; i < pool; ++i) {
+        buffers_[i].create(frameSize_, CV_8UC3);
+        free_.push_back(pool - 1 - i);
+    }
+    queued_.clear();
+    done_.clear();
+    sweepDone_ = false;
+    failed_ = false;
+
+    std::vector<Worker> workers(threads);
+    std::vector<std::thread> composers;
+    for (Worker& w : workers)
+        composers.emplace_back(&SynopsisRenderer::composeLoop, this, std::ref(w));
+    std::thread encoder(&SynopsisRenderer::encodeLoop, this, length);
+
+    LOG_INFO_STREAM("[SynopsisRenderer] Rendering " << order.size() << " tubes into " << length << " frames ("
+        << outputPathUtf8 << "), " << threads << " compose threads, " << pool << " buffers");
+
+    // Sweep: admit tubes at their first synopsis frame, retire them after their last. Each
+    // keeps a window of its chunks: every one starting at or before the current source frame
+    // and not yet passed, plus the next one.
+    struct Active {
+        const TubePlacement* placement;
+        int classId;
+        uint32_t nextChunk;             // first chunk of the tube not read yet
+        uint32_t lastChunk;
+        int64_t aheadFirst;             // first frame of the last chunk read
+        std::deque<std::shared_ptr<const Segment>> segments;
+    };
+    // Reads the chunks the window needs at `source`; false if the store fails
+    auto advance = [&](Active& a, int64_t source) {
+        while (a.nextChunk <= a.lastChunk) {
+            int64_t first = 0;
+            int64_t last = 0;
+            if (!store.chunkRange(a.nextChunk, first, last))
+                return false;
+            if (first > source && a.aheadFirst > source)
+                break;
+            const auto tl = Clock::now();
+            auto segment = std::make_shared<Segment>();
+            const bool ok = store.ReadTubeChunk(a.placement->tubeId, a.nextChunk, *segment);
+            stats_.loadMs += msSince(tl);
+            if (!ok)
+                return false;
+            if (!segment->empty())
+                a.segments.push_back(std::move(segment));
+            a.aheadFirst = first;
+            ++a.nextChunk;
+        }
+        // The record shown is the latest one at or before the source frame (tubes of strided
+        // analysis hold each record until the next); segments before its own are done with
+        while (a.segments.size() > 1 && a.segments[1]->front().frameIndex <= source)
+            a.segments.pop_front();
+        return !a.segments.empty();
+    };
+    std::vector<Active> active;
+    size_t next = 0;
+    for (int64_t t = 0; t < length; ++t) {
+        for (; next < order.size() && order[next]->start <= t; ++next) {
+            const TubeSummary& summary = summaries[order[next]->tubeId];
+            active.push_back({ order[next], summary.classId, summary.firstChunk, summary.lastChunk,
+                std::numeric_limits<int64_t>::min(), {} });
+            ++stats_.tubes;
+        }
+        active.erase(std::remove_if(active.begin(), active.end(), [t](const Active& a) {
+            return a.placement->start + a.placement->length <= t;
+        }), active.end());
+
+        Job job;
+        job.frame = t;
+        job.items.reserve(active.size());
+        for (auto it = active.begin(); it != active.end();) {
+            const int64_t source = it->placement->sourceStart + (t - it->placement->start);
+            if (!advance(*it, source)) {
+                LOG_WARNING_STREAM("[SynopsisRenderer] Tube " << it->placement->tubeId << " could not be read, skipped");
+                it = active.erase(it);
+                --stats_.tubes;
+                continue;
+            }
+            const std::shared_ptr<const Segment>& segment = it->segments.front();
+            auto r = std::upper_bound(segment->begin(), segment->end(), source, [](int64_t f, const TubeFrame& rec) {
+                return f < rec.frameIndex;
+            });
+            job.items.push_back({ segment, r == segment->begin() ? 0 : static_cast<size_t>(r - segment->begin() - 1), it->classId });
+            ++it;
+        }
+        if (plates)
+            job.plate = plates(sourceFirst + t * (sourceLast - sourceFirst) / length);
+        if (progress_ && t % 64 == 0 && !progress_(static_cast<double>(t) / static_cast<double>(length)))
+            Cancel();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        bufferFree_.wait(lock, [this] { return failed_ || cancel_ || !free_.empty(); });
+        if (failed_ || cancel_)
+            break;
+        job.buffer = free_.back();
+        free_.pop_back();
+        queued_.push_back(std::move(job));
+        lock.unlock();
+        jobReady_.notify_one();
+    }
+    active.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sweepDone_ = true;
+    }
+    jobReady_.notify_all();
+    for (std::thread& c : composers)
+        c.join();
+    encoder.join();
+    writer_.release();
+
+    for (const Worker& w : workers) {
+        stats_.composeMs += w.composeMs;
+        stats_.pasted += w.pasted;
+    }
+    queued_.clear();
+    buffers_.clear();
+    stats_.totalMs = msSince(t0);
+
+    const bool ok = !failed_ && !cancel_ && stats_.frames == length;
+    LOG_INFO_STREAM("[SynopsisRenderer] " << (ok ? "Wrote " : "Stopped after ") << stats_.frames << " frames, "
+        << stats_.pasted << " tube frames in " << stats_.totalMs / 1000.0 << " s (load " << stats_.loadMs
+        << " ms, compose " << stats_.composeMs << " ms, encode " << stats_.encodeMs << " ms, peak reorder "
+        << stats_.peakReorder << ")");
+    return ok;
+}
+
+// ============================================================================
+// Compose and encode threads
+// ============================================================================
+void SynopsisRenderer::composeLoop(Worker& worker)
+{
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobReady_.wait(lock, [this] { return sweepDone_ || failed_ || cancel_ || !queued_.empty(); });
+            if (failed_ || cancel_ || queued_.empty())
+                break;
+            job = std::move(queued_.front());
+            queued_.pop_front();
+        }
+
+        const auto t0 = Clock::now();
+        compose(job, buffers_[job.buffer], worker);
+        worker.composeMs += msSince(t0);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_.emplace(job.frame, job.buffer);
+            stats_.peakReorder = std::max(stats_.peakReorder, static_cast<int32_t>(done_.size()) - 1);
+        }
+        frameDone_.notify_one();
+    }
+}
+
+void SynopsisRenderer::compose(const Job& job, cv::Mat& out, Worker& worker)
+{
+    if (job.plate.size() == frameSize_ && job.plate.type() == CV_8UC3)
+        job.plate.copyTo(out);
+    else if (!job.plate.empty() && job.plate.type() == CV_8UC3)
+        cv::resize(job.plate, out, frameSize_);
+    else
+        out.setTo(cv::Scalar::all(0));
+
+    if (options_.stampTime)
+        worker.compositor.Begin(frameSize_);
+    const cv::Rect frame(0, 0, frameSize_.width, frameSize_.height);
+    const int feather = std::max(0, options_.featherPx);
+
+    for (const Item& item : job.items) {
+        const TubeFrame& f = (*item.segment)[item.record];
+        const cv::Rect box = f.box & frame;
+        if (box.empty() || !f.decodeCrop(worker.crop))
+            continue;
+        if (worker.crop.size() != f.box.size())
+            cv::resize(worker.crop, worker.crop, f.box.size());
+        f.decodeMask(worker.mask);
+        const bool soften = feather > 0 && !f.mask.empty();
+        if (soften)
+            cv::blur(worker.mask, worker.alpha, cv::Size(2 * feather + 1, 2 * feather + 1));
+        const cv::Mat& alpha = soften ? worker.alpha : worker.mask;
+
+        const cv::Rect src(box.x - f.box.x, box.y - f.box.y, box.width, box.height);
+        blendThroughMask(worker.crop(src), alpha(src), out(box));
+        ++worker.pasted;
+
+        if (options_.stampTime)
+            worker.compositor.AddLabel(formatTime(f.timestampMs), box.tl(), AnnotationCompositor::ClassColor(item.classId),
+                options_.fontScale);
+    }
+    if (options_.stampTime)
+        worker.compositor.Composite(out);
+}
+
+void SynopsisRenderer::encodeLoop(int64_t frames)
+{
+    for (int64_t next = 0; next < frames; ++next) {
+        size_t buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            frameDone_.wait(lock, [&] {
+                return failed_ || cancel_ || (!done_.empty() && done_.begin()->first == next);
+            });
+            if (failed_ || cancel_)
+                return;
+            buffer = done_.begin()->second;
+            done_.erase(done_.begin());
+        }
+
+        const auto t0 = Clock::now();
+        try {
+            writer_.write(buffers_[buffer]);
+        }
+        catch (const cv::Exception& e) {
+            LOG_ERROR_STREAM("[SynopsisRenderer] Encode failed: " << e.what());
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                failed_ = true;
+            }
+            jobReady_.notify_all();
+            bufferFree_.notify_all();
+            return;
+        }
+        stats_.encodeMs += msSince(t0);
+        ++stats_.frames;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(buffer);
+        }
+        bufferFree_.notify_one();
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "annotation_compositor.h"
+#include "background_model.h"
+#include "tube_store.h"
+#include "synopsis_optimizer.h"
+
+/**
+ * @brief Writes the synopsis video of a placement: background plus every active tube.
+ *
+ * The calling thread sweeps the synopsis frames in order. Each active tube's records are read
+ * from the store (its records only, still encoded) chunk by chunk as the sweep reaches them,
+ * one chunk ahead, and dropped once passed, so the source video is never decoded again and a
+ * long tube is never held whole. Each synopsis frame becomes
+ * a work list of (tube, record) pairs plus its background plate, and takes one of
+ * poolFrames pooled buffers; compose threads copy the plate, decode each crop and mask,
+ * alpha-blend the crop through the feathered mask and stamp the record's original time.
+ * Finished frames wait in a reorder map until the encoder thread can write them in order.
+ *
+ * Memory is the pooled frames plus about two chunks of encoded records per active tube (and
+ * the ones frames in flight still point at). Tubes placed later are drawn over earlier ones.
+ */
+class SynopsisRenderer {
+public:
+    struct Options {
+        int threads = 0;                // compose threads; 0 = one per core but one
+        int poolFrames = 0;             // frame buffers in flight; 0 = 3 per compose thread
+        int fourcc = 0;                 // 0 = mp4v
+        double fps = 0.0;               // 0 = the store's
+        int featherPx = 2;              // mask edge softening radius, 0 = hard edges
+        bool stampTime = true;          // source time (hh:mm:ss) next to each tube
+        double fontScale = 0.45;
+    };
+
+    struct Stats {
+        int64_t frames = 0;             // synopsis frames written
+        size_t tubes = 0;               // tubes rendered
+        int64_t pasted = 0;             // tube frames composed
+        double loadMs = 0.0;            // reading tube records, on the calling thread
+        double composeMs = 0.0;         // summed over compose threads
+        double encodeMs = 0.0;
+        double totalMs = 0.0;
+        int32_t peakReorder = 0;        // most finished frames waiting for an earlier one
+    };
+
+    // Background of the synopsis frame that maps to a source frame; empty = black
+    using PlateFn = std::function<cv::Mat(int64_t sourceFrame)>;
+    // Share of the frames handed to the compose threads; false cancels the render
+    using ProgressFn = std::function<bool(double fraction)>;
+
+    SynopsisRenderer();
+    explicit SynopsisRenderer(const Options& options);
+
+    // Latest plate computed at or before the source frame (the first plate before that)
+    static PlateFn PlatesFromList(std::vector<BackgroundPlate> plates);
+
+    // Renders every synopsis frame of placements; blocks until the file is written. Without
+    // placements there is no synopsis: nothing is written and stats().frames stays 0.
+    bool Render(const TubeStoreReader& store, const std::vector<TubePlacement>& placements, const PlateFn& plates,
+        const std::string& outputPathUtf8);
+    // Stops a Render() running on another thread; it returns false
+    void Cancel();
+    // Called on the thread running Render() every few dozen frames
+    void setProgress(ProgressFn progress) { progress_ = std::move(progress); }
+
+    const Stats& stats() const { return stats_; }
+
+private:
+    // The records of one tube in one chunk
+    using Segment = std::vector<TubeFrame>;
+    struct Item {
+        std::shared_ptr<const Segment> segment;
+        size_t record;
+        int classId;
+    };
+    struct Job {
+        int64_t frame = 0;
+        size_t buffer = 0;
+        cv::Mat plate;
+        std::vector<Item> items;
+    };
+    struct Worker {
+        AnnotationCompositor compositor;
+        cv::Mat crop;
+        cv::Mat mask;
+        cv::Mat alpha;
+        double composeMs = 0.0;
+        int64_t pasted = 0;
+    };
+
+    void composeLoop(Worker& worker);
+    void compose(const Job& job, cv::Mat& out, Worker& worker);
+    void encodeLoop(int64_t frames);
+
+    Options options_;
+    Stats stats_;
+    ProgressFn progress_;
+    std::atomic<bool> cancel_{ false };
+
+    cv::Size frameSize_;
+    cv::VideoWriter writer_;
+    std::vector<cv::Mat> buffers_;
+    std::vector<size_t> free_;          // buffers the sweep may fill
+    std::deque<Job> queued_;            // waiting for a compose thread
+    std::map<int64_t, size_t> done_;    // composed, waiting for the encoder: frame -> buffer
+    std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable frameDone_;
+    std::condition_variable bufferFree_;
+    bool sweepDone_ = false;
+    bool failed_ = false;
+};
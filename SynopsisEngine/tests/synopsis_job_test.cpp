@@ -0,0 +1,143 @@
+// SynopsisJob resuming prepared work directories: a query that matches no tube gives an
+// empty synopsis instead of placing the whole store, changing the query between runs places
+// again, a job stopped after analysing every segment stitches them without the source, and
+// a stopped fragment merge resumes from its cached embeddings.
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include "synopsis_job.h"
+#include "test_support.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* kSource = "camera.mp4";
+
+// A work directory whose analysis is done: tubes.vstube plus a checkpoint at the place stage
+void prepare(const fs::path& dir, size_t tubes)
+{
+    std::vector<test::TubeSpec> specs(tubes);
+    for (size_t i = 0; i < tubes; ++i)
+        specs[i].firstFrame = static_cast<int64_t>(i) * 10;
+    test::expect(test::writeStore((dir / "tubes.vstube").u8string(), specs).size() == tubes, "store written");
+    std::ofstream ckpt(dir / "job.ckpt");
+    ckpt << "version=2\nsource=" << kSource << "\nstage=place\n";
+}
+
+// Two analysed segments, not stitched yet: one tube crosses the boundary at frame 100
+void prepareSegments(const fs::path& dir)
+{
+    std::vector<test::TubeSpec> first(1), second(2);
+    first[0].frames = 100;
+    second[0].firstFrame = 80;
+    second[0].frames = 70;
+    second[0].box = first[0].box + cv::Point(80 * first[0].step, 0);
+    second[1].firstFrame = 90;
+    second[1].box = cv::Rect(10, 300, 40, 40);
+    test::expect(test::writeStore((dir / "tubes_000.vstube").u8string(), first).size() == 1, "segment 0 written");
+    test::expect(test::writeStore((dir / "tubes_001.vstube").u8string(), second).size() == 2, "segment 1 written");
+    std::ofstream ckpt(dir / "job.ckpt");
+    ckpt << "version=2\nsource=" << kSource << "\nstage=analyse\n"
+         << "segment=0,100,0,100,0,1\nsegment=100,200,80,200,0,1\n";
+}
+
+// An analysed store of two fragments of one red object and a blue one, at the merge stage
+void prepareMerge(const fs::path& dir)
+{
+    std::vector<test::TubeSpec> specs(3);
+    specs[0].frames = 30;
+    specs[0].color = cv::Scalar(0, 0, 255);
+    specs[1] = specs[0];
+    specs[1].firstFrame = 40;
+    specs[2].firstFrame = 45;
+    specs[2].box = cv::Rect(10, 200, 40, 40);
+    specs[2].color = cv::Scalar(255, 0, 0);
+    test::expect(test::writeStore((dir / "tubes.vstube").u8string(), specs).size() == 3, "merge store written");
+    std::ofstream ckpt(dir / "job.ckpt");
+    ckpt << "version=2\nsource=" << kSource << "\nstage=merge\n";
+}
+
+uint64_t placementBytes(const fs::path& dir)
+{
+    std::error_code ec;
+    const uint64_t size = fs::file_size(dir / "placements.bin", ec);
+    return ec ? UINT64_MAX : size;
+}
+
+} // namespace
+
+int main()
+{
+    const fs::path dir = test::scratchDir("vs_synopsis_job_test");
+    const fs::path output = dir / "synopsis.mp4";
+    prepare(dir, 3);
+
+    // Class 7 is not in the store
+    SynopsisJob::Options options;
+    options.optimizer.annealSeconds = 1.0;
+    options.query.classes = { 7 };
+    {
+        SynopsisJob job(options);
+        test::expect(job.Run(kSource, dir.u8string(), output.u8string(), {}, nullptr), "empty query runs");
+        test::expect(job.placedTubes() == 0, "empty query places nothing");
+        test::expect(placementBytes(dir) == 0, "empty query leaves an empty placement file");
+        test::expect(!fs::exists(output), "empty query writes no synopsis");
+    }
+
+    // The same work directory with a query that matches: the finished (empty) job is placed
+    // again; stopping after the last batch leaves every match placed
+    options.query.classes = { 0 };
+    {
+        SynopsisJob job(options);
+        auto stopAfterPlace = [](int pass, double fraction) { return !(pass == VS_SYNOPSIS_PLACE && fraction >= 1.0); };
+        test::expect(!job.Run(kSource, dir.u8string(), output.u8string(), {}, stopAfterPlace), "stopped after placing");
+        test::expect(placementBytes(dir) == 3 * sizeof(TubePlacement), "changed query places every match");
+    }
+
+    // Every segment analysed, the stitch not done: the source is not needed any more
+    const fs::path segmented = test::scratchDir("vs_synopsis_job_test_segments");
+    prepareSegments(segmented);
+    {
+        SynopsisJob job(options);
+        auto stopAfterPlace = [](int pass, double fraction) { return !(pass == VS_SYNOPSIS_PLACE && fraction >= 1.0); };
+        test::expect(!job.Run(kSource, segmented.u8string(), output.u8string(), {}, stopAfterPlace), "stitched and placed");
+        TubeStoreReader store;
+        test::expect(store.Open((segmented / "tubes.vstube").u8string()), "stitched store written");
+        test::expect(store.tubes().size() == 2, "crossing tube joined");
+        test::expect(!fs::exists(segmented / "tubes_000.vstube"), "segment stores removed");
+        test::expect(placementBytes(segmented) == 2 * sizeof(TubePlacement), "stitched tubes placed");
+    }
+
+    // Merge stopped after the first tube, then resumed: the cached embedding is not redone
+    const fs::path merging = test::scratchDir("vs_synopsis_job_test_merge");
+    prepareMerge(merging);
+    SynopsisJob::Options mergeOptions = options;
+    mergeOptions.merger.samplesPerTube = 4;
+    size_t sent = 0;
+    TubeMerger::EmbedFn embed = [&sent](const std::vector<cv::Mat>& crops, cv::Mat& out) {
+        return test::embedByColour(crops, out, sent);
+    };
+    {
+        SynopsisJob job(mergeOptions);
+        auto stopInMerge = [](int pass, double) { return pass != VS_SYNOPSIS_MERGE; };
+        test::expect(!job.Run(kSource, merging.u8string(), output.u8string(), {}, stopInMerge, embed), "merge stopped");
+        test::expect(sent == 4 && fs::exists(merging / "embeddings.bin"), "first tube embedded and cached");
+    }
+    {
+        SynopsisJob job(mergeOptions);
+        auto stopAfterPlace = [](int pass, double fraction) { return !(pass == VS_SYNOPSIS_PLACE && fraction >= 1.0); };
+        test::expect(!job.Run(kSource, merging.u8string(), output.u8string(), {}, stopAfterPlace, embed), "merged and placed");
+        test::expect(sent == 12, "only the other tubes embedded on resume");
+        test::expect(!fs::exists(merging / "embeddings.bin"), "cache removed after the merge");
+        TubeStoreReader store;
+        test::expect(store.Open((merging / "tubes.vstube").u8string()) && store.tubes().size() == 2, "fragments joined");
+        test::expect(placementBytes(merging) == 2 * sizeof(TubePlacement), "merged tubes placed");
+    }
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::remove_all(segmented, ec);
+    fs::remove_all(merging, ec);
+    return test::finish("synopsis_job_test");
+}
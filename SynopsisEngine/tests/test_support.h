@@ -0,0 +1,114 @@
+#pragma once
+// Shared by the engine tests: failure counting and small synthetic tube stores.
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "tube_store.h"
+
+namespace test {
+
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline void expect(bool ok, const char* what)
+{
+    if (!ok) {
+        std::printf("FAIL %s\n", what);
+        ++failures();
+    }
+}
+
+inline int finish(const char* name)
+{
+    if (failures() == 0)
+        std::printf("%s: ok\n", name);
+    return failures() == 0 ? 0 : 1;
+}
+
+// Fresh empty directory under the system temp directory
+inline std::filesystem::path scratchDir(const char* name)
+{
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / name;
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir, ec);
+    return dir;
+}
+
+// One tube of a synthetic store: a box moving right by `step` pixels per frame
+struct TubeSpec {
+    int classId = 0;
+    int64_t firstFrame = 0;
+    int64_t frames = 20;
+    cv::Rect box{ 10, 10, 40, 40 };
+    int step = 2;
+    cv::Scalar color{ 128, 128, 128 };  // of the crop
+};
+
+// Writes the tubes frame by frame (interleaved, as the builder does); every record carries
+// a JPEG crop of the tube's colour. Returns the tube ids in spec order.
+inline std::vector<uint32_t> writeStore(const std::string& path, const std::vector<TubeSpec>& specs,
+    size_t chunkBytes = 4 << 20, cv::Size frameSize = cv::Size(640, 360))
+{
+    TubeStoreInfo info;
+    info.frameSize = frameSize;
+    info.fps = 25.0;
+    info.chunkBytes = chunkBytes;
+    TubeStoreWriter writer;
+    std::vector<uint32_t> ids;
+    if (!writer.Open(path, info))
+        return ids;
+    int64_t first = INT64_MAX;
+    int64_t last = 0;
+    std::vector<std::vector<uint8_t>> crops(specs.size());
+    for (size_t i = 0; i < specs.size(); ++i) {
+        if (!cv::imencode(".jpg", cv::Mat(specs[i].box.size(), CV_8UC3, specs[i].color), crops[i]))
+            return {};
+        ids.push_back(writer.NewTube(static_cast<int>(i), specs[i].classId));
+        first = std::min(first, specs[i].firstFrame);
+        last = std::max(last, specs[i].firstFrame + specs[i].frames);
+    }
+    for (int64_t f = first; f < last; ++f) {
+        for (size_t i = 0; i < specs.size(); ++i) {
+            const TubeSpec& s = specs[i];
+            if (f < s.firstFrame || f >= s.firstFrame + s.frames)
+                continue;
+            const cv::Rect box = s.box + cv::Point(static_cast<int>((f - s.firstFrame) * s.step), 0);
+            writer.Append(ids[i], f, f * 40.0, box, 0.9f, nullptr, 0, crops[i].data(), crops[i].size());
+        }
+    }
+    if (!writer.Close())
+        ids.clear();
+    return ids;
+}
+
+// Stand-in for the re-ID model: the mean colour of each crop, normalised; counts the crops
+// it was given in `sent`
+inline bool embedByColour(const std::vector<cv::Mat>& crops, cv::Mat& embeddings, size_t& sent)
+{
+    embeddings = cv::Mat::zeros(static_cast<int>(crops.size()), 3, CV_32F);
+    for (size_t i = 0; i < crops.size(); ++i) {
+        const cv::Mat& crop = crops[i];
+        float* row = embeddings.ptr<float>(static_cast<int>(i));
+        for (int y = 0; y < crop.rows; ++y) {
+            const uint8_t* p = crop.ptr<uint8_t>(y);
+            for (int x = 0; x < crop.cols * 3; ++x)
+                row[x % 3] += p[x];
+        }
+        const float norm = std::sqrt(row[0] * row[0] + row[1] * row[1] + row[2] * row[2]);
+        for (int d = 0; d < 3 && norm > 0.0f; ++d)
+            row[d] /= norm;
+    }
+    sent += crops.size();
+    return true;
+}
+
+} // namespace test
@@ -0,0 +1,89 @@
+// A person whose track broke (two red fragments) walks past a blue one. The merge joins the
+// red fragments only; a merge stopped after the first tube resumes from the embedding cache,
+// and a changed re-ID model file throws that cache away.
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include "tube_merger.h"
+#include "test_support.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void writeModel(const fs::path& path, size_t bytes)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << std::string(bytes, 'm');
+}
+
+} // namespace
+
+int main()
+{
+    const fs::path dir = test::scratchDir("vs_tube_merger_test");
+    const std::string input = (dir / "tubes.vstube").u8string();
+    const std::string cache = (dir / "embeddings.bin").u8string();
+    const std::string output = (dir / "tubes_merged.vstube").u8string();
+    const fs::path model = dir / "reid.onnx";
+    writeModel(model, 100);
+
+    std::vector<test::TubeSpec> specs(3);
+    specs[0].frames = 30;
+    specs[0].color = cv::Scalar(0, 0, 255);
+    specs[1] = specs[0];
+    specs[1].firstFrame = 40;       // 0.4 s after the first fragment ended
+    specs[2].firstFrame = 45;
+    specs[2].box = cv::Rect(10, 200, 40, 40);
+    specs[2].color = cv::Scalar(255, 0, 0);
+    test::expect(test::writeStore(input, specs).size() == specs.size(), "store written");
+
+    TubeMerger::Options options;
+    options.samplesPerTube = 4;
+    options.modelPathUtf8 = model.u8string();
+    size_t crops = 0;
+    auto embed = [&crops](const std::vector<cv::Mat>& in, cv::Mat& out) { return test::embedByColour(in, out, crops); };
+
+    // Stopped after the first tube: its embedding is cached
+    {
+        TubeMerger merger(options);
+        test::expect(!merger.Merge(input, cache, output, embed, [](double) { return false; }), "stopped merge fails");
+        test::expect(merger.stats().embedded == 1, "first tube embedded before the stop");
+        test::expect(crops == 4, "one tube's samples sent");
+    }
+
+    // Resumed: only the other two tubes go through the model
+    crops = 0;
+    {
+        TubeMerger merger(options);
+        test::expect(merger.Merge(input, cache, output, embed), "resumed merge");
+        test::expect(merger.stats().cached == 1, "cached embedding reused");
+        test::expect(merger.stats().embedded == 2, "remaining tubes embedded");
+        test::expect(crops == 8, "only the remaining samples sent");
+        test::expect(merger.stats().merged == 1, "red fragments joined");
+        test::expect(merger.stats().tubesOut == 2, "blue tube kept apart");
+    }
+
+    TubeStoreReader reader;
+    test::expect(reader.Open(output), "output opens");
+    bool joined = false;
+    for (const TubeSummary& t : reader.tubes())
+        joined |= t.firstFrame == 0 && t.lastFrame == 69 && t.frameCount == 60;
+    test::expect(joined, "joined tube holds both fragments");
+    reader.Close();
+
+    // Another model file: the cache no longer applies
+    writeModel(model, 200);
+    crops = 0;
+    {
+        TubeMerger merger(options);
+        test::expect(merger.Merge(input, cache, output, embed), "merge after a model change");
+        test::expect(merger.stats().cached == 0, "stale cache dropped");
+        test::expect(merger.stats().embedded == 3, "every tube embedded again");
+        test::expect(crops == 12, "every sample sent again");
+    }
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    return test::finish("tube_merger_test");
+}
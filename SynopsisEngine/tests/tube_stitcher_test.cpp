@@ -0,0 +1,73 @@
+// Two segments with a 20 frame overlap, stored in small chunks so every tube spans many of
+// them: the tube crossing the boundary is joined only if all of its overlap frames are
+// found, while a tube of another class and one elsewhere in the frame stay apart.
+#include <cstdio>
+#include <filesystem>
+#include "tube_stitcher.h"
+#include "test_support.h"
+
+namespace fs = std::filesystem;
+
+int main()
+{
+    const fs::path dir = test::scratchDir("vs_tube_stitcher_test");
+    const size_t kChunkBytes = 4096;    // a few records per chunk
+
+    std::vector<VideoSegment> segments(2);
+    segments[0].begin = 0;
+    segments[0].end = 100;
+    segments[1].begin = 100;
+    segments[1].decodeFrom = 80;
+
+    // Segment 0: the crossing tube (0..99) and one that ends long before the overlap
+    std::vector<test::TubeSpec> first(2);
+    first[0].frames = 100;
+    first[1].firstFrame = 10;
+    first[1].frames = 30;
+    first[1].box = cv::Rect(10, 200, 40, 40);
+
+    // Segment 1 from frame 80: the same object continuing, the same path with another
+    // class, and a tube of the same class far away
+    std::vector<test::TubeSpec> second(3);
+    second[0].firstFrame = 80;
+    second[0].frames = 70;
+    second[0].box = first[0].box + cv::Point(80 * first[0].step, 0);
+    second[1] = second[0];
+    second[1].classId = 1;
+    second[1].firstFrame = 85;
+    second[1].frames = 30;
+    second[1].box = second[0].box + cv::Point(5 * second[0].step, 0);
+    second[2].firstFrame = 90;
+    second[2].frames = 30;
+    second[2].box = cv::Rect(10, 300, 40, 40);
+
+    const std::vector<std::string> paths = { (dir / "0.vstube").u8string(), (dir / "1.vstube").u8string() };
+    test::expect(test::writeStore(paths[0], first, kChunkBytes).size() == first.size(), "segment 0 written");
+    test::expect(test::writeStore(paths[1], second, kChunkBytes).size() == second.size(), "segment 1 written");
+
+    TubeStitcher::Options options;
+    options.minCommonFrames = 20;       // every overlap frame must be read
+    options.chunkBytes = kChunkBytes;
+    TubeStitcher stitcher(options);
+    const std::string output = (dir / "tubes.vstube").u8string();
+    test::expect(stitcher.Merge(paths, segments, output), "merge");
+    test::expect(stitcher.stats().tubesIn == 5, "tubes in");
+    test::expect(stitcher.stats().stitched == 1, "one tube joined");
+    test::expect(stitcher.stats().tubesOut == 4, "tubes out");
+
+    TubeStoreReader reader;
+    test::expect(reader.Open(output), "output opens");
+    bool found = false;
+    for (const TubeSummary& t : reader.tubes()) {
+        if (t.classId == 0 && t.firstFrame == 0 && t.lastFrame == 149) {
+            found = true;
+            test::expect(t.frameCount == 150, "joined tube keeps every frame once");
+        }
+    }
+    test::expect(found, "joined tube spans both segments");
+    reader.Close();
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    return test::finish("tube_stitcher_test");
+}
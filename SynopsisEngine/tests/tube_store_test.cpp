@@ -0,0 +1,61 @@
+// A chunk header whose record or payload count does not fit the chunk is rejected before
+// anything is sized from it, by every read path.
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include "test_support.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::streamoff kFirstChunk = 64;      // after the file header
+
+void patch(const fs::path& path, std::streamoff offset, const void* bytes, size_t size)
+{
+    std::fstream f(path, std::ios::binary | std::ios::in | std::ios::out);
+    f.seekp(kFirstChunk + offset);
+    f.write(static_cast<const char*>(bytes), static_cast<std::streamsize>(size));
+}
+
+void expectRejected(const fs::path& path, const char* what)
+{
+    TubeStoreReader reader;
+    test::expect(reader.Open(path.u8string()), what);
+    std::vector<TubeFrame> frames;
+    test::expect(!reader.ReadChunk(0, frames), what);
+    test::expect(!reader.ReadTubeChunk(0, 0, frames), what);
+    test::expect(!reader.ReadTube(0, frames), what);
+}
+
+} // namespace
+
+int main()
+{
+    const fs::path dir = test::scratchDir("vs_tube_store_test");
+    const fs::path good = dir / "good.vstube";
+    test::expect(test::writeStore(good.u8string(), std::vector<test::TubeSpec>(2)).size() == 2, "store written");
+    {
+        TubeStoreReader reader;
+        std::vector<TubeFrame> frames;
+        test::expect(reader.Open(good.u8string()) && reader.ReadTube(0, frames) && frames.size() == 20, "intact store reads");
+    }
+
+    // Record count of the first chunk far past its size
+    const fs::path records = dir / "records.vstube";
+    fs::copy_file(good, records);
+    const uint32_t manyRecords = 0x7FFFFFFF;
+    patch(records, 4, &manyRecords, sizeof(manyRecords));
+    expectRejected(records, "oversized record table rejected");
+
+    // Payload size that would wrap the sum of the chunk's sections
+    const fs::path payload = dir / "payload.vstube";
+    fs::copy_file(good, payload);
+    const uint64_t hugePayload = ~uint64_t(0) - 16;
+    patch(payload, 8, &hugePayload, sizeof(hugePayload));
+    expectRejected(payload, "oversized payload rejected");
+
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    return test::finish("tube_store_test");
+}
@@ -0,0 +1,134 @@
+#include "ReIdEmbedder.h"
+#include "../../Logger.h"
+
+// ImageNet statistics, which the common re-ID backbones are trained with
+static const float kMean[3] = { 0.485f, 0.456f, 0.406f };
+static const float kStd[3] = { 0.229f, 0.224f, 0.225f };
+
+ReIdEmbedder::ReIdEmbedder(const JString& modelPath, bool useGPU, int numThreads)
+{
+    env_ = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "ONNX_REID");
+    sessionOptions_ = Ort::SessionOptions();
+
+    int nThread = numThreads > 0 ? numThreads : std::min(6, static_cast<int>(std::thread::hardware_concurrency()));
+    sessionOptions_.SetIntraOpNumThreads(nThread);
+    sessionOptions_.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
+
+    std::vector<std::string> availableProviders = Ort::GetAvailableProviders();
+    auto cudaAvailable = std::find(availableProviders.begin(), availableProviders.end(), "CUDAExecutionProvider");
+    OrtCUDAProviderOptions cudaOption;
+    if (useGPU && cudaAvailable != availableProviders.end()) {
+        LOG_INFO("[ReIdEmbedder] Inference device: GPU");
+        sessionOptions_.AppendExecutionProvider_CUDA(cudaOption);
+    }
+    else {
+        if (useGPU) {
+            LOG_INFO("GPU is not supported by your ONNXRuntime build. Fallback to CPU.");
+        }
+        LOG_INFO("[ReIdEmbedder] Inference device: CPU");
+    }
+
+    session_ = Ort::Session(env_, modelPath.c_str(), sessionOptions_);
+
+    Ort::AllocatorWithDefaultOptions allocator;
+    const std::vector<int64_t> inputShape = session_.GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    if (inputShape.size() != 4 || inputShape[2] <= 0 || inputShape[3] <= 0)
+        throw std::runtime_error("Re-ID model needs a fixed [N, 3, H, W] input.");
+    inputImageShape_ = cv::Size(static_cast<int>(inputShape[3]), static_cast<int>(inputShape[2]));
+    fixedBatch_ = inputShape[0] > 0 ? static_cast<int>(inputShape[0]) : 0;
+
+    // Feature size: everything after the batch axis ([N, D] or [N, D, 1, 1])
+    const std::vector<int64_t> outputShape = session_.GetOutputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    int64_t dimension = 1;
+    for (size_t i = 1; i < outputShape.size(); ++i)
+        dimension *= outputShape[i];
+    if (outputShape.size() < 2 || dimension <= 0)
+        throw std::runtime_error("Re-ID model needs a fixed [N, D] output.");
+    dimension_ = static_cast<int>(dimension);
+
+    inputNodeNameAllocatedStrings_.push_back(session_.GetInputNameAllocated(0, allocator));
+    inputNames_.push_back(inputNodeNameAllocatedStrings_.back().get());
+    outputNodeNameAllocatedStrings_.push_back(session_.GetOutputNameAllocated(0, allocator));
+    outputNames_.push_back(outputNodeNameAllocatedStrings_.back().get());
+
+    LOG_INFO_STREAM("[ReIdEmbedder] Model loaded: input " << inputImageShape_.width << "x" << inputImageShape_.height
+        << ", " << dimension_ << "-d embeddings, batch " << (fixedBatch_ > 0 ? std::to_string(fixedBatch_) : std::string("dynamic")));
+}
+
+void ReIdEmbedder::preprocess(const cv::Mat& crop, float* blob) const
+{
+    const size_t plane = static_cast<size_t>(inputImageShape_.width) * inputImageShape_.height;
+    if (crop.empty()) {
+        std::fill(blob, blob + 3 * plane, 0.0f);
+        return;
+    }
+    cv::Mat resized;
+    cv::resize(crop, resized, inputImageShape_, 0, 0, cv::INTER_LINEAR);
+    if (resized.channels() == 1)
+        cv::cvtColor(resized, resized, cv::COLOR_GRAY2BGR);
+    else if (resized.channels() == 4)
+        cv::cvtColor(resized, resized, cv::COLOR_BGRA2BGR);
+    for (int y = 0; y < resized.rows; ++y) {
+        const uchar* row = resized.ptr<uchar>(y);
+        float* r = blob + static_cast<size_t>(y) * resized.cols;
+        float* g = r + plane;
+        float* b = g + plane;
+        for (int x = 0; x < resized.cols; ++x) {
+            // BGR in, RGB planes out
+            b[x] = (row[3 * x] / 255.0f - kMean[2]) / kStd[2];
+            g[x] = (row[3 * x + 1] / 255.0f - kMean[1]) / kStd[1];
+            r[x] = (row[3 * x + 2] / 255.0f - kMean[0]) / kStd[0];
+        }
+    }
+}
+
+bool ReIdEmbedder::embed(const std::vector<cv::Mat>& crops, cv::Mat& embeddings)
+{
+    embeddings.create(static_cast<int>(crops.size()), dimension_, CV_32F);
+    if (crops.empty())
+        return true;
+
+    const size_t perImage = static_cast<size_t>(3) * inputImageShape_.width * inputImageShape_.height;
+    static Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    std::vector<float> batchValues;
+
+    for (size_t first = 0; first < crops.size(); first += maxBatch()) {
+        const size_t count = std::min(crops.size() - first, static_cast<size_t>(maxBatch()));
+        const size_t tensorImages = fixedBatch_ > 0 ? static_cast<size_t>(fixedBatch_) : count;
+        batchValues.assign(perImage * tensorImages, 0.0f);
+        {
+            ScopedTimer timer("preprocessing", MetricStage::Preprocess);
+            for (size_t i = 0; i < count; ++i)
+                preprocess(crops[first + i], batchValues.data() + i * perImage);
+        }
+
+        const std::vector<int64_t> batchShape = { static_cast<int64_t>(tensorImages), 3, inputImageShape_.height, inputImageShape_.width };
+        Ort::Value inputTensor = Ort::Value::CreateTensor<float>(
+            memoryInfo, batchValues.data(), batchValues.size(), batchShape.data(), batchShape.size());
+
+        std::vector<Ort::Value> outputTensors;
+        try {
+            ScopedTimer runTimer("inference", MetricStage::Inference);
+            outputTensors = session_.Run(Ort::RunOptions{ nullptr }, inputNames_.data(), &inputTensor, 1, outputNames_.data(), 1);
+        }
+        catch (const Ort::Exception& e) {
+            LOG_ERROR_STREAM("[ReIdEmbedder] Run failed: " << e.what());
+            return false;
+        }
+
+        const float* features = outputTensors[0].GetTensorData<float>();
+        for (size_t i = 0; i < count; ++i) {
+            const float* in = features + i * dimension_;
+            float* out = embeddings.ptr<float>(static_cast<int>(first + i));
+            double norm = 0.0;
+            for (int d = 0; d < dimension_; ++d)
+                norm += static_cast<double>(in[d]) * in[d];
+            const float scale = norm > 0.0 && !crops[first + i].empty() ? static_cast<float>(1.0 / std::sqrt(norm)) : 0.0f;
+            for (int d = 0; d < dimension_; ++d)
+                out[d] = in[d] * scale;
+        }
+    }
+
+    LOG_DEBUG_STREAM("[ReIdEmbedder] Embedded " << crops.size() << " crops");
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// ===================================
+// Appearance Re-Identification Header File
+// ===================================
+//
+// This header defines the ReIdEmbedder class, which turns object crops into appearance
+// embeddings with a small ONNX re-identification model (OSNet, MobileNet re-ID and the
+// like: one [N, 3, H, W] image input, one [N, D] feature output).
+//
+// ================================
+
+#include <onnxruntime_cxx_api.h>
+#include <opencv2/opencv.hpp>
+#include <thread>
+
+#include "YOLO-common.h"
+#include "tools/Debug.hpp"
+#include "tools/ScopedTimer.hpp"
+
+/**
+ * @brief
+ * ReIdEmbedder loads a re-ID model and embeds batches of crops, one session run per batch.
+ */
+class ReIdEmbedder {
+public:
+    /**
+     * @brief Loads the model.
+     *
+     * @param modelPath Path to the ONNX model file.
+     * @param useGPU Whether to use GPU for inference (default is false).
+     * @param numThreads ONNX Runtime intra-op threads, 0 keeps the default.
+     */
+    ReIdEmbedder(const JString &modelPath, bool useGPU = false, int numThreads = 0);
+
+    /**
+     * @brief Embeds several crops.
+     *
+     * Crops are stretched to the model input (re-ID models are trained on stretched
+     * person / vehicle crops, not letterboxed ones), stacked into one tensor of up to
+     * maxBatch() images and run once per tensor. Models with a fixed batch axis get
+     * tensors of exactly that size, padded with zeros.
+     *
+     * @param crops BGR crops, any sizes; empty crops give zero rows.
+     * @param embeddings Output, crops.size() x dimension() CV_32F, rows L2-normalised.
+     * @return false if a run failed.
+     */
+    bool embed(const std::vector<cv::Mat> &crops, cv::Mat &embeddings);
+
+    int dimension() const { return dimension_; }
+    int maxBatch() const { return fixedBatch_ > 0 ? fixedBatch_ : kMaxDynamicBatch; }
+    cv::Size inputShape() const { return inputImageShape_; }
+
+private:
+    static const int kMaxDynamicBatch = 64;
+
+    // One crop as normalised RGB CHW floats at blob
+    void preprocess(const cv::Mat &crop, float *blob) const;
+
+    Ort::Env env_{nullptr};
+    Ort::SessionOptions sessionOptions_{nullptr};
+    Ort::Session session_{nullptr};
+
+    cv::Size inputImageShape_;
+    int fixedBatch_ = 0;            // batch axis of the model, 0 = dynamic
+    int dimension_ = 0;
+
+    std::vector<Ort::AllocatedStringPtr> inputNodeNameAllocatedStrings_;
+    std::vector<const char *> inputNames_;
+    std::vector<Ort::AllocatedStringPtr> outputNodeNameAllocatedStrings_;
+    std::vector<const char *> outputNames_;
+};
@@ -117,7 +117,11 @@ namespace utils {
             }
         }
         else {
+#if defined(UNICODE)
             std::wcerr << L"ERROR: Failed to access class name path: " << path << std::endl;
+#else
+            std::cerr << "ERROR: Failed to access class name path: " << path << std::endl;
+#endif
         }
 
         // DEBUG_PRINT("Loaded " << classNames.size() << " class names from " + path);
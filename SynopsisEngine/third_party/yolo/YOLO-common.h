@@ -287,7 +287,7 @@ namespace utils {
         int stride = 32
     );
 
-    inline void letterBoxSeg(const cv::Mat& image, cv::Mat& outImage,
+    void letterBoxSeg(const cv::Mat& image, cv::Mat& outImage,
         const cv::Size& newShape,
         const cv::Scalar& color = cv::Scalar(114, 114, 114),
         bool auto_ = true,
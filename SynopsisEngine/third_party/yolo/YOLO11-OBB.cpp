@@ -2,17 +2,17 @@
 #define NOMINMAX
 #endif
 #include "YOLO11-OBB.h"
-#include "..\..\Logger.h"
+#include "../../Logger.h"
 
 
 // Implementation of YOLO11OBBDetector constructor
-YOLO11OBBDetector::YOLO11OBBDetector(const JString& modelPath, const JString& labelsPath, bool useGPU) {
+YOLO11OBBDetector::YOLO11OBBDetector(const JString& modelPath, const JString& labelsPath, bool useGPU, int numThreads) {
     // Initialize ONNX Runtime environment with warning level
     env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "ONNX_DETECTION");
     sessionOptions = Ort::SessionOptions();
 
     // Set number of intra-op threads for parallelism
-    sessionOptions.SetIntraOpNumThreads(std::min(6, static_cast<int>(std::thread::hardware_concurrency())));
+    sessionOptions.SetIntraOpNumThreads(numThreads > 0 ? numThreads : std::min(6, static_cast<int>(std::thread::hardware_concurrency())));
     sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
 
     // Retrieve available execution providers (e.g., CPU, CUDA)
@@ -73,7 +73,7 @@ YOLO11OBBDetector::YOLO11OBBDetector(const JString& modelPath, const JString& la
 
 // Preprocess function implementation
 cv::Mat YOLO11OBBDetector::preprocess(const cv::Mat& image, float*& blob, std::vector<int64_t>& inputTensorShape) {
-    ScopedTimer timer("preprocessing");
+    ScopedTimer timer("preprocessing", MetricStage::Preprocess);
 
     cv::Mat resizedImage;
     // Resize and pad the image using letterBox utility
@@ -109,7 +109,7 @@ std::vector<ObbDetection> YOLO11OBBDetector::postprocess(
     float iouThreshold,
     int topk)
 {
-    ScopedTimer timer("postprocessing");
+    ScopedTimer timer("postprocessing", MetricStage::Postprocess);
     std::vector<ObbDetection> detections;
 
     // Get raw output data and shape (assumed [1, num_features, num_detections])
@@ -200,8 +200,12 @@ std::vector<ObbDetection> YOLO11OBBDetector::postprocess(
     }
 
     // Perform rotated NMS.
-    std::vector<ObbDetection> post_nms_detections = utils::nonMaxSuppression(
-        detectionsForNMS, confThreshold, iouThreshold, topk);
+    std::vector<ObbDetection> post_nms_detections;
+    {
+        ScopedTimer nmsTimer("nms", MetricStage::NMS);
+        post_nms_detections = utils::nonMaxSuppression(
+            detectionsForNMS, confThreshold, iouThreshold, topk);
+    }
 
 
 
@@ -213,7 +217,7 @@ std::vector<ObbDetection> YOLO11OBBDetector::postprocess(
 
 // Detect function implementation
 std::vector<ObbDetection> YOLO11OBBDetector::detect(const cv::Mat& image, float confThreshold, float iouThreshold) {
-    ScopedTimer timer("Overall detection");
+    ScopedTimer timer("Overall detection", MetricStage::Total);
 
     float* blobPtr = nullptr; // Pointer to hold preprocessed image data
     // Define the shape of the input tensor (batch size, channels, height, width)
@@ -243,14 +247,18 @@ std::vector<ObbDetection> YOLO11OBBDetector::detect(const cv::Mat& image, float
     );
 
     // Run the inference session with the input tensor and retrieve output tensors
-    std::vector<Ort::Value> outputTensors = session.Run(
-        Ort::RunOptions{ nullptr },
-        inputNames.data(),
-        &inputTensor,
-        numInputNodes,
-        outputNames.data(),
-        numOutputNodes
-    );
+    std::vector<Ort::Value> outputTensors;
+    {
+        ScopedTimer runTimer("inference", MetricStage::Inference);
+        outputTensors = session.Run(
+            Ort::RunOptions{ nullptr },
+            inputNames.data(),
+            &inputTensor,
+            numInputNodes,
+            outputNames.data(),
+            numOutputNodes
+        );
+    }
 
     // Determine the resized image shape based on input tensor shape
     cv::Size resizedImageShape(static_cast<int>(inputTensorShape[3]), static_cast<int>(inputTensorShape[2]));
@@ -2,17 +2,17 @@
 #define NOMINMAX
 #endif
 #include "YOLO11-POSE.h"
-#include "..\..\Logger.h"
+#include "../../Logger.h"
 
 
 // Implementation of YOLO11POSEDetector constructor
-YOLO11POSEDetector::YOLO11POSEDetector(const JString& modelPath, const JString& labelsPath, bool useGPU) {
+YOLO11POSEDetector::YOLO11POSEDetector(const JString& modelPath, const JString& labelsPath, bool useGPU, int numThreads) {
     // Initialize ONNX Runtime environment with warning level
     env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "ONNX_DETECTION");
     sessionOptions = Ort::SessionOptions();
 
     // Set number of intra-op threads for parallelism
-    sessionOptions.SetIntraOpNumThreads(std::min(6, static_cast<int>(std::thread::hardware_concurrency())));
+    sessionOptions.SetIntraOpNumThreads(numThreads > 0 ? numThreads : std::min(6, static_cast<int>(std::thread::hardware_concurrency())));
     sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
 
     // Retrieve available execution providers (e.g., CPU, CUDA)
@@ -70,7 +70,7 @@ YOLO11POSEDetector::YOLO11POSEDetector(const JString& modelPath, const JString&
 
 // Preprocess function implementation
 cv::Mat YOLO11POSEDetector::preprocess(const cv::Mat& image, float*& blob, std::vector<int64_t>& inputTensorShape) {
-    ScopedTimer timer("preprocessing");
+    ScopedTimer timer("preprocessing", MetricStage::Preprocess);
 
     cv::Mat resizedImage;
     // Resize and pad the image using letterBox utility
@@ -132,7 +132,7 @@ std::vector<PoseDetection> YOLO11POSEDetector::postprocess(
     float confThreshold,
     float iouThreshold
 ) {
-    ScopedTimer timer("postprocessing");
+    ScopedTimer timer("postprocessing", MetricStage::Postprocess);
     std::vector<PoseDetection> detections;
 
     const float* rawOutput = outputTensors[0].GetTensorData<float>();
@@ -208,7 +208,10 @@ std::vector<PoseDetection> YOLO11POSEDetector::postprocess(
 
     // Apply Non-Maximum Suppression
     std::vector<int> indices;
-    utils::NMSBoxesPose(boxes, confidences, confThreshold, iouThreshold, indices);
+    {
+        ScopedTimer nmsTimer("nms", MetricStage::NMS);
+        utils::NMSBoxesPose(boxes, confidences, confThreshold, iouThreshold, indices);
+    }
 
     // Create final detections
     for (int idx : indices) {
@@ -229,7 +232,7 @@ std::vector<PoseDetection> YOLO11POSEDetector::postprocess(
 
 // Detect function implementation
 std::vector<PoseDetection> YOLO11POSEDetector::detect(const cv::Mat& image, float confThreshold, float iouThreshold) {
-    ScopedTimer timer("Overall detection");
+    ScopedTimer timer("Overall detection", MetricStage::Total);
 
     float* blobPtr = nullptr; // Pointer to hold preprocessed image data
     // Define the shape of the input tensor (batch size, channels, height, width)
@@ -259,14 +262,18 @@ std::vector<PoseDetection> YOLO11POSEDetector::detect(const cv::Mat& image, floa
     );
 
     // Run the inference session with the input tensor and retrieve output tensors
-    std::vector<Ort::Value> outputTensors = session.Run(
-        Ort::RunOptions{ nullptr },
-        inputNames.data(),
-        &inputTensor,
-        numInputNodes,
-        outputNames.data(),
-        numOutputNodes
-    );
+    std::vector<Ort::Value> outputTensors;
+    {
+        ScopedTimer runTimer("inference", MetricStage::Inference);
+        outputTensors = session.Run(
+            Ort::RunOptions{ nullptr },
+            inputNames.data(),
+            &inputTensor,
+            numInputNodes,
+            outputNames.data(),
+            numOutputNodes
+        );
+    }
 
     // Determine the resized image shape based on input tensor shape
     cv::Size resizedImageShape(static_cast<int>(inputTensorShape[3]), static_cast<int>(inputTensorShape[2]));
@@ -116,8 +116,9 @@ public:
      * @param modelPath Path to the ONNX model file.
      * @param labelsPath Path to the file containing class labels.
      * @param useGPU Whether to use GPU for inference (default is false).
+     * @param numThreads ONNX Runtime intra-op threads, 0 keeps the default.
      */
-    YOLO11POSEDetector(const JString&modelPath, const JString&labelsPath, bool useGPU = false);
+    YOLO11POSEDetector(const JString&modelPath, const JString&labelsPath, bool useGPU = false, int numThreads = 0);
     
     /**
      * @brief Runs detection on the provided image.
@@ -1,19 +1,19 @@
 #include "YOLO11.h"
-#include "..\..\Logger.h"
+#include "../../Logger.h"
 
 // Implementation of YOLO11Detector constructor
 YOLO11Detector::YOLO11Detector(
     const JString& modelPath,
     const JString& labelsPath,
-    bool useGPU
+    bool useGPU,
+    int numThreads
 ) {
     // Initialize ONNX Runtime environment with warning level
     env = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "ONNX_DETECTION");
     sessionOptions = Ort::SessionOptions();
 
     // Set number of intra-op threads for parallelism
-    int nThread = std::thread::hardware_concurrency();
-    nThread = std::min(6, nThread);
+    int nThread = numThreads > 0 ? numThreads : std::min(6, static_cast<int>(std::thread::hardware_concurrency()));
     sessionOptions.SetIntraOpNumThreads(nThread);
     sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
 
@@ -44,6 +44,7 @@ YOLO11Detector::YOLO11Detector(
     std::vector<int64_t> inputTensorShapeVec = inputTypeInfo.GetTensorTypeAndShapeInfo().GetShape();
     isDynamicInputShape = (inputTensorShapeVec.size() >= 4) &&
         (inputTensorShapeVec[2] == -1 && inputTensorShapeVec[3] == -1); // Check for dynamic dimensions
+    isDynamicBatch = !isDynamicInputShape && !inputTensorShapeVec.empty() && inputTensorShapeVec[0] == -1;
 
     // Allocate and store input node names
     auto input_name = session.GetInputNameAllocated(0, allocator);
@@ -76,7 +77,7 @@ YOLO11Detector::YOLO11Detector(
 
 // Preprocess function implementation
 cv::Mat YOLO11Detector::preprocess(const cv::Mat& image, float*& blob, std::vector<int64_t>& inputTensorShape) {
-    ScopedTimer timer("preprocessing");
+    ScopedTimer timer("preprocessing", MetricStage::Preprocess);
 
     cv::Mat resizedImage;
     // Resize and pad the image using letterBox utility
@@ -111,9 +112,6 @@ std::vector<Detection> YOLO11Detector::postprocess(
     float confThreshold,
     float iouThreshold
 ) {
-    ScopedTimer timer("postprocessing"); // Measure postprocessing time
-
-    std::vector<Detection> detections;
     const float* rawOutput = outputTensors[0].GetTensorData<float>(); // Extract raw output data from the first output tensor
     const std::vector<int64_t> outputShape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
 
@@ -121,6 +119,22 @@ std::vector<Detection> YOLO11Detector::postprocess(
     const size_t num_features = outputShape[1];
     const size_t num_detections = outputShape[2];
 
+    return postprocess(originalImageSize, resizedImageShape, rawOutput, num_features, num_detections, confThreshold, iouThreshold);
+}
+
+std::vector<Detection> YOLO11Detector::postprocess(
+    const cv::Size& originalImageSize,
+    const cv::Size& resizedImageShape,
+    const float* rawOutput,
+    size_t num_features,
+    size_t num_detections,
+    float confThreshold,
+    float iouThreshold
+) {
+    ScopedTimer timer("postprocessing", MetricStage::Postprocess); // Measure postprocessing time
+
+    std::vector<Detection> detections;
+
     // Early exit if no detections
     if (num_detections == 0) {
         return detections;
@@ -200,7 +214,10 @@ std::vector<Detection> YOLO11Detector::postprocess(
 
     // Apply Non-Maximum Suppression (NMS) to eliminate redundant detections
     std::vector<int> indices;
-    utils::NMSBoxes(nms_boxes, confs, confThreshold, iouThreshold, indices);
+    {
+        ScopedTimer nmsTimer("nms", MetricStage::NMS);
+        utils::NMSBoxes(nms_boxes, confs, confThreshold, iouThreshold, indices);
+    }
 
     // Collect filtered detections into the result vector
     detections.reserve(indices.size());
@@ -219,7 +236,7 @@ std::vector<Detection> YOLO11Detector::postprocess(
 
 // Detect function implementation
 std::vector<Detection> YOLO11Detector::detect(const cv::Mat& image, float confThreshold, float iouThreshold) {
-    ScopedTimer timer("Overall detection");
+    ScopedTimer timer("Overall detection", MetricStage::Total);
 
     float* blobPtr = nullptr; // Pointer to hold preprocessed image data
     // Define the shape of the input tensor (batch size, channels, height, width)
@@ -249,6 +266,67 @@ std::vector<Detection> YOLO11Detector::detect(const cv::Mat& image, float confTh
     );
 
     // Run the inference session with the input tensor and retrieve output tensors
+    std::vector<Ort::Value> outputTensors;
+    {
+        ScopedTimer runTimer("inference", MetricStage::Inference);
+        outputTensors = session.Run(
+            Ort::RunOptions{ nullptr },
+            inputNames.data(),
+            &inputTensor,
+            numInputNodes,
+            outputNames.data(),
+            numOutputNodes
+        );
+    }
+
+    // Determine the resized image shape based on input tensor shape
+    cv::Size resizedImageShape(static_cast<int>(inputTensorShape[3]), static_cast<int>(inputTensorShape[2]));
+
+    // Postprocess the output tensors to obtain detections
+    std::vector<Detection> detections = postprocess(image.size(), resizedImageShape, outputTensors, confThreshold, iouThreshold);
+
+    return detections; // Return the vector of detections
+}
+
+// Batched detect: every image is letterboxed to the fixed input size, stacked into one
+// [N, 3, H, W] tensor and run once; postprocess then works on each image's output slice.
+std::vector<std::vector<Detection>> YOLO11Detector::detectBatch(const std::vector<cv::Mat>& images, const int* streamIds,
+    float confThreshold, float iouThreshold) {
+    std::vector<std::vector<Detection>> results(images.size());
+    if (images.empty())
+        return results;
+
+    metrics::Context& ctx = metrics::current();
+    const int callerStream = ctx.streamId;
+    auto useStream = [&](size_t i) { ctx.streamId = streamIds ? streamIds[i] : callerStream; };
+
+    if (!isDynamicBatch || images.size() == 1) {
+        for (size_t i = 0; i < images.size(); ++i) {
+            useStream(i);
+            results[i] = detect(images[i], confThreshold, iouThreshold);
+        }
+        ctx.streamId = callerStream;
+        return results;
+    }
+
+    const uint64_t start = metrics::nowNs();
+    const size_t perImage = static_cast<size_t>(3) * inputImageShape.width * inputImageShape.height;
+    std::vector<float> batchValues(perImage * images.size());
+    std::vector<int64_t> inputTensorShape = { 1, 3, inputImageShape.height, inputImageShape.width };
+    for (size_t i = 0; i < images.size(); ++i) {
+        useStream(i);
+        float* blobPtr = nullptr;
+        preprocess(images[i], blobPtr, inputTensorShape);
+        std::memcpy(batchValues.data() + i * perImage, blobPtr, perImage * sizeof(float));
+        delete[] blobPtr;
+    }
+
+    const std::vector<int64_t> batchShape = { static_cast<int64_t>(images.size()), 3, inputImageShape.height, inputImageShape.width };
+    static Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
+    Ort::Value inputTensor = Ort::Value::CreateTensor<float>(
+        memoryInfo, batchValues.data(), batchValues.size(), batchShape.data(), batchShape.size());
+
+    const uint64_t runStart = metrics::nowNs();
     std::vector<Ort::Value> outputTensors = session.Run(
         Ort::RunOptions{ nullptr },
         inputNames.data(),
@@ -257,12 +335,29 @@ std::vector<Detection> YOLO11Detector::detect(const cv::Mat& image, float confTh
         outputNames.data(),
         numOutputNodes
     );
+    const uint64_t runNs = metrics::nowNs() - runStart;
 
-    // Determine the resized image shape based on input tensor shape
-    cv::Size resizedImageShape(static_cast<int>(inputTensorShape[3]), static_cast<int>(inputTensorShape[2]));
+    const float* rawOutput = outputTensors[0].GetTensorData<float>();
+    const std::vector<int64_t> outputShape = outputTensors[0].GetTensorTypeAndShapeInfo().GetShape();
+    const size_t num_features = static_cast<size_t>(outputShape[1]);
+    const size_t num_detections = static_cast<size_t>(outputShape[2]);
+    for (size_t i = 0; i < images.size(); ++i) {
+        useStream(i);
+        results[i] = postprocess(images[i].size(), inputImageShape, rawOutput + i * num_features * num_detections,
+            num_features, num_detections, confThreshold, iouThreshold);
+    }
 
-    // Postprocess the output tensors to obtain detections
-    std::vector<Detection> detections = postprocess(image.size(), resizedImageShape, outputTensors, confThreshold, iouThreshold);
+    // Each frame waited for the whole batch run; Total is the batch wall time
+    if (ctx.registry) {
+        const uint64_t totalNs = metrics::nowNs() - start;
+        for (size_t i = 0; i < images.size(); ++i) {
+            const int stream = streamIds ? streamIds[i] : callerStream;
+            ctx.registry->record(stream, MetricStage::Inference, runNs);
+            ctx.registry->record(stream, MetricStage::Total, totalNs);
+        }
+    }
+    ctx.streamId = callerStream;
 
-    return detections; // Return the vector of detections
+    LOG_DEBUG_STREAM("[YOLO11Detector] Batch of " << images.size() << " images processed");
+    return results;
 }
\ No newline at end of file
@@ -22,6 +22,7 @@
 // Include necessary ONNX Runtime and OpenCV headers
 #include <onnxruntime_cxx_api.h>
 #include <opencv2/opencv.hpp>
+#include <thread>
 
 
 
@@ -234,8 +235,9 @@ public:
      * @param modelPath Path to the ONNX model file.
      * @param labelsPath Path to the file containing class labels.
      * @param useGPU Whether to use GPU for inference (default is false).
+     * @param numThreads ONNX Runtime intra-op threads, 0 keeps the default.
      */
-    YOLO11Detector(const JString&modelPath, const JString&labelsPath, bool useGPU = false);
+    YOLO11Detector(const JString&modelPath, const JString&labelsPath, bool useGPU = false, int numThreads = 0);
     
     /**
      * @brief Runs detection on the provided image.
@@ -246,6 +248,23 @@ public:
      * @return std::vector<Detection> Vector of detections.
      */
     std::vector<Detection> detect(const cv::Mat &image, float confThreshold = 0.4f, float iouThreshold = 0.45f);
+
+    /**
+     * @brief Runs detection on several images with one inference call.
+     *
+     * Needs a model exported with a dynamic batch axis and a fixed input size; other
+     * models fall back to one detect() per image. Stage latencies are recorded under
+     * streamIds[i] for image i when streamIds is given (the batch run counts for each).
+     *
+     * @param images Input images, any sizes.
+     * @param streamIds Optional metrics stream per image (images.size() entries).
+     * @return One detection vector per image, in order.
+     */
+    std::vector<std::vector<Detection>> detectBatch(const std::vector<cv::Mat> &images, const int *streamIds = nullptr,
+                                                    float confThreshold = 0.4f, float iouThreshold = 0.45f);
+
+    // True when detectBatch() really stacks images into one tensor
+    bool supportsBatch() const { return isDynamicBatch; }
     
     /**
      * @brief Draws bounding boxes on the image based on detections.
@@ -273,6 +292,7 @@ private:
     Ort::SessionOptions sessionOptions{nullptr};   // Session options for ONNX Runtime
     Ort::Session session{nullptr};                 // ONNX Runtime session for running inference
     bool isDynamicInputShape{};                    // Flag indicating if input shape is dynamic
+    bool isDynamicBatch{};                         // Batch axis is dynamic and H/W are fixed
     cv::Size inputImageShape;                      // Expected input image shape for the model
 
     // Vectors to hold allocated input and output node names
@@ -309,6 +329,11 @@ private:
     std::vector<Detection> postprocess(const cv::Size &originalImageSize, const cv::Size &resizedImageShape,
                                       const std::vector<Ort::Value> &outputTensors,
                                       float confThreshold, float iouThreshold);
+
+    // Same as above on one image's slice [features x anchors] of the output
+    std::vector<Detection> postprocess(const cv::Size &originalImageSize, const cv::Size &resizedImageShape,
+                                      const float *rawOutput, size_t num_features, size_t num_detections,
+                                      float confThreshold, float iouThreshold);
     
 };
 
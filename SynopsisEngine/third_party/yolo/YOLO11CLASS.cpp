@@ -2,18 +2,18 @@
 #define NOMINMAX
 #endif
 #include "YOLO11CLASS.h"
-#include "..\..\Logger.h"
-#include <tchar.h>
+#include "../../Logger.h"
+#include "vs_platform.h"
 #include <vector>
 
 // Implementation of YOLO11Classifier constructor
 YOLO11Classifier::YOLO11Classifier(const JString& modelPath, const JString& labelsPath,
-    bool useGPU, const cv::Size& targetInputShape)
+    bool useGPU, const cv::Size& targetInputShape, int numThreads)
     : inputImageShape_(targetInputShape) {
     env_ = Ort::Env(ORT_LOGGING_LEVEL_WARNING, "ONNX_CLASSIFICATION_ENV");
     sessionOptions_ = Ort::SessionOptions();
 
-    sessionOptions_.SetIntraOpNumThreads(std::min(4, static_cast<int>(std::thread::hardware_concurrency())));
+    sessionOptions_.SetIntraOpNumThreads(numThreads > 0 ? numThreads : std::min(4, static_cast<int>(std::thread::hardware_concurrency())));
     sessionOptions_.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
 
     std::vector<std::string> availableProviders = Ort::GetAvailableProviders();
@@ -131,7 +131,12 @@ YOLO11Classifier::YOLO11Classifier(const JString& modelPath, const JString& labe
 
     classNames_ = utils::getClassNames(labelsPath);
     if (numClasses_ > 0 && !classNames_.empty() && classNames_.size() != static_cast<size_t>(numClasses_)) {
-        std::wcerr << "Warning: Number of classes from model (" << numClasses_
+#if defined(UNICODE)
+        auto& err = std::wcerr;
+#else
+        auto& err = std::cerr;
+#endif
+        err << "Warning: Number of classes from model (" << numClasses_
             << ") does not match number of labels in " << labelsPath
             << " (" << classNames_.size() << ")." << std::endl;
     }
@@ -156,7 +161,7 @@ YOLO11Classifier::YOLO11Classifier(const JString& modelPath, const JString& labe
 
 // ... (preprocess, postprocess, and classify methods remain the same as previous correct version) ...
 void YOLO11Classifier::preprocess(const cv::Mat& image, float*& blob, std::vector<int64_t>& inputTensorShape) {
-    ScopedTimer timer("Preprocessing (Ultralytics-style)");
+    ScopedTimer timer("Preprocessing (Ultralytics-style)", MetricStage::Preprocess);
 
     if (image.empty()) {
         throw std::runtime_error("Input image to preprocess is empty.");
@@ -223,7 +228,7 @@ void YOLO11Classifier::preprocess(const cv::Mat& image, float*& blob, std::vecto
         << inputTensorShape[2] << "x" << inputTensorShape[3]);
 }
 ClassificationResult YOLO11Classifier::postprocess(const std::vector<Ort::Value>& outputTensors) {
-    ScopedTimer timer("Postprocessing");
+    ScopedTimer timer("Postprocessing", MetricStage::Postprocess);
 
     if (outputTensors.empty()) {
         LOG_ERROR("[YOLO11Classifier] No output tensors for postprocessing.");
@@ -326,7 +331,7 @@ ClassificationResult YOLO11Classifier::postprocess(const std::vector<Ort::Value>
 }
 
 ClassificationResult YOLO11Classifier::classify(const cv::Mat& image) {
-    ScopedTimer timer("Overall classification task");
+    ScopedTimer timer("Overall classification task", MetricStage::Total);
 
     if (image.empty()) {
         LOG_ERROR("[YOLO11Classifier] Input image for classification is empty.");
@@ -371,6 +376,7 @@ ClassificationResult YOLO11Classifier::classify(const cv::Mat& image) {
 
     std::vector<Ort::Value> outputTensors;
     try {
+        ScopedTimer runTimer("inference", MetricStage::Inference);
         outputTensors = session_.Run(
             Ort::RunOptions{ nullptr },
             inputNames_.data(),
@@ -161,7 +161,8 @@ public:
      * @brief Constructor to initialize the classifier with model and label paths.
      */
     YOLO11Classifier(const JString&modelPath, const JString&labelsPath,
-                    bool useGPU = false, const cv::Size& targetInputShape = cv::Size(224, 224));
+                    bool useGPU = false, const cv::Size& targetInputShape = cv::Size(224, 224),
+                    int numThreads = 0);
 
     /**
      * @brief Runs classification on the provided image.
@@ -2,17 +2,19 @@
 #define NOMINMAX
 #endif
 #include "YOLO11Seg.h"
-#include "..\..\Logger.h"
+#include "../../Logger.h"
+#include "../../annotation_compositor.h"
 
 
 YOLOv11SegDetector::YOLOv11SegDetector(const JString& modelPath,
     const JString& labelsPath,
-    bool useGPU)
+    bool useGPU,
+    int numThreads)
     : env(ORT_LOGGING_LEVEL_WARNING, "YOLOv11Seg")
 {
     ScopedTimer timer("YOLOv11SegDetector Constructor");
 
-    sessionOptions.SetIntraOpNumThreads(std::min(6, static_cast<int>(std::thread::hardware_concurrency())));
+    sessionOptions.SetIntraOpNumThreads(numThreads > 0 ? numThreads : std::min(6, static_cast<int>(std::thread::hardware_concurrency())));
     sessionOptions.SetGraphOptimizationLevel(GraphOptimizationLevel::ORT_ENABLE_ALL);
 
     std::vector<std::string> providers = Ort::GetAvailableProviders();
@@ -78,11 +80,11 @@ YOLOv11SegDetector::YOLOv11SegDetector(const JString& modelPath,
     */
 }
 
-inline cv::Mat YOLOv11SegDetector::preprocess(const cv::Mat& image,
+cv::Mat YOLOv11SegDetector::preprocess(const cv::Mat& image,
     float*& blobPtr,
     std::vector<int64_t>& inputTensorShape)
 {
-    ScopedTimer timer("Preprocess");
+    ScopedTimer timer("Preprocess", MetricStage::Preprocess);
 
     cv::Mat letterboxImage;
     utils::letterBoxSeg(image, letterboxImage, inputImageShape,
@@ -115,7 +117,7 @@ std::vector<Segmentation> YOLOv11SegDetector::postprocess(
     float confThreshold,
     float iouThreshold)
 {
-    ScopedTimer timer("PostprocessSeg");
+    ScopedTimer timer("PostprocessSeg", MetricStage::Postprocess);
 
     std::vector<Segmentation> results;
 
@@ -229,7 +231,10 @@ std::vector<Segmentation> YOLOv11SegDetector::postprocess(
 
     // 3. Apply NMS
     std::vector<int> nmsIndices;
-    utils::NMSBoxesSeg(boxes, confidences, confThreshold, iouThreshold, nmsIndices);
+    {
+        ScopedTimer nmsTimer("nms", MetricStage::NMS);
+        utils::NMSBoxesSeg(boxes, confidences, confThreshold, iouThreshold, nmsIndices);
+    }
 
     if (nmsIndices.empty()) {
         return results;
@@ -316,7 +321,7 @@ std::vector<Segmentation> YOLOv11SegDetector::postprocess(
     return results;
 }
 
-inline void YOLOv11SegDetector::drawSegmentationsAndBoxes(cv::Mat& image,
+void YOLOv11SegDetector::drawSegmentationsAndBoxes(cv::Mat& image,
     const std::vector<Segmentation>& results,
     float maskAlpha) const
 {
@@ -384,49 +389,43 @@ inline void YOLOv11SegDetector::drawSegmentationsAndBoxes(cv::Mat& image,
 }
 
 
-inline void YOLOv11SegDetector::drawSegmentations(cv::Mat& image,
+void YOLOv11SegDetector::drawSegmentations(cv::Mat& image,
     const std::vector<Segmentation>& results,
     float maskAlpha) const
 {
+    // Every mask goes into one overlay, blended once over the rows the masks cover
+    thread_local AnnotationCompositor compositor;
+    compositor.Begin(image.size());
+    const cv::Rect frame(0, 0, image.cols, image.rows);
+
     for (const auto& seg : results) {
-        if (seg.conf < CONFIDENCE_THRESHOLD_SEG) {
+        if (seg.conf < CONFIDENCE_THRESHOLD_SEG || seg.mask.empty()) {
             continue;
         }
-        cv::Scalar color = classColors[seg.classId % classColors.size()];
-
-        // -----------------------------
-        // Draw Segmentation Mask Only
-        // -----------------------------
-        if (!seg.mask.empty()) {
-            // Ensure the mask is single-channel
-            cv::Mat mask_gray;
-            if (seg.mask.channels() == 3) {
-                cv::cvtColor(seg.mask, mask_gray, cv::COLOR_BGR2GRAY);
-            }
-            else {
-                mask_gray = seg.mask.clone();
-            }
-
-            // Threshold the mask to binary (object: 255, background: 0)
-            cv::Mat mask_binary;
-            cv::threshold(mask_gray, mask_binary, 127, 255, cv::THRESH_BINARY);
-
-            // Create a colored version of the mask
-            cv::Mat colored_mask;
-            cv::cvtColor(mask_binary, colored_mask, cv::COLOR_GRAY2BGR);
-            colored_mask.setTo(color, mask_binary); // Apply color where mask is present
-
-            // Blend the colored mask with the original image
-            cv::addWeighted(image, 1.0, colored_mask, maskAlpha, 0, image);
+        // segment() leaves the mask zero outside the box, so only the box is looked at
+        const cv::Rect roi = cv::Rect(seg.box.x, seg.box.y, seg.box.width, seg.box.height)
+            & frame & cv::Rect(0, 0, seg.mask.cols, seg.mask.rows);
+        if (roi.empty()) {
+            continue;
+        }
+        cv::Mat maskGray;
+        if (seg.mask.channels() == 3) {
+            cv::cvtColor(seg.mask(roi), maskGray, cv::COLOR_BGR2GRAY);
         }
+        else {
+            maskGray = seg.mask(roi);
+        }
+        const cv::Mat maskBinary = maskGray > 127;
+        compositor.AddMask(roi, maskBinary, classColors[seg.classId % classColors.size()], maskAlpha);
     }
+    compositor.Composite(image);
 }
 
-inline std::vector<Segmentation> YOLOv11SegDetector::segment(const cv::Mat& image,
+std::vector<Segmentation> YOLOv11SegDetector::segment(const cv::Mat& image,
     float confThreshold,
     float iouThreshold)
 {
-    ScopedTimer timer("YOLOv11Seg: segment()");
+    ScopedTimer timer("YOLOv11Seg: segment()", MetricStage::Total);
 
     float* blobPtr = nullptr;
     std::vector<int64_t> inputShape = { 1, 3, inputImageShape.height, inputImageShape.width };
@@ -445,13 +444,17 @@ inline std::vector<Segmentation> YOLOv11SegDetector::segment(const cv::Mat& imag
         inputShape.size()
     );
 
-    std::vector<Ort::Value> outputs = session.Run(
-        Ort::RunOptions{ nullptr },
-        inputNames.data(),
-        &inputTensor,
-        numInputNodes,
-        outputNames.data(),
-        numOutputNodes);
+    std::vector<Ort::Value> outputs;
+    {
+        ScopedTimer runTimer("inference", MetricStage::Inference);
+        outputs = session.Run(
+            Ort::RunOptions{ nullptr },
+            inputNames.data(),
+            &inputTensor,
+            numInputNodes,
+            outputNames.data(),
+            numOutputNodes);
+    }
 
     cv::Size letterboxSize(static_cast<int>(inputShape[3]), static_cast<int>(inputShape[2]));
     return postprocess(image.size(), letterboxSize, outputs, confThreshold, iouThreshold);
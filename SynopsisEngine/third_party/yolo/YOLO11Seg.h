@@ -111,7 +111,8 @@ class YOLOv11SegDetector {
 public:
     YOLOv11SegDetector(const JString&modelPath,
                       const JString&labelsPath,
-                      bool useGPU = false);
+                      bool useGPU = false,
+                      int numThreads = 0);
 
     // Main API
     std::vector<Segmentation> segment(const cv::Mat &image,
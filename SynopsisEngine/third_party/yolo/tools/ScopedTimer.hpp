@@ -16,6 +16,7 @@
 #include <iostream>
 #include <string>
 #include "tools/Config.hpp" // Include the config file to access the flags
+#include "../../../metrics_registry.h"
 
 #ifdef TIMING_MODE
 class ScopedTimer {
@@ -23,9 +24,10 @@ public:
     /**
      * @brief Constructs a ScopedTimer to measure the duration of a named code block.
      * @param name The name of the code block being timed.
+     * @param stage Metrics stage the duration is also recorded under (always on).
      */
-    ScopedTimer(const std::string &name) 
-        : func_name(name), start(std::chrono::high_resolution_clock::now()) {}
+    ScopedTimer(const char *name, MetricStage stage = MetricStage::None)
+        : func_name(name), stage_timer(stage), start(std::chrono::high_resolution_clock::now()) {}
     
     /**
      * @brief Destructor that calculates and prints the elapsed time.
@@ -37,14 +39,18 @@ public:
     }
 
 private:
-    std::string func_name; ///< The name of the timed function.
+    const char *func_name; ///< The name of the timed function.
+    metrics::StageTimer stage_timer; ///< Records into the current metrics context.
     std::chrono::time_point<std::chrono::high_resolution_clock> start; ///< Start time point.
 };
 #else
 class ScopedTimer {
 public:
-    ScopedTimer(const std::string &name) {}
-    ~ScopedTimer() {}
+    // The name is a literal so no string is built on the hot path when printing is off
+    ScopedTimer(const char *, MetricStage stage = MetricStage::None) : stage_timer(stage) {}
+
+private:
+    metrics::StageTimer stage_timer;
 };
 #endif // TIMING_MODE
 
@@ -1,7 +1,6 @@
 #include "pch.h"
 #include "yolo_runner.h"
 #include <fstream>
-#include <tchar.h>
 
 // YOLOs-CPP headers (vendor/include in your project)
 // Detection / Segmentation / Pose
@@ -44,47 +43,49 @@ YoloRunner::~YoloRunner()
     Release();
 }
 
-bool YoloRunner::Init(YoloTask task, const TCHAR* appPath) 
+bool YoloRunner::Init(YoloTask task, const TCHAR* appPath, int intraOpThreads, bool useGPU, const TCHAR* variant)
 {
+    if (task < 0 || task >= YT_MAX || !appPath)
+        return false;
     task_ = task;
-    TCHAR fullPath[MAX_PATH];
-    _tcscpy_s(fullPath, appPath);  // Copy base path
-    // Make sure there is a trailing backslash
-    size_t len = _tcslen(fullPath);
-    if (len > 0 && fullPath[len - 1] != _T('\\')) {
-        _tcscat_s(fullPath, _T("\\"));
-    }
-    // Append relative path
-    _tcscat_s(fullPath, _T("model\\"));
-    _tcscat_s(fullPath, MODEL_FNs[static_cast<int>(task)].c_str());
-
-    TCHAR fullPathcfg[MAX_PATH];
-    _tcscpy_s(fullPathcfg, appPath);  // Copy base path
-    // Make sure there is a trailing backslash
-    len = _tcslen(fullPathcfg);
-    if (len > 0 && fullPathcfg[len - 1] != _T('\\')) {
-        _tcscat_s(fullPathcfg, _T("\\"));
+
+    // Make sure there is a trailing separator
+    JString base(appPath);
+    if (!base.empty() && base.back() != _T('\\') && base.back() != _T('/'))
+        base += VS_PATH_SEP;
+
+    JString fullPath = base + _T("model") + VS_PATH_SEP + MODEL_FNs[static_cast<int>(task)];
+    if (variant && *variant) {
+        const size_t ext = fullPath.rfind(_T(".onnx"));
+        fullPath.insert(ext == JString::npos ? fullPath.size() : ext, variant);
     }
-    // Append relative path
-    _tcscat_s(fullPathcfg, _T("cfg\\"));
-    _tcscat_s(fullPathcfg, CFG_FNs[static_cast<int>(task)].c_str());
+    JString fullPathcfg = base + _T("cfg") + VS_PATH_SEP + CFG_FNs[static_cast<int>(task)];
 
     try {
         switch (task) {
         case YT_DETECT:
-            detector_ = std::make_unique<YOLO11Detector>(fullPath, fullPathcfg, true);
+            detector_ = std::make_unique<YOLO11Detector>(fullPath, fullPathcfg, useGPU, intraOpThreads);
+            conf_ = 0.4f;
+            iou_ = 0.45f;
             break;
         case YT_CLASSIFY:
-            classifier_ = std::make_unique<YOLO11Classifier>(fullPath, fullPathcfg, true);
+            classifier_ = std::make_unique<YOLO11Classifier>(fullPath, fullPathcfg, useGPU, cv::Size(224, 224), intraOpThreads);
+            conf_ = iou_ = 0.0f;
             break;
         case YT_OBB:
-            obb_ = std::make_unique<YOLO11OBBDetector>(fullPath, fullPathcfg, true);
+            obb_ = std::make_unique<YOLO11OBBDetector>(fullPath, fullPathcfg, useGPU, intraOpThreads);
+            conf_ = 0.25f;
+            iou_ = 0.25f;
             break;
         case YT_POSE:
-            pose_ = std::make_unique<YOLO11POSEDetector>(fullPath, fullPathcfg, true);
+            pose_ = std::make_unique<YOLO11POSEDetector>(fullPath, fullPathcfg, useGPU, intraOpThreads);
+            conf_ = 0.4f;
+            iou_ = 0.5f;
             break;
         case YT_SEGMENT:
-            seg_ = std::make_unique<YOLOv11SegDetector>(fullPath, fullPathcfg, true);
+            seg_ = std::make_unique<YOLOv11SegDetector>(fullPath, fullPathcfg, useGPU, intraOpThreads);
+            conf_ = CONFIDENCE_THRESHOLD_SEG;
+            iou_ = IOU_THRESHOLD_SEG;
             break;
         default:
             return false;
@@ -94,6 +95,7 @@ bool YoloRunner::Init(YoloTask task, const TCHAR* appPath)
         std::cerr << "[YoloRunner] Load failed: " << e.what() << std::endl;
         return false;
     }
+    modelPath_ = fullPath;
     return true;
 }
 
@@ -104,6 +106,9 @@ void YoloRunner::Release()
     obb_.reset();
     pose_.reset();
     seg_.reset();
+    reid_.reset();
+    modelPath_.clear();
+    reidModelPath_.clear();
     task_ = YT_MAX; // Optional: indicate invalid
 }
 
@@ -111,6 +116,75 @@ std::vector<Detection>  YoloRunner::runDetect(const cv::Mat& frame)
 {
     if (!detector_)
         return {};
-    std::vector<Detection> result = detector_->detect(frame);
+    metrics::ContextScope scope(sink_);
+    std::vector<Detection> result = detector_->detect(frame, conf_, iou_);
     return result;
-}
\ No newline at end of file
+}
+
+std::vector<Segmentation> YoloRunner::runSegment(const cv::Mat& frame)
+{
+    if (!seg_)
+        return {};
+    metrics::ContextScope scope(sink_);
+    return seg_->segment(frame, conf_, iou_);
+}
+
+std::vector<PoseDetection> YoloRunner::runPose(const cv::Mat& frame)
+{
+    if (!pose_)
+        return {};
+    metrics::ContextScope scope(sink_);
+    return pose_->detect(frame, conf_, iou_);
+}
+
+std::vector<ObbDetection> YoloRunner::runOBB(const cv::Mat& frame)
+{
+    if (!obb_)
+        return {};
+    metrics::ContextScope scope(sink_);
+    return obb_->detect(frame, conf_, iou_);
+}
+
+std::vector<std::vector<Detection>> YoloRunner::runDetectBatch(const std::vector<cv::Mat>& frames, const int* streamIds)
+{
+    if (!detector_)
+        return std::vector<std::vector<Detection>>(frames.size());
+    metrics::ContextScope scope(sink_);
+    return detector_->detectBatch(frames, streamIds, conf_, iou_);
+}
+
+bool YoloRunner::runClassify(const cv::Mat& frame, ClassificationResult& result)
+{
+    if (!classifier_)
+        return false;
+    metrics::ContextScope scope(sink_);
+    result = classifier_->classify(frame);
+    return result.classId >= 0;
+}
+
+bool YoloRunner::InitReId(const TCHAR* appPath, int intraOpThreads, bool useGPU)
+{
+    if (!appPath)
+        return false;
+    JString base(appPath);
+    if (!base.empty() && base.back() != _T('\\') && base.back() != _T('/'))
+        base += VS_PATH_SEP;
+    const JString fullPath = base + _T("model") + VS_PATH_SEP + _T("reid.onnx");
+    try {
+        reid_ = std::make_unique<ReIdEmbedder>(fullPath, useGPU, intraOpThreads);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "[YoloRunner] Re-ID load failed: " << e.what() << std::endl;
+        return false;
+    }
+    reidModelPath_ = fullPath;
+    return true;
+}
+
+bool YoloRunner::runEmbed(const std::vector<cv::Mat>& crops, cv::Mat& embeddings)
+{
+    if (!reid_)
+        return false;
+    metrics::ContextScope scope(sink_);
+    return reid_->embed(crops, embeddings);
+}
@@ -3,13 +3,15 @@
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <vector>
-#include <tchar.h>
+#include "vs_platform.h"
 #include "yolo_define.h"
 #include "yolo/YOLO11.h"
 #include "yolo/YOLO11CLASS.h"
 #include "yolo/YOLO11-POSE.h"
 #include "yolo/YOLO11-OBB.h"
 #include "yolo/YOLO11Seg.h"
+#include "yolo/ReIdEmbedder.h"
+#include "../metrics_registry.h"
 
 
 /*
@@ -49,15 +51,51 @@ public:
     YoloRunner() = default;
     ~YoloRunner();
 
-    bool Init(YoloTask task, const TCHAR* appPath);
+    // Loads <appPath>/model/<file>[<variant>].onnx and <appPath>/cfg/<labels>.
+    // intraOpThreads <= 0 keeps the detector default, variant is e.g. _T("-fp16").
+    bool Init(YoloTask task, const TCHAR* appPath, int intraOpThreads = 0, bool useGPU = true, const TCHAR* variant = nullptr);
     void Release();
 
+    YoloTask task() const { return task_; }
+    // Model file loaded by Init() and the score / NMS thresholds the run* calls apply
+    const JString& modelPath() const { return modelPath_; }
+    float confThreshold() const { return conf_; }
+    float iouThreshold() const { return iou_; }
+
     std::vector<Detection> runDetect(const cv::Mat& frame);
+    // One inference call for all frames when the detect model has a dynamic batch axis.
+    // streamIds (optional, one per frame) picks the metrics stream of each frame.
+    std::vector<std::vector<Detection>> runDetectBatch(const std::vector<cv::Mat>& frames, const int* streamIds = nullptr);
+    bool supportsBatch() const { return detector_ && detector_->supportsBatch(); }
+    std::vector<Segmentation> runSegment(const cv::Mat& frame);
+    std::vector<PoseDetection> runPose(const cv::Mat& frame);
+    std::vector<ObbDetection> runOBB(const cv::Mat& frame);
+    bool runClassify(const cv::Mat& frame, ClassificationResult& result);
+
+    // Loads <appPath>/model/reid.onnx next to (or instead of) the task model
+    bool InitReId(const TCHAR* appPath, int intraOpThreads = 0, bool useGPU = true);
+    bool hasReId() const { return reid_ != nullptr; }
+    // Model file loaded by InitReId(); empty without one
+    const JString& reidModelPath() const { return reidModelPath_; }
+    // Appearance embeddings of the crops in as few session runs as the model's batch allows
+    bool runEmbed(const std::vector<cv::Mat>& crops, cv::Mat& embeddings);
+
+    // Stage latencies of every run* call, keyed by the caller's metrics::threadStream()
+    MetricsRegistry& metrics() { return *sink_; }
+    // Records into another registry instead (sessions of one scheduler share theirs)
+    void setMetricsSink(MetricsRegistry* sink) { sink_ = sink ? sink : &metrics_; }
 private:
-    YoloTask task_;
+    YoloTask task_ = YT_MAX;
+    JString modelPath_;
+    JString reidModelPath_;
+    float conf_ = 0.0f;
+    float iou_ = 0.0f;
     std::unique_ptr<YOLO11Detector> detector_;
     std::unique_ptr<YOLO11Classifier> classifier_;
     std::unique_ptr<YOLO11OBBDetector> obb_;
     std::unique_ptr<YOLO11POSEDetector> pose_;
     std::unique_ptr<YOLOv11SegDetector> seg_;
+    std::unique_ptr<ReIdEmbedder> reid_;
+    MetricsRegistry metrics_;
+    MetricsRegistry* sink_ = &metrics_;
 };
@@ -0,0 +1,106 @@
+#include "pch.h"
+#include "tube_attributes.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int kColorSamples = 48;       // per side of the crop
+const int kBlackValue = 50;         // HSV thresholds on 0..255 scales
+const int kGreySaturation = 50;
+const int kDarkGreyValue = 110;
+const int kLightGreyValue = 190;
+
+static_assert(kTubeColorBins == VS_COLOR_COUNT, "tube store bins follow VS_COLOR_*");
+
+int colorBin(int b, int g, int r)
+{
+    const int maxc = std::max(b, std::max(g, r));
+    const int minc = std::min(b, std::min(g, r));
+    if (maxc < kBlackValue)
+        return VS_COLOR_BLACK;
+    const int delta = maxc - minc;
+    if (delta * 255 < kGreySaturation * maxc) {
+        if (maxc < kDarkGreyValue)
+            return VS_COLOR_DARK_GREY;
+        return maxc < kLightGreyValue ? VS_COLOR_LIGHT_GREY : VS_COLOR_WHITE;
+    }
+    // Hue in degrees, as in cv::COLOR_BGR2HSV_FULL but without the table
+    int hue;
+    if (maxc == r)
+        hue = 60 * (g - b) / delta;
+    else if (maxc == g)
+        hue = 120 + 60 * (b - r) / delta;
+    else
+        hue = 240 + 60 * (r - g) / delta;
+    if (hue < 0)
+        hue += 360;
+    return ((hue + 15) / 30) % 12;      // red centred on 0 degrees
+}
+
+} // namespace
+
+void ColorHistogram(const cv::Mat& crop, const cv::Mat& mask, uint16_t bins[kTubeColorBins])
+{
+    std::fill(bins, bins + kTubeColorBins, 0);
+    if (crop.empty() || crop.type() != CV_8UC3)
+        return;
+    const bool masked = !mask.empty() && mask.size() == crop.size() && mask.type() == CV_8UC1;
+    const int stepX = std::max(1, crop.cols / kColorSamples);
+    const int stepY = std::max(1, crop.rows / kColorSamples);
+
+    uint32_t counts[kTubeColorBins] = {};
+    uint32_t total = 0;
+    for (int y = stepY / 2; y < crop.rows; y += stepY) {
+        const uchar* px = crop.ptr<uchar>(y);
+        const uchar* m = masked ? mask.ptr<uchar>(y) : nullptr;
+        for (int x = stepX / 2; x < crop.cols; x += stepX) {
+            if (m && !m[x])
+                continue;
+            ++counts[colorBin(px[3 * x], px[3 * x + 1], px[3 * x + 2])];
+            ++total;
+        }
+    }
+    if (total == 0)
+        return;
+    for (int b = 0; b < kTubeColorBins; ++b)
+        bins[b] = static_cast<uint16_t>(counts[b] * 1000u / total);
+}
+
+int DominantColor(const TubeSummary& t)
+{
+    const uint32_t* best = std::max_element(t.colors, t.colors + kTubeColorBins);
+    return *best > 0 ? static_cast<int>(best - t.colors) : -1;
+}
+
+double ColorShare(const TubeSummary& t, int bin)
+{
+    if (bin < 0 || bin >= kTubeColorBins)
+        return 0.0;
+    uint64_t sum = 0;
+    for (uint32_t c : t.colors)
+        sum += c;
+    return sum > 0 ? static_cast<double>(t.colors[bin]) / sum : 0.0;
+}
+
+double TubeSpeed(const TubeSummary& t, double fps)
+{
+    const int64_t frames = t.lastFrame - t.firstFrame;
+    return frames > 0 && fps > 0.0 ? t.pathLength * fps / frames : 0.0;
+}
+
+double TubeHeading(const TubeSummary& t)
+{
+    const double dx = t.lastX - t.firstX;
+    const double dy = t.lastY - t.firstY;
+    const double size = std::max(1.0f, std::min(t.meanWidth, t.meanHeight));
+    if (std::hypot(dx, dy) < size)
+        return -1.0;
+    const double deg = std::atan2(dy, dx) * 180.0 / CV_PI;
+    return deg < 0.0 ? deg + 360.0 : deg;
+}
+
+double TubeAreaStdDev(const TubeSummary& t)
+{
+    return t.frameCount > 1 ? std::sqrt(std::max(0.0f, t.areaM2) / (t.frameCount - 1)) : 0.0;
+}
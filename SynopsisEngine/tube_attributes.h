@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "vs_synopsis.h"
+#include "tube_store.h"
+
+/**
+ * Per-tube attributes for filtering, accumulated while the tube is written.
+ *
+ * TubeBuilder computes a colour histogram on each object's crop (the ROI it encodes
+ * anyway) and the store folds it, the box size and the box centre into the tube's
+ * TubeSummary as running sums, so a tube costs the same few hundred bytes however long it
+ * lives and nothing is decoded again to filter by colour, size, speed or heading.
+ */
+
+// Tag TubeIndex gives the tubes showing a colour (see TubeIndex::Add)
+inline uint32_t ColorAttribute(int bin) { return 0x100u + static_cast<uint32_t>(bin); }
+
+// Per-mille of the object's pixels in each VS_COLOR_* bin, sampled on a grid of at most
+// about 48x48 points; mask (CV_8UC1 of the crop size, non-zero = object) may be empty.
+// All zero when no pixel qualifies.
+void ColorHistogram(const cv::Mat& crop, const cv::Mat& mask, uint16_t bins[kTubeColorBins]);
+
+// VS_COLOR_* bin holding most of the tube's pixels over its life, -1 without colour data
+int DominantColor(const TubeSummary& t);
+// Share (0..1) of one bin in the tube's histogram
+double ColorShare(const TubeSummary& t, int bin);
+// Mean speed of the box centre in pixels per second
+double TubeSpeed(const TubeSummary& t, double fps);
+// Direction of the net displacement in degrees, 0 = right, 90 = down; -1 if it moved less than a box
+double TubeHeading(const TubeSummary& t);
+// Standard deviation of the box area over the tube
+double TubeAreaStdDev(const TubeSummary& t);
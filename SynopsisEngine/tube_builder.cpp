@@ -0,0 +1,184 @@
+#include "pch.h"
+#include "tube_builder.h"
+#include <algorithm>
+#include "yolo_define.h"
+#include "result_block.h"
+#include "tube_attributes.h"
+#include "Logger.h"
+
+TubeBuilder::TubeBuilder()
+    : TubeBuilder(Options())
+{
+}
+
+TubeBuilder::TubeBuilder(const Options& options)
+    : options_(options), tracker_(options.tracker)
+{
+}
+
+bool TubeBuilder::Open(const std::string& pathUtf8, cv::Size frameSize, double fps)
+{
+    Close();
+    open_.clear();
+    tracker_.reset();
+    tracker_.setNextId(options_.firstTrackId);
+
+    TubeStoreInfo info;
+    info.frameSize = frameSize;
+    info.fps = fps;
+    info.jpegQuality = options_.jpegQuality;
+    info.chunkBytes = options_.chunkBytes;
+    return store_.Open(pathUtf8, info);
+}
+
+bool TubeBuilder::Resume(const std::string& pathUtf8, uint64_t validBytes)
+{
+    Close();
+    open_.clear();
+    tracker_.reset();
+    if (!store_.Resume(pathUtf8, validBytes, options_.chunkBytes))
+        return false;
+
+    int nextId = options_.firstTrackId;
+    for (const TubeSummary& t : store_.tubes())
+        nextId = std::max(nextId, t.trackId + 1);
+    tracker_.setNextId(nextId);
+    return true;
+}
+
+uint64_t TubeBuilder::Checkpoint()
+{
+    return store_.Flush() ? store_.bytesWritten() : 0;
+}
+
+bool TubeBuilder::Close()
+{
+    open_.clear();
+    return store_.Close();
+}
+
+void TubeBuilder::closeStale(int64_t frameIndex)
+{
+    for (auto it = open_.begin(); it != open_.end();) {
+        if (frameIndex - it->second.lastFrame > options_.maxGap)
+            it = open_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void TubeBuilder::Add(const cv::Mat& frame, int64_t frameIndex, double timestampMs, std::vector<TubeObservation>& objects)
+{
+    if (!store_.IsOpen() || frame.empty())
+        return;
+    const cv::Rect full(0, 0, frame.cols, frame.rows);
+
+    // Crops are taken at the clipped box; objects entirely outside the frame are dropped
+    objects.erase(std::remove_if(objects.begin(), objects.end(), [&](TubeObservation& o) {
+        const cv::Rect clipped = o.box & full;
+        if (clipped != o.box && !o.mask.empty() && o.mask.size() == o.box.size())
+            o.mask = o.mask(cv::Rect(clipped.x - o.box.x, clipped.y - o.box.y, clipped.width, clipped.height));
+        o.box = clipped;
+        return o.box.empty();
+    }), objects.end());
+
+    const bool needTracker = std::any_of(objects.begin(), objects.end(), [](const TubeObservation& o) { return o.trackId < 0; });
+    if (needTracker) {
+        trackBoxes_.clear();
+        trackClasses_.clear();
+        for (const TubeObservation& o : objects) {
+            trackBoxes_.push_back(o.box);
+            trackClasses_.push_back(o.classId);
+        }
+        tracker_.update(frameIndex, trackBoxes_, trackClasses_, trackIds_);
+        for (size_t i = 0; i < objects.size(); ++i)
+            objects[i].trackId = trackIds_[i];
+    }
+
+    // Encoding dominates; objects of one frame are independent
+    const int n = static_cast<int>(objects.size());
+    if (encoded_.size() < objects.size())
+        encoded_.resize(objects.size());
+    const std::vector<int> jpegParams = { cv::IMWRITE_JPEG_QUALITY, options_.jpegQuality };
+    cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+            const TubeObservation& o = objects[i];
+            Encoded& e = encoded_[i];
+            e.runs.clear();
+            if (!o.mask.empty() && o.mask.size() == o.box.size() && o.mask.type() == CV_8UC1)
+                EncodeMaskRLE(o.mask, e.runs);
+            const cv::Mat roi = frame(o.box);
+            if (!cv::imencode(".jpg", roi, e.crop, jpegParams))
+                e.crop.clear();
+            ColorHistogram(roi, o.mask, e.colors);
+        }
+    });
+
+    for (int i = 0; i < n; ++i) {
+        const TubeObservation& o = objects[i];
+        auto it = open_.find(o.trackId);
+        if (it == open_.end())
+            it = open_.emplace(o.trackId, OpenTube{ store_.NewTube(o.trackId, o.classId), frameIndex }).first;
+        it->second.lastFrame = frameIndex;
+        const Encoded& e = encoded_[i];
+        store_.Append(it->second.tubeId, frameIndex, timestampMs, o.box, o.conf,
+            reinterpret_cast<const uint8_t*>(e.runs.data()), e.runs.size() * sizeof(uint32_t), e.crop.data(), e.crop.size(),
+            e.colors);
+    }
+    closeStale(frameIndex);
+}
+
+void TubeBuilder::AddResult(const cv::Mat& frame, const vsResultHeader* r, int64_t frameIndex, double timestampMs)
+{
+    fromBlock_.clear();
+    if (r && r->magic == VS_RESULT_MAGIC) {
+        const uint8_t* base = reinterpret_cast<const uint8_t*>(r) + r->objectsOffset;
+        for (int i = 0; i < r->count; ++i) {
+            const uint8_t* rec = base + static_cast<size_t>(i) * r->objectStride;
+            TubeObservation o;
+            switch (r->task) {
+            case YT_DETECT: {
+                const vsDetObject& d = *reinterpret_cast<const vsDetObject*>(rec);
+                o.box = cv::Rect(d.box.x, d.box.y, d.box.width, d.box.height);
+                o.classId = d.classId;
+                o.conf = d.conf;
+                break;
+            }
+            case YT_SEGMENT: {
+                const vsSegObject& s = *reinterpret_cast<const vsSegObject*>(rec);
+                // The mask covers maskRoi, which is the box clipped to the image
+                o.box = cv::Rect(s.maskRoi.x, s.maskRoi.y, s.maskRoi.width, s.maskRoi.height);
+                if (o.box.empty())
+                    o.box = cv::Rect(s.box.x, s.box.y, s.box.width, s.box.height);
+                else if (!DecodeSegmentMask(r, s, o.mask))
+                    o.mask.release();
+                o.classId = s.classId;
+                o.conf = s.conf;
+                break;
+            }
+            case YT_POSE: {
+                const vsPoseObject& p = *reinterpret_cast<const vsPoseObject*>(rec);
+                o.box = cv::Rect(p.box.x, p.box.y, p.box.width, p.box.height);
+                o.classId = p.classId;
+                o.conf = p.conf;
+                break;
+            }
+            case YT_OBB: {
+                const vsObbObject& b = *reinterpret_cast<const vsObbObject*>(rec);
+                cv::Point2f pts[4];
+                for (int k = 0; k < 4; ++k)
+                    pts[k] = cv::Point2f(b.corners[2 * k], b.corners[2 * k + 1]);
+                o.box = cv::boundingRect(std::vector<cv::Point2f>(pts, pts + 4));
+                o.classId = b.classId;
+                o.conf = b.conf;
+                break;
+            }
+            default:
+                continue;
+            }
+            fromBlock_.push_back(std::move(o));
+        }
+    }
+    // An empty frame still ages the open tubes and the tracker
+    Add(frame, frameIndex, timestampMs, fromBlock_);
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_result.h"
+#include "iou_tracker.h"
+#include "tube_store.h"
+
+/**
+ * @brief One object of an analysed frame, as handed to TubeBuilder.
+ */
+struct TubeObservation {
+    cv::Rect box;
+    int classId = -1;
+    float conf = 0.0f;
+    int trackId = -1;       // -1 = let the builder's IoU tracker assign one
+    cv::Mat mask;           // optional CV_8UC1 of the box size, non-zero = object
+};
+
+/**
+ * @brief Turns per-frame tracked objects into tubes in a TubeStoreWriter.
+ *
+ * Every observation becomes one tube frame: the crop of the box is JPEG-encoded and the
+ * mask run-length encoded, both at box resolution, and its colour histogram taken from the
+ * same crop (tube_attributes.h), in parallel across the frame's objects.
+ * A track's tube stays open while the track keeps appearing and is closed after maxGap
+ * frames without it; a track that comes back later starts a new tube. Frames without track
+ * ids go through an IouTracker first.
+ *
+ * Memory is the open tubes plus one store chunk; finished tubes only keep their summary.
+ * Not thread-safe; one builder per source, fed in frame order.
+ */
+class TubeBuilder {
+public:
+    struct Options {
+        int maxGap = 15;                // frames a track may be missing before its tube closes
+        int jpegQuality = 90;
+        size_t chunkBytes = 4 << 20;
+        int firstTrackId = 0;           // tracker ids start here (keeps builders of one source apart)
+        IouTracker::Options tracker;
+    };
+
+    TubeBuilder();
+    explicit TubeBuilder(const Options& options);
+    ~TubeBuilder() { Close(); }
+
+    TubeBuilder(const TubeBuilder&) = delete;
+    TubeBuilder& operator=(const TubeBuilder&) = delete;
+
+    bool Open(const std::string& pathUtf8, cv::Size frameSize, double fps);
+    // Continues a store cut off at validBytes (see TubeStoreWriter::Resume). Tubes that were
+    // open then stay closed; objects still in view start new tubes, with fresh track ids.
+    bool Resume(const std::string& pathUtf8, uint64_t validBytes);
+    // Puts everything added so far on disk; returns the store size to resume from, 0 on error
+    uint64_t Checkpoint();
+    // Closes every tube and finalizes the store; safe to call twice
+    bool Close();
+
+    // Adds the objects of one BGR frame; trackIds are filled in when the tracker assigns them
+    void Add(const cv::Mat& frame, int64_t frameIndex, double timestampMs, std::vector<TubeObservation>& objects);
+    // Same for a result block (detect, segment, pose or OBB; OBBs use their bounding box)
+    void AddResult(const cv::Mat& frame, const vsResultHeader* result, int64_t frameIndex, double timestampMs);
+
+    // Objects of the last AddResult() call, boxes clipped to the frame
+    const std::vector<TubeObservation>& lastObjects() const { return fromBlock_; }
+    size_t openTubes() const { return open_.size(); }
+    size_t tubeCount() const { return store_.tubes().size(); }
+    const TubeStoreWriter& store() const { return store_; }
+
+private:
+    struct OpenTube {
+        uint32_t tubeId;
+        int64_t lastFrame;
+    };
+    struct Encoded {
+        std::vector<uchar> crop;
+        std::vector<uint32_t> runs;
+        uint16_t colors[kTubeColorBins];
+    };
+
+    void closeStale(int64_t frameIndex);
+
+    Options options_;
+    TubeStoreWriter store_;
+    IouTracker tracker_;
+    std::unordered_map<int, OpenTube> open_;    // trackId -> tube
+    std::vector<TubeObservation> fromBlock_;
+    std::vector<Encoded> encoded_;              // per observation, buffers reused across frames
+    std::vector<cv::Rect> trackBoxes_;
+    std::vector<int> trackClasses_;
+    std::vector<int> trackIds_;
+};
@@ -0,0 +1,265 @@
+#include "pch.h"
+#include "tube_index.h"
+#include <algorithm>
+#include "tube_attributes.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+const int kZoneRaster = 4;      // zone polygons are drawn at this many pixels per grid cell
+
+inline int lowestBit(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, v);
+    return static_cast<int>(idx);
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+} // namespace
+
+// ============================================================================
+// Bitmap
+// ============================================================================
+void TubeIndex::Bitmap::set(uint32_t bit)
+{
+    if ((bit >> 6) >= words_.size())
+        words_.resize((bit >> 6) + 1, 0);
+    words_[bit >> 6] |= uint64_t(1) << (bit & 63);
+}
+
+void TubeIndex::Bitmap::orWith(const Bitmap& other)
+{
+    if (other.words_.size() > words_.size())
+        words_.resize(other.words_.size(), 0);
+    for (size_t i = 0; i < other.words_.size(); ++i)
+        words_[i] |= other.words_[i];
+}
+
+void TubeIndex::Bitmap::andWith(const Bitmap& other)
+{
+    const size_t common = std::min(words_.size(), other.words_.size());
+    for (size_t i = 0; i < common; ++i)
+        words_[i] &= other.words_[i];
+    std::fill(words_.begin() + common, words_.end(), 0);
+}
+
+// ============================================================================
+// Building
+// ============================================================================
+void TubeIndex::Clear()
+{
+    count_ = 0;
+    frameCounts_.clear();
+    lifetimes_.clear();
+    subtreeLast_.clear();
+    treeDirty_ = false;
+    classes_.clear();
+    attributes_.clear();
+    cells_.clear();
+}
+
+void TubeIndex::Build(const TubeStoreReader& store)
+{
+    Clear();
+    frameSize_ = store.info().frameSize;
+    lifetimes_.reserve(store.tubes().size());
+    for (const TubeSummary& t : store.tubes())
+        Add(t);
+    buildTree();
+}
+
+void TubeIndex::Add(const TubeSummary& tube)
+{
+    if (tube.frameCount == 0)
+        return;
+    const uint32_t id = tube.tubeId;
+    count_ = std::max<size_t>(count_, static_cast<size_t>(id) + 1);
+    if (frameCounts_.size() < count_)
+        frameCounts_.resize(count_, 0);
+    frameCounts_[id] = tube.frameCount;
+
+    lifetimes_.push_back({ tube.firstFrame, tube.lastFrame, id });
+    treeDirty_ = true;
+    classes_[tube.classId].set(id);
+
+    const int dominant = DominantColor(tube);
+    for (int b = 0; b < kTubeColorBins; ++b) {
+        if (b == dominant || ColorShare(tube, b) >= kColorShare)
+            Tag(id, ColorAttribute(b));
+    }
+
+    if (cells_.empty())
+        cells_.resize(kTubeGridSize * kTubeGridSize);
+    for (int w = 0; w < 4; ++w) {
+        for (uint64_t bits = tube.cells[w]; bits; bits &= bits - 1)
+            cells_[w * 64 + lowestBit(bits)].set(id);
+    }
+}
+
+void TubeIndex::Tag(uint32_t tubeId, uint32_t attribute)
+{
+    attributes_[attribute].set(tubeId);
+}
+
+void TubeIndex::buildTree()
+{
+    std::sort(lifetimes_.begin(), lifetimes_.end(), [](const Lifetime& a, const Lifetime& b) { return a.first < b.first; });
+    subtreeLast_.assign(lifetimes_.size(), INT64_MIN);
+    // Node of [begin, end) is its middle element; children are the two halves
+    struct Builder {
+        const std::vector<Lifetime>& items;
+        std::vector<int64_t>& last;
+        int64_t operator()(size_t begin, size_t end) const
+        {
+            if (begin >= end)
+                return INT64_MIN;
+            const size_t mid = begin + (end - begin) / 2;
+            last[mid] = std::max(items[mid].last, std::max((*this)(begin, mid), (*this)(mid + 1, end)));
+            return last[mid];
+        }
+    };
+    Builder{ lifetimes_, subtreeLast_ }(0, lifetimes_.size());
+    treeDirty_ = false;
+}
+
+// ============================================================================
+// Query
+// ============================================================================
+void TubeIndex::queryTree(size_t begin, size_t end, int64_t from, int64_t to, std::vector<uint32_t>& out) const
+{
+    if (begin >= end)
+        return;
+    const size_t mid = begin + (end - begin) / 2;
+    if (subtreeLast_[mid] < from)
+        return;
+    queryTree(begin, mid, from, to, out);
+    if (lifetimes_[mid].first > to)
+        return;                 // so does everything to the right
+    if (lifetimes_[mid].last >= from)
+        out.push_back(lifetimes_[mid].tubeId);
+    queryTree(mid + 1, end, from, to, out);
+}
+
+void TubeIndex::zoneCells(const std::vector<cv::Point>& zone, uint64_t cells[4]) const
+{
+    std::fill(cells, cells + 4, 0);
+    if (frameSize_.width <= 0 || frameSize_.height <= 0) {
+        std::fill(cells, cells + 4, ~uint64_t(0));
+        return;
+    }
+    // Drawn filled and outlined, so thin or tiny zones still mark the cells they cross
+    const int side = kTubeGridSize * kZoneRaster;
+    std::vector<cv::Point> scaled;
+    scaled.reserve(zone.size());
+    for (const cv::Point& p : zone) {
+        scaled.emplace_back(static_cast<int>(static_cast<int64_t>(p.x) * side * 16 / frameSize_.width),
+            static_cast<int>(static_cast<int64_t>(p.y) * side * 16 / frameSize_.height));
+    }
+    cv::Mat raster = cv::Mat::zeros(side, side, CV_8UC1);
+    const cv::Point* pts = scaled.data();
+    const int n = static_cast<int>(scaled.size());
+    cv::fillPoly(raster, &pts, &n, 1, cv::Scalar(255), cv::LINE_8, 4);
+    cv::polylines(raster, &pts, &n, 1, true, cv::Scalar(255), 1, cv::LINE_8, 4);
+
+    for (int cy = 0; cy < kTubeGridSize; ++cy) {
+        for (int cx = 0; cx < kTubeGridSize; ++cx) {
+            const cv::Mat block = raster(cv::Rect(cx * kZoneRaster, cy * kZoneRaster, kZoneRaster, kZoneRaster));
+            if (cv::countNonZero(block) > 0) {
+                const int bit = cy * kTubeGridSize + cx;
+                cells[bit >> 6] |= uint64_t(1) << (bit & 63);
+            }
+        }
+    }
+}
+
+std::vector<uint32_t> TubeIndex::Query(const TubeQuery& query)
+{
+    // Bitmap filters first; `filtered` stays false while every tube still qualifies
+    Bitmap candidates;
+    bool filtered = false;
+    auto restrict = [&](const Bitmap& b) {
+        if (filtered) {
+            candidates.andWith(b);
+        }
+        else {
+            candidates = b;
+            candidates.resize(count_);
+            filtered = true;
+        }
+    };
+
+    if (!query.classes.empty()) {
+        Bitmap any;
+        for (int c : query.classes) {
+            auto it = classes_.find(c);
+            if (it != classes_.end())
+                any.orWith(it->second);
+        }
+        restrict(any);
+    }
+    if (query.colors != 0) {
+        Bitmap any;
+        for (int b = 0; b < kTubeColorBins; ++b) {
+            auto it = (query.colors >> b & 1) ? attributes_.find(ColorAttribute(b)) : attributes_.end();
+            if (it != attributes_.end())
+                any.orWith(it->second);
+        }
+        restrict(any);
+    }
+    for (uint32_t a : query.attributes) {
+        auto it = attributes_.find(a);
+        if (it == attributes_.end())
+            return {};
+        restrict(it->second);
+    }
+    if (!query.zone.empty() && !cells_.empty()) {
+        uint64_t zone[4];
+        zoneCells(query.zone, zone);
+        Bitmap any;
+        for (int w = 0; w < 4; ++w) {
+            for (uint64_t bits = zone[w]; bits; bits &= bits - 1)
+                any.orWith(cells_[w * 64 + lowestBit(bits)]);
+        }
+        restrict(any);
+    }
+
+    auto accept = [&](uint32_t id) {
+        return id < count_ && frameCounts_[id] > 0 && frameCounts_[id] >= query.minFrames && (!filtered || candidates.test(id));
+    };
+
+    std::vector<uint32_t> out;
+    if (query.fromFrame > 0 || query.toFrame != INT64_MAX) {
+        if (treeDirty_)
+            buildTree();
+        std::vector<uint32_t> alive;
+        queryTree(0, lifetimes_.size(), query.fromFrame, query.toFrame, alive);
+        for (uint32_t id : alive) {
+            if (accept(id))
+                out.push_back(id);
+        }
+        std::sort(out.begin(), out.end());
+    }
+    else if (filtered) {
+        const std::vector<uint64_t>& words = candidates.words();
+        for (size_t w = 0; w < words.size(); ++w) {
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                const uint32_t id = static_cast<uint32_t>(w * 64 + lowestBit(bits));
+                if (accept(id))
+                    out.push_back(id);
+            }
+        }
+    }
+    else {
+        for (uint32_t id = 0; id < count_; ++id) {
+            if (accept(id))
+                out.push_back(id);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "tube_store.h"
+
+/**
+ * @brief What to look for in a TubeIndex; every set field must hold.
+ */
+struct TubeQuery {
+    int64_t fromFrame = 0;                  // tubes alive at any frame of [fromFrame, toFrame]
+    int64_t toFrame = INT64_MAX;
+    std::vector<int> classes;               // any of these, empty = every class
+    std::vector<uint32_t> attributes;       // all of these (TubeIndex::Tag), empty = no constraint
+    uint32_t colors = 0;                    // shows any of these (1 << VS_COLOR_*) colours, 0 = any
+    std::vector<cv::Point> zone;            // polygon in frame pixels the trajectory touches, empty = anywhere
+    uint32_t minFrames = 0;
+};
+
+/**
+ * @brief In-memory query index over the tubes of a store.
+ *
+ * Lifetimes sit in an interval tree (intervals sorted by first frame, laid out as an
+ * implicit balanced tree with the latest last frame of every subtree), so a time window
+ * costs O(log n + hits). Classes, attributes (colours included) and the kTubeGridSize^2
+ * trajectory cells of TubeSummary::cells each own a bitmap over tube ids; a query ANDs the
+ * class, colour, attribute and zone bitmaps and walks the interval tree only when the
+ * window is bounded.
+ *
+ * Everything comes from the summaries in the store's index, which the writer fills during
+ * analysis, so building never reads a record. Zones are as precise as the grid: a tube is
+ * returned when one of its boxes shares a cell with the polygon.
+ *
+ * Not thread-safe; Query() rebuilds the interval tree after Add().
+ */
+class TubeIndex {
+public:
+    static constexpr double kColorShare = 0.25;
+
+    void Build(const TubeStoreReader& store);
+    void Add(const TubeSummary& tube);
+    // Attaches an attribute key to a tube; Add() already tags the colours (ColorAttribute)
+    // making up at least kColorShare of it
+    void Tag(uint32_t tubeId, uint32_t attribute);
+    void Clear();
+
+    // Matching tube ids, ascending; ready for SynopsisOptimizer::LoadTubes
+    std::vector<uint32_t> Query(const TubeQuery& query);
+
+    size_t size() const { return count_; }
+    void setFrameSize(cv::Size frameSize) { frameSize_ = frameSize; }
+
+private:
+    class Bitmap {
+    public:
+        void set(uint32_t bit);
+        bool test(uint32_t bit) const { return (bit >> 6) < words_.size() && (words_[bit >> 6] >> (bit & 63) & 1); }
+        void resize(size_t bits) { words_.resize((bits + 63) / 64, 0); }
+        void orWith(const Bitmap& other);
+        void andWith(const Bitmap& other);
+        const std::vector<uint64_t>& words() const { return words_; }
+    private:
+        std::vector<uint64_t> words_;
+    };
+
+    struct Lifetime {
+        int64_t first;
+        int64_t last;
+        uint32_t tubeId;
+    };
+
+    void buildTree();
+    void queryTree(size_t begin, size_t end, int64_t from, int64_t to, std::vector<uint32_t>& out) const;
+    void zoneCells(const std::vector<cv::Point>& zone, uint64_t cells[4]) const;
+
+    cv::Size frameSize_;
+    size_t count_ = 0;                          // tubes added; ids are below this
+    std::vector<uint32_t> frameCounts_;         // per tube id
+    std::vector<Lifetime> lifetimes_;           // sorted by first once built
+    std::vector<int64_t> subtreeLast_;          // latest last frame under each node of lifetimes_
+    bool treeDirty_ = false;
+    std::unordered_map<int, Bitmap> classes_;
+    std::unordered_map<uint32_t, Bitmap> attributes_;
+    std::vector<Bitmap> cells_;                 // kTubeGridSize^2 cells
+};
@@ -0,0 +1,342 @@
+#include "pch.h"
+#include "tube_merger.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint32_t kCacheMagic = 0x4D455356u;     // 'VSEM'
+const uint32_t kCacheVersion = 2;
+
+// Cache file: this header, then (uint32 tube id, float[dimension]) per embedded tube
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dimension;
+    uint32_t tubeCount;
+    uint64_t storeBytes;        // size of the store the ids refer to
+    uint64_t modelSize;         // re-ID model the embeddings come from
+    int64_t modelTime;
+    uint64_t modelPathHash;
+};
+
+uint64_t fnv1a(const std::string& s)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : s) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Header fields naming the model; zero size and time when the file cannot be read
+void modelFingerprint(const std::string& pathUtf8, CacheHeader& h)
+{
+    std::error_code ec;
+    const fs::path p = fs::u8path(pathUtf8);
+    h.modelSize = pathUtf8.empty() ? 0 : fs::file_size(p, ec);
+    if (ec)
+        h.modelSize = 0;
+    h.modelTime = pathUtf8.empty() ? 0 : static_cast<int64_t>(fs::last_write_time(p, ec).time_since_epoch().count());
+    if (ec)
+        h.modelTime = 0;
+    h.modelPathHash = fnv1a(pathUtf8);
+}
+
+struct Pair {
+    float similarity;
+    uint32_t earlier;
+    uint32_t later;
+};
+
+// Scales a row to unit length; false if it is all zeros
+bool normalizeRow(float* row, int dimension)
+{
+    double norm = 0.0;
+    for (int d = 0; d < dimension; ++d)
+        norm += static_cast<double>(row[d]) * row[d];
+    if (norm <= 0.0)
+        return false;
+    const float scale = static_cast<float>(1.0 / std::sqrt(norm));
+    for (int d = 0; d < dimension; ++d)
+        row[d] *= scale;
+    return true;
+}
+
+} // namespace
+
+TubeMerger::TubeMerger()
+    : TubeMerger(Options())
+{
+}
+
+TubeMerger::TubeMerger(const Options& options)
+    : options_(options)
+{
+    options_.samplesPerTube = std::max(1, options_.samplesPerTube);
+    options_.batchSize = std::max(1, options_.batchSize);
+}
+
+// ============================================================================
+// Embedding
+// ============================================================================
+bool TubeMerger::embedTubes(const TubeStoreReader& store, uint64_t storeBytes, const std::string& cacheUtf8, EmbedFn& embed,
+    ProgressFn& progress, cv::Mat& embeddings)
+{
+    const std::vector<TubeSummary>& tubes = store.tubes();
+    const fs::path cachePath = fs::u8path(cacheUtf8);
+    int dimension = 0;
+    CacheHeader model = {};
+    modelFingerprint(options_.modelPathUtf8, model);
+
+    // Whatever an earlier run of the same store and model got through; a torn last record is cut off
+    {
+        std::ifstream in(cachePath, std::ios::binary);
+        CacheHeader h = {};
+        if (in.read(reinterpret_cast<char*>(&h), sizeof(h)) && h.magic == kCacheMagic && h.version == kCacheVersion
+            && h.tubeCount == tubes.size() && h.storeBytes == storeBytes && h.dimension > 0 && h.modelSize == model.modelSize
+            && h.modelTime == model.modelTime && h.modelPathHash == model.modelPathHash) {
+            dimension = static_cast<int>(h.dimension);
+            embeddings = cv::Mat::zeros(static_cast<int>(tubes.size()), dimension, CV_32F);
+            uint64_t valid = sizeof(h);
+            std::vector<float> row(dimension);
+            uint32_t id = 0;
+            while (in.read(reinterpret_cast<char*>(&id), sizeof(id))
+                && in.read(reinterpret_cast<char*>(row.data()), row.size() * sizeof(float))) {
+                valid += sizeof(id) + row.size() * sizeof(float);
+                if (id >= tubes.size())
+                    continue;
+                std::copy(row.begin(), row.end(), embeddings.ptr<float>(static_cast<int>(id)));
+                ++stats_.cached;
+            }
+            in.close();
+            std::error_code ec;
+            fs::resize_file(cachePath, valid, ec);
+        }
+    }
+    std::ofstream cache;
+    if (dimension > 0)
+        cache.open(cachePath, std::ios::binary | std::ios::app);
+
+    auto cached = [&](uint32_t id) {
+        if (dimension == 0)
+            return false;
+        const float* row = embeddings.ptr<float>(static_cast<int>(id));
+        return std::any_of(row, row + dimension, [](float v) { return v != 0.0f; });
+    };
+    std::vector<uint32_t> todo;
+    for (const TubeSummary& t : tubes) {
+        if (t.frameCount >= static_cast<uint32_t>(std::max(1, options_.minFrames)) && !cached(t.tubeId))
+            todo.push_back(t.tubeId);
+    }
+
+    std::vector<cv::Mat> crops;
+    std::vector<uint32_t> owners;           // tube of each crop
+    std::vector<uint32_t> batchTubes;
+    auto flush = [&]() -> bool {
+        if (crops.empty()) {
+            batchTubes.clear();
+            return true;
+        }
+        cv::Mat out;
+        if (!embed(crops, out) || out.rows != static_cast<int>(crops.size()) || out.type() != CV_32F
+            || (dimension > 0 && out.cols != dimension)) {
+            LOG_ERROR("[TubeMerger] The re-ID model gave no usable embeddings");
+            return false;
+        }
+        if (dimension == 0) {
+            dimension = out.cols;
+            embeddings = cv::Mat::zeros(static_cast<int>(tubes.size()), dimension, CV_32F);
+            const CacheHeader h = { kCacheMagic, kCacheVersion, static_cast<uint32_t>(dimension),
+                static_cast<uint32_t>(tubes.size()), storeBytes, model.modelSize, model.modelTime, model.modelPathHash };
+            cache.open(cachePath, std::ios::binary | std::ios::trunc);
+            cache.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        }
+        for (int i = 0; i < out.rows; ++i) {
+            float* sum = embeddings.ptr<float>(static_cast<int>(owners[i]));
+            const float* e = out.ptr<float>(i);
+            for (int d = 0; d < dimension; ++d)
+                sum[d] += e[d];
+        }
+        for (uint32_t id : batchTubes) {
+            float* row = embeddings.ptr<float>(static_cast<int>(id));
+            if (!normalizeRow(row, dimension))
+                continue;
+            cache.write(reinterpret_cast<const char*>(&id), sizeof(id));
+            cache.write(reinterpret_cast<const char*>(row), dimension * sizeof(float));
+            ++stats_.embedded;
+        }
+        cache.flush();
+        crops.clear();
+        owners.clear();
+        batchTubes.clear();
+        return true;
+    };
+
+    std::vector<TubeFrame> frames;
+    std::vector<uint32_t> ranks;
+    for (size_t n = 0; n < todo.size(); ++n) {
+        const uint32_t id = todo[n];
+        // Samples spread over the lifetime, each in the middle of its share of the frames
+        const size_t count = tubes[id].frameCount;
+        const size_t samples = std::min(count, static_cast<size_t>(options_.samplesPerTube));
+        ranks.clear();
+        for (size_t s = 0; s < samples; ++s)
+            ranks.push_back(static_cast<uint32_t>((2 * s + 1) * count / (2 * samples)));
+        if (!store.ReadTubeRecords(id, ranks, frames))
+            return false;
+        for (const TubeFrame& frame : frames) {
+            cv::Mat crop;
+            if (frame.decodeCrop(crop)) {
+                crops.push_back(crop);
+                owners.push_back(id);
+            }
+        }
+        batchTubes.push_back(id);
+        if (crops.size() >= static_cast<size_t>(options_.batchSize) && !flush())
+            return false;
+        if (progress && !progress(static_cast<double>(n + 1) / todo.size())) {
+            flush();
+            LOG_INFO("[TubeMerger] Stopped; embeddings so far are cached");
+            return false;
+        }
+    }
+    if (!flush())
+        return false;
+    if (cache.is_open() && !cache) {
+        LOG_ERROR_STREAM("[TubeMerger] Cannot write " << cacheUtf8);
+        return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// Linking
+// ============================================================================
+void TubeMerger::link(const TubeStoreReader& store, cv::Mat embeddings, std::vector<int64_t>& previous)
+{
+    const std::vector<TubeSummary>& tubes = store.tubes();
+    previous.assign(tubes.size(), -1);
+    if (embeddings.empty())
+        return;
+
+    // Index rows: the tubes that have an embedding
+    std::vector<uint32_t> ids;
+    for (const TubeSummary& t : tubes) {
+        const float* row = embeddings.ptr<float>(static_cast<int>(t.tubeId));
+        if (std::any_of(row, row + embeddings.cols, [](float v) { return v != 0.0f; }))
+            ids.push_back(t.tubeId);
+    }
+    if (ids.size() < 2)
+        return;
+    // Index rows moved to the front (ids ascend, so no row is overwritten before it moves);
+    // the index shares them
+    const size_t rowBytes = embeddings.cols * sizeof(float);
+    for (size_t r = 0; r < ids.size(); ++r) {
+        if (ids[r] != r)
+            std::memcpy(embeddings.ptr<float>(static_cast<int>(r)), embeddings.ptr<float>(static_cast<int>(ids[r])), rowBytes);
+    }
+    const cv::Mat rows = embeddings.rowRange(0, static_cast<int>(ids.size()));
+    EmbeddingIndex index(options_.index);
+    index.Build(rows);
+
+    const double fps = store.info().fps > 0.0 ? store.info().fps : 25.0;
+    const int64_t maxGap = static_cast<int64_t>(options_.maxGapSeconds * fps);
+    const int k = std::max(1, options_.neighbours) + 1;     // the tube finds itself first
+    std::vector<int> found(k);
+    std::vector<float> similarity(k);
+    std::vector<Pair> pairs;
+    for (size_t r = 0; r < ids.size(); ++r) {
+        const TubeSummary& later = tubes[ids[r]];
+        const int n = index.Search(rows.ptr<float>(static_cast<int>(r)), k, found.data(), similarity.data());
+        for (int i = 0; i < n && similarity[i] >= options_.minSimilarity; ++i) {
+            const TubeSummary& earlier = tubes[ids[found[i]]];
+            if (earlier.tubeId == later.tubeId || earlier.classId != later.classId || earlier.lastFrame >= later.firstFrame
+                || later.firstFrame - earlier.lastFrame > maxGap)
+                continue;
+            if (options_.maxSpeed > 0.0f) {
+                const double seconds = std::max((later.firstMs - earlier.lastMs) / 1000.0, 1.0 / fps);
+                if (std::hypot(later.firstX - earlier.lastX, later.firstY - earlier.lastY) > options_.maxSpeed * seconds)
+                    continue;
+            }
+            pairs.push_back({ similarity[i], earlier.tubeId, later.tubeId });
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& x, const Pair& y) { return x.similarity > y.similarity; });
+
+    std::vector<char> hasNext(tubes.size(), 0);
+    for (const Pair& p : pairs) {
+        if (hasNext[p.earlier] || previous[p.later] >= 0)
+            continue;
+        hasNext[p.earlier] = 1;
+        previous[p.later] = p.earlier;
+        ++stats_.merged;
+    }
+}
+
+// ============================================================================
+// Merge
+// ============================================================================
+bool TubeMerger::Merge(const std::string& inputUtf8, const std::string& cacheUtf8, const std::string& outputUtf8,
+    EmbedFn embed, ProgressFn progress)
+{
+    stats_ = Stats();
+    if (!embed)
+        return false;
+    TubeStoreReader store;
+    if (!store.Open(inputUtf8))
+        return false;
+    std::error_code ec;
+    const uint64_t storeBytes = fs::file_size(fs::u8path(inputUtf8), ec);
+    const std::vector<TubeSummary>& tubes = store.tubes();
+    stats_.tubesIn = tubes.size();
+
+    cv::Mat embeddings;
+    if (!embedTubes(store, ec ? 0 : storeBytes, cacheUtf8, embed, progress, embeddings))
+        return false;
+    std::vector<int64_t> previous;
+    link(store, std::move(embeddings), previous);
+
+    // First tube of every chain; a predecessor always starts earlier, so its head is known
+    std::vector<uint32_t> order(tubes.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return tubes[a].firstFrame < tubes[b].firstFrame; });
+    std::vector<uint32_t> head(tubes.size());
+    for (uint32_t id : order)
+        head[id] = previous[id] >= 0 ? head[previous[id]] : id;
+
+    TubeStoreInfo info = store.info();
+    info.chunkBytes = options_.chunkBytes;
+    TubeStoreWriter out;
+    if (!out.Open(outputUtf8, info))
+        return false;
+    std::vector<int64_t> outputId(tubes.size(), -1);
+    std::vector<TubeFrame> records;
+    for (size_t c = 0; c < store.chunkCount(); ++c) {
+        if (!store.ReadChunk(c, records))
+            return false;
+        for (const TubeFrame& f : records) {
+            const uint32_t first = head[f.tubeId];
+            int64_t& id = outputId[first];
+            if (id < 0)
+                id = out.NewTube(tubes[first].trackId, tubes[first].classId);
+            if (!out.Append(static_cast<uint32_t>(id), f.frameIndex, f.timestampMs, f.box, f.conf,
+                f.mask.data(), f.mask.size(), f.crop.data(), f.crop.size(), f.colors))
+                return false;
+        }
+    }
+
+    stats_.tubesOut = out.tubes().size();
+    const bool ok = out.Close();
+    LOG_INFO_STREAM("[TubeMerger] " << stats_.tubesIn << " tubes in, " << stats_.tubesOut << " out, " << stats_.merged
+        << " fragments joined; " << stats_.embedded << " embedded, " << stats_.cached << " from the cache");
+    return ok;
+}
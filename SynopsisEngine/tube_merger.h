@@ -0,0 +1,76 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "tube_store.h"
+#include "embedding_index.h"
+
+/**
+ * @brief Joins the fragments of objects whose track broke (occlusion, missed detections)
+ *        by appearance.
+ *
+ * Every tube of at least minFrames frames gets one embedding: samplesPerTube of its crops,
+ * spread over its lifetime, go through the re-ID model together with the samples of the
+ * next tubes, batchSize crops per call, and their mean (normalised) stands for the tube.
+ * Only the sampled records are read from the store. Embeddings are appended to a cache
+ * file as they are computed, so an interrupted merge only embeds the tubes it had not
+ * reached; the cache names the store and the model file (path, size, time) it was filled
+ * from and is dropped when either changed.
+ *
+ * The embeddings then go into an EmbeddingIndex. Each tube asks it for its neighbours; a
+ * neighbour of the same class that ended before the tube started, at most maxGapSeconds
+ * earlier (and, with maxSpeed, not too far away for the gap), with at least minSimilarity
+ * is a candidate predecessor. Pairs are matched greedily, best first, one successor and
+ * one predecessor per tube, and the store is copied (still encoded) with every chain of
+ * fragments under the id and track id of its first tube.
+ *
+ * Memory is the embeddings, one batch of crops and one chunk of records.
+ */
+class TubeMerger {
+public:
+    struct Options {
+        int samplesPerTube = 8;
+        int minFrames = 5;              // shorter tubes are left as they are
+        int batchSize = 32;             // crops per embedding call
+        float minSimilarity = 0.7f;     // cosine of the tube embeddings
+        double maxGapSeconds = 10.0;    // from the last frame of one fragment to the first of the next
+        float maxSpeed = 0.0f;          // pixels per second between the fragments' boxes, 0 = no limit
+        int neighbours = 10;            // candidates looked at per tube
+        EmbeddingIndex::Options index;
+        size_t chunkBytes = 4 << 20;
+        std::string modelPathUtf8;      // re-ID model behind embed, for the cache header
+    };
+
+    struct Stats {
+        size_t tubesIn = 0;
+        size_t tubesOut = 0;
+        size_t embedded = 0;            // tubes embedded by this run
+        size_t cached = 0;              // tubes whose embedding came from the cache
+        size_t merged = 0;              // fragments joined to a predecessor
+    };
+
+    // BGR crops in, crops.size() x D CV_32F L2-normalised rows out (zero rows for unusable crops)
+    using EmbedFn = std::function<bool(const std::vector<cv::Mat>& crops, cv::Mat& embeddings)>;
+    // Fraction of the tubes embedded; false stops the merge
+    using ProgressFn = std::function<bool(double fraction)>;
+
+    TubeMerger();
+    explicit TubeMerger(const Options& options);
+
+    bool Merge(const std::string& inputUtf8, const std::string& cacheUtf8, const std::string& outputUtf8,
+        EmbedFn embed, ProgressFn progress = nullptr);
+    const Stats& stats() const { return stats_; }
+
+private:
+    // Fills rows of `embeddings` (one per tube id, zero = none) from the cache, then the model
+    bool embedTubes(const TubeStoreReader& store, uint64_t storeBytes, const std::string& cacheUtf8, EmbedFn& embed,
+        ProgressFn& progress, cv::Mat& embeddings);
+    // Predecessor of every tube (or -1). Takes the matrix over: its rows are compacted in
+    // place and indexed without another copy.
+    void link(const TubeStoreReader& store, cv::Mat embeddings, std::vector<int64_t>& previous);
+
+    Options options_;
+    Stats stats_;
+};
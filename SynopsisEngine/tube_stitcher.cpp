@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "tube_stitcher.h"
+#include <algorithm>
+#include <unordered_map>
+#include "Logger.h"
+
+namespace {
+
+struct Pair {
+    float iou;
+    uint32_t earlier;
+    uint32_t later;
+};
+
+} // namespace
+
+TubeStitcher::TubeStitcher()
+    : TubeStitcher(Options())
+{
+}
+
+TubeStitcher::TubeStitcher(const Options& options)
+    : options_(options)
+{
+}
+
+bool TubeStitcher::matchBoundary(const TubeStoreReader& earlier, const TubeStoreReader& later, const VideoSegment& laterSegment,
+    std::vector<int64_t>& matchOfLater)
+{
+    matchOfLater.assign(later.tubes().size(), -1);
+    const int64_t from = laterSegment.decodeFrom;
+    const int64_t to = laterSegment.begin;
+    if (from >= to)
+        return true;
+
+    // Boxes of both sides inside the overlap, keyed by frame. Only the tube's chunks that
+    // cover the overlap are read, not the whole tube.
+    auto overlapBoxes = [&](const TubeStoreReader& store, bool bornInside,
+        std::vector<std::pair<uint32_t, std::unordered_map<int64_t, cv::Rect>>>& out) {
+        std::vector<TubeFrame> frames;
+        for (const TubeSummary& t : store.tubes()) {
+            if (t.frameCount == 0 || t.lastFrame < from || t.firstFrame >= to || (bornInside && t.firstFrame < from))
+                continue;
+            std::unordered_map<int64_t, cv::Rect> boxes;
+            for (size_t c = t.firstChunk; c <= t.lastChunk && c < store.chunkCount(); ++c) {
+                int64_t chunkFirst = 0, chunkLast = 0;
+                if (!store.chunkRange(c, chunkFirst, chunkLast))
+                    return false;
+                if (chunkFirst >= to)
+                    break;
+                if (chunkLast < from)
+                    continue;
+                if (!store.ReadTubeChunk(t.tubeId, c, frames))
+                    return false;
+                for (const TubeFrame& f : frames) {
+                    if (f.frameIndex >= from && f.frameIndex < to)
+                        boxes.emplace(f.frameIndex, f.box);
+                }
+            }
+            if (!boxes.empty())
+                out.emplace_back(t.tubeId, std::move(boxes));
+        }
+        return true;
+    };
+    std::vector<std::pair<uint32_t, std::unordered_map<int64_t, cv::Rect>>> a, b;
+    if (!overlapBoxes(earlier, false, a) || !overlapBoxes(later, true, b))
+        return false;
+
+    std::vector<Pair> pairs;
+    for (const auto& tb : b) {
+        const int classB = later.tubes()[tb.first].classId;
+        for (const auto& ta : a) {
+            if (earlier.tubes()[ta.first].classId != classB)
+                continue;
+            int common = 0;
+            double iouSum = 0.0;
+            for (const auto& fb : tb.second) {
+                auto it = ta.second.find(fb.first);
+                if (it == ta.second.end())
+                    continue;
+                const double inter = (fb.second & it->second).area();
+                const double uni = fb.second.area() + it->second.area() - inter;
+                iouSum += uni > 0.0 ? inter / uni : 0.0;
+                ++common;
+            }
+            if (common >= options_.minCommonFrames && iouSum / common >= options_.minIou)
+                pairs.push_back({ static_cast<float>(iouSum / common), ta.first, tb.first });
+        }
+    }
+    std::sort(pairs.begin(), pairs.end(), [](const Pair& x, const Pair& y) { return x.iou > y.iou; });
+
+    std::vector<char> earlierTaken(earlier.tubes().size(), 0);
+    for (const Pair& p : pairs) {
+        if (earlierTaken[p.earlier] || matchOfLater[p.later] >= 0)
+            continue;
+        earlierTaken[p.earlier] = 1;
+        matchOfLater[p.later] = p.earlier;
+        ++stats_.stitched;
+    }
+    return true;
+}
+
+bool TubeStitcher::Merge(const std::vector<std::string>& storePaths, const std::vector<VideoSegment>& segments,
+    const std::string& outputUtf8)
+{
+    stats_ = Stats();
+    if (storePaths.empty() || storePaths.size() != segments.size())
+        return false;
+
+    TubeStoreReader current;
+    if (!current.Open(storePaths[0]))
+        return false;
+    TubeStoreInfo info = current.info();
+    info.chunkBytes = options_.chunkBytes;
+    TubeStoreWriter out;
+    if (!out.Open(outputUtf8, info))
+        return false;
+
+    // Output id of every tube of the current segment, -1 until its first owned record;
+    // tubes continuing one of the previous segment start out with that tube's id
+    std::vector<int64_t> outputId(current.tubes().size(), -1);
+    std::vector<TubeFrame> records;
+    std::vector<int64_t> matchOfNext;
+
+    for (size_t k = 0; k < segments.size(); ++k) {
+        stats_.tubesIn += current.tubes().size();
+
+        TubeStoreReader next;
+        const bool hasNext = k + 1 < segments.size();
+        if (hasNext && (!next.Open(storePaths[k + 1]) || !matchBoundary(current, next, segments[k + 1], matchOfNext)))
+            return false;
+
+        const VideoSegment& seg = segments[k];
+        for (size_t c = 0; c < current.chunkCount(); ++c) {
+            if (!current.ReadChunk(c, records))
+                return false;
+            for (const TubeFrame& f : records) {
+                if (f.frameIndex < seg.begin || f.frameIndex >= seg.end)
+                    continue;
+                int64_t& id = outputId[f.tubeId];
+                if (id < 0) {
+                    const TubeSummary& t = current.tubes()[f.tubeId];
+                    id = out.NewTube(t.trackId, t.classId);
+                }
+                if (!out.Append(static_cast<uint32_t>(id), f.frameIndex, f.timestampMs, f.box, f.conf,
+                    f.mask.data(), f.mask.size(), f.crop.data(), f.crop.size(), f.colors))
+                    return false;
+            }
+        }
+
+        if (!hasNext)
+            break;
+        std::vector<int64_t> nextId(next.tubes().size(), -1);
+        for (size_t t = 0; t < matchOfNext.size(); ++t) {
+            if (matchOfNext[t] >= 0)
+                nextId[t] = outputId[matchOfNext[t]];
+        }
+        outputId.swap(nextId);
+        current.Close();
+        if (!current.Open(storePaths[k + 1]))
+            return false;
+    }
+
+    stats_.tubesOut = out.tubes().size();
+    const bool ok = out.Close();
+    LOG_INFO_STREAM("[TubeStitcher] " << segments.size() << " segments, " << stats_.tubesIn << " tubes in, "
+        << stats_.tubesOut << " out, " << stats_.stitched << " joined across boundaries");
+    return ok;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "tube_store.h"
+#include "video_segments.h"
+
+/**
+ * @brief Joins the tube stores of separately analysed segments into one store.
+ *
+ * Neighbouring segments both analyse the overlap in front of a boundary, each with its own
+ * tracker. A tube of the earlier segment alive in the overlap and a tube of the later one
+ * born there are the same object when they have the same class, share at least
+ * minCommonFrames frames and their boxes overlap by minIou on average; pairs are matched
+ * greedily, best first. Records are then copied (still encoded) in frame order, each
+ * segment contributing only the frames it owns, and a matched tube carries on under the
+ * id and track id of its predecessor.
+ *
+ * Memory is one chunk plus the records of the tubes alive at one boundary.
+ */
+class TubeStitcher {
+public:
+    struct Options {
+        float minIou = 0.5f;
+        int minCommonFrames = 2;
+        size_t chunkBytes = 4 << 20;
+    };
+
+    struct Stats {
+        size_t tubesIn = 0;
+        size_t tubesOut = 0;
+        size_t stitched = 0;            // boundary crossings joined
+    };
+
+    TubeStitcher();
+    explicit TubeStitcher(const Options& options);
+
+    // storePaths[k] holds the tubes of segments[k]
+    bool Merge(const std::vector<std::string>& storePaths, const std::vector<VideoSegment>& segments, const std::string& outputUtf8);
+    const Stats& stats() const { return stats_; }
+
+private:
+    // For each tube of `later` born in the overlap, the matching tube of `earlier` (or -1)
+    bool matchBoundary(const TubeStoreReader& earlier, const TubeStoreReader& later, const VideoSegment& laterSegment,
+        std::vector<int64_t>& matchOfLater);
+
+    Options options_;
+    Stats stats_;
+};
@@ -0,0 +1,689 @@
+#include "pch.h"
+#include "tube_store.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include "result_block.h"
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const uint32_t kFileMagic = 0x42545356u;       // 'VSTB'
+const uint32_t kChunkMagic = 0x43545356u;      // 'VSTC'
+const uint32_t kIndexMagic = 0x49545356u;      // 'VSTI'
+const uint32_t kTrailerMagic = 0x45545356u;    // 'VSTE'
+const uint32_t kVersion = 4;            // 2: record table after each chunk header, 3: trajectory cells in summaries,
+                                        // 4: colour histogram per record, running attributes in summaries
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    double fps;
+    int32_t jpegQuality;
+    uint32_t reserved[9];
+};
+static_assert(sizeof(FileHeader) == 64, "tube store header layout");
+
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t records;
+    uint64_t payloadBytes;
+    int64_t firstFrame;
+    int64_t lastFrame;
+    uint32_t checksum;          // FNV-1a of the record table and the payload
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkHeader) == 40, "tube store chunk layout");
+
+// One per record, between the chunk header and the payload: lets a reader fetch the
+// records of one tube without reading the rest of the chunk
+struct RecordRef {
+    uint32_t tubeId;
+    uint32_t offset;            // in the payload
+};
+static_assert(sizeof(RecordRef) == 2 * sizeof(uint32_t), "written from TubeStoreWriter::table_");
+
+struct RecordHeader {
+    uint32_t tubeId;
+    float conf;
+    int64_t frameIndex;
+    double timestampMs;
+    int32_t x, y, w, h;
+    int32_t classId;
+    int32_t trackId;
+    uint32_t maskBytes;
+    uint32_t cropBytes;
+    uint16_t colors[kTubeColorBins];
+};
+static_assert(sizeof(RecordHeader) == 88, "tube store record layout");
+
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t chunkCount;
+    uint32_t tubeCount;
+};
+
+struct Trailer {
+    uint64_t indexOffset;
+    uint32_t magic;
+    uint32_t checksum;          // FNV-1a of the index
+};
+
+static_assert(sizeof(TubeSummary) == 208, "tube summary is stored verbatim");
+static_assert(kTubeGridSize * kTubeGridSize == 64 * 4, "TubeSummary::cells holds the whole grid");
+
+uint32_t fnv1a(const uint8_t* data, size_t size, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ data[i]) * 16777619u;
+    return hash;
+}
+
+inline size_t align8(size_t v)
+{
+    return (v + 7) & ~static_cast<size_t>(7);
+}
+
+template <typename T>
+void appendPod(std::vector<uint8_t>& buf, const T& value)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+// Parses the records of one chunk payload; false if a record runs past the end
+bool parseChunk(const std::vector<uint8_t>& payload, uint32_t records, std::vector<TubeFrame>& out)
+{
+    size_t pos = 0;
+    for (uint32_t i = 0; i < records; ++i) {
+        RecordHeader rec;
+        if (pos + sizeof(rec) > payload.size())
+            return false;
+        std::memcpy(&rec, payload.data() + pos, sizeof(rec));
+        pos += sizeof(rec);
+        if (pos + rec.maskBytes + rec.cropBytes > payload.size())
+            return false;
+
+        TubeFrame frame;
+        frame.tubeId = rec.tubeId;
+        frame.frameIndex = rec.frameIndex;
+        frame.timestampMs = rec.timestampMs;
+        frame.box = cv::Rect(rec.x, rec.y, rec.w, rec.h);
+        frame.conf = rec.conf;
+        std::copy(rec.colors, rec.colors + kTubeColorBins, frame.colors);
+        frame.mask.assign(payload.data() + pos, payload.data() + pos + rec.maskBytes);
+        frame.crop.assign(payload.data() + pos + rec.maskBytes, payload.data() + pos + rec.maskBytes + rec.cropBytes);
+        pos = align8(pos + rec.maskBytes + rec.cropBytes);
+        out.push_back(std::move(frame));
+    }
+    return true;
+}
+
+// Reads the record table and the payload following a chunk header and checks them
+// True if the record table and payload a chunk header announces fit in the `bytes` the
+// chunk spans on disk; checked before anything is sized from the header's counts
+bool chunkFits(const ChunkHeader& header, uint64_t bytes)
+{
+    if (bytes < sizeof(ChunkHeader))
+        return false;
+    const uint64_t body = bytes - sizeof(ChunkHeader);
+    const uint64_t tableBytes = static_cast<uint64_t>(header.records) * sizeof(RecordRef);
+    return tableBytes <= body && header.payloadBytes <= body - tableBytes;
+}
+
+bool readChunkBody(std::ifstream& in, const ChunkHeader& header, std::vector<RecordRef>& table, std::vector<uint8_t>& payload)
+{
+    table.resize(header.records);
+    payload.resize(static_cast<size_t>(header.payloadBytes));
+    const size_t tableBytes = table.size() * sizeof(RecordRef);
+    if (!in.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(tableBytes))
+        || !in.read(reinterpret_cast<char*>(payload.data()), static_cast<std::streamsize>(payload.size())))
+        return false;
+    return fnv1a(payload.data(), payload.size(), fnv1a(reinterpret_cast<const uint8_t*>(table.data()), tableBytes)) == header.checksum;
+}
+
+void extendSummary(TubeSummary& t, cv::Size frameSize, uint32_t chunk, int64_t frameIndex, double timestampMs, const cv::Rect& box,
+    float conf, const uint16_t* colors)
+{
+    const float cx = box.x + box.width * 0.5f;
+    const float cy = box.y + box.height * 0.5f;
+    if (t.frameCount == 0) {
+        t.firstX = cx;
+        t.firstY = cy;
+        t.firstFrame = frameIndex;
+        t.firstMs = timestampMs;
+        t.firstChunk = chunk;
+        t.x0 = box.x;
+        t.y0 = box.y;
+        t.x1 = box.x + box.width;
+        t.y1 = box.y + box.height;
+    }
+    else {
+        t.x0 = std::min(t.x0, box.x);
+        t.y0 = std::min(t.y0, box.y);
+        t.x1 = std::max(t.x1, box.x + box.width);
+        t.y1 = std::max(t.y1, box.y + box.height);
+        t.pathLength += std::hypot(cx - t.lastX, cy - t.lastY);
+    }
+    t.lastX = cx;
+    t.lastY = cy;
+    t.lastFrame = frameIndex;
+    t.lastMs = timestampMs;
+    t.lastChunk = chunk;
+    ++t.frameCount;
+    const float n = static_cast<float>(t.frameCount);
+    t.meanConf += (conf - t.meanConf) / n;
+    t.meanWidth += (box.width - t.meanWidth) / n;
+    t.meanHeight += (box.height - t.meanHeight) / n;
+    const float area = static_cast<float>(box.area());
+    const float delta = area - t.meanArea;
+    t.meanArea += delta / n;
+    t.areaM2 += delta * (area - t.meanArea);
+    if (colors) {
+        for (int b = 0; b < kTubeColorBins; ++b)
+            t.colors[b] += colors[b];
+    }
+    MarkTubeCells(box, frameSize, t.cells);
+}
+
+} // namespace
+
+void MarkTubeCells(const cv::Rect& area, cv::Size frameSize, uint64_t cells[4])
+{
+    if (frameSize.width <= 0 || frameSize.height <= 0 || area.width <= 0 || area.height <= 0)
+        return;
+    auto cell = [](int v, int size) {
+        return std::min(kTubeGridSize - 1, std::max(0, static_cast<int>(static_cast<int64_t>(v) * kTubeGridSize / size)));
+    };
+    const int cx0 = cell(area.x, frameSize.width), cx1 = cell(area.x + area.width - 1, frameSize.width);
+    const int cy0 = cell(area.y, frameSize.height), cy1 = cell(area.y + area.height - 1, frameSize.height);
+    for (int cy = cy0; cy <= cy1; ++cy) {
+        for (int cx = cx0; cx <= cx1; ++cx) {
+            const int bit = cy * kTubeGridSize + cx;
+            cells[bit >> 6] |= uint64_t(1) << (bit & 63);
+        }
+    }
+}
+
+// ============================================================================
+// TubeFrame
+// ============================================================================
+bool TubeFrame::decodeCrop(cv::Mat& out) const
+{
+    if (crop.empty())
+        return false;
+    out = cv::imdecode(crop, cv::IMREAD_COLOR);
+    return !out.empty();
+}
+
+void TubeFrame::decodeMask(cv::Mat& out) const
+{
+    if (mask.empty()) {
+        out.create(box.size(), CV_8UC1);
+        out.setTo(255);
+        return;
+    }
+    DecodeMaskRLE(mask.data(), mask.size(), box.size(), out);
+}
+
+// ============================================================================
+// TubeStoreWriter
+// ============================================================================
+bool TubeStoreWriter::Open(const std::string& pathUtf8, const TubeStoreInfo& info)
+{
+    Close();
+    path_ = pathUtf8;
+    info_ = info;
+    written_ = 0;
+    chunk_.clear();
+    chunk_.reserve(info_.chunkBytes + (1 << 16));
+    table_.clear();
+    chunkRecords_ = 0;
+    chunks_.clear();
+    tubes_.clear();
+    failed_ = false;
+
+    out_.open(fs::u8path(pathUtf8), std::ios::binary | std::ios::trunc);
+    if (!out_) {
+        LOG_ERROR_STREAM("[TubeStore] Cannot create " << pathUtf8);
+        return false;
+    }
+    FileHeader header = {};
+    header.magic = kFileMagic;
+    header.version = kVersion;
+    header.width = info_.frameSize.width;
+    header.height = info_.frameSize.height;
+    header.fps = info_.fps;
+    header.jpegQuality = info_.jpegQuality;
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    written_ = sizeof(header);
+    return static_cast<bool>(out_);
+}
+
+bool TubeStoreWriter::Resume(const std::string& pathUtf8, uint64_t validBytes, size_t chunkBytes)
+{
+    Close();
+    TubeStoreReader reader;
+    if (!reader.openFile(pathUtf8) || !reader.rebuildIndex(validBytes ? validBytes : UINT64_MAX)) {
+        LOG_ERROR_STREAM("[TubeStore] Cannot resume " << pathUtf8);
+        return false;
+    }
+    info_ = reader.info_;
+    info_.chunkBytes = chunkBytes;
+    chunks_ = std::move(reader.chunks_);
+    tubes_ = std::move(reader.tubes_);
+    written_ = reader.dataEnd_;
+    reader.Close();
+
+    std::error_code ec;
+    fs::resize_file(fs::u8path(pathUtf8), written_, ec);
+    if (!ec)
+        out_.open(fs::u8path(pathUtf8), std::ios::binary | std::ios::app);
+    if (ec || !out_) {
+        LOG_ERROR_STREAM("[TubeStore] Cannot reopen " << pathUtf8 << " for appending");
+        return false;
+    }
+    path_ = pathUtf8;
+    chunk_.clear();
+    chunk_.reserve(info_.chunkBytes + (1 << 16));
+    table_.clear();
+    chunkRecords_ = 0;
+    failed_ = false;
+    LOG_INFO_STREAM("[TubeStore] Resumed " << pathUtf8 << " after " << chunks_.size() << " chunks, " << tubes_.size() << " tubes");
+    return true;
+}
+
+uint32_t TubeStoreWriter::NewTube(int trackId, int classId)
+{
+    TubeSummary t;
+    t.tubeId = static_cast<uint32_t>(tubes_.size());
+    t.trackId = trackId;
+    t.classId = classId;
+    tubes_.push_back(t);
+    return t.tubeId;
+}
+
+bool TubeStoreWriter::Append(uint32_t tubeId, int64_t frameIndex, double timestampMs, const cv::Rect& box, float conf,
+    const uint8_t* mask, size_t maskBytes, const uint8_t* crop, size_t cropBytes, const uint16_t* colors)
+{
+    if (!out_.is_open() || failed_ || tubeId >= tubes_.size())
+        return false;
+    TubeSummary& tube = tubes_[tubeId];
+
+    RecordHeader rec = {};
+    rec.tubeId = tubeId;
+    rec.conf = conf;
+    rec.frameIndex = frameIndex;
+    rec.timestampMs = timestampMs;
+    rec.x = box.x;
+    rec.y = box.y;
+    rec.w = box.width;
+    rec.h = box.height;
+    rec.classId = tube.classId;
+    rec.trackId = tube.trackId;
+    rec.maskBytes = static_cast<uint32_t>(maskBytes);
+    rec.cropBytes = static_cast<uint32_t>(cropBytes);
+    if (colors)
+        std::copy(colors, colors + kTubeColorBins, rec.colors);
+
+    if (chunkRecords_ == 0)
+        chunkFirst_ = frameIndex;
+    chunkLast_ = frameIndex;
+    table_.push_back(tubeId);
+    table_.push_back(static_cast<uint32_t>(chunk_.size()));
+    appendPod(chunk_, rec);
+    if (maskBytes)
+        chunk_.insert(chunk_.end(), mask, mask + maskBytes);
+    if (cropBytes)
+        chunk_.insert(chunk_.end(), crop, crop + cropBytes);
+    chunk_.resize(align8(chunk_.size()), 0);
+    ++chunkRecords_;
+
+    extendSummary(tube, info_.frameSize, static_cast<uint32_t>(chunks_.size()), frameIndex, timestampMs, box, conf, rec.colors);
+
+    if (chunk_.size() >= info_.chunkBytes)
+        return flushChunk();
+    return true;
+}
+
+bool TubeStoreWriter::flushChunk()
+{
+    if (chunkRecords_ == 0)
+        return true;
+    ChunkHeader header = {};
+    header.magic = kChunkMagic;
+    header.records = chunkRecords_;
+    header.payloadBytes = chunk_.size();
+    header.firstFrame = chunkFirst_;
+    header.lastFrame = chunkLast_;
+    const size_t tableBytes = table_.size() * sizeof(uint32_t);
+    header.checksum = fnv1a(chunk_.data(), chunk_.size(), fnv1a(reinterpret_cast<const uint8_t*>(table_.data()), tableBytes));
+
+    chunks_.push_back({ written_, chunkFirst_, chunkLast_, chunkRecords_, 0 });
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out_.write(reinterpret_cast<const char*>(table_.data()), static_cast<std::streamsize>(tableBytes));
+    out_.write(reinterpret_cast<const char*>(chunk_.data()), static_cast<std::streamsize>(chunk_.size()));
+    out_.flush();
+    written_ += sizeof(header) + tableBytes + chunk_.size();
+    chunk_.clear();
+    table_.clear();
+    chunkRecords_ = 0;
+
+    if (!out_) {
+        LOG_ERROR_STREAM("[TubeStore] Write failed on " << path_);
+        failed_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool TubeStoreWriter::Flush()
+{
+    return out_.is_open() && !failed_ && flushChunk();
+}
+
+bool TubeStoreWriter::Close()
+{
+    if (!out_.is_open())
+        return true;
+    bool ok = flushChunk();
+
+    // Index: chunk table and tube summaries, then the trailer pointing at it
+    std::vector<uint8_t> index;
+    appendPod(index, IndexHeader{ kIndexMagic, kVersion, static_cast<uint32_t>(chunks_.size()), static_cast<uint32_t>(tubes_.size()) });
+    for (const ChunkEntry& c : chunks_)
+        appendPod(index, c);
+    for (const TubeSummary& t : tubes_)
+        appendPod(index, t);
+    const Trailer trailer = { written_, kTrailerMagic, fnv1a(index.data(), index.size()) };
+
+    out_.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size()));
+    out_.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    written_ += index.size() + sizeof(trailer);
+    out_.close();
+    ok = ok && !out_.fail() && !failed_;
+
+    LOG_INFO_STREAM("[TubeStore] Closed " << path_ << ": " << tubes_.size() << " tubes, " << chunks_.size()
+        << " chunks, " << written_ / (1024 * 1024) << " MB" << (ok ? "" : " (write errors)"));
+    return ok;
+}
+
+// ============================================================================
+// TubeStoreReader
+// ============================================================================
+bool TubeStoreReader::Open(const std::string& pathUtf8)
+{
+    if (!openFile(pathUtf8))
+        return false;
+    std::error_code ec;
+    const uint64_t fileSize = fs::file_size(fs::u8path(pathUtf8), ec);
+    if (readIndex(fileSize))
+        return true;
+    LOG_WARNING_STREAM("[TubeStore] " << pathUtf8 << " was not closed, rebuilding the index from its chunks");
+    recovered_ = true;
+    return rebuildIndex(fileSize);
+}
+
+bool TubeStoreReader::openFile(const std::string& pathUtf8)
+{
+    Close();
+    path_ = pathUtf8;
+    std::error_code ec;
+    const uint64_t fileSize = fs::file_size(fs::u8path(pathUtf8), ec);
+    if (ec || fileSize < sizeof(FileHeader))
+        return false;
+
+    in_.open(fs::u8path(pathUtf8), std::ios::binary);
+    FileHeader header = {};
+    if (!in_.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kFileMagic || header.version != kVersion) {
+        LOG_ERROR_STREAM("[TubeStore] " << pathUtf8 << " is not a tube store");
+        Close();
+        return false;
+    }
+    info_.frameSize = cv::Size(header.width, header.height);
+    info_.fps = header.fps;
+    info_.jpegQuality = header.jpegQuality;
+    return true;
+}
+
+void TubeStoreReader::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (in_.is_open())
+        in_.close();
+    in_.clear();
+    chunks_.clear();
+    tubes_.clear();
+    dataEnd_ = 0;
+    recovered_ = false;
+}
+
+bool TubeStoreReader::readIndex(uint64_t fileSize)
+{
+    if (fileSize < sizeof(FileHeader) + sizeof(IndexHeader) + sizeof(Trailer))
+        return false;
+    Trailer trailer = {};
+    in_.seekg(static_cast<std::streamoff>(fileSize - sizeof(Trailer)));
+    if (!in_.read(reinterpret_cast<char*>(&trailer), sizeof(trailer)) || trailer.magic != kTrailerMagic
+        || trailer.indexOffset < sizeof(FileHeader) || trailer.indexOffset > fileSize - sizeof(Trailer)) {
+        in_.clear();
+        return false;
+    }
+
+    std::vector<uint8_t> index(static_cast<size_t>(fileSize - sizeof(Trailer) - trailer.indexOffset));
+    in_.seekg(static_cast<std::streamoff>(trailer.indexOffset));
+    if (!in_.read(reinterpret_cast<char*>(index.data()), static_cast<std::streamsize>(index.size()))
+        || fnv1a(index.data(), index.size()) != trailer.checksum || index.size() < sizeof(IndexHeader)) {
+        in_.clear();
+        return false;
+    }
+    IndexHeader header;
+    std::memcpy(&header, index.data(), sizeof(header));
+    const size_t expected = sizeof(IndexHeader) + header.chunkCount * sizeof(TubeStoreWriter::ChunkEntry)
+        + header.tubeCount * sizeof(TubeSummary);
+    if (header.magic != kIndexMagic || expected != index.size())
+        return false;
+
+    chunks_.resize(header.chunkCount);
+    tubes_.resize(header.tubeCount);
+    size_t pos = sizeof(IndexHeader);
+    if (!chunks_.empty())
+        std::memcpy(chunks_.data(), index.data() + pos, chunks_.size() * sizeof(TubeStoreWriter::ChunkEntry));
+    pos += chunks_.size() * sizeof(TubeStoreWriter::ChunkEntry);
+    if (!tubes_.empty())
+        std::memcpy(tubes_.data(), index.data() + pos, tubes_.size() * sizeof(TubeSummary));
+    dataEnd_ = trailer.indexOffset;
+    return true;
+}
+
+bool TubeStoreReader::rebuildIndex(uint64_t fileSize)
+{
+    chunks_.clear();
+    tubes_.clear();
+    in_.clear();
+    uint64_t offset = sizeof(FileHeader);
+    std::vector<RecordRef> table;
+    std::vector<uint8_t> payload;
+
+    while (offset + sizeof(ChunkHeader) <= fileSize) {
+        ChunkHeader header = {};
+        in_.seekg(static_cast<std::streamoff>(offset));
+        if (!in_.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kChunkMagic
+            || !chunkFits(header, fileSize - offset))
+            break;
+        if (!readChunkBody(in_, header, table, payload))
+            break;
+
+        // Summaries come back from the record headers
+        const uint32_t chunk = static_cast<uint32_t>(chunks_.size());
+        size_t pos = 0;
+        for (uint32_t i = 0; i < header.records && pos + sizeof(RecordHeader) <= payload.size(); ++i) {
+            RecordHeader rec;
+            std::memcpy(&rec, payload.data() + pos, sizeof(rec));
+            pos = align8(pos + sizeof(rec) + rec.maskBytes + rec.cropBytes);
+            if (rec.tubeId >= tubes_.size()) {
+                const size_t first = tubes_.size();
+                tubes_.resize(rec.tubeId + 1);
+                for (size_t t = first; t < tubes_.size(); ++t)
+                    tubes_[t].tubeId = static_cast<uint32_t>(t);
+            }
+            TubeSummary& t = tubes_[rec.tubeId];
+            t.classId = rec.classId;
+            t.trackId = rec.trackId;
+            extendSummary(t, info_.frameSize, chunk, rec.frameIndex, rec.timestampMs, cv::Rect(rec.x, rec.y, rec.w, rec.h), rec.conf,
+                rec.colors);
+        }
+        chunks_.push_back({ offset, header.firstFrame, header.lastFrame, header.records, 0 });
+        offset += sizeof(header) + table.size() * sizeof(RecordRef) + header.payloadBytes;
+    }
+    in_.clear();
+    dataEnd_ = offset;
+    LOG_INFO_STREAM("[TubeStore] Recovered " << chunks_.size() << " chunks, " << tubes_.size() << " tubes from " << path_);
+    return true;
+}
+
+bool TubeStoreReader::chunkRange(size_t chunk, int64_t& firstFrame, int64_t& lastFrame) const
+{
+    if (chunk >= chunks_.size())
+        return false;
+    firstFrame = chunks_[chunk].firstFrame;
+    lastFrame = chunks_[chunk].lastFrame;
+    return true;
+}
+
+bool TubeStoreReader::chunkSize(size_t chunk, uint64_t& bytes, uint32_t& records) const
+{
+    if (chunk >= chunks_.size())
+        return false;
+    const uint64_t end = chunk + 1 < chunks_.size() ? chunks_[chunk + 1].offset : dataEnd_;
+    bytes = end > chunks_[chunk].offset ? end - chunks_[chunk].offset : 0;
+    records = chunks_[chunk].records;
+    return true;
+}
+
+bool TubeStoreReader::ReadChunk(size_t chunk, std::vector<TubeFrame>& out) const
+{
+    out.clear();
+    if (chunk >= chunks_.size())
+        return false;
+    ChunkHeader header = {};
+    std::vector<RecordRef> table;
+    std::vector<uint8_t> payload;
+    bool ok;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        in_.clear();
+        in_.seekg(static_cast<std::streamoff>(chunks_[chunk].offset));
+        uint64_t bytes = 0;
+        uint32_t records = 0;
+        if (!in_.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kChunkMagic
+            || !chunkSize(chunk, bytes, records))
+            return false;
+        ok = chunkFits(header, bytes) && readChunkBody(in_, header, table, payload);
+    }
+    if (!ok) {
+        LOG_ERROR_STREAM("[TubeStore] Chunk " << chunk << " of " << path_ << " is corrupt");
+        return false;
+    }
+    out.reserve(header.records);
+    return parseChunk(payload, header.records, out);
+}
+
+bool TubeStoreReader::readTubeChunk(uint32_t tubeId, size_t chunk, std::vector<TubeFrame>& out,
+    const std::vector<uint32_t>* ranks, uint32_t* rank) const
+{
+    // Only the record table and the tube's own records are read; the chunk checksum
+    // covers the whole chunk and is left to ReadChunk
+    ChunkHeader header = {};
+    uint64_t bytes = 0;
+    uint32_t records = 0;
+    in_.clear();
+    in_.seekg(static_cast<std::streamoff>(chunks_[chunk].offset));
+    if (!in_.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != kChunkMagic
+        || !chunkSize(chunk, bytes, records))
+        return false;
+    if (!chunkFits(header, bytes)) {
+        LOG_ERROR_STREAM("[TubeStore] Chunk " << chunk << " of " << path_ << " is corrupt");
+        return false;
+    }
+    std::vector<RecordRef> table(header.records);
+    if (!in_.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(RecordRef))))
+        return false;
+    const uint64_t payloadOffset = chunks_[chunk].offset + sizeof(header) + table.size() * sizeof(RecordRef);
+
+    for (const RecordRef& ref : table) {
+        if (ref.tubeId != tubeId)
+            continue;
+        if (ranks && !std::binary_search(ranks->begin(), ranks->end(), (*rank)++))
+            continue;
+        RecordHeader rec;
+        in_.seekg(static_cast<std::streamoff>(payloadOffset + ref.offset));
+        if (!in_.read(reinterpret_cast<char*>(&rec), sizeof(rec)) || rec.tubeId != tubeId
+            || ref.offset + sizeof(rec) + rec.maskBytes + rec.cropBytes > header.payloadBytes) {
+            LOG_ERROR_STREAM("[TubeStore] Chunk " << chunk << " of " << path_ << " is corrupt");
+            return false;
+        }
+        TubeFrame frame;
+        frame.tubeId = rec.tubeId;
+        frame.frameIndex = rec.frameIndex;
+        frame.timestampMs = rec.timestampMs;
+        frame.box = cv::Rect(rec.x, rec.y, rec.w, rec.h);
+        frame.conf = rec.conf;
+        std::copy(rec.colors, rec.colors + kTubeColorBins, frame.colors);
+        frame.mask.resize(rec.maskBytes);
+        frame.crop.resize(rec.cropBytes);
+        if (!in_.read(reinterpret_cast<char*>(frame.mask.data()), rec.maskBytes)
+            || !in_.read(reinterpret_cast<char*>(frame.crop.data()), rec.cropBytes))
+            return false;
+        out.push_back(std::move(frame));
+    }
+    return true;
+}
+
+bool TubeStoreReader::ReadTube(uint32_t tubeId, std::vector<TubeFrame>& out) const
+{
+    out.clear();
+    if (tubeId >= tubes_.size())
+        return false;
+    const TubeSummary& t = tubes_[tubeId];
+    out.reserve(t.frameCount);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t c = t.firstChunk; c <= t.lastChunk && c < chunks_.size(); ++c) {
+        if (!readTubeChunk(tubeId, c, out))
+            return false;
+    }
+    return true;
+}
+
+bool TubeStoreReader::ReadTubeRecords(uint32_t tubeId, const std::vector<uint32_t>& ranks, std::vector<TubeFrame>& out) const
+{
+    out.clear();
+    if (tubeId >= tubes_.size())
+        return false;
+    if (ranks.empty())
+        return true;
+    const TubeSummary& t = tubes_[tubeId];
+    out.reserve(ranks.size());
+    uint32_t rank = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (uint32_t c = t.firstChunk; c <= t.lastChunk && c < chunks_.size() && rank <= ranks.back(); ++c) {
+        if (!readTubeChunk(tubeId, c, out, &ranks, &rank))
+            return false;
+    }
+    return true;
+}
+
+bool TubeStoreReader::ReadTubeChunk(uint32_t tubeId, size_t chunk, std::vector<TubeFrame>& out) const
+{
+    out.clear();
+    if (tubeId >= tubes_.size() || chunk >= chunks_.size())
+        return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    return readTubeChunk(tubeId, chunk, out);
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Side of the grid TubeSummary::cells is laid over the frame with
+const int kTubeGridSize = 16;
+// Bins of the colour histograms (VS_COLOR_*, see tube_attributes.h)
+const int kTubeColorBins = 16;
+
+// Sets the bits of the grid cells `area` touches (row-major, kTubeGridSize^2 bits)
+void MarkTubeCells(const cv::Rect& area, cv::Size frameSize, uint64_t cells[4]);
+
+/**
+ * @brief Lifetime summary of one object tube, kept in the store's index.
+ */
+struct TubeSummary {
+    uint32_t tubeId = 0;
+    int32_t trackId = -1;
+    int32_t classId = -1;
+    uint32_t frameCount = 0;
+    int64_t firstFrame = 0;
+    int64_t lastFrame = 0;
+    double firstMs = 0.0;
+    double lastMs = 0.0;
+    int32_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;    // union of the tube's boxes
+    float meanConf = 0.0f;
+    uint32_t firstChunk = 0;                    // chunks holding the tube's frames
+    uint32_t lastChunk = 0;
+    float pathLength = 0.0f;                    // distance its box centre travelled, pixels
+    uint64_t cells[4] = {};                     // grid cells any of its boxes touched (MarkTubeCells)
+    // Running attributes, constant size whatever the tube's length (tube_attributes.h reads them)
+    uint32_t colors[kTubeColorBins] = {};       // sum of the per-frame histograms
+    float meanWidth = 0.0f;
+    float meanHeight = 0.0f;
+    float meanArea = 0.0f;
+    float areaM2 = 0.0f;                        // Welford sum of squared area deviations
+    float firstX = 0.0f, firstY = 0.0f;         // box centres of the first and last frame
+    float lastX = 0.0f, lastY = 0.0f;
+};
+
+/**
+ * @brief One frame of a tube: box plus crop and mask at box resolution.
+ */
+struct TubeFrame {
+    uint32_t tubeId = 0;
+    int64_t frameIndex = 0;
+    double timestampMs = 0.0;
+    cv::Rect box;
+    float conf = 0.0f;
+    uint16_t colors[kTubeColorBins] = {};   // per-mille of the object's pixels per colour bin, all 0 = unknown
+    std::vector<uint8_t> mask;      // RLE runs (EncodeMaskRLE) over the box, empty = whole box
+    std::vector<uint8_t> crop;      // encoded image (JPEG) of the box
+
+    bool decodeCrop(cv::Mat& out) const;
+    // 0/255 bitmap of the box size; all 255 when the tube has no masks
+    void decodeMask(cv::Mat& out) const;
+};
+
+struct TubeStoreInfo {
+    cv::Size frameSize;
+    double fps = 0.0;
+    int jpegQuality = 90;
+    size_t chunkBytes = 4 << 20;    // records are buffered up to this size, then written as one chunk
+};
+
+/**
+ * @brief Append-only tube container: "<name>.vstube".
+ *
+ *   header | chunk | chunk | ... | index | trailer
+ *
+ * Each chunk is a header (frame range, record count, checksum), a table of (tube, offset)
+ * per record and the records of consecutive analysed frames, so a tube lives in a few
+ * neighbouring chunks and can be read without the other tubes' crops. The index holds
+ * the chunk table and a TubeSummary per tube, each summary naming the chunks of its tube;
+ * the writer keeps only the current chunk and the summaries in memory. A file without a
+ * trailer (the writer did not close) is recovered by scanning chunks up to the first torn one.
+ */
+class TubeStoreWriter {
+public:
+    TubeStoreWriter() = default;
+    ~TubeStoreWriter() { Close(); }
+
+    TubeStoreWriter(const TubeStoreWriter&) = delete;
+    TubeStoreWriter& operator=(const TubeStoreWriter&) = delete;
+
+    bool Open(const std::string& pathUtf8, const TubeStoreInfo& info);
+    // Reopens a store that was not closed. Only the chunks that end within validBytes (0 = all
+    // complete chunks) are kept, the rest is cut off, and appending continues after them with
+    // the same tube ids.
+    bool Resume(const std::string& pathUtf8, uint64_t validBytes, size_t chunkBytes = 4 << 20);
+    // Writes the buffered records as a chunk; everything appended so far is then on disk
+    // and survives a crash up to bytesWritten()
+    bool Flush();
+    // Writes the last chunk, the index and the trailer; safe to call twice
+    bool Close();
+    bool IsOpen() const { return out_.is_open(); }
+
+    uint32_t NewTube(int trackId, int classId);
+    // Records one frame of a tube. Frames must arrive in non-decreasing frame order.
+    bool Append(uint32_t tubeId, int64_t frameIndex, double timestampMs, const cv::Rect& box, float conf,
+        const uint8_t* mask, size_t maskBytes, const uint8_t* crop, size_t cropBytes, const uint16_t* colors = nullptr);
+
+    const TubeStoreInfo& info() const { return info_; }
+    const std::vector<TubeSummary>& tubes() const { return tubes_; }
+    uint64_t bytesWritten() const { return written_; }
+
+private:
+    bool flushChunk();
+
+    struct ChunkEntry {
+        uint64_t offset;
+        int64_t firstFrame;
+        int64_t lastFrame;
+        uint32_t records;
+        uint32_t reserved;
+    };
+
+    std::string path_;
+    TubeStoreInfo info_;
+    std::ofstream out_;
+    uint64_t written_ = 0;
+    std::vector<uint8_t> chunk_;
+    std::vector<uint32_t> table_;       // tube id, payload offset per record of the current chunk
+    uint32_t chunkRecords_ = 0;
+    int64_t chunkFirst_ = 0;
+    int64_t chunkLast_ = 0;
+    std::vector<ChunkEntry> chunks_;
+    std::vector<TubeSummary> tubes_;
+    bool failed_ = false;
+
+    friend class TubeStoreReader;
+};
+
+/**
+ * @brief Random access to a closed (or recovered) tube store. Reads are serialized on one
+ *        file handle; decoding happens outside the lock, so any thread may read.
+ */
+class TubeStoreReader {
+public:
+    bool Open(const std::string& pathUtf8);
+    void Close();
+
+    const TubeStoreInfo& info() const { return info_; }
+    const std::vector<TubeSummary>& tubes() const { return tubes_; }
+    size_t chunkCount() const { return chunks_.size(); }
+    // Frame range of a chunk
+    bool chunkRange(size_t chunk, int64_t& firstFrame, int64_t& lastFrame) const;
+    // Size of a chunk on disk (header, record table and records) and its record count
+    bool chunkSize(size_t chunk, uint64_t& bytes, uint32_t& records) const;
+    // True if the index was rebuilt from the chunks (the writer did not close)
+    bool recovered() const { return recovered_; }
+
+    // Every record of one chunk, in frame order
+    bool ReadChunk(size_t chunk, std::vector<TubeFrame>& out) const;
+    // Every frame of one tube, in frame order; reads only that tube's records
+    bool ReadTube(uint32_t tubeId, std::vector<TubeFrame>& out) const;
+    // The frames of one tube held by one chunk (none if the tube skips it), in frame order
+    bool ReadTubeChunk(uint32_t tubeId, size_t chunk, std::vector<TubeFrame>& out) const;
+    // The frames of one tube at the given ranks (positions among its frames, ascending), in
+    // frame order; the other records are skipped without reading their crops
+    bool ReadTubeRecords(uint32_t tubeId, const std::vector<uint32_t>& ranks, std::vector<TubeFrame>& out) const;
+
+private:
+    bool openFile(const std::string& pathUtf8);
+    // Appends the tube's records in one chunk, or with ranks only those whose rank (counted
+    // on from *rank) is listed; mutex_ must be held
+    bool readTubeChunk(uint32_t tubeId, size_t chunk, std::vector<TubeFrame>& out,
+        const std::vector<uint32_t>* ranks = nullptr, uint32_t* rank = nullptr) const;
+    bool readIndex(uint64_t fileSize);
+    bool rebuildIndex(uint64_t fileSize);
+
+    std::string path_;
+    TubeStoreInfo info_;
+    mutable std::ifstream in_;
+    mutable std::mutex mutex_;
+    std::vector<TubeStoreWriter::ChunkEntry> chunks_;
+    std::vector<TubeSummary> tubes_;
+    uint64_t dataEnd_ = 0;              // end of the last chunk
+    bool recovered_ = false;
+
+    friend class TubeStoreWriter;
+};
@@ -0,0 +1,366 @@
+#include "pch.h"
+#include "video_pipeline.h"
+#include "result_block.h"
+#include "SynopsisEngine.h"
+#include "Logger.h"
+
+using Clock = std::chrono::steady_clock;
+
+// ============================================================================
+// PrefetchRing
+// ============================================================================
+PrefetchRing::Slot* PrefetchRing::beginWrite(bool overwrite, int& dropped)
+{
+    dropped = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (overwrite && count_ == slots_.size() && count_ > (reading_ ? 1u : 0u)) {
+        // The reader skips to the newest frame anyway, so replacing it loses nothing more
+        head_ = (head_ + slots_.size() - 1) % slots_.size();
+        --count_;
+        dropped = 1;
+    }
+    notFull_.wait(lock, [this] { return closed_ || count_ < slots_.size(); });
+    return closed_ ? nullptr : &slots_[head_];
+}
+
+void PrefetchRing::commitWrite()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        head_ = (head_ + 1) % slots_.size();
+        ++count_;
+    }
+    notEmpty_.notify_one();
+}
+
+void PrefetchRing::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finished_ = true;
+    }
+    notEmpty_.notify_all();
+}
+
+PrefetchRing::Slot* PrefetchRing::beginRead(bool latestOnly, int& skipped)
+{
+    skipped = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    notEmpty_.wait(lock, [this] { return closed_ || finished_ || count_ > 0; });
+    if (closed_ || count_ == 0)
+        return nullptr;
+
+    if (latestOnly && count_ > 1) {
+        skipped = static_cast<int>(count_ - 1);
+        tail_ = (tail_ + count_ - 1) % slots_.size();
+        count_ = 1;
+        notFull_.notify_one();
+    }
+    reading_ = true;
+    return &slots_[tail_];
+}
+
+void PrefetchRing::commitRead()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tail_ = (tail_ + 1) % slots_.size();
+        --count_;
+        reading_ = false;
+    }
+    notFull_.notify_one();
+}
+
+void PrefetchRing::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+    }
+    notEmpty_.notify_all();
+    notFull_.notify_all();
+}
+
+// ============================================================================
+// VideoPipeline
+// ============================================================================
+static vsVideoOptions withDefaults(const vsVideoOptions& in)
+{
+    vsVideoOptions o = in;
+    if (o.prefetchFrames <= 0)
+        o.prefetchFrames = 8;
+    if (o.maxPendingResults <= 0)
+        o.maxPendingResults = 32;
+    if (o.frameStride <= 0)
+        o.frameStride = 1;
+    if (o.pacing == VS_VIDEO_LATEST && o.prefetchFrames < 2)
+        o.prefetchFrames = 2;   // one slot being read, one the decoder can keep replacing
+    return o;
+}
+
+VideoPipeline::VideoPipeline(int sourceId, const vsVideoOptions& options, InferFn infer, MetricsRegistry* metrics,
+    vsFrameResultCallback callback, void* userData)
+    : sourceId_(sourceId)
+    , streamId_(sourceId >= 0 && sourceId < MetricsRegistry::kMaxStreams ? sourceId : 0)
+    , options_(withDefaults(options))
+    , infer_(std::move(infer))
+    , metrics_(metrics)
+    , callback_(callback)
+    , userData_(userData)
+    , ring_(static_cast<size_t>(withDefaults(options).prefetchFrames))
+{
+    if (options.output && options.output->pathUtf8 && *options.output->pathUtf8) {
+        outputOptions_ = *options.output;
+        outputPath_ = options.output->pathUtf8;
+        outputOptions_.pathUtf8 = nullptr;
+    }
+    options_.output = nullptr;
+}
+
+VideoPipeline::~VideoPipeline()
+{
+    Stop();
+}
+
+bool VideoPipeline::Open(const std::string& url)
+{
+    if (!cap_.open(url)) {
+        LOG_ERROR_STREAM("[VideoPipeline] Failed to open source " << sourceId_ << ": " << url);
+        return false;
+    }
+    width_ = static_cast<int>(cap_.get(cv::CAP_PROP_FRAME_WIDTH));
+    height_ = static_cast<int>(cap_.get(cv::CAP_PROP_FRAME_HEIGHT));
+    fps_ = cap_.get(cv::CAP_PROP_FPS);
+    const double frames = cap_.get(cv::CAP_PROP_FRAME_COUNT);
+    frameCount_ = frames > 0 ? static_cast<int64_t>(frames) : -1;
+
+    LOG_INFO_STREAM("[VideoPipeline] Source " << sourceId_ << " opened: " << width_ << "x" << height_
+        << " @ " << fps_ << " fps, " << frameCount_ << " frames, prefetch " << options_.prefetchFrames);
+
+    if (!outputPath_.empty()) {
+        const double fps = outputOptions_.fps > 0.0 ? outputOptions_.fps
+            : (fps_ > 0.0 ? fps_ / options_.frameStride : 0.0);
+        writer_ = std::make_unique<AnnotationWriter>();
+        if (!writer_->Open(outputPath_, cv::Size(width_, height_), fps, outputOptions_)) {
+            writer_.reset();
+            cap_.release();
+            return false;
+        }
+    }
+    return true;
+}
+
+void VideoPipeline::Start()
+{
+    decodeThread_ = std::thread(&VideoPipeline::decodeLoop, this);
+    inferThread_ = std::thread(&VideoPipeline::inferLoop, this);
+}
+
+void VideoPipeline::Stop()
+{
+    stop_ = true;
+    ring_.close();
+    {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        ended_ = true;
+    }
+    resultSpace_.notify_all();
+    resultReady_.notify_all();
+
+    if (decodeThread_.joinable())
+        decodeThread_.join();
+    if (inferThread_.joinable())
+        inferThread_.join();
+    cap_.release();
+    if (writer_)
+        writer_->Close();
+
+    std::lock_guard<std::mutex> lock(resultMutex_);
+    for (auto& r : results_)
+        FreeResultBlock(r.result);
+    results_.clear();
+}
+
+void VideoPipeline::decodeLoop()
+{
+    const int stride = options_.frameStride;
+    const bool latestOnly = options_.pacing == VS_VIDEO_LATEST;
+    int64_t index = 0;
+    bool failed = false;
+
+    while (!stop_) {
+        // Frames outside the stride are grabbed but never converted
+        bool more = true;
+        while (stride > 1 && index % stride != 0) {
+            if (!cap_.grab()) {
+                more = false;
+                break;
+            }
+            ++index;
+        }
+        if (!more)
+            break;
+
+        int replaced = 0;
+        PrefetchRing::Slot* slot = ring_.beginWrite(latestOnly, replaced);
+        if (!slot)
+            break;
+        if (replaced > 0) {
+            dropped_ += replaced;
+            if (metrics_)
+                metrics_->addDropped(streamId_, static_cast<uint64_t>(replaced));
+        }
+        try {
+            if (!cap_.read(slot->frame) || slot->frame.empty())
+                break;
+        }
+        catch (const cv::Exception& e) {
+            LOG_ERROR_STREAM("[VideoPipeline] Decode error on source " << sourceId_ << ": " << e.what());
+            failed = true;
+            break;
+        }
+        if (slot->frame.type() != CV_8UC3)
+            cv::cvtColor(slot->frame, slot->frame, slot->frame.channels() == 1 ? cv::COLOR_GRAY2BGR : cv::COLOR_BGRA2BGR);
+
+        slot->index = index++;
+        slot->timestampMs = cap_.get(cv::CAP_PROP_POS_MSEC);
+        slot->decodedAt = Clock::now();
+        ring_.commitWrite();
+        ++decoded_;
+    }
+
+    if (failed)
+        state_ = VS_VIDEO_FAILED;
+    ring_.finish();
+}
+
+void VideoPipeline::inferLoop()
+{
+    metrics::setThreadStream(streamId_);
+    const bool latestOnly = options_.pacing == VS_VIDEO_LATEST;
+
+    for (;;) {
+        int skipped = 0;
+        PrefetchRing::Slot* slot = ring_.beginRead(latestOnly, skipped);
+        if (!slot)
+            break;
+        if (skipped > 0) {
+            dropped_ += skipped;
+            if (metrics_)
+                metrics_->addDropped(streamId_, static_cast<uint64_t>(skipped));
+        }
+        if (metrics_) {
+            const auto waited = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - slot->decodedAt);
+            metrics_->record(streamId_, MetricStage::QueueWait, static_cast<uint64_t>(waited.count()));
+        }
+
+        vsFrameResult frame = {};
+        frame.sourceId = sourceId_;
+        frame.frameIndex = slot->index;
+        frame.timestampMs = slot->timestampMs;
+        try {
+            frame.result = infer_(slot->frame);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR_STREAM("[VideoPipeline] Inference failed on source " << sourceId_ << " frame " << slot->index << ": " << e.what());
+            frame.result = nullptr;
+            frame.status = VS_ERROR_UNKNOWN;
+        }
+        // Copies frame and result; drops the frame rather than waiting for the encoder
+        if (writer_)
+            writer_->Submit(slot->frame, frame.result);
+        ring_.commitRead();
+
+        ++analysed_;
+        deliver(frame);
+    }
+
+    if (stop_)
+        return;
+    if (state_ == VS_VIDEO_RUNNING)
+        state_ = VS_VIDEO_ENDED;
+    LOG_INFO_STREAM("[VideoPipeline] Source " << sourceId_ << " finished: " << analysed_.load() << " analysed, "
+        << dropped_.load() << " dropped");
+
+    if (callback_) {
+        vsFrameResult end = {};
+        end.sourceId = sourceId_;
+        end.endOfStream = 1;
+        end.frameIndex = -1;
+        callback_(userData_, &end);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        ended_ = true;
+    }
+    resultReady_.notify_all();
+}
+
+void VideoPipeline::deliver(const vsFrameResult& frame)
+{
+    if (callback_) {
+        callback_(userData_, &frame);
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(resultMutex_);
+    const size_t limit = static_cast<size_t>(options_.maxPendingResults);
+    if (options_.pacing == VS_VIDEO_LATEST) {
+        // Nobody is polling fast enough: keep the newest results
+        while (results_.size() >= limit) {
+            FreeResultBlock(results_.front().result);
+            results_.pop_front();
+            ++dropped_;
+            if (metrics_)
+                metrics_->addDropped(streamId_, 1);
+        }
+    }
+    else {
+        resultSpace_.wait(lock, [&] { return stop_ || results_.size() < limit; });
+        if (stop_) {
+            FreeResultBlock(frame.result);
+            return;
+        }
+    }
+    results_.push_back(frame);
+    lock.unlock();
+    resultReady_.notify_one();
+}
+
+VideoPipeline::PollStatus VideoPipeline::Poll(vsFrameResult& out, int timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(resultMutex_);
+    const auto ready = [this] { return !results_.empty() || ended_; };
+    if (timeoutMs < 0)
+        resultReady_.wait(lock, ready);
+    else if (!resultReady_.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready))
+        return PollStatus::Timeout;
+
+    if (results_.empty())
+        return PollStatus::Ended;
+    out = results_.front();
+    results_.pop_front();
+    lock.unlock();
+    resultSpace_.notify_one();
+    return PollStatus::Frame;
+}
+
+void VideoPipeline::GetInfo(vsVideoInfo& out) const
+{
+    out.width = width_;
+    out.height = height_;
+    out.fps = fps_;
+    out.frameCount = frameCount_;
+    out.state = state_.load();
+    out.framesDecoded = decoded_.load();
+    out.framesAnalysed = analysed_.load();
+    out.framesDropped = dropped_.load();
+}
+
+bool VideoPipeline::GetWriterStats(vsWriterStats& out) const
+{
+    if (!writer_)
+        return false;
+    writer_->GetStats(out);
+    return true;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "vs_video.h"
+#include "metrics_registry.h"
+#include "annotation_writer.h"
+
+/**
+ * @brief Fixed-size ring of decoded frames, written and read in place.
+ *
+ * The decoder reads straight into a slot's cv::Mat, so after the first lap no frame
+ * buffer is allocated again; the consumer works on the slot and only then releases it.
+ * In overwrite mode a full ring gives the producer its newest waiting slot back instead
+ * of blocking; that slot is never the one being read. One producer, one consumer.
+ */
+class PrefetchRing {
+public:
+    struct Slot {
+        cv::Mat frame;
+        int64_t index = 0;
+        double timestampMs = 0.0;
+        std::chrono::steady_clock::time_point decodedAt;
+    };
+
+    explicit PrefetchRing(size_t capacity) : slots_(capacity) {}
+
+    // Producer: next free slot, or nullptr once closed. With overwrite, a full ring drops its
+    // newest waiting frame for the slot (counted in dropped) unless that frame is being read.
+    Slot* beginWrite(bool overwrite, int& dropped);
+    Slot* beginWrite() { int dropped; return beginWrite(false, dropped); }
+    void commitWrite();
+    // Producer: no more frames will come
+    void finish();
+
+    // Consumer: oldest filled slot, or nullptr when finished and empty (or closed).
+    // With latestOnly, older filled slots are released first and counted in skipped.
+    Slot* beginRead(bool latestOnly, int& skipped);
+    void commitRead();
+
+    // Wakes both sides for shutdown; pending frames are abandoned
+    void close();
+
+private:
+    std::vector<Slot> slots_;
+    size_t head_ = 0;       // next slot to write
+    size_t tail_ = 0;       // next slot to read
+    size_t count_ = 0;
+    bool reading_ = false;  // slot at tail_ is held between beginRead and commitRead
+    bool finished_ = false;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+};
+
+/**
+ * @brief Decode -> prefetch ring -> inference pipeline of one opened source.
+ *
+ * InferFn runs the handle's task on a BGR frame and returns a result block (or
+ * nullptr). It is called on the pipeline's inference thread, which also records
+ * queue wait and drops into the handle's metrics under the source's stream id.
+ * With vsVideoOptions::output set, analysed frames also go to an AnnotationWriter.
+ */
+class VideoPipeline {
+public:
+    using InferFn = std::function<vsResultHeader*(const cv::Mat& frame)>;
+
+    enum class PollStatus { Frame, Timeout, Ended };
+
+    VideoPipeline(int sourceId, const vsVideoOptions& options, InferFn infer, MetricsRegistry* metrics,
+        vsFrameResultCallback callback, void* userData);
+    ~VideoPipeline();
+
+    VideoPipeline(const VideoPipeline&) = delete;
+    VideoPipeline& operator=(const VideoPipeline&) = delete;
+
+    // Opens the source (file path or stream URL, UTF-8) and the annotated output, if any
+    bool Open(const std::string& url);
+    // Starts decoding and inference; metrics and infer are used from here on
+    void Start();
+    // Stops both threads and releases undelivered results; safe to call twice
+    void Stop();
+
+    PollStatus Poll(vsFrameResult& out, int timeoutMs);
+    void GetInfo(vsVideoInfo& out) const;
+    // False if the source has no annotated output
+    bool GetWriterStats(vsWriterStats& out) const;
+
+    bool usesCallback() const { return callback_ != nullptr; }
+
+private:
+    void decodeLoop();
+    void inferLoop();
+    void deliver(const vsFrameResult& frame);
+
+    const int sourceId_;
+    const int streamId_;
+    vsVideoOptions options_;
+    InferFn infer_;
+    MetricsRegistry* metrics_;
+    vsFrameResultCallback callback_;
+    void* userData_;
+
+    cv::VideoCapture cap_;
+    int width_ = 0;
+    int height_ = 0;
+    double fps_ = 0.0;
+    int64_t frameCount_ = -1;
+
+    // Annotated output (options copied at construction, the caller's strings may go away)
+    std::string outputPath_;
+    vsWriterOptions outputOptions_ = {};
+    std::unique_ptr<AnnotationWriter> writer_;
+
+    PrefetchRing ring_;
+    std::thread decodeThread_;
+    std::thread inferThread_;
+    std::atomic<bool> stop_{ false };
+    std::atomic<int> state_{ VS_VIDEO_RUNNING };
+    std::atomic<int64_t> decoded_{ 0 };
+    std::atomic<int64_t> analysed_{ 0 };
+    std::atomic<int64_t> dropped_{ 0 };
+
+    // Poll mode results, bounded by options_.maxPendingResults
+    std::deque<vsFrameResult> results_;
+    bool ended_ = false;
+    std::mutex resultMutex_;
+    std::condition_variable resultReady_;
+    std::condition_variable resultSpace_;
+};
@@ -0,0 +1,69 @@
+#include "pch.h"
+#include "video_segments.h"
+#include <algorithm>
+#include "Logger.h"
+
+namespace {
+
+const int kKeyframeScan = 1000;     // packets read past a nominal boundary looking for a keyframe
+
+} // namespace
+
+std::vector<VideoSegment> PlanVideoSegments(const std::string& url, int64_t frameCount, int count, int64_t overlapFrames)
+{
+    std::vector<int64_t> starts = { 0 };
+    if (count > 1 && frameCount > count) {
+        cv::VideoCapture raw;
+        bool rawOk = false;
+        try {
+            rawOk = raw.open(url, cv::CAP_FFMPEG, { cv::CAP_PROP_FORMAT, -1 });
+        }
+        catch (const cv::Exception&) {
+        }
+
+        for (int k = 1; k < count; ++k) {
+            int64_t start = frameCount * k / count;
+            if (rawOk && raw.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(start))) {
+                int64_t pos = static_cast<int64_t>(raw.get(cv::CAP_PROP_POS_FRAMES));
+                cv::Mat packet;
+                for (int i = 0; i < kKeyframeScan && pos >= 0 && raw.read(packet); ++i, ++pos) {
+                    if (raw.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) > 0.0) {
+                        start = pos;
+                        break;
+                    }
+                }
+            }
+            if (start > starts.back() && start < frameCount)
+                starts.push_back(start);
+        }
+        if (!rawOk)
+            LOG_INFO_STREAM("[VideoSegments] No packet access for " << url << ", splitting at nominal frames");
+    }
+
+    std::vector<VideoSegment> segments(starts.size());
+    for (size_t k = 0; k < starts.size(); ++k) {
+        segments[k].begin = starts[k];
+        segments[k].end = k + 1 < starts.size() ? starts[k + 1] : INT64_MAX;
+        segments[k].decodeFrom = k == 0 ? 0 : std::max(starts[k - 1], starts[k] - overlapFrames);
+    }
+    return segments;
+}
+
+int64_t SeekToFrame(cv::VideoCapture& cap, int64_t frame)
+{
+    if (frame <= 0)
+        return 0;
+    int64_t pos = 0;
+    if (cap.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frame)))
+        pos = std::max<int64_t>(0, static_cast<int64_t>(cap.get(cv::CAP_PROP_POS_FRAMES)));
+    if (pos > frame) {
+        LOG_WARNING_STREAM("[VideoSegments] Seek to frame " << frame << " landed on " << pos);
+        return pos;
+    }
+    // Short of the target (or no seeking at all): walk the rest without decoding
+    for (; pos < frame; ++pos) {
+        if (!cap.grab())
+            return -1;
+    }
+    return pos;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * @brief A frame range of a file analysed by its own decoder.
+ */
+struct VideoSegment {
+    int64_t begin = 0;          // first frame the segment owns
+    int64_t end = INT64_MAX;    // one past its last frame
+    int64_t decodeFrom = 0;     // first frame it decodes: begin less the stitching overlap
+};
+
+/**
+ * Splits [0, frameCount) into at most `count` segments. Each boundary is moved forward to
+ * the next keyframe, found by reading packets without decoding them (FFmpeg raw mode);
+ * where the backend cannot say, the nominal boundary stays and that decoder simply starts
+ * at the keyframe before it. Every segment but the first also decodes overlapFrames frames
+ * of its predecessor so tracks can be matched across the boundary.
+ */
+std::vector<VideoSegment> PlanVideoSegments(const std::string& url, int64_t frameCount, int count, int64_t overlapFrames);
+
+// Positions a freshly opened capture so the next read() returns `frame`. Returns the index
+// the next read() will actually return (later than frame if the container only seeks to
+// keyframes past it), or -1 if the source ends first.
+int64_t SeekToFrame(cv::VideoCapture& cap, int64_t frame);
@@ -0,0 +1,534 @@
+#include "pch.h"
+#include "DetectionIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "Logger.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kIndexMagic[4] = { 'V', 'S', 'D', 'X' };
+constexpr char kJournalMagic[4] = { 'V', 'S', 'D', 'J' };
+constexpr uint32_t kVersion = 2;         // 2: model fingerprint
+// Pending frames plus their records held in memory before they are sealed into the index
+constexpr size_t kSealEvery = 1 << 16;
+
+using Fingerprint = DetectionIndex::Fingerprint;
+static_assert(sizeof(Fingerprint) == 48, "Fingerprint layout");
+
+struct IndexHeader {
+    char        magic[4];
+    uint32_t    version;
+    Fingerprint fingerprint;
+    uint64_t    frameCount;
+    uint64_t    objectCount;
+    uint64_t    reserved[3];
+};
+static_assert(sizeof(IndexHeader) == 96, "IndexHeader layout");
+
+struct JournalHeader {
+    char        magic[4];
+    uint32_t    version;
+    Fingerprint fingerprint;
+    uint64_t    reserved;
+};
+static_assert(sizeof(JournalHeader) == 64, "JournalHeader layout");
+
+struct JournalFrame {
+    int64_t frame;
+    int32_t count;
+    int32_t reserved;
+};
+
+size_t align8(size_t n)
+{
+    return (n + 7) & ~size_t(7);
+}
+
+// Byte offsets of the sections of a sealed index; counts must be bounded first (fitsIndex)
+struct IndexLayout {
+    uint64_t offsets, analysed, columns, total;
+
+    IndexLayout(uint64_t frames, uint64_t objects) {
+        offsets = sizeof(IndexHeader);
+        analysed = offsets + (frames + 1) * sizeof(uint64_t);
+        columns = analysed + align8((frames + 7) / 8);
+        total = columns + objects * 7 * sizeof(int32_t);
+    }
+};
+
+// True if a header's counts can describe a file of `size` bytes. Each section is checked on
+// its own before they are added up, so counts read from a damaged file cannot overflow.
+bool fitsIndex(uint64_t frames, uint64_t objects, uint64_t size)
+{
+    return size >= sizeof(IndexHeader) && frames < size / sizeof(uint64_t)
+        && objects <= size / (7 * sizeof(int32_t)) && IndexLayout(frames, objects).total <= size;
+}
+
+bool fileFingerprint(const std::string& path, uint64_t& size, int64_t& time)
+{
+    std::error_code ec;
+    const fs::path p = fs::u8path(path);
+    size = fs::file_size(p, ec);
+    if (ec)
+        return false;
+    time = static_cast<int64_t>(fs::last_write_time(p, ec).time_since_epoch().count());
+    return !ec;
+}
+
+uint64_t fnv1a(const std::string& s)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool sameFingerprint(const Fingerprint& a, const Fingerprint& b)
+{
+    return std::memcmp(&a, &b, sizeof(Fingerprint)) == 0;
+}
+
+} // namespace
+
+// ============================================================================
+// MappedFile
+// ============================================================================
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+#ifdef _WIN32
+    HANDLE file = ::CreateFileW(fs::u8path(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size{};
+    if (!::GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        ::CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = ::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* view = mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping)
+            ::CloseHandle(mapping);
+        ::CloseHandle(file);
+        return false;
+    }
+    file_ = file;
+    mapping_ = mapping;
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    data_ = static_cast<const uint8_t*>(view);
+    size_ = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+    if (data_)
+        ::UnmapViewOfFile(data_);
+    if (mapping_)
+        ::CloseHandle(mapping_);
+    if (file_)
+        ::CloseHandle(file_);
+    mapping_ = nullptr;
+    file_ = nullptr;
+#else
+    if (data_)
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+    if (fd_ >= 0)
+        ::close(fd_);
+    fd_ = -1;
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+// ============================================================================
+// DetectionIndex
+// ============================================================================
+bool DetectionIndex::Open(const std::string& videoPath, const Model& model)
+{
+    Close();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    fingerprint_ = {};
+    if (!fileFingerprint(videoPath, fingerprint_.sourceSize, fingerprint_.sourceTime))
+        return false;
+    // A model that cannot be read keeps size and time 0; its results still carry the path
+    if (!fileFingerprint(model.pathUtf8, fingerprint_.modelSize, fingerprint_.modelTime)) {
+        fingerprint_.modelSize = 0;
+        fingerprint_.modelTime = 0;
+    }
+    fingerprint_.modelPathHash = fnv1a(model.pathUtf8);
+    fingerprint_.confThreshold = model.confThreshold;
+    fingerprint_.iouThreshold = model.iouThreshold;
+
+    videoPath_ = videoPath;
+    indexPath_ = videoPath + ".vsdet";
+    journalPath_ = indexPath_ + ".log";
+    sealAt_ = kSealEvery;
+    open_ = true;
+
+    if (mapSealedLocked())
+        LOG_INFO_STREAM("[DetectionIndex] Loaded " << indexPath_ << ": " << sealedFrames_ << " frames");
+    replayJournalLocked();
+    return true;
+}
+
+void DetectionIndex::Close()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_)
+        return;
+    sealLocked();
+    journal_.close();
+    map_.Close();
+    sealedFrames_ = 0;
+    offsets_ = nullptr;
+    pending_.clear();
+    pendingRecords_ = 0;
+    sealAt_ = kSealEvery;
+    open_ = false;
+}
+
+bool DetectionIndex::IsOpen() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_;
+}
+
+bool DetectionIndex::mapSealedLocked()
+{
+    map_.Close();
+    sealedFrames_ = 0;
+    offsets_ = nullptr;
+
+    std::error_code ec;
+    if (!fs::exists(fs::u8path(indexPath_), ec) || !map_.Open(indexPath_))
+        return false;
+
+    IndexHeader h{};
+    bool valid = map_.size() >= sizeof(h);
+    if (valid) {
+        std::memcpy(&h, map_.data(), sizeof(h));
+        valid = std::memcmp(h.magic, kIndexMagic, 4) == 0 && h.version == kVersion
+            && sameFingerprint(h.fingerprint, fingerprint_)
+            && fitsIndex(h.frameCount, h.objectCount, map_.size());
+    }
+    if (valid) {
+        const IndexLayout layout(h.frameCount, h.objectCount);
+        const uint8_t* base = map_.data();
+        offsets_ = reinterpret_cast<const uint64_t*>(base + static_cast<size_t>(layout.offsets));
+        analysed_ = base + static_cast<size_t>(layout.analysed);
+        const int32_t* col = reinterpret_cast<const int32_t*>(base + static_cast<size_t>(layout.columns));
+        const size_t n = static_cast<size_t>(h.objectCount);
+        colX_ = col;
+        colY_ = col + n;
+        colW_ = col + 2 * n;
+        colH_ = col + 3 * n;
+        colScore_ = reinterpret_cast<const float*>(col + 4 * n);
+        colClass_ = col + 5 * n;
+        colTrack_ = col + 6 * n;
+        // Offsets must rise to objectCount, or a frame's range would leave the columns
+        valid = offsets_[0] == 0 && offsets_[h.frameCount] == h.objectCount;
+        for (uint64_t f = 0; valid && f < h.frameCount; ++f)
+            valid = offsets_[f] <= offsets_[f + 1];
+    }
+    if (!valid) {
+        LOG_INFO_STREAM("[DetectionIndex] Ignoring stale or damaged " << indexPath_);
+        map_.Close();
+        offsets_ = nullptr;
+        return false;
+    }
+    sealedFrames_ = static_cast<int64_t>(h.frameCount);
+    return true;
+}
+
+void DetectionIndex::replayJournalLocked()
+{
+    const fs::path path = fs::u8path(journalPath_);
+    std::error_code ec;
+    if (!fs::exists(path, ec))
+        return;
+
+    std::ifstream in(path, std::ios::binary);
+    JournalHeader h{};
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) || std::memcmp(h.magic, kJournalMagic, 4) != 0
+        || h.version != kVersion || !sameFingerprint(h.fingerprint, fingerprint_)) {
+        in.close();
+        fs::remove(path, ec);
+        return;
+    }
+
+    const uint64_t fileSize = fs::file_size(path, ec);
+    if (ec)
+        return;
+    uint64_t valid = sizeof(h);
+    size_t frames = 0;
+    JournalFrame jf{};
+    while (in.read(reinterpret_cast<char*>(&jf), sizeof(jf))) {
+        // A torn or damaged count must not size an allocation past what the file holds
+        const uint64_t remaining = fileSize - std::min(fileSize, valid + sizeof(jf));
+        if (jf.count < 0 || static_cast<uint64_t>(jf.count) > remaining / sizeof(Record))
+            break;
+        std::vector<Record> records(static_cast<size_t>(jf.count));
+        if (jf.count > 0 && !in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(Record)))
+            break;
+        setPendingLocked(jf.frame, std::move(records));
+        valid += sizeof(jf) + static_cast<uint64_t>(jf.count) * sizeof(Record);
+        ++frames;
+    }
+    in.close();
+
+    // Drop a record cut short by a crash so new appends line up again
+    if (fs::file_size(path, ec) != valid && !ec)
+        fs::resize_file(path, valid, ec);
+    if (frames > 0)
+        LOG_INFO_STREAM("[DetectionIndex] Replayed " << frames << " frames from " << journalPath_);
+}
+
+bool DetectionIndex::sealedContains(int64_t frame) const
+{
+    return offsets_ && frame >= 0 && frame < sealedFrames_ && (analysed_[frame >> 3] & (1u << (frame & 7))) != 0;
+}
+
+bool DetectionIndex::Contains(int64_t frame) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.count(frame) != 0 || sealedContains(frame);
+}
+
+bool DetectionIndex::Lookup(int64_t frame, std::vector<Detection>& out, std::vector<int32_t>* trackIds) const
+{
+    out.clear();
+    if (trackIds)
+        trackIds->clear();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_.find(frame);
+    if (it != pending_.end()) {
+        for (const Record& r : it->second) {
+            Detection d;
+            d.box = BoundingBox(r.x, r.y, r.w, r.h);
+            d.conf = r.score;
+            d.classId = r.classId;
+            out.push_back(d);
+            if (trackIds)
+                trackIds->push_back(r.trackId);
+        }
+        return true;
+    }
+    if (!sealedContains(frame))
+        return false;
+
+    const uint64_t first = offsets_[frame];
+    const uint64_t last = offsets_[frame + 1];
+    if (first > last || last > offsets_[sealedFrames_])
+        return false;
+    out.resize(static_cast<size_t>(last - first));
+    for (uint64_t i = first; i < last; ++i) {
+        Detection& d = out[static_cast<size_t>(i - first)];
+        d.box = BoundingBox(colX_[i], colY_[i], colW_[i], colH_[i]);
+        d.conf = colScore_[i];
+        d.classId = colClass_[i];
+    }
+    if (trackIds)
+        trackIds->assign(colTrack_ + first, colTrack_ + last);
+    return true;
+}
+
+void DetectionIndex::Append(int64_t frame, const Detection* detections, int count, const int32_t* trackIds)
+{
+    if (frame < 0)
+        return;
+    count = detections ? std::max(count, 0) : 0;
+
+    std::vector<Record> records(static_cast<size_t>(count));
+    for (int i = 0; i < count; i++) {
+        const Detection& d = detections[i];
+        records[i] = Record{ d.box.x, d.box.y, d.box.width, d.box.height, d.conf, d.classId, trackIds ? trackIds[i] : -1 };
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_)
+        return;
+
+    if (!journal_.is_open()) {
+        const fs::path path = fs::u8path(journalPath_);
+        std::error_code ec;
+        const bool fresh = !fs::exists(path, ec) || fs::file_size(path, ec) == 0;
+        journal_.open(path, std::ios::binary | std::ios::app);
+        if (fresh && journal_) {
+            JournalHeader h{};
+            std::memcpy(h.magic, kJournalMagic, 4);
+            h.version = kVersion;
+            h.fingerprint = fingerprint_;
+            journal_.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        }
+    }
+    if (journal_) {
+        const JournalFrame jf{ frame, count, 0 };
+        journal_.write(reinterpret_cast<const char*>(&jf), sizeof(jf));
+        if (count > 0)
+            journal_.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+        journal_.flush();       // a crash loses at most the frame being written
+    }
+    setPendingLocked(frame, std::move(records));
+
+    // Bound what a long session keeps in memory: seal every kSealEvery frames and records.
+    // After a failed seal the journal still holds everything; retry one batch later.
+    if (pending_.size() + pendingRecords_ >= sealAt_ && !sealLocked())
+        sealAt_ = pending_.size() + pendingRecords_ + kSealEvery;
+}
+
+void DetectionIndex::setPendingLocked(int64_t frame, std::vector<Record> records)
+{
+    std::vector<Record>& slot = pending_[frame];
+    pendingRecords_ = pendingRecords_ - slot.size() + records.size();
+    slot = std::move(records);
+}
+
+bool DetectionIndex::Seal()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_ && sealLocked();
+}
+
+bool DetectionIndex::sealLocked()
+{
+    if (pending_.empty())
+        return true;
+
+    int64_t frames = sealedFrames_;
+    for (const auto& kv : pending_)
+        frames = std::max(frames, kv.first + 1);
+
+    // Offsets and the analysed bitmap: pending results win over sealed ones
+    std::vector<uint64_t> offsets(static_cast<size_t>(frames) + 1, 0);
+    std::vector<uint8_t> analysed(align8((static_cast<size_t>(frames) + 7) / 8), 0);
+    for (int64_t f = 0; f < frames; ++f) {
+        uint64_t count = 0;
+        auto it = pending_.find(f);
+        if (it != pending_.end())
+            count = it->second.size();
+        else if (sealedContains(f))
+            count = offsets_[f + 1] - offsets_[f];
+        if (it != pending_.end() || sealedContains(f))
+            analysed[static_cast<size_t>(f >> 3)] |= static_cast<uint8_t>(1u << (f & 7));
+        offsets[static_cast<size_t>(f) + 1] = offsets[static_cast<size_t>(f)] + count;
+    }
+    const uint64_t objects = offsets.back();
+
+    const fs::path tmp = fs::u8path(indexPath_ + ".tmp");
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            LOG_ERROR_STREAM("[DetectionIndex] Cannot write " << indexPath_ << ".tmp");
+            return false;
+        }
+        IndexHeader h{};
+        std::memcpy(h.magic, kIndexMagic, 4);
+        h.version = kVersion;
+        h.fingerprint = fingerprint_;
+        h.frameCount = static_cast<uint64_t>(frames);
+        h.objectCount = objects;
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(analysed.data()), analysed.size());
+
+        // One column at a time, frame order
+        std::vector<int32_t> column;
+        column.reserve(static_cast<size_t>(objects));
+        auto writeColumn = [&](auto pendingField, auto sealedColumn) {
+            column.clear();
+            for (int64_t f = 0; f < frames; ++f) {
+                auto it = pending_.find(f);
+                if (it != pending_.end()) {
+                    for (const Record& r : it->second)
+                        column.push_back(pendingField(r));
+                }
+                else if (sealedContains(f)) {
+                    const int32_t* src = sealedColumn();
+                    column.insert(column.end(), src + offsets_[f], src + offsets_[f + 1]);
+                }
+            }
+            out.write(reinterpret_cast<const char*>(column.data()), column.size() * sizeof(int32_t));
+        };
+        auto scoreBits = [](float v) { int32_t b; std::memcpy(&b, &v, sizeof(b)); return b; };
+        writeColumn([](const Record& r) { return r.x; }, [this] { return colX_; });
+        writeColumn([](const Record& r) { return r.y; }, [this] { return colY_; });
+        writeColumn([](const Record& r) { return r.w; }, [this] { return colW_; });
+        writeColumn([](const Record& r) { return r.h; }, [this] { return colH_; });
+        writeColumn([&](const Record& r) { return scoreBits(r.score); }, [this] { return reinterpret_cast<const int32_t*>(colScore_); });
+        writeColumn([](const Record& r) { return r.classId; }, [this] { return colClass_; });
+        writeColumn([](const Record& r) { return r.trackId; }, [this] { return colTrack_; });
+        if (!out.flush()) {
+            LOG_ERROR_STREAM("[DetectionIndex] Write failed for " << indexPath_ << ".tmp");
+            return false;
+        }
+    }
+
+    // The old mapping has to go before the file can be replaced (Windows)
+    map_.Close();
+    offsets_ = nullptr;
+    sealedFrames_ = 0;
+    journal_.close();
+
+    std::error_code ec;
+    fs::rename(tmp, fs::u8path(indexPath_), ec);
+    if (ec) {
+        LOG_ERROR_STREAM("[DetectionIndex] Cannot replace " << indexPath_ << ": " << ec.message());
+        fs::remove(tmp, ec);
+        mapSealedLocked();      // the journal still holds this session's results
+        return false;
+    }
+    fs::remove(fs::u8path(journalPath_), ec);
+    LOG_INFO_STREAM("[DetectionIndex] Sealed " << pending_.size() << " new frames into " << indexPath_
+        << " (" << frames << " frames, " << objects << " objects)");
+    pending_.clear();
+    pendingRecords_ = 0;
+    sealAt_ = kSealEvery;
+    return mapSealedLocked();
+}
+
+size_t DetectionIndex::FramesIndexed() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = pending_.size();
+    for (int64_t f = 0; f < sealedFrames_; ++f) {
+        if (sealedContains(f) && !pending_.count(f))
+            ++n;
+    }
+    return n;
+}
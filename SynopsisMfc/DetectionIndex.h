@@ -0,0 +1,134 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "yolo_define.h"
+
+/**
+ * @brief Read-only memory mapping of a whole file.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_ = nullptr;
+    void* mapping_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
+
+/**
+ * @brief Persistent per-video detection store: "<video>.vsdet" next to the video.
+ *
+ * The sealed file is columnar and memory-mapped for lookups:
+ *   header | frame offsets (frameCount + 1) | analysed bitmap | x | y | w | h | score | class | track
+ * Results of the current session are appended to a journal ("<video>.vsdet.log") and kept in
+ * memory; Close() (or Seal()) merges them into a new sealed file, as does Append() whenever
+ * 64K frames and records are pending. A journal left by a crash is
+ * replayed on the next Open(). Both files carry a Fingerprint of the video (size, write time) and
+ * of the model (path, size, write time, thresholds) and are dropped once either changes, so
+ * results of another model or other thresholds are never served.
+ *
+ * Lookup() distinguishes "analysed, nothing found" from "not analysed". Track ids are -1 until
+ * a tracker provides them. Safe to call from the decoder and UI threads concurrently.
+ */
+class DetectionIndex {
+public:
+    DetectionIndex() = default;
+    ~DetectionIndex() { Close(); }
+
+    DetectionIndex(const DetectionIndex&) = delete;
+    DetectionIndex& operator=(const DetectionIndex&) = delete;
+
+    // The model the results come from (vsGetModelInfo)
+    struct Model {
+        std::string pathUtf8;
+        float confThreshold = 0.0f;
+        float iouThreshold = 0.0f;
+    };
+
+    // Everything stored results depend on; 48 bytes, no padding, compared bytewise
+    struct Fingerprint {
+        uint64_t sourceSize;
+        int64_t  sourceTime;
+        uint64_t modelSize;
+        int64_t  modelTime;
+        uint64_t modelPathHash;
+        float    confThreshold;
+        float    iouThreshold;
+    };
+
+    bool Open(const std::string& videoPath, const Model& model);
+    void Close();                   // seals pending results
+    bool IsOpen() const;
+
+    // True if frame was analysed; out gets its detections (possibly none)
+    bool Lookup(int64_t frame, std::vector<Detection>& out, std::vector<int32_t>* trackIds = nullptr) const;
+    bool Contains(int64_t frame) const;
+
+    // Records the result of one frame; a later record for the same frame replaces it
+    void Append(int64_t frame, const Detection* detections, int count, const int32_t* trackIds = nullptr);
+    bool Seal();
+
+    size_t FramesIndexed() const;
+
+private:
+    struct Record {
+        int32_t x, y, w, h;
+        float score;
+        int32_t classId;
+        int32_t trackId;
+    };
+
+    bool mapSealedLocked();
+    void replayJournalLocked();
+    bool sealLocked();
+    bool sealedContains(int64_t frame) const;
+    void setPendingLocked(int64_t frame, std::vector<Record> records);
+
+    std::string videoPath_;
+    std::string indexPath_;
+    std::string journalPath_;
+    Fingerprint fingerprint_ = {};
+
+    mutable std::mutex mutex_;
+    bool open_ = false;
+
+    // Sealed columns (views into map_)
+    MappedFile map_;
+    int64_t sealedFrames_ = 0;
+    const uint64_t* offsets_ = nullptr;
+    const uint8_t* analysed_ = nullptr;
+    const int32_t* colX_ = nullptr;
+    const int32_t* colY_ = nullptr;
+    const int32_t* colW_ = nullptr;
+    const int32_t* colH_ = nullptr;
+    const float* colScore_ = nullptr;
+    const int32_t* colClass_ = nullptr;
+    const int32_t* colTrack_ = nullptr;
+
+    // This session's results, mirrored in the journal; sealed once frames plus records
+    // reach sealAt_
+    std::unordered_map<int64_t, std::vector<Record>> pending_;
+    size_t pendingRecords_ = 0;
+    size_t sealAt_ = 0;
+    std::ofstream journal_;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "yolo_define.h"
+
+/**
+ * @brief Detection results of the most recent frames, slot = frameIndex mod capacity.
+ *
+ * Each slot owns a preallocated slab of maxPerFrame detections and is published with a
+ * seqlock: the writer makes the sequence odd, copies, and makes it even again; a reader
+ * copies and retries only if the sequence moved meanwhile. Writers never wait for readers
+ * and neither side allocates or takes a lock. Slab contents are relaxed atomic words, so
+ * a reader racing a writer gets a retry, never a torn result.
+ *
+ * A newer frame that lands on the same slot replaces the older one (lookups for the old
+ * frame then miss). Frames with more than maxPerFrame detections are truncated.
+ */
+class DetectionRing {
+public:
+    explicit DetectionRing(size_t frames = 128, size_t maxPerFrame = 256)
+        : maxPerFrame_(maxPerFrame > 0 ? maxPerFrame : 1)
+    {
+        size_t cap = 1;
+        while (cap < frames)
+            cap <<= 1;
+        mask_ = cap - 1;
+        slots_.reset(new Slot[cap]);
+        slab_.reset(new std::atomic<uint32_t>[cap * maxPerFrame_ * kWords]);
+    }
+
+    DetectionRing(const DetectionRing&) = delete;
+    DetectionRing& operator=(const DetectionRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+    size_t maxPerFrame() const { return maxPerFrame_; }
+    uint64_t truncated() const { return truncated_.load(std::memory_order_relaxed); }
+
+    // Stores the result of one frame (count 0 = analysed, nothing found)
+    void publish(int64_t frameIndex, const Detection* detections, int count) {
+        if (frameIndex < 0)
+            return;
+        size_t n = (detections && count > 0) ? static_cast<size_t>(count) : 0;
+        if (n > maxPerFrame_) {
+            truncated_.fetch_add(1, std::memory_order_relaxed);
+            n = maxPerFrame_;
+        }
+        write(static_cast<size_t>(frameIndex) & mask_, frameIndex, detections, n);
+    }
+
+    // Copies the result of frameIndex into out. Reserve maxPerFrame() in out once and this
+    // never allocates. Returns false if the frame has no result (or was overwritten).
+    bool read(int64_t frameIndex, std::vector<Detection>& out) const {
+        out.clear();
+        if (frameIndex < 0)
+            return false;
+        const size_t index = static_cast<size_t>(frameIndex) & mask_;
+        const Slot& slot = slots_[index];
+        const std::atomic<uint32_t>* words = slab_.get() + index * maxPerFrame_ * kWords;
+
+        for (;;) {
+            const uint32_t before = slot.seq.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();      // a writer is mid-copy on this slot
+                continue;
+            }
+            const bool hit = slot.frame.load(std::memory_order_relaxed) == frameIndex;
+            const size_t n = hit ? static_cast<size_t>(slot.count.load(std::memory_order_relaxed)) : 0;
+            out.resize(n);
+            for (size_t i = 0; i < n; ++i) {
+                uint32_t raw[kWords];
+                for (size_t w = 0; w < kWords; ++w)
+                    raw[w] = words[i * kWords + w].load(std::memory_order_relaxed);
+                std::memcpy(&out[i], raw, sizeof(Detection));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == before)
+                return hit;
+            out.clear();
+        }
+    }
+
+    // Forgets every frame (new video, mode switch)
+    void clear() {
+        for (size_t i = 0; i <= mask_; ++i)
+            write(i, -1, nullptr, 0);
+    }
+
+private:
+    static_assert(std::is_trivially_copyable<Detection>::value && sizeof(Detection) % sizeof(uint32_t) == 0,
+        "Detection is copied as 32-bit words");
+    static constexpr size_t kWords = sizeof(Detection) / sizeof(uint32_t);
+
+    struct Slot {
+        std::atomic<uint32_t> seq{ 0 };         // odd while a writer owns the slot
+        std::atomic<int64_t> frame{ -1 };
+        std::atomic<int32_t> count{ 0 };
+    };
+
+    void write(size_t index, int64_t frameIndex, const Detection* detections, size_t n) {
+        Slot& slot = slots_[index];
+
+        // Claim the slot; only another writer on the same slot (frames capacity() apart) waits here
+        uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+        for (;;) {
+            if (seq & 1) {
+                std::this_thread::yield();
+                seq = slot.seq.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (slot.seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed))
+                break;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        std::atomic<uint32_t>* words = slab_.get() + index * maxPerFrame_ * kWords;
+        for (size_t i = 0; i < n; ++i) {
+            uint32_t raw[kWords];
+            std::memcpy(raw, &detections[i], sizeof(Detection));
+            for (size_t w = 0; w < kWords; ++w)
+                words[i * kWords + w].store(raw[w], std::memory_order_relaxed);
+        }
+        slot.count.store(static_cast<int32_t>(n), std::memory_order_relaxed);
+        slot.frame.store(frameIndex, std::memory_order_relaxed);
+        slot.seq.store(seq + 2, std::memory_order_release);
+    }
+
+    size_t mask_ = 0;
+    size_t maxPerFrame_;
+    std::unique_ptr<Slot[]> slots_;
+    std::unique_ptr<std::atomic<uint32_t>[]> slab_;
+    std::atomic<uint64_t> truncated_{ 0 };
+};
@@ -0,0 +1,231 @@
+#include "pch.h"
+#include "FramePool.h"
+#include <algorithm>
+
+struct FrameBuffer {
+    uchar* data = nullptr;
+    size_t capacity = 0;
+    cv::Mat mat;                                // header over data, set by acquire()
+    std::atomic<int> refs{ 0 };
+    std::shared_ptr<FramePool::Impl> home;      // set while handed out; null for overflow buffers
+
+    ~FrameBuffer() {
+        if (data)
+            cv::fastFree(data);
+    }
+
+    void allocate(size_t bytes) {
+        if (data)
+            cv::fastFree(data);
+        data = static_cast<uchar*>(cv::fastMalloc(bytes));
+        capacity = bytes;
+    }
+};
+
+struct FramePool::Impl {
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<FrameBuffer>> buffers;
+    std::vector<FrameBuffer*> idle;
+    size_t maxBuffers = 0;
+    std::atomic<uint64_t> overflow{ 0 };
+};
+
+static size_t frameBytes(int rows, int cols, int type)
+{
+    return static_cast<size_t>(rows) * static_cast<size_t>(cols) * CV_ELEM_SIZE(type);
+}
+
+// ============================================================================
+// FrameRef
+// ============================================================================
+FrameRef::FrameRef(const FrameRef& other) : buffer_(other.buffer_)
+{
+    if (buffer_)
+        buffer_->refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+FrameRef::FrameRef(FrameRef&& other) noexcept : buffer_(other.buffer_)
+{
+    other.buffer_ = nullptr;
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& other)
+{
+    if (buffer_ != other.buffer_) {
+        if (other.buffer_)
+            other.buffer_->refs.fetch_add(1, std::memory_order_relaxed);
+        reset();
+        buffer_ = other.buffer_;
+    }
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        buffer_ = other.buffer_;
+        other.buffer_ = nullptr;
+    }
+    return *this;
+}
+
+void FrameRef::reset()
+{
+    if (!buffer_)
+        return;
+    if (buffer_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        FramePool::recycle(buffer_);
+    buffer_ = nullptr;
+}
+
+bool FrameRef::empty() const
+{
+    return !buffer_ || buffer_->mat.empty();
+}
+
+const cv::Mat& FrameRef::mat() const
+{
+    static const cv::Mat none;
+    return buffer_ ? buffer_->mat : none;
+}
+
+cv::Mat& FrameRef::mat()
+{
+    // Writable access needs a buffer: a shared empty Mat would be written by every caller
+    CV_Assert(buffer_ != nullptr);
+    return buffer_->mat;
+}
+
+// ============================================================================
+// FramePool
+// ============================================================================
+FramePool::FramePool(size_t maxBuffers)
+    : impl_(std::make_shared<Impl>())
+{
+    impl_->maxBuffers = std::max<size_t>(1, maxBuffers);
+}
+
+FramePool::~FramePool() = default;
+
+void FramePool::setMaxBuffers(size_t maxBuffers)
+{
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    impl_->maxBuffers = std::max<size_t>(1, maxBuffers);
+}
+
+void FramePool::reserve(int rows, int cols, int type, size_t count)
+{
+    const size_t bytes = frameBytes(rows, cols, type);
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    Impl& p = *impl_;
+
+    // Idle buffers of an older geometry are resized now rather than on the first frames
+    for (FrameBuffer* b : p.idle) {
+        if (b->capacity < bytes)
+            b->allocate(bytes);
+    }
+    count = std::min(count, p.maxBuffers);
+    while (p.buffers.size() < count) {
+        auto b = std::make_unique<FrameBuffer>();
+        b->allocate(bytes);
+        p.idle.push_back(b.get());
+        p.buffers.push_back(std::move(b));
+    }
+}
+
+FrameRef FramePool::acquire(int rows, int cols, int type)
+{
+    const size_t bytes = frameBytes(rows, cols, type);
+    FrameBuffer* b = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        Impl& p = *impl_;
+        if (!p.idle.empty()) {
+            auto it = std::find_if(p.idle.begin(), p.idle.end(),
+                [bytes](const FrameBuffer* c) { return c->capacity >= bytes; });
+            if (it == p.idle.end())
+                it = p.idle.end() - 1;
+            b = *it;
+            *it = p.idle.back();
+            p.idle.pop_back();
+        }
+        else if (p.buffers.size() < p.maxBuffers) {
+            p.buffers.push_back(std::make_unique<FrameBuffer>());
+            b = p.buffers.back().get();
+        }
+        if (b)
+            b->home = impl_;
+    }
+
+    if (!b) {
+        // Every pooled buffer is held somewhere: fall back to a one-off allocation
+        b = new FrameBuffer();
+        impl_->overflow.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (b->capacity < bytes)
+        b->allocate(bytes);
+    b->mat = cv::Mat(rows, cols, type, b->data);
+    b->refs.store(1, std::memory_order_relaxed);
+    return FrameRef(b);
+}
+
+void FramePool::recycle(FrameBuffer* buffer)
+{
+    // Drops anything a decoder may have attached in place of the pooled pixels
+    buffer->mat.release();
+
+    std::shared_ptr<Impl> home = std::move(buffer->home);
+    if (!home) {
+        delete buffer;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(home->mutex);
+    home->idle.push_back(buffer);
+    // If the pool object is already gone, home is the last owner and frees everything here
+}
+
+size_t FramePool::maxBuffers() const
+{
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->maxBuffers;
+}
+
+size_t FramePool::allocated() const
+{
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->buffers.size();
+}
+
+size_t FramePool::inUse() const
+{
+    std::lock_guard<std::mutex> lock(impl_->mutex);
+    return impl_->buffers.size() - impl_->idle.size();
+}
+
+uint64_t FramePool::overflowCount() const
+{
+    return impl_->overflow.load(std::memory_order_relaxed);
+}
+
+bool ReadPooledFrame(cv::VideoCapture& cap, FramePool& pool, FrameRef& out, cv::Size& geometry)
+{
+    out = pool.acquire(geometry.height, geometry.width, CV_8UC3);
+    cv::Mat& dst = out.mat();
+    const uchar* pooled = dst.data;
+    if (!cap.read(dst) || dst.empty()) {
+        out.reset();
+        return false;
+    }
+    if (dst.data != pooled) {
+        // The backend did not decode in place (geometry differs from the container's
+        // claim): adopt the real geometry and copy this frame into a pooled buffer once
+        cv::Mat decoded = dst;
+        geometry = decoded.size();
+        if (decoded.type() != CV_8UC3)
+            cv::cvtColor(decoded, decoded, decoded.channels() == 1 ? cv::COLOR_GRAY2BGR : cv::COLOR_BGRA2BGR);
+        out = pool.acquire(geometry.height, geometry.width, CV_8UC3);
+        decoded.copyTo(out.mat());
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+struct FrameBuffer;
+
+/**
+ * @brief Shared, reference-counted handle to one pooled frame buffer.
+ *
+ * Copying a FrameRef only bumps the count, so the decoder, the inference queue and
+ * the display all look at the same pixels. The buffer goes back to its pool when
+ * the last FrameRef is released. The pixels must be treated as read-only once the
+ * frame has been handed out, and a cv::Mat taken from mat() must not outlive the ref.
+ */
+class FrameRef {
+public:
+    FrameRef() = default;
+    FrameRef(const FrameRef& other);
+    FrameRef(FrameRef&& other) noexcept;
+    FrameRef& operator=(const FrameRef& other);
+    FrameRef& operator=(FrameRef&& other) noexcept;
+    ~FrameRef() { reset(); }
+
+    void reset();
+    bool empty() const;
+    const cv::Mat& mat() const;     // an empty Mat for an empty ref
+    cv::Mat& mat();                 // requires a buffer (from FramePool::acquire)
+
+private:
+    friend class FramePool;
+    explicit FrameRef(FrameBuffer* buffer) : buffer_(buffer) {}
+
+    FrameBuffer* buffer_ = nullptr;
+};
+
+/**
+ * @brief Fixed-size pool of 64-byte aligned frame buffers.
+ *
+ * reserve() preallocates buffers for the expected geometry; acquire() hands out a free
+ * buffer (reallocating an idle one only if the geometry changed) and grows the pool up
+ * to maxBuffers. When every buffer is in use, acquire() still succeeds with a one-off
+ * heap buffer that is freed on release and counted in overflowCount().
+ * Handles may outlive the pool object: its storage lives until the last buffer returns.
+ */
+class FramePool {
+public:
+    explicit FramePool(size_t maxBuffers = 8);
+    ~FramePool();
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    void setMaxBuffers(size_t maxBuffers);
+    void reserve(int rows, int cols, int type, size_t count);
+    FrameRef acquire(int rows, int cols, int type);
+
+    size_t maxBuffers() const;
+    size_t allocated() const;
+    size_t inUse() const;
+    uint64_t overflowCount() const;
+
+    struct Impl;
+
+private:
+    friend class FrameRef;
+    static void recycle(FrameBuffer* buffer);
+
+    std::shared_ptr<Impl> impl_;
+};
+
+// Reads the next frame of cap into a pooled BGR buffer of the given geometry. If the
+// backend hands back another size or its own buffer, geometry is updated and the frame
+// is copied into a pooled buffer once.
+bool ReadPooledFrame(cv::VideoCapture& cap, FramePool& pool, FrameRef& out, cv::Size& geometry);
@@ -3,134 +3,322 @@
 
 #include <opencv2/opencv.hpp>
 #include <cstdint>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
+#include <atomic>
 #include <chrono>
+#include <memory>
+#include <thread>
+#ifdef _WIN32
+#include <Windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "FramePool.h"
 
+// Holds a reference to the decoded frame, never a copy of it
 struct FrameInfo {
-    cv::Mat frame;
+    FrameRef frame;
     int64_t frameIndex = -1;
     double timestamp = 0.0; // in seconds
+    std::chrono::steady_clock::time_point queuedAt; // for queue wait metrics
 
     FrameInfo() = default;
-    FrameInfo(const cv::Mat& img, int64_t idx, double time)
-        : frame(img.clone()), frameIndex(idx), timestamp(time) {}
+    FrameInfo(const FrameRef& img, int64_t idx, double time)
+        : frame(img), frameIndex(idx), timestamp(time), queuedAt(std::chrono::steady_clock::now()) {}
 };
 
+// ============================================================================
+// WaitPoint: futex-style wakeup (WaitOnAddress on Windows)
+// ============================================================================
+// A waiter samples epoch(), re-checks its condition, then sleeps until the epoch
+// moves. notify_* bumps the epoch and only enters the kernel if someone is waiting,
+// so the uncontended push/pop path is a couple of atomic operations.
+class WaitPoint {
+public:
+    uint32_t epoch() const { return epoch_.load(std::memory_order_seq_cst); }
+
+    // Returns when the epoch differs from seen, on timeout, or spuriously
+    void wait(uint32_t seen, std::chrono::milliseconds timeout) {
+        waiters_.fetch_add(1, std::memory_order_seq_cst);
+        if (epoch_.load(std::memory_order_seq_cst) == seen) {
+            const auto ms = timeout.count() < 0 ? 0 : timeout.count();
+#ifdef _WIN32
+            WaitOnAddress(reinterpret_cast<volatile VOID*>(&epoch_), &seen, sizeof(seen),
+                static_cast<DWORD>(ms > 0x7FFFFFFE ? 0x7FFFFFFE : ms));
+#elif defined(__linux__)
+            timespec ts{ static_cast<time_t>(ms / 1000), static_cast<long>((ms % 1000) * 1000000) };
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAIT_PRIVATE, seen, &ts, nullptr, 0);
+#else
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms < 1 ? ms : 1));
+#endif
+        }
+        waiters_.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void notify_one() { notify(false); }
+    void notify_all() { notify(true); }
+
+private:
+    void notify(bool all) {
+        epoch_.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters_.load(std::memory_order_seq_cst) == 0)
+            return;
+#ifdef _WIN32
+        if (all)
+            WakeByAddressAll(reinterpret_cast<PVOID>(&epoch_));
+        else
+            WakeByAddressSingle(reinterpret_cast<PVOID>(&epoch_));
+#elif defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch_), FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, nullptr, nullptr, 0);
+#endif
+    }
+
+    std::atomic<uint32_t> epoch_{ 0 };
+    std::atomic<int> waiters_{ 0 };
+};
+
+// ============================================================================
+// RingQueue: bounded lock-free MPMC ring
+// ============================================================================
+// Every slot carries a sequence number (Vyukov's bounded queue), so push and pop are
+// one CAS on their own index plus a release store; no lock is taken per frame.
+// Capacity is rounded up to a power of two. Overflow handling is chosen per call:
+//   push(item, false)    reject when full
+//   push(item, true)     drop the oldest entry to make room
+//   push_latest(item)    overwrite: the queue keeps only this newest entry
+//   push_timeout(...)    block until there is room (or timeout / shutdown)
+// Consumers use try_pop, pop, pop_timeout, or exchange_latest to take the newest
+// entry and discard older ones in a single call.
 template <typename T>
-class SafeQueue {
+class RingQueue {
 public:
-    SafeQueue(size_t maxSize = 0) : shutdown_(false), maxSize_(maxSize) {}
-    
-    // Push with option to drop oldest if queue is full
+    explicit RingQueue(size_t maxSize = 64) { allocate(maxSize); }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
     bool push(const T& item, bool dropOldestIfFull = false) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (shutdown_) return false; // Don't accept new items after shutdown
-        
-        // If queue is full and we should drop oldest
-        if (maxSize_ > 0 && queue_.size() >= maxSize_) {
-            if (dropOldestIfFull) {
-                queue_.pop(); // Remove oldest
-            } else {
-                return false; // Queue full, cannot add
-            }
+        T copy(item);
+        return push(std::move(copy), dropOldestIfFull);
+    }
+
+    bool push(T&& item, bool dropOldestIfFull = false) {
+        if (shutdown_.load(std::memory_order_acquire))
+            return false; // Don't accept new items after shutdown
+        while (!tryEnqueue(item)) {
+            if (!dropOldestIfFull)
+                return false;
+            T oldest;
+            tryDequeue(oldest); // make room; a concurrent consumer may beat us to it
         }
-        
-        queue_.push(item);
-        cv_.notify_one();
+        notEmpty_.notify_one();
         return true;
     }
 
-    bool pop(T& item) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [&] { return !queue_.empty() || shutdown_; });
-        if (shutdown_ && queue_.empty())
-            return false; // Shutdown and no items left
-        if (queue_.empty())
-            return false; // Shouldn't happen, but safety check
-        item = std::move(queue_.front());
-        queue_.pop();
+    bool push_latest(T&& item) {
+        if (shutdown_.load(std::memory_order_acquire))
+            return false;
+        T stale;
+        while (tryDequeue(stale)) {}
+        while (!tryEnqueue(item)) {
+            tryDequeue(stale); // another producer raced us in
+        }
+        notEmpty_.notify_one();
         return true;
     }
 
+    template<typename Rep, typename Period>
+    bool push_timeout(T&& item, const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            if (shutdown_.load(std::memory_order_acquire))
+                return false;
+            const uint32_t seen = notFull_.epoch();
+            if (tryEnqueue(item)) {
+                notEmpty_.notify_one();
+                return true;
+            }
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+                return false;
+            notFull_.wait(seen, left);
+        }
+    }
+
     bool try_pop(T& item) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty() || shutdown_) return false;
-        item = std::move(queue_.front());
-        queue_.pop();
+        if (shutdown_.load(std::memory_order_acquire) || !tryDequeue(item))
+            return false;
+        notFull_.notify_one();
         return true;
     }
 
-    // Pop with timeout - returns false if timeout expires or queue is empty
+    bool pop(T& item) {
+        return pop_timeout(item, std::chrono::hours(24 * 365));
+    }
+
+    // Pop with timeout - returns false if timeout expires or queue is shut down and empty
     template<typename Rep, typename Period>
     bool pop_timeout(T& item, const std::chrono::duration<Rep, Period>& timeout) {
-        std::unique_lock<std::mutex> lock(mutex_);
-        if (cv_.wait_for(lock, timeout, [&] { return !queue_.empty() || shutdown_; })) {
-            if (shutdown_ && queue_.empty())
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            const uint32_t seen = notEmpty_.epoch();
+            if (tryDequeue(item)) {
+                notFull_.notify_one();
+                return true;
+            }
+            if (shutdown_.load(std::memory_order_acquire))
+                return false;
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+                return false;
+            notEmpty_.wait(seen, left);
+        }
+    }
+
+    // Takes the newest entry and discards everything older.
+    // Returns how many entries were removed (0 = queue was empty, >1 = drops).
+    size_t exchange_latest(T& item) {
+        if (shutdown_.load(std::memory_order_acquire))
+            return 0;
+        size_t taken = 0;
+        T next;
+        while (tryDequeue(next)) {
+            item = std::move(next);
+            ++taken;
+        }
+        if (taken > 0)
+            notFull_.notify_all();
+        return taken;
+    }
+
+    // Blocks until the queue holds something (or timeout / shutdown) without taking it
+    template<typename Rep, typename Period>
+    bool wait_nonempty(const std::chrono::duration<Rep, Period>& timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            const uint32_t seen = notEmpty_.epoch();
+            if (!empty())
+                return true;
+            if (shutdown_.load(std::memory_order_acquire))
                 return false;
-            if (queue_.empty())
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
                 return false;
-            item = std::move(queue_.front());
-            queue_.pop();
-            return true;
+            notEmpty_.wait(seen, left);
         }
-        return false; // Timeout
     }
 
     void shutdown() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        shutdown_ = true;
-        cv_.notify_all(); // Wake all waiting threads
+        shutdown_.store(true, std::memory_order_release);
+        notEmpty_.notify_all(); // Wake all waiting threads
+        notFull_.notify_all();
     }
 
     void reset() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        shutdown_ = false;
-        // Clear any remaining items
-        std::queue<T> empty;
-        std::swap(queue_, empty);
+        clear();
+        shutdown_.store(false, std::memory_order_release);
     }
 
     void clear() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        std::queue<T> empty;
-        std::swap(queue_, empty);
+        T item;
+        while (tryDequeue(item)) {}
+        notFull_.notify_all();
     }
 
+    // Snapshot; exact only while nobody pushes or pops
     size_t size() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
+        const size_t head = dequeuePos_.load(std::memory_order_acquire);
+        const size_t tail = enqueuePos_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
     }
 
-    bool empty() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.empty();
+    bool empty() const { return size() == 0; }
+    bool isFull() const { return size() >= capacity_; }
+
+    size_t maxSize() const { return capacity_; }
+
+    // Reallocates the ring; call only while no thread uses the queue. Contents are dropped.
+    void setMaxSize(size_t maxSize) { allocate(maxSize); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    void allocate(size_t maxSize) {
+        size_t cap = 2;
+        while (cap < maxSize)
+            cap <<= 1;
+        cells_.reset(new Cell[cap]);
+        for (size_t i = 0; i < cap; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        capacity_ = cap;
+        mask_ = cap - 1;
+        enqueuePos_.store(0, std::memory_order_relaxed);
+        dequeuePos_.store(0, std::memory_order_relaxed);
     }
 
-    bool isFull() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return maxSize_ > 0 && queue_.size() >= maxSize_;
+    // Moves from item only on success
+    bool tryEnqueue(T& item) {
+        size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false; // full
+            }
+            else {
+                pos = enqueuePos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(item);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
     }
 
-    size_t maxSize() const { return maxSize_; }
-    void setMaxSize(size_t maxSize) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        maxSize_ = maxSize;
-        // Optionally trim queue if new max is smaller
-        while (maxSize_ > 0 && queue_.size() > maxSize_) {
-            queue_.pop();
+    bool tryDequeue(T& item) {
+        size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                return false; // empty
+            }
+            else {
+                pos = dequeuePos_.load(std::memory_order_relaxed);
+            }
         }
+        item = std::move(cell->value);
+        cell->value = T(); // release whatever the slot still references (pooled frames)
+        cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
     }
 
-private:
-    std::queue<T> queue_;
-    mutable std::mutex mutex_;
-    std::condition_variable cv_;
-    bool shutdown_;
-    size_t maxSize_; // 0 means unbounded
+    std::unique_ptr<Cell[]> cells_;
+    size_t capacity_ = 0;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> enqueuePos_{ 0 };
+    alignas(64) std::atomic<size_t> dequeuePos_{ 0 };
+    alignas(64) std::atomic<bool> shutdown_{ false };
+    WaitPoint notEmpty_;
+    WaitPoint notFull_;
 };
 
-typedef SafeQueue<FrameInfo> FrameQueue;
+typedef RingQueue<FrameInfo> FrameQueue;
 
 #endif//__YOLOTESTAPP_FRAMEPROC_H__
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "pch.h"
+#include "FrameSkipController.h"
+#include <cmath>
+
+void FrameSkipController::reset()
+{
+    meanUs_ = 0.0;
+    devUs_ = 0.0;
+    haveLatency_ = false;
+    periodUs_ = 1e6 / 30.0;
+    lastTimestamp_ = -1.0;
+    anchored_ = false;
+    inferred_ = 0;
+    onTime_ = 0;
+    skipped_ = 0;
+    expired_ = 0;
+    shownPredictedUs_ = 0.0;
+    shownPeriodUs_ = 0.0;
+    shownWindowUs_ = 0.0;
+}
+
+double FrameSkipController::windowUs() const
+{
+    const double target = targetUs_.load();
+    return target > 0.0 ? target : periodUs_;
+}
+
+FrameSkipController::Clock::time_point FrameSkipController::deadline(const FrameInfo& frame) const
+{
+    const double us = (frame.timestamp - anchorTimestamp_) * 1e6 + windowUs();
+    return anchorTime_ + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(us));
+}
+
+void FrameSkipController::observe(const FrameInfo& frame)
+{
+    // Consecutive displayed frames give the period; gaps from seeks or drops are ignored
+    bool continuous = false;
+    if (lastTimestamp_ >= 0.0) {
+        const double dtUs = (frame.timestamp - lastTimestamp_) * 1e6;
+        continuous = dtUs > 0.0 && dtUs < 4.0 * periodUs_ + 1e3;
+        if (continuous)
+            periodUs_ += 0.1 * (dtUs - periodUs_);
+    }
+    lastTimestamp_ = frame.timestamp;
+
+    // A frame queued after its own deadline means the clock no longer matches playback
+    if (!anchored_ || !continuous || frame.queuedAt > deadline(frame)) {
+        anchorTime_ = frame.queuedAt;
+        anchorTimestamp_ = frame.timestamp;
+        anchored_ = true;
+    }
+    shownPeriodUs_.store(periodUs_, std::memory_order_relaxed);
+    shownWindowUs_.store(windowUs(), std::memory_order_relaxed);
+}
+
+FrameSkipController::Verdict FrameSkipController::judge(const FrameInfo& frame, Clock::time_point now) const
+{
+    const double leftUs = std::chrono::duration<double, std::micro>(deadline(frame) - now).count();
+    if (leftUs < 0.0)
+        return Verdict::Expired;
+    if (haveLatency_ && predictedUs() > leftUs)
+        return Verdict::WillMiss;
+    return Verdict::Infer;
+}
+
+void FrameSkipController::recordSkip(Verdict verdict)
+{
+    if (verdict == Verdict::Expired)
+        expired_.fetch_add(1, std::memory_order_relaxed);
+    else if (verdict == Verdict::WillMiss)
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameSkipController::recordInference(const FrameInfo& frame, Clock::time_point start, Clock::time_point end)
+{
+    const double us = std::chrono::duration<double, std::micro>(end - start).count();
+    if (!haveLatency_) {
+        meanUs_ = us;
+        devUs_ = us * 0.25;
+        haveLatency_ = true;
+    }
+    else {
+        // EWMA of mean and mean absolute deviation (as in TCP's RTT estimator)
+        devUs_ += 0.25 * (std::fabs(us - meanUs_) - devUs_);
+        meanUs_ += 0.125 * (us - meanUs_);
+    }
+
+    inferred_.fetch_add(1, std::memory_order_relaxed);
+    if (end <= deadline(frame))
+        onTime_.fetch_add(1, std::memory_order_relaxed);
+    shownPredictedUs_.store(predictedUs(), std::memory_order_relaxed);
+}
+
+FrameSkipController::Stats FrameSkipController::stats() const
+{
+    Stats s;
+    s.inferred = inferred_.load(std::memory_order_relaxed);
+    s.onTime = onTime_.load(std::memory_order_relaxed);
+    s.skipped = skipped_.load(std::memory_order_relaxed);
+    s.expired = expired_.load(std::memory_order_relaxed);
+    s.predictedUs = shownPredictedUs_.load(std::memory_order_relaxed);
+    s.framePeriodUs = shownPeriodUs_.load(std::memory_order_relaxed);
+    s.targetLatencyUs = shownWindowUs_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "FrameProc.h"
+
+/**
+ * @brief Chooses which frames Timed mode infers so results arrive while the frame is on screen.
+ *
+ * A frame's deadline is when the playback clock shows it plus the target latency, which
+ * defaults to one frame period measured from FrameInfo::timestamp. The clock maps
+ * timestamps to wall time from an anchor frame (its queuedAt and timestamp), so frames
+ * queued in a burst still get the deadlines of their own presentation times. It is
+ * re-anchored on a seek (timestamps going back or jumping ahead) and when playback falls
+ * behind it by more than the window, e.g. after a pause.
+ * Inference time is tracked as mean + 2 x mean deviation of the measured latencies. A frame
+ * whose deadline has passed is dropped; one that would finish too late is skipped when a
+ * newer frame is queued behind it. Only the newest frame is inferred late, so slow hardware
+ * still gets results for the index and replays.
+ *
+ * Used by the inference thread only; stats() may be called from any thread.
+ */
+class FrameSkipController {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Verdict {
+        Infer,      // expected to finish before its deadline
+        WillMiss,   // still on screen, but inference would finish after the deadline
+        Expired     // deadline already passed
+    };
+
+    struct Stats {
+        uint64_t inferred = 0;
+        uint64_t onTime = 0;            // inferred and finished before the deadline
+        uint64_t skipped = 0;           // would have missed, a newer frame was taken instead
+        uint64_t expired = 0;           // dropped before inference, deadline passed
+        double predictedUs = 0.0;       // current inference latency estimate
+        double framePeriodUs = 0.0;     // measured from frame timestamps
+        double targetLatencyUs = 0.0;   // effective deadline window
+    };
+
+    void reset();
+
+    // How long after being shown a frame's detections are still useful; zero = one frame period
+    void setTargetLatency(std::chrono::microseconds latency) { targetUs_.store(static_cast<double>(latency.count())); }
+
+    // Feeds the frame period and the playback clock; call once per frame taken from the queue,
+    // before judge()
+    void observe(const FrameInfo& frame);
+    Verdict judge(const FrameInfo& frame, Clock::time_point now) const;
+    void recordSkip(Verdict verdict);
+    // Feeds the latency estimate with one measured inference
+    void recordInference(const FrameInfo& frame, Clock::time_point start, Clock::time_point end);
+
+    Stats stats() const;
+
+private:
+    double windowUs() const;
+    // When the playback clock shows the frame, plus the window
+    Clock::time_point deadline(const FrameInfo& frame) const;
+    double predictedUs() const { return meanUs_ + 2.0 * devUs_; }
+
+    std::atomic<double> targetUs_{ 0.0 };
+    double meanUs_ = 0.0;
+    double devUs_ = 0.0;
+    bool haveLatency_ = false;
+    double periodUs_ = 1e6 / 30.0;
+    double lastTimestamp_ = -1.0;
+    bool anchored_ = false;
+    Clock::time_point anchorTime_;      // wall time the anchor frame was queued
+    double anchorTimestamp_ = 0.0;      // and its timestamp, in seconds
+
+    std::atomic<uint64_t> inferred_{ 0 };
+    std::atomic<uint64_t> onTime_{ 0 };
+    std::atomic<uint64_t> skipped_{ 0 };
+    std::atomic<uint64_t> expired_{ 0 };
+    std::atomic<double> shownPredictedUs_{ 0.0 };
+    std::atomic<double> shownPeriodUs_{ 0.0 };
+    std::atomic<double> shownWindowUs_{ 0.0 };
+};
@@ -0,0 +1,306 @@
+#include "pch.h"
+#include "GopFrameCache.h"
+#include <algorithm>
+#include "Logger.h"
+
+// ============================================================================
+// KeyframeIndex
+// ============================================================================
+bool KeyframeIndex::Build(const std::string& path, const std::atomic<bool>& cancel)
+{
+    keys_.clear();
+
+    // Raw mode hands out compressed packets, so the scan never decodes a picture
+    cv::VideoCapture raw;
+    try {
+        if (!raw.open(path, cv::CAP_FFMPEG, { cv::CAP_PROP_FORMAT, -1 }))
+            return false;
+    }
+    catch (const cv::Exception&) {
+        return false;
+    }
+    if (raw.get(cv::CAP_PROP_FORMAT) != -1)
+        return false;
+
+    std::vector<int64_t> keys;
+    int64_t packet = 0;
+    while (!cancel && raw.grab()) {
+        if (raw.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0)
+            keys.push_back(packet);
+        ++packet;
+    }
+    if (cancel || keys.empty() || keys.front() != 0)
+        return false;
+
+    keys_ = std::move(keys);
+    return true;
+}
+
+void KeyframeIndex::GopOf(int64_t frame, int64_t& start, int64_t& end) const
+{
+    auto next = std::upper_bound(keys_.begin(), keys_.end(), frame);
+    start = next == keys_.begin() ? 0 : *(next - 1);
+    end = next == keys_.end() ? -1 : *next;
+}
+
+// ============================================================================
+// GopFrameCache
+// ============================================================================
+bool GopFrameCache::Open(const std::string& path, int64_t frameCount, cv::Size frameSize, const Options& options)
+{
+    Close();
+
+    if (!fgCap_.open(path) || !bgCap_.open(path)) {
+        LOG_ERROR_STREAM("[GopFrameCache] Cannot open " << path);
+        fgCap_.release();
+        bgCap_.release();
+        return false;
+    }
+
+    path_ = path;
+    options_ = options;
+    if (options_.fallbackGop <= 0)
+        options_.fallbackGop = 32;
+    frameCount_ = frameCount;
+    frameSize_ = frameSize;
+
+    const size_t frameBytes = frameSize.area() > 0 ? static_cast<size_t>(frameSize.area()) * 3 : size_t(1920) * 1080 * 3;
+    capacity_ = std::max<size_t>(16, options_.maxBytes / frameBytes);
+    fgPool_.setMaxBuffers(capacity_);
+    bgPool_.setMaxBuffers(capacity_);
+
+    stop_ = false;
+    open_ = true;
+    worker_ = std::thread(&GopFrameCache::prefetchLoop, this);
+
+    LOG_INFO_STREAM("[GopFrameCache] Opened, " << capacity_ << " frames in memory");
+    return true;
+}
+
+void GopFrameCache::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    changed_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+
+    {
+        std::lock_guard<std::mutex> fg(fgMutex_);
+        fgCap_.release();
+    }
+    bgCap_.release();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_) {
+        LOG_INFO_STREAM("[GopFrameCache] Closed: " << hits_.load() << " hits, " << misses_.load() << " misses, "
+            << gopsDecoded_.load() << " GOPs decoded, keyframe index " << (indexReady_ ? "used" : "not available"));
+    }
+    frames_.clear();
+    lru_.clear();
+    decoding_.clear();
+    prefetch_.clear();
+    index_.Clear();
+    indexReady_ = false;
+    open_ = false;
+    hits_ = 0;
+    misses_ = 0;
+    gopsDecoded_ = 0;
+}
+
+void GopFrameCache::gopOf(int64_t frame, int64_t& start, int64_t& end) const
+{
+    if (indexReady_.load(std::memory_order_acquire)) {
+        index_.GopOf(frame, start, end);
+    }
+    else {
+        const int64_t block = options_.fallbackGop;
+        start = frame - frame % block;
+        end = start + block;
+    }
+    if (frameCount_ > 0 && (end < 0 || end > frameCount_))
+        end = frameCount_;
+}
+
+bool GopFrameCache::hitLocked(int64_t index, FrameRef& out)
+{
+    auto it = frames_.find(index);
+    if (it == frames_.end())
+        return false;
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    out = it->second.frame;
+    return true;
+}
+
+void GopFrameCache::insertLocked(int64_t index, const FrameRef& frame)
+{
+    auto it = frames_.find(index);
+    if (it != frames_.end()) {
+        it->second.frame = frame;
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return;
+    }
+    while (frames_.size() >= capacity_ && !lru_.empty()) {
+        frames_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    lru_.push_front(index);
+    frames_.emplace(index, Entry{ frame, lru_.begin() });
+}
+
+bool GopFrameCache::decodeGop(cv::VideoCapture& cap, FramePool& pool, int64_t start, int64_t end, int64_t focus)
+{
+    // Keep at most half the cache from one GOP, centred on the frame that matters
+    const int64_t window = static_cast<int64_t>(std::max<size_t>(1, capacity_ / 2));
+    const int64_t last = end >= 0 ? end : start + window;
+    int64_t storeFrom = std::max(start, focus - window / 2);
+    int64_t storeTo = std::min(last, storeFrom + window);
+    storeFrom = std::max(start, storeTo - window);
+
+    if (!cap.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(start)))
+        return false;
+
+    cv::Size geometry = frameSize_;
+    int64_t i = start;
+    for (; i < storeTo && !stop_; ++i) {
+        if (i < storeFrom) {
+            if (!cap.grab())        // decoded for the references, never converted or stored
+                break;
+            continue;
+        }
+        FrameRef frame;
+        if (!ReadPooledFrame(cap, pool, frame, geometry))
+            break;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            insertLocked(i, frame);
+        }
+        changed_.notify_all();
+    }
+    ++gopsDecoded_;
+    return i > storeFrom;
+}
+
+bool GopFrameCache::Lookup(int64_t index, FrameRef& out)
+{
+    if (!open_)
+        return false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!hitLocked(index, out))
+        return false;
+    ++hits_;
+    return true;
+}
+
+bool GopFrameCache::Fetch(int64_t index, FrameRef& out)
+{
+    if (!open_ || index < 0 || (frameCount_ > 0 && index >= frameCount_))
+        return false;
+
+    int64_t start = 0, end = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (hitLocked(index, out)) {
+            ++hits_;
+            return true;
+        }
+        gopOf(index, start, end);
+        if (!decoding_.count(start))
+            break;
+        // The prefetcher is on this GOP already; its frames show up as they are decoded
+        changed_.wait(lock);
+    }
+    ++misses_;
+    decoding_.insert(start);
+    lock.unlock();
+
+    {
+        std::lock_guard<std::mutex> fg(fgMutex_);
+        decodeGop(fgCap_, fgPool_, start, end, index);
+    }
+
+    lock.lock();
+    decoding_.erase(start);
+    changed_.notify_all();
+    return hitLocked(index, out);
+}
+
+void GopFrameCache::Insert(int64_t index, const FrameRef& frame)
+{
+    if (!open_ || frame.empty())
+        return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    insertLocked(index, frame);
+}
+
+void GopFrameCache::Prefetch(int64_t cursor, int direction)
+{
+    if (!open_ || cursor < 0)
+        return;
+
+    int64_t start = 0, end = 0;
+    gopOf(cursor, start, end);
+
+    std::vector<GopJob> jobs;
+    if (direction <= 0 && start > 0) {
+        GopJob prev;
+        gopOf(start - 1, prev.start, prev.end);
+        prev.end = start;
+        prev.focus = start - 1;
+        jobs.push_back(prev);
+    }
+    if (direction >= 0 && end >= 0 && (frameCount_ <= 0 || end < frameCount_)) {
+        GopJob next;
+        gopOf(end, next.start, next.end);
+        next.focus = end;
+        jobs.push_back(next);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const GopJob& job : jobs) {
+            if (frames_.count(job.focus) || decoding_.count(job.start))
+                continue;
+            auto queued = std::find_if(prefetch_.begin(), prefetch_.end(),
+                [&job](const GopJob& q) { return q.start == job.start; });
+            if (queued != prefetch_.end())
+                continue;
+            prefetch_.push_back(job);
+        }
+        // Only the neighbourhood of the latest cursor matters
+        while (prefetch_.size() > 4)
+            prefetch_.pop_front();
+    }
+    changed_.notify_all();
+}
+
+void GopFrameCache::prefetchLoop()
+{
+    if (index_.Build(path_, stop_)) {
+        indexReady_.store(true, std::memory_order_release);
+        LOG_INFO_STREAM("[GopFrameCache] Keyframe index: " << index_.size() << " GOPs");
+    }
+    else if (!stop_) {
+        LOG_INFO_STREAM("[GopFrameCache] No keyframe index, using blocks of " << options_.fallbackGop << " frames");
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        changed_.wait(lock, [this] { return stop_ || !prefetch_.empty(); });
+        if (stop_)
+            break;
+        GopJob job = prefetch_.back();      // newest request first
+        prefetch_.pop_back();
+        if (frames_.count(job.focus) || decoding_.count(job.start))
+            continue;
+
+        decoding_.insert(job.start);
+        lock.unlock();
+        decodeGop(bgCap_, bgPool_, job.start, job.end, job.focus);
+        lock.lock();
+        decoding_.erase(job.start);
+        changed_.notify_all();
+    }
+}
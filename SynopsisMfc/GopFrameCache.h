@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "FramePool.h"
+
+/**
+ * @brief Keyframe positions of a file, built once by scanning packets without decoding.
+ *
+ * Uses the FFmpeg backend's raw mode (CAP_PROP_FORMAT = -1) and CAP_PROP_LRF_HAS_KEY_FRAME.
+ * If the backend cannot do that the index stays empty and callers use fixed-size blocks.
+ */
+class KeyframeIndex {
+public:
+    // Returns false if the file could not be scanned; cancel is polled between packets
+    bool Build(const std::string& path, const std::atomic<bool>& cancel);
+    void Clear() { keys_.clear(); }
+
+    bool empty() const { return keys_.empty(); }
+    size_t size() const { return keys_.size(); }
+
+    // [start, end) of the GOP holding frame; end is -1 for the last GOP
+    void GopOf(int64_t frame, int64_t& start, int64_t& end) const;
+
+private:
+    std::vector<int64_t> keys_;     // ascending frame indices
+};
+
+/**
+ * @brief LRU cache of decoded frames, filled a whole GOP at a time.
+ *
+ * A GOP is decoded sequentially from its keyframe, so one seek serves every frame in it;
+ * stepping backwards or scrubbing inside decoded GOPs never touches the decoder again.
+ * Misses are decoded on the calling thread with one capture, neighbouring GOPs are
+ * prefetched by a background thread with a second capture. Frames are pooled FrameRefs,
+ * so handing one out shares the cached buffer. Portable: OpenCV and the standard
+ * library only.
+ */
+class GopFrameCache {
+public:
+    struct Options {
+        size_t maxBytes = size_t(512) << 20;    // decoded frames kept in memory
+        int fallbackGop = 32;                   // block size when there is no keyframe index
+    };
+
+    GopFrameCache() = default;
+    ~GopFrameCache() { Close(); }
+
+    GopFrameCache(const GopFrameCache&) = delete;
+    GopFrameCache& operator=(const GopFrameCache&) = delete;
+
+    // Opens both decoders and starts indexing in the background. frameSize sizes the cache.
+    bool Open(const std::string& path, int64_t frameCount, cv::Size frameSize, const Options& options);
+    bool Open(const std::string& path, int64_t frameCount, cv::Size frameSize) { return Open(path, frameCount, frameSize, Options()); }
+    void Close();
+    bool IsOpen() const { return open_; }
+
+    // Memory only; counts as a use for the LRU order
+    bool Lookup(int64_t index, FrameRef& out);
+    // Decodes the GOP holding index on a miss (unless the prefetcher is already on it)
+    bool Fetch(int64_t index, FrameRef& out);
+    // Adds a frame the player decoded anyway
+    void Insert(int64_t index, const FrameRef& frame);
+    // Queues the GOPs next to cursor for background decoding; direction < 0 favours the previous one
+    void Prefetch(int64_t cursor, int direction);
+
+    size_t capacityFrames() const { return capacity_; }
+    uint64_t hits() const { return hits_.load(); }
+    uint64_t misses() const { return misses_.load(); }
+    uint64_t gopsDecoded() const { return gopsDecoded_.load(); }
+    bool indexed() const { return indexReady_.load(); }
+
+private:
+    struct Entry {
+        FrameRef frame;
+        std::list<int64_t>::iterator lru;
+    };
+
+    struct GopJob {
+        int64_t start;
+        int64_t end;
+        int64_t focus;      // frame nearest the cursor, kept if the GOP does not fit
+    };
+
+    void gopOf(int64_t frame, int64_t& start, int64_t& end) const;
+    // Decodes [start, end) from its keyframe, storing the frames that fit the window
+    bool decodeGop(cv::VideoCapture& cap, FramePool& pool, int64_t start, int64_t end, int64_t focus);
+    void insertLocked(int64_t index, const FrameRef& frame);
+    bool hitLocked(int64_t index, FrameRef& out);
+    void prefetchLoop();
+
+    std::string path_;
+    Options options_;
+    int64_t frameCount_ = -1;
+    cv::Size frameSize_;
+    size_t capacity_ = 0;
+    std::atomic<bool> open_{ false };
+    std::atomic<bool> stop_{ false };
+
+    // Decoders: foreground misses and background prefetch never wait on each other
+    cv::VideoCapture fgCap_;
+    cv::VideoCapture bgCap_;
+    FramePool fgPool_;
+    FramePool bgPool_;
+    std::mutex fgMutex_;
+
+    KeyframeIndex index_;
+    std::atomic<bool> indexReady_{ false };
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;       // frames inserted / GOP finished / prefetch queued
+    std::unordered_map<int64_t, Entry> frames_;
+    std::list<int64_t> lru_;                // front = most recently used
+    std::set<int64_t> decoding_;            // GOP starts being decoded right now
+    std::deque<GopJob> prefetch_;
+    std::thread worker_;
+
+    std::atomic<uint64_t> hits_{ 0 };
+    std::atomic<uint64_t> misses_{ 0 };
+    std::atomic<uint64_t> gopsDecoded_{ 0 };
+};
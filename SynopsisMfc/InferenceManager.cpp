@@ -25,6 +25,7 @@ void InferenceManager::start(
     
     stopFlag_ = false;
     playMode_ = playMode;
+    skip_.reset();
     inputQueue_ = inputQueue;
     outputQueue_ = outputQueue;
     detector_ = detector;
@@ -63,47 +64,55 @@ void InferenceManager::loop()
             bool gotFrame = false;
         
             // PlayMode::Continuous = drop old frames, process latest (like old Realtime)
-            // PlayMode::Timed = process all frames in sequence (like old FullSequence)
+            // PlayMode::Timed = process frames in order, skipping those that would miss their
+            //                   display deadline (FrameSkipController)
             if (playMode_ == PlayMode::Continuous) {
-                // Drain queue, take only latest (drop older frames)
-                FrameInfo temp;
-                int drained = 0;
-                while (inputQueue_->try_pop(temp)) {
-                    frame = std::move(temp);
-                    gotFrame = true;
-                    drained++;
-                }
+                // Take only the latest frame, dropping older ones, in one call
+                int drained = static_cast<int>(inputQueue_->exchange_latest(frame));
+                gotFrame = drained > 0;
+                if (drained > 1)
+                    vsRecordDrops(detector_, 0, drained - 1);
                 // Debug: log if we drained many frames
                 if (drained > 10) {
                     LOG_DEBUG_STREAM("[InferenceManager] Drained " << drained 
                         << " frames, processing latest (frame " << frame.frameIndex << ")");
                 }
-                // If no frame available, sleep briefly to avoid tight loop
+                // If no frame available, sleep until the next push wakes us
                 if (!gotFrame) {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                    inputQueue_->wait_nonempty(std::chrono::milliseconds(100));
                     continue;
                 }
             }
             else {
-                // Timed mode: Try to pop with short timeout, skip frames if falling behind
-                // If queue has many frames, skip old ones to catch up
+                // Timed mode: infer the oldest frame whose result can still arrive while it is
+                // on screen; frames past their deadline, or that would miss it while a newer
+                // one waits behind them, are skipped (see FrameSkipController)
                 gotFrame = inputQueue_->pop_timeout(frame, std::chrono::milliseconds(100));
-                
-                // If we got a frame but queue is still large, we're falling behind
-                // Skip to more recent frames to catch up
-                if (gotFrame && inputQueue_->size() > 10) {
-                    FrameInfo temp;
-                    int skipped = 0;
-                    // Skip frames until we're closer to real-time
-                    while (inputQueue_->try_pop(temp)) {
-                        frame = std::move(temp);
-                        skipped++;
-                        if (inputQueue_->size() <= 5) break; // Stop skipping when queue is reasonable
-                    }
-                    if (skipped > 0) {
-                        LOG_DEBUG_STREAM("[InferenceManager] Skipped " << skipped 
-                            << " frames to catch up, now processing frame " << frame.frameIndex);
+                int skipped = 0;
+                while (gotFrame) {
+                    skip_.observe(frame);
+                    auto verdict = skip_.judge(frame, std::chrono::steady_clock::now());
+                    if (verdict == FrameSkipController::Verdict::Infer)
+                        break;
+                    FrameInfo newer;
+                    if (!inputQueue_->try_pop(newer)) {
+                        // Nothing newer: a late result still serves the index and replays,
+                        // an expired frame is gone from the screen already
+                        if (verdict == FrameSkipController::Verdict::Expired) {
+                            skip_.recordSkip(verdict);
+                            skipped++;
+                            gotFrame = false;
+                        }
+                        break;
                     }
+                    skip_.recordSkip(verdict);
+                    skipped++;
+                    frame = std::move(newer);
+                }
+                if (skipped > 0) {
+                    vsRecordDrops(detector_, 0, skipped);
+                    LOG_DEBUG_STREAM("[InferenceManager] Skipped " << skipped 
+                        << " frames to meet display deadlines, now at frame " << frame.frameIndex);
                 }
             }
 
@@ -134,17 +143,21 @@ void InferenceManager::loop()
                 continue; // Continue loop instead of exiting
             }
 
-            const unsigned char* imgData = frame.frame.data;
-            int width = frame.frame.cols;
-            int height = frame.frame.rows;
-            int channels = frame.frame.channels();
+            const cv::Mat& img = frame.frame.mat();
+            const unsigned char* imgData = img.data;
+            int width = img.cols;
+            int height = img.rows;
+            int channels = img.channels();
 
             Detection* detections = nullptr;
             int count = 0;
 
             auto t0 = std::chrono::steady_clock::now();
+            vsRecordMetric(detector_, 0, VS_STAGE_QUEUE_WAIT,
+                std::chrono::duration<double, std::micro>(t0 - frame.queuedAt).count());
             vsCode result = vsDetectObjects(detector_, imgData, width, height, channels, &detections, &count);
             auto t1 = std::chrono::steady_clock::now();
+            skip_.recordInference(frame, t0, t1);
             auto detectionTime = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
 
             // Always send result, even if count == 0, so UI knows frame was processed
@@ -182,8 +195,11 @@ void InferenceManager::loop()
                           << ", error code: " << result << ", time: " << detectionTime << "ms");
             }
 
+            // The engine allocated the array, hand it back (the UI got its own copy)
+            vsReleaseDetections(detections);
+
             // Push to output queue (non-blocking, drop if full)
-            outputQueue_->push(frame, true);
+            outputQueue_->push(std::move(frame), true);
         }
     }
     catch (const std::exception& e) {
@@ -192,5 +208,15 @@ void InferenceManager::loop()
     catch (...) {
         LOG_ERROR("[InferenceManager] Unknown exception in loop!");
     }
+    char metricsJson[4096];
+    int metricsLen = 0;
+    if (detector_ && vsGetMetricsJson(detector_, VS_METRICS_ALL_STREAMS, metricsJson, sizeof(metricsJson), &metricsLen) == VS_SUCCESS)
+        LOG_INFO_STREAM("[InferenceManager] Metrics: " << metricsJson);
+    if (playMode_ == PlayMode::Timed) {
+        auto st = skip_.stats();
+        LOG_INFO_STREAM("[InferenceManager] Frame skip: " << st.inferred << " inferred (" << st.onTime << " on time), "
+            << st.skipped << " skipped, " << st.expired << " expired, latency estimate " << st.predictedUs / 1000.0
+            << "ms, deadline window " << st.targetLatencyUs / 1000.0 << "ms");
+    }
     LOG_INFO("[InferenceManager] Loop ended");
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "FrameProc.h"
 #include "SynopsisEngine.h"
 #include "VideoPlayer.h"
+#include "FrameSkipController.h"
 
 class InferenceManager {
 public:
@@ -16,6 +17,11 @@ public:
     );
 
     void stop();
+
+    // Timed mode: how long after display a frame's detections are still worth having
+    // (zero = one frame period), and what the skip controller did so far
+    void setTargetLatency(std::chrono::microseconds latency) { skip_.setTargetLatency(latency); }
+    FrameSkipController::Stats skipStats() const { return skip_.stats(); }
 private:
     void loop();
     std::thread th_;
@@ -26,5 +32,6 @@ private:
     vsHandle detector_ = nullptr;
     CWnd* parent_ = nullptr;
     UINT msgID_ = 0;
+    FrameSkipController skip_;
 };
 
@@ -108,6 +108,9 @@ BOOL CSynopsisMfcApp::InitInstance()
 
 int CSynopsisMfcApp::ExitInstance()
 {
+	// Engine threads (log writer included) must stop before the DLL unloads
+	vsShutdown();
+
 	// Shutdown GDI+
 	Gdiplus::GdiplusShutdown(gdiplusToken);
 	return CWinApp::ExitInstance();
@@ -189,6 +189,9 @@ LRESULT CSynopsisMfcDlg::OnProcessedFrame(WPARAM wParam, LPARAM lParam)
 		if (result == nullptr) {
 			return 0L;
 		}
+
+		// Persist every analysed frame, including the ones with nothing detected
+		m_detIndex.Append(result->frameIndex, result->detections, result->count);
 		
 		// Handle count == 0 case (no detections, but frame was processed)
 		if (result->count <= 0 || result->detections == nullptr) {
@@ -203,11 +206,8 @@ LRESULT CSynopsisMfcDlg::OnProcessedFrame(WPARAM wParam, LPARAM lParam)
 				if (result->frameIndex == currentFrame) {
 					m_imageWnd.DrawDetections(nullptr, 0);
 				}
-				// Also clear from cache
-				{
-					std::lock_guard<std::mutex> lock(m_detectionCacheMutex);
-					m_detectionCache.erase(result->frameIndex);
-				}
+				// Also record the empty result
+				m_resultRing.publish(result->frameIndex, nullptr, 0);
 			} else {
 				// In Continuous mode, clear detections immediately
 				m_imageWnd.DrawDetections(nullptr, 0);
@@ -219,19 +219,8 @@ LRESULT CSynopsisMfcDlg::OnProcessedFrame(WPARAM wParam, LPARAM lParam)
 		// Handle based on play mode
 		// Timed = sync with video playback, Continuous = display as fast as possible
 		if (result->playMode == PlayMode::Timed) {
-			// Timed mode: Store in cache, only display if matches current frame
-			{
-				std::lock_guard<std::mutex> lock(m_detectionCacheMutex);
-				m_detectionCache[result->frameIndex].clear();
-				for (int i = 0; i < result->count; i++) {
-					m_detectionCache[result->frameIndex].push_back(result->detections[i]);
-				}
-				// Clean up old cache entries (keep only last 100 frames)
-				if (m_detectionCache.size() > 100) {
-					auto it = m_detectionCache.begin();
-					m_detectionCache.erase(it);
-				}
-			}
+			// Timed mode: Store in the ring, only display if matches current frame
+			m_resultRing.publish(result->frameIndex, result->detections, result->count);
 			
 			// Check if this matches currently displayed frame
 			int64_t currentFrame;
@@ -251,7 +240,7 @@ LRESULT CSynopsisMfcDlg::OnProcessedFrame(WPARAM wParam, LPARAM lParam)
 				m_imageWnd.DrawDetections(result->detections, result->count);
 				LOG_DEBUG_STREAM("[OnProcessedFrame] Displayed " << result->count << " detections for frame " << currentFrame);
 			} else {
-				// Frame mismatch - will be displayed when FrameRcvCallback checks cache
+				// Frame mismatch - will be displayed when FrameRcvCallback checks the ring
 				LOG_DEBUG_STREAM("[OnProcessedFrame] Frame mismatch: cached detections for frame " 
 					<< result->frameIndex << ", current frame is " << currentFrame);
 			}
@@ -270,27 +259,28 @@ LRESULT CSynopsisMfcDlg::OnProcessedFrame(WPARAM wParam, LPARAM lParam)
 	return 0L;
 }
 
-void CSynopsisMfcDlg::FrameRcvCallback(const cv::Mat& f, int64_t frameIdx, int64_t total, double fps)
+void CSynopsisMfcDlg::FrameRcvCallback(const FrameRef& f, int64_t frameIdx, int64_t total, double fps)
 {
 	// Minimize lock time - only protect frame_bgr_ update
 	{
 		std::lock_guard<std::mutex> lk(mtx_);
-		frame_bgr_ = f.clone();
+		frame_bgr_ = f;
 		m_currentDisplayedFrame = frameIdx; // Update current displayed frame index
 	}
 
+	// Frames analysed before (now or in an earlier session) are served from the index
+	bool indexed = m_detIndex.Lookup(frameIdx, m_indexedDets);
+
 	// Push frame to queue immediately (non-blocking, outside of mutex)
 	double ts = static_cast<double>(frameIdx) / fps;
-	FrameInfo frameInfo(f, frameIdx, ts);
-	
 	// In Continuous mode: drop oldest when full (process latest only)
 	// In Timed mode: don't drop (let queue grow, InferenceManager will skip if needed)
 	bool dropOldest = (m_playMode == PlayMode::Continuous);
-	bool pushed = m_frameInQueue.push(frameInfo, dropOldest);
+	bool pushed = indexed || m_frameInQueue.push(FrameInfo(f, frameIdx, ts), dropOldest);
 	if (!pushed) {
 		// This should only happen if queue is shutdown
 		LOG_DEBUG_STREAM("[FrameRcvCallback] Frame " << frameIdx << " rejected (queue shutdown?)");
-	} else {
+	} else if (!indexed) {
 		// Debug: log every 30 frames to verify queue is working
 		if (frameIdx % 30 == 0) {
 			LOG_DEBUG_STREAM("[FrameRcvCallback] Pushed frame " << frameIdx 
@@ -300,7 +290,7 @@ void CSynopsisMfcDlg::FrameRcvCallback(const cv::Mat& f, int64_t frameIdx, int64
 
 	// UI updates (these should be fast, but done outside main mutex)
 	if (GetSafeHwnd() && IsWindow(GetSafeHwnd())) {
-		auto img = MatToCxImage(frame_bgr_);
+		auto img = MatToCxImage(f.mat());
 		m_imageWnd.SetImage(img);
 		auto pos = m_videoPlayer.CurrentFrame();
 		
@@ -312,20 +302,20 @@ void CSynopsisMfcDlg::FrameRcvCallback(const cv::Mat& f, int64_t frameIdx, int64
 		m_lblTimeStamp.SetWindowText(timeInfo);
 	}
 	
-	// For Timed mode: Check cache and display matching detections
-	if (m_playMode == PlayMode::Timed) {
-		std::lock_guard<std::mutex> lock(m_detectionCacheMutex);
-		auto it = m_detectionCache.find(frameIdx);
-		if (it != m_detectionCache.end() && !it->second.empty()) {
-			// Display cached detections for this frame
-			LOG_DEBUG_STREAM("[FrameRcvCallback] Found cached detections for frame " << frameIdx 
-				<< ", count: " << it->second.size());
-			m_imageWnd.DrawDetections(it->second.data(), static_cast<int>(it->second.size()));
+	if (indexed) {
+		m_imageWnd.DrawDetections(m_indexedDets.data(), static_cast<int>(m_indexedDets.size()));
+	}
+	// For Timed mode: Check the ring and display matching detections
+	else if (m_playMode == PlayMode::Timed) {
+		if (m_resultRing.read(frameIdx, m_ringDets) && !m_ringDets.empty()) {
+			// Display published detections for this frame
+			LOG_DEBUG_STREAM("[FrameRcvCallback] Found detections for frame " << frameIdx 
+				<< ", count: " << m_ringDets.size());
+			m_imageWnd.DrawDetections(m_ringDets.data(), static_cast<int>(m_ringDets.size()));
 		} else {
-			// Clear detections if no cached results for this frame
+			// Clear detections if no results for this frame
 			if (frameIdx % 30 == 0) {  // Log occasionally to avoid spam
-				LOG_DEBUG_STREAM("[FrameRcvCallback] No cached detections for frame " << frameIdx 
-					<< ", cache size: " << m_detectionCache.size());
+				LOG_DEBUG_STREAM("[FrameRcvCallback] No detections for frame " << frameIdx);
 			}
 			m_imageWnd.DrawDetections(nullptr, 0);
 		}
@@ -449,15 +439,23 @@ void CSynopsisMfcDlg::OnBnClickedBtnBrowser()
 	m_txtPath.SetWindowText(filename);
 	m_videoPlayer.Stop();
 
-	// Clear detection cache when opening new video
-	{
-		std::lock_guard<std::mutex> lock(m_detectionCacheMutex);
-		m_detectionCache.clear();
+	// Seal the previous video's results and pick up the new one's, if the same model made them
+	m_detIndex.Close();
+	DetectionIndex::Model model;
+	vsModelInfo info = {};
+	if (vsGetModelInfo(m_YoloHandle, &info) == VS_SUCCESS) {
+		model.pathUtf8 = info.modelPathUtf8;
+		model.confThreshold = info.confThreshold;
+		model.iouThreshold = info.iouThreshold;
 	}
+	m_detIndex.Open(std::string(CT2A(filename, CP_UTF8)), model);
+
+	// Forget results of the previous video
+	m_resultRing.clear();
 	m_currentDisplayedFrame = -1;
 
 	HWND hwnd = m_imageWnd.GetSafeHwnd();
-	m_videoPlayer.SetCallback([this](const cv::Mat& frame, int64_t idx, int64_t total, double fps){
+	m_videoPlayer.SetCallback([this](const FrameRef& frame, int64_t idx, int64_t total, double fps){
 		FrameRcvCallback(frame, idx, total, fps);
 	});
 
@@ -541,11 +539,8 @@ void CSynopsisMfcDlg::SetPlayMode(PlayMode mode)
 	m_frameInQueue.reset();
 	m_frameOutQueue.reset();
 	
-	// Clear cache when switching modes
-	{
-		std::lock_guard<std::mutex> lock(m_detectionCacheMutex);
-		m_detectionCache.clear();
-	}
+	// Forget results when switching modes
+	m_resultRing.clear();
 	
 	// Restart with new mode
 	m_InfManager.start(&m_frameInQueue, &m_frameOutQueue, 
@@ -570,6 +565,9 @@ void CSynopsisMfcDlg::InitControls()
 	// Set queue max size to prevent memory issues
 	m_frameInQueue.setMaxSize(MAX_QUEUE_SIZE);
 	m_frameOutQueue.setMaxSize(MAX_QUEUE_SIZE);
+	m_ringDets.reserve(m_resultRing.maxPerFrame());
+	// Both queues, the frame in inference, the displayed one and the one being decoded
+	m_videoPlayer.SetFramePoolSize(2 * MAX_QUEUE_SIZE + 3);
 	
 	// Ensure queues are in active state (not shutdown)
 	m_frameInQueue.reset();
@@ -673,4 +671,5 @@ void CSynopsisMfcDlg::OnDestroy()
 		m_YoloHandle = nullptr;
 	}
 	m_InfManager.stop();
+	m_detIndex.Close();
 }
@@ -3,13 +3,14 @@
 //
 #pragma once
 #include <mutex>
-#include <map>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include "VideoPlayer.h"
 #include "PicWndDemo.h"
 #include "SynopsisEngine.h"
 #include "InferenceManager.h"
+#include "DetectionIndex.h"
+#include "DetectionRing.h"
 
 const UINT WM_FRAME_ARRIVED = ::RegisterWindowMessage(_T("WM_FRAME_ARRIVED"));
 const UINT WM_PROCESSED_FRAME = ::RegisterWindowMessage(_T("WM_PROCESSED_FRAME"));
@@ -42,15 +43,17 @@ private:
 	vsHandle    m_YoloHandle;
 
 	std::mutex mtx_;
-	cv::Mat frame_bgr_; // last frame
+	FrameRef frame_bgr_; // last frame (shares the decoder's pooled buffer)
 	int64_t m_currentDisplayedFrame = -1; // Track currently displayed frame index
-	std::map<int64_t, std::vector<Detection>> m_detectionCache; // Cache detections by frame index (for Timed mode)
-	std::mutex m_detectionCacheMutex; // Protect detection cache
+	DetectionRing m_resultRing; // Detections of recent frames by frame index (for Timed mode)
+	std::vector<Detection> m_ringDets; // Read buffer for m_resultRing (player thread only, never reallocates)
+	DetectionIndex m_detIndex; // Results persisted per video: analysed frames are never re-inferred
+	std::vector<Detection> m_indexedDets; // Lookup buffer (player thread only)
 	PlayMode m_playMode = PlayMode::Timed; // Current play mode (Timed = sync with video, Continuous = as fast as possible)
 	static constexpr size_t MAX_QUEUE_SIZE = 60; // Maximum frames in queue (increased to handle slower detection)
 private:
 	void InitControls();
-	void FrameRcvCallback(const cv::Mat& frame, int64_t frameIdx, int64_t total, double fps);
+	void FrameRcvCallback(const FrameRef& frame, int64_t frameIdx, int64_t total, double fps);
 	void SetPlayMode(PlayMode mode); // Change play mode and restart inference if needed
 // Implementation
 protected:
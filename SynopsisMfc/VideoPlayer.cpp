@@ -58,6 +58,13 @@ bool VideoPlayer::Open(const TCHAR* path)
         fps_ = 30.0; // fallback
 
     curFrame_ = static_cast<int64_t>(cap_.get(cv::CAP_PROP_POS_FRAMES));
+    frameWidth_ = static_cast<int>(cap_.get(cv::CAP_PROP_FRAME_WIDTH));
+    frameHeight_ = static_cast<int>(cap_.get(cv::CAP_PROP_FRAME_HEIGHT));
+    if (frameWidth_ > 0 && frameHeight_ > 0)
+        pool_.reserve(frameHeight_, frameWidth_, CV_8UC3, 8);
+    if (cache_.Open(p, totalFrames_, cv::Size(frameWidth_, frameHeight_)))
+        pool_.setMaxBuffers(poolFrames_ + cache_.capacityFrames());
+    capStale_ = false;
     totalTimeStr_ = FrameToTimestamp(totalFrames_, fps_);
     frameTimeStr_ = FrameToTimestamp(0, fps_);
     extractVideoSummary();
@@ -111,6 +118,12 @@ void VideoPlayer::Close()
         th_.join();
     if (cap_.isOpened())
         cap_.release();
+    cache_.Close();
+    capStale_ = false;
+    if (pool_.allocated() > 0) {
+        LOG_INFO_STREAM("[VideoPlayer] Frame pool: " << pool_.allocated() << "/" << pool_.maxBuffers()
+            << " buffers, " << pool_.inUse() << " still held, " << pool_.overflowCount() << " overflow allocations");
+    }
     state_ = State::Stopped;
     curFrame_ = 0;
     totalFrames_ = -1;
@@ -148,13 +161,15 @@ void VideoPlayer::Stop()
         // Use mutex to protect cap_ access from concurrent runLoop() calls
         std::lock_guard<std::mutex> lk(mtx_);
         cap_.set(cv::CAP_PROP_POS_FRAMES, 0);
+        capStale_ = false;
         curFrame_ = 0;
         frameTimeStr_ = FrameToTimestamp(0, fps_);
         
         // Deliver the first frame (optional, but useful for UI)
-        cv::Mat frame;
-        if (cap_.read(frame) && !frame.empty()) {
+        FrameRef frame;
+        if (readFrame(frame)) {
             curFrame_ = 0;
+            cache_.Insert(0, frame);
             if (on_frame_) {
                 on_frame_(frame, 0, totalFrames_, fps_);
             }
@@ -171,18 +186,23 @@ bool VideoPlayer::SeekFrame(int64_t frameIndex)
     state_ = State::Paused;
     cv_.notify_all();
     
+    if (showCachedFrame(frameIndex, frameIndex < curFrame_ ? -1 : 1))
+        return true;
+
     std::unique_lock<std::mutex> lk(mtx_);
     
     // Set position (OpenCV expects double)
     if (!cap_.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(frameIndex)))
         return false;
+    capStale_ = false;
     
-    cv::Mat frame;
-    if (!cap_.read(frame) || frame.empty())
+    FrameRef frame;
+    if (!readFrame(frame))
         return false;
     
     int64_t posNext = static_cast<int64_t>(cap_.get(cv::CAP_PROP_POS_FRAMES));
     curFrame_ = posNext - 1;
+    cache_.Insert(curFrame_, frame);
     frameTimeStr_ = FrameToTimestamp(curFrame_, fps_);
     
     lk.unlock();
@@ -200,12 +220,18 @@ bool VideoPlayer::NextFrame()
     
     // We're already at current frame index; reading advances by 1
     std::unique_lock<std::mutex> lk(mtx_);
-    cv::Mat frame;
-    if (!cap_.read(frame) || frame.empty())
-        return false;
-    
-    int64_t posNext = static_cast<int64_t>(cap_.get(cv::CAP_PROP_POS_FRAMES));
-    curFrame_ = posNext - 1;
+    FrameRef frame;
+    if (capStale_ && cache_.Lookup(curFrame_ + 1, frame)) {
+        // Still walking through cached frames after stepping back
+        curFrame_ = curFrame_ + 1;
+    }
+    else {
+        if (!resyncCapture() || !readFrame(frame))
+            return false;
+        int64_t posNext = static_cast<int64_t>(cap_.get(cv::CAP_PROP_POS_FRAMES));
+        curFrame_ = posNext - 1;
+        cache_.Insert(curFrame_, frame);
+    }
     frameTimeStr_ = FrameToTimestamp(curFrame_, fps_);
     
     lk.unlock();
@@ -221,20 +247,23 @@ bool VideoPlayer::PrevFrame()
     state_ = State::Paused;
     cv_.notify_all(); // Wake up thread so it sees the state change
 
-    std::unique_lock<std::mutex> lk(mtx_);
-    
-    int64_t idx = curFrame_.load();
-    // After a successful read, OpenCV's POS_FRAMES points to "next".
-    // So to show previous frame, jump to (idx - 2), then read one.
-    int64_t target = idx - 2;
+    int64_t target = curFrame_.load() - 1;
     if (target < 0) 
         target = 0;
 
+    // Usually a memory hit: the whole GOP was decoded on the first step back
+    if (showCachedFrame(target, -1))
+        return true;
+
+    std::unique_lock<std::mutex> lk(mtx_);
+
+    // POS_FRAMES is the index of the frame the next read returns
     if (!cap_.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(target)))
         return false;
+    capStale_ = false;
 
-    cv::Mat frame;
-    if (!cap_.read(frame) || frame.empty())
+    FrameRef frame;
+    if (!readFrame(frame))
         return false;
     
     int64_t posNext = static_cast<int64_t>(cap_.get(cv::CAP_PROP_POS_FRAMES));
@@ -309,13 +338,14 @@ bool VideoPlayer::grabAndDispatch()
         return false;
     }
     
-    cv::Mat frame;
-    if (!cap_.read(frame) || frame.empty()) 
+    FrameRef frame;
+    if (!resyncCapture() || !readFrame(frame)) 
         return false;
 
     // POS_FRAMES is now "next index", so the current frame index is:
     int64_t posNext = static_cast<int64_t>(cap_.get(cv::CAP_PROP_POS_FRAMES));
     curFrame_ = posNext - 1; // best-effort tracking
+    cache_.Insert(curFrame_, frame);
 
     frameTimeStr_ = FrameToTimestamp(curFrame_, fps_);
 
@@ -327,6 +357,49 @@ bool VideoPlayer::grabAndDispatch()
     return true;
 }
 
+bool VideoPlayer::readFrame(FrameRef& out)
+{
+    cv::Size geometry(frameWidth_, frameHeight_);
+    if (!ReadPooledFrame(cap_, pool_, out, geometry))
+        return false;
+    frameWidth_ = geometry.width;
+    frameHeight_ = geometry.height;
+    return true;
+}
+
+bool VideoPlayer::resyncCapture()
+{
+    if (!capStale_)
+        return true;
+    if (!cap_.set(cv::CAP_PROP_POS_FRAMES, static_cast<double>(curFrame_ + 1)))
+        return false;
+    capStale_ = false;
+    return true;
+}
+
+bool VideoPlayer::showCachedFrame(int64_t frameIndex, int direction)
+{
+    if (!cache_.IsOpen())
+        return false;
+
+    // The cache has its own decoder and lock; a miss decodes a whole GOP, which must not
+    // hold up the playback thread or Stop() waiting on mtx_
+    FrameRef frame;
+    if (!cache_.Fetch(frameIndex, frame))
+        return false;
+
+    std::unique_lock<std::mutex> lk(mtx_);
+    curFrame_ = frameIndex;
+    capStale_ = true;   // cap_ is wherever playback left it
+    frameTimeStr_ = FrameToTimestamp(curFrame_, fps_);
+    lk.unlock();
+
+    cache_.Prefetch(frameIndex, direction);
+    if (on_frame_)
+        on_frame_(frame, frameIndex, totalFrames_, fps_);
+    return true;
+}
+
 CString VideoPlayer::FrameToTimestamp(int64_t frameIndex, double fps)
 {
     if (fps <= 1e-3)
@@ -5,6 +5,8 @@
 #include <condition_variable>
 #include <functional>
 #include <opencv2/opencv.hpp>
+#include "FramePool.h"
+#include "GopFrameCache.h"
 
 // Unified mode for video playback, frame processing, and detection display
 enum class PlayMode {
@@ -16,7 +18,7 @@ enum class PlayMode {
 class VideoPlayer
 {
 public:
-    using FrameCallback = std::function<void(const cv::Mat& frame, int64_t frameIdx, int64_t total, double fps)>;
+    using FrameCallback = std::function<void(const FrameRef& frame, int64_t frameIdx, int64_t total, double fps)>;
 
     enum class State { Stopped, Paused, Playing };
 
@@ -28,7 +30,7 @@ public:
 
     // Single-step (stays Paused afterwards)
     bool   NextFrame();             // +1 frame
-    bool   PrevFrame();             // -1 frame (seek back one, read one)
+    bool   PrevFrame();             // -1 frame (served from the GOP cache when possible)
 
     // Seek (absolute frame index)
     bool   SeekFrame(int64_t frameIndex);
@@ -42,6 +44,11 @@ public:
     // UI callback: called on worker thread � post to UI thread in your handler
     void   SetCallback(FrameCallback cb) { on_frame_ = std::move(cb); }
 
+    // Decoded frames are pooled; size this to cover every FrameRef held downstream
+    // (queues, inference, display). Beyond it frames fall back to one-off allocations.
+    // The GOP cache's share is added on Open.
+    void   SetFramePoolSize(size_t frames) { poolFrames_ = frames; pool_.setMaxBuffers(frames + cache_.capacityFrames()); }
+
     ~VideoPlayer() { Close(); }
 
     void SetPlayMode(PlayMode mode) {
@@ -61,6 +68,9 @@ private:
     // worker
     void   runLoop();
     bool   grabAndDispatch(); // read current (or next) frame and call callback
+    bool   readFrame(FrameRef& out); // decode the next frame into a pooled buffer (cap_ locked)
+    bool   resyncCapture();          // move cap_ to curFrame_ + 1 after frames came from the cache (mtx_ held)
+    bool   showCachedFrame(int64_t frameIndex, int direction); // fetch from the GOP cache and dispatch
     CString FrameToTimestamp(int64_t frameIndex, double fps);
     void   extractVideoSummary();
 private:
@@ -80,6 +90,14 @@ private:
     mutable std::mutex   mtx_;
     std::condition_variable cv_;
     FrameCallback        on_frame_;
+    FramePool            pool_;
+    int                  frameWidth_ = 0;
+    int                  frameHeight_ = 0;
+    size_t               poolFrames_ = 8;
+
+    // Decoded frames by GOP, for seeking and stepping backwards
+    GopFrameCache        cache_;
+    bool                 capStale_ = false;   // cap_ is not positioned right after curFrame_
 
     PlayMode            playMode_ = PlayMode::Timed;
     CString             videoPath_;
@@ -0,0 +1,383 @@
+// kernel_bench.cpp : microbenchmarks of the utils:: kernels on synthetic data, no model needed.
+//
+//   kernel_bench [--filter <substr>] [--min-time ms] [--quick] [--json report.json]
+//
+// Every group sweeps input sizes and times the current utils:: implementation next to
+// the alternatives in kernel_variants.h. Before timing, each alternative is checked
+// against the reference on the same input and any disagreement is printed.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "YOLO-common.h"
+#include "synthetic_data.h"
+#include "kernel_variants.h"
+#include "micro_harness.h"
+
+struct KernelBenchConfig {
+    std::string filter;
+    double minTimeMs = 200.0;
+    bool quick = false;
+    std::string json;
+};
+
+static const cv::Size kInputShape(640, 640);
+static const float kScoreThreshold = 0.25f;
+static const float kIouThreshold = 0.45f;
+
+static void usage()
+{
+    std::cerr <<
+        "usage: kernel_bench [--filter <substr>] [--min-time ms] [--quick] [--json report.json]\n"
+        "  groups: nms nms_obb decode sigmoid mask letterbox scale\n";
+}
+
+static bool parseArgs(int argc, char** argv, KernelBenchConfig& cfg)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--quick") {
+            cfg.quick = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        const std::string v = argv[++i];
+        if (a == "--filter") cfg.filter = v;
+        else if (a == "--min-time") cfg.minTimeMs = std::max(1.0, std::atof(v.c_str()));
+        else if (a == "--json") cfg.json = v;
+        else return false;
+    }
+    return true;
+}
+
+static std::string param(const char* fmt, double a, double b = 0.0)
+{
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), fmt, a, b);
+    return buf;
+}
+
+static void reportMismatch(const char* group, const std::string& name, const std::string& p, const std::string& what)
+{
+    std::fprintf(stderr, "[kernel_bench] verify %s/%s (%s): %s\n", group, name.c_str(), p.c_str(), what.c_str());
+}
+
+// Index sets as produced by the NMS functions, order-insensitive
+static bool sameSet(std::vector<int> a, std::vector<int> b)
+{
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    return a == b;
+}
+
+// ============================================================================
+// Groups
+// ============================================================================
+static void benchNms(MicroHarness& h, bool quick)
+{
+    const int sizes[] = { 100, 1000, 4000, 8400 };
+    const float overlaps[] = { 0.1f, 0.5f, 0.9f };
+    for (const int n : sizes) {
+        if (quick && n > 1000)
+            break;
+        for (const float ov : overlaps) {
+            const synth::BoxSet set = synth::makeBoxes(n, ov, kInputShape, 1000u + n);
+            const std::string p = param("n=%.0f overlap=%.1f", n, ov);
+            std::vector<int> ref, alt;
+
+            utils::NMSBoxes(set.boxes, set.scores, kScoreThreshold, kIouThreshold, ref);
+            variants::nmsBoxesFlat(set.boxes, set.scores, kScoreThreshold, kIouThreshold, alt);
+            if (!sameSet(ref, alt))
+                reportMismatch("nms", "variants::nmsBoxesFlat", p, "kept set differs");
+
+            h.run("nms", "utils::NMSBoxes", p, n, [&] {
+                utils::NMSBoxes(set.boxes, set.scores, kScoreThreshold, kIouThreshold, ref);
+                return ref.size();
+            });
+            h.run("nms", "utils::NMSBoxesSeg", p, n, [&] {
+                utils::NMSBoxesSeg(set.boxes, set.scores, kScoreThreshold, kIouThreshold, alt);
+                return alt.size();
+            });
+            h.run("nms", "variants::nmsBoxesFlat", p, n, [&] {
+                variants::nmsBoxesFlat(set.boxes, set.scores, kScoreThreshold, kIouThreshold, alt);
+                return alt.size();
+            });
+            h.run("nms", "cv::dnn::NMSBoxes", p, n, [&] {
+                variants::nmsBoxesOpenCV(set.boxes, set.scores, kScoreThreshold, kIouThreshold, alt);
+                return alt.size();
+            });
+        }
+    }
+}
+
+static void benchNmsObb(MicroHarness& h, bool quick)
+{
+    const int sizes[] = { 50, 200, 1000, 3000 };
+    const float overlaps[] = { 0.1f, 0.9f };
+    for (const int n : sizes) {
+        if (quick && n > 200)
+            break;
+        for (const float ov : overlaps) {
+            const synth::ObbSet set = synth::makeObbCloud(n, ov, cv::Size(1024, 1024), 2000u + n);
+            const std::string p = param("n=%.0f overlap=%.1f", n, ov);
+
+            if (!sameSet(utils::nmsRotated(set.boxes, set.scores, 0.75f), variants::nmsRotatedLazy(set.boxes, set.scores, 0.75f)))
+                reportMismatch("nms_obb", "variants::nmsRotatedLazy", p, "kept set differs");
+
+            h.run("nms_obb", "utils::nmsRotated", p, n, [&] {
+                return utils::nmsRotated(set.boxes, set.scores, 0.75f).size();
+            });
+            h.run("nms_obb", "variants::nmsRotatedLazy", p, n, [&] {
+                return variants::nmsRotatedLazy(set.boxes, set.scores, 0.75f).size();
+            });
+        }
+    }
+}
+
+static void benchDecode(MicroHarness& h, bool quick)
+{
+    // 8400 anchors = 640x640 input, 2100 = 320x320; 80 COCO classes
+    const int anchorCounts[] = { 2100, 8400 };
+    const int objectCounts[] = { 5, 50 };
+    const int numClasses = 80;
+    const cv::Size original(1920, 1080);
+    for (const int anchors : anchorCounts) {
+        if (quick && anchors > 2100)
+            break;
+        const cv::Size input = anchors == 2100 ? cv::Size(320, 320) : kInputShape;
+        for (const int objects : objectCounts) {
+            const std::vector<float> output = synth::makeDetectOutput(numClasses, anchors, objects, 0, input, 3000u + anchors + objects);
+            const std::string p = param("%.0fx%.0f", 4 + numClasses, anchors) + " obj=" + std::to_string(objects);
+            variants::Decoded ref, alt;
+
+            variants::decodeReference(output.data(), numClasses, anchors, kScoreThreshold, input, original, ref);
+            variants::decodeClassMajor(output.data(), numClasses, anchors, kScoreThreshold, input, original, alt);
+            if (alt.scores != ref.scores || alt.classIds != ref.classIds)
+                reportMismatch("decode", "variants::decodeClassMajor", p, "candidates differ");
+            variants::decodeTransposed(output.data(), numClasses, anchors, kScoreThreshold, input, original, alt);
+            if (alt.scores != ref.scores || alt.classIds != ref.classIds)
+                reportMismatch("decode", "variants::decodeTransposed", p, "candidates differ");
+
+            h.run("decode", "reference (YOLOv11Detector)", p, anchors, [&] {
+                variants::decodeReference(output.data(), numClasses, anchors, kScoreThreshold, input, original, ref);
+                return ref.boxes.size();
+            });
+            h.run("decode", "variants::decodeClassMajor", p, anchors, [&] {
+                variants::decodeClassMajor(output.data(), numClasses, anchors, kScoreThreshold, input, original, alt);
+                return alt.boxes.size();
+            });
+            h.run("decode", "variants::decodeTransposed", p, anchors, [&] {
+                variants::decodeTransposed(output.data(), numClasses, anchors, kScoreThreshold, input, original, alt);
+                return alt.boxes.size();
+            });
+        }
+    }
+}
+
+static void benchSigmoid(MicroHarness& h, bool quick)
+{
+    const int sides[] = { 160, 640 };
+    for (const int side : sides) {
+        if (quick && side > 160)
+            break;
+        cv::Mat src(side, side, CV_32F);
+        cv::randn(src, 0.0, 3.0);
+        const std::string p = param("%.0fx%.0f", side, side);
+
+        cv::Mat work;
+        src.copyTo(work);
+        variants::sigmoidInPlace(work);
+        if (cv::norm(work, utils::sigmoid(src), cv::NORM_INF) > 1e-5)
+            reportMismatch("sigmoid", "variants::sigmoidInPlace", p, "values differ");
+
+        h.run("sigmoid", "utils::sigmoid", p, src.total(), [&] {
+            cv::Mat r = utils::sigmoid(src);
+            return static_cast<size_t>(r.total());
+        });
+        h.run("sigmoid", "variants::sigmoidInPlace (+copy)", p, src.total(), [&] {
+            src.copyTo(work);
+            variants::sigmoidInPlace(work);
+            return static_cast<size_t>(work.total());
+        });
+    }
+}
+
+static variants::MaskJob makeMaskJob(int detections, const cv::Size& original, uint32_t seed)
+{
+    variants::MaskJob job;
+    job.maskSize = cv::Size(160, 160);
+    job.letterboxShape = kInputShape;
+    job.originalShape = original;
+    job.protos = synth::makePrototypes(32, job.maskSize, seed);
+
+    // Boxes inside the unpadded letterbox region, like post-NMS detections
+    const float gain = std::min(static_cast<float>(kInputShape.width) / original.width,
+        static_cast<float>(kInputShape.height) / original.height);
+    const cv::Size inner(static_cast<int>(original.width * gain), static_cast<int>(original.height * gain));
+    const int padY = (kInputShape.height - inner.height) / 2;
+    const int padX = (kInputShape.width - inner.width) / 2;
+    job.boxes = synth::makeBoxes(detections, 0.0f, inner, seed).boxes;
+    for (auto& b : job.boxes) {
+        b.x += padX;
+        b.y += padY;
+    }
+
+    job.coeffs.create(detections, 32, CV_32F);
+    cv::RNG rng(seed);
+    rng.fill(job.coeffs, cv::RNG::NORMAL, 0.0, 0.5);
+    return job;
+}
+
+static void benchMasks(MicroHarness& h, bool quick)
+{
+    const int detectionCounts[] = { 5, 20, 50 };
+    const cv::Size originals[] = { cv::Size(1280, 720), cv::Size(1920, 1080) };
+    for (const cv::Size& original : originals) {
+        if (quick && original.width > 1280)
+            break;
+        for (const int n : detectionCounts) {
+            const variants::MaskJob job = makeMaskJob(n, original, 4000u + n);
+            const std::string p = param("det=%.0f out=%.0f", n, original.width);
+            std::vector<cv::Mat> ref, alt;
+
+            variants::assembleMasksReference(job, ref);
+            variants::assembleMasksGemm(job, alt);
+            double differing = 0.0, total = 0.0;
+            for (size_t i = 0; i < ref.size() && i < alt.size(); ++i) {
+                differing += cv::countNonZero(ref[i] != alt[i]);
+                total += cv::countNonZero(ref[i] | alt[i]);
+            }
+            if (differing > 0.0)
+                reportMismatch("mask", "variants::assembleMasksGemm", p,
+                    param("%.3f%% of mask pixels differ", total > 0.0 ? 100.0 * differing / total : 100.0));
+
+            h.run("mask", "reference (YOLOv11SegDetector)", p, n, [&] {
+                variants::assembleMasksReference(job, ref);
+                return ref.size();
+            });
+            h.run("mask", "variants::assembleMasksGemm", p, n, [&] {
+                variants::assembleMasksGemm(job, alt);
+                return alt.size();
+            });
+        }
+    }
+}
+
+static void benchLetterbox(MicroHarness& h, bool quick)
+{
+    const cv::Size frames[] = { cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080), cv::Size(3840, 2160) };
+    const cv::Scalar color(114, 114, 114);
+    for (const cv::Size& size : frames) {
+        if (quick && size.width > 1280)
+            break;
+        const cv::Mat frame = synth::makeFrame(size, 5000u + size.width);
+        const std::string p = param("%.0fx%.0f", size.width, size.height);
+        cv::Mat ref, alt;
+
+        utils::letterBox(frame, ref, kInputShape, color, false, false, true, 32);
+        variants::letterBoxInto(frame, alt, kInputShape, color);
+        if (ref.size() != alt.size() || cv::norm(ref, alt, cv::NORM_INF) != 0.0)
+            reportMismatch("letterbox", "variants::letterBoxInto", p, "image differs");
+
+        h.run("letterbox", "utils::letterBox", p, 1, [&] {
+            cv::Mat out;
+            utils::letterBox(frame, out, kInputShape, color, false, false, true, 32);
+            return static_cast<size_t>(out.rows);
+        });
+        h.run("letterbox", "utils::letterBoxSeg", p, 1, [&] {
+            cv::Mat out;
+            utils::letterBoxSeg(frame, out, kInputShape, color, false, false, true, 32);
+            return static_cast<size_t>(out.rows);
+        });
+        h.run("letterbox", "utils::letterBoxObb", p, 1, [&] {
+            cv::Mat out;
+            utils::letterBoxObb(frame, out, kInputShape, color, false, false, true, 32);
+            return static_cast<size_t>(out.rows);
+        });
+        h.run("letterbox", "utils::letterBoxPos", p, 1, [&] {
+            cv::Mat out;
+            utils::letterBoxPos(frame, out, kInputShape, color, false, false, true, 32);
+            return static_cast<size_t>(out.rows);
+        });
+        h.run("letterbox", "variants::letterBoxInto (reused)", p, 1, [&] {
+            variants::letterBoxInto(frame, alt, kInputShape, color);
+            return static_cast<size_t>(alt.rows);
+        });
+    }
+}
+
+static void benchScale(MicroHarness& h, bool quick)
+{
+    const int sizes[] = { 100, 1000, 8400 };
+    const cv::Size original(1920, 1080);
+    for (const int n : sizes) {
+        if (quick && n > 1000)
+            break;
+        const synth::BoxSet set = synth::makeBoxes(n, 0.0f, kInputShape, 6000u + n);
+        const std::string p = param("n=%.0f", n);
+        std::vector<BoundingBox> ref(n), alt;
+
+        for (int i = 0; i < n; ++i)
+            ref[i] = utils::scaleCoords(kInputShape, set.boxes[i], original, true);
+        variants::scaleCoordsBatch(set.boxes, kInputShape, original, alt);
+        int differing = 0;
+        for (int i = 0; i < n; ++i) {
+            const BoundingBox& a = ref[i];
+            const BoundingBox& b = alt[i];
+            differing += (a.x != b.x || a.y != b.y || a.width != b.width || a.height != b.height) ? 1 : 0;
+        }
+        if (differing)
+            reportMismatch("scale", "variants::scaleCoordsBatch", p, std::to_string(differing) + " boxes off by rounding");
+
+        h.run("scale", "utils::scaleCoords (loop)", p, n, [&] {
+            for (int i = 0; i < n; ++i)
+                ref[i] = utils::scaleCoords(kInputShape, set.boxes[i], original, true);
+            return static_cast<size_t>(ref[n - 1].x);
+        });
+        h.run("scale", "variants::scaleCoordsBatch", p, n, [&] {
+            variants::scaleCoordsBatch(set.boxes, kInputShape, original, alt);
+            return static_cast<size_t>(alt[n - 1].x);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    KernelBenchConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) {
+        usage();
+        return 2;
+    }
+
+    // Single-threaded OpenCV so the kernels are compared, not the thread pool
+    cv::setNumThreads(0);
+
+    MicroHarness h(cfg.minTimeMs, cfg.filter);
+    benchNms(h, cfg.quick);
+    benchNmsObb(h, cfg.quick);
+    benchDecode(h, cfg.quick);
+    benchSigmoid(h, cfg.quick);
+    benchMasks(h, cfg.quick);
+    benchLetterbox(h, cfg.quick);
+    benchScale(h, cfg.quick);
+
+    std::cout << "\n";
+    h.printTable(std::cout);
+
+    if (!cfg.json.empty()) {
+        std::ofstream f(cfg.json);
+        if (!f) {
+            std::cerr << "[kernel_bench] Cannot write " << cfg.json << std::endl;
+            return 1;
+        }
+        h.writeJson(f);
+    }
+    return 0;
+}
@@ -0,0 +1,387 @@
+#include "kernel_variants.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <opencv2/dnn.hpp>
+
+namespace variants {
+
+    // ------------------------------------------------------------------------
+    // NMS
+    // ------------------------------------------------------------------------
+
+    void nmsBoxesFlat(const std::vector<BoundingBox>& boxes, const std::vector<float>& scores,
+        float scoreThreshold, float nmsThreshold, std::vector<int>& indices)
+    {
+        indices.clear();
+
+        std::vector<int> order;
+        order.reserve(boxes.size());
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            if (scores[i] >= scoreThreshold)
+                order.push_back(static_cast<int>(i));
+        }
+        std::sort(order.begin(), order.end(), [&scores](int a, int b) { return scores[a] > scores[b]; });
+
+        // Corners of kept boxes, appended as they are accepted
+        std::vector<float> kx1, ky1, kx2, ky2, karea;
+        kx1.reserve(order.size()); ky1.reserve(order.size());
+        kx2.reserve(order.size()); ky2.reserve(order.size());
+        karea.reserve(order.size());
+
+        for (const int idx : order) {
+            const BoundingBox& b = boxes[idx];
+            const float x1 = static_cast<float>(b.x);
+            const float y1 = static_cast<float>(b.y);
+            const float x2 = static_cast<float>(b.x + b.width);
+            const float y2 = static_cast<float>(b.y + b.height);
+            const float area = static_cast<float>(b.width * b.height);
+
+            bool keep = true;
+            const size_t kept = karea.size();
+            for (size_t k = 0; k < kept; ++k) {
+                const float iw = std::min(x2, kx2[k]) - std::max(x1, kx1[k]);
+                const float ih = std::min(y2, ky2[k]) - std::max(y1, ky1[k]);
+                if (iw <= 0 || ih <= 0)
+                    continue;
+                const float inter = iw * ih;
+                const float uni = karea[k] + area - inter;
+                if (uni > 0.0f && inter / uni > nmsThreshold) {
+                    keep = false;
+                    break;
+                }
+            }
+            if (!keep)
+                continue;
+
+            indices.push_back(idx);
+            kx1.push_back(x1); ky1.push_back(y1);
+            kx2.push_back(x2); ky2.push_back(y2);
+            karea.push_back(area);
+        }
+    }
+
+    void nmsBoxesOpenCV(const std::vector<BoundingBox>& boxes, const std::vector<float>& scores,
+        float scoreThreshold, float nmsThreshold, std::vector<int>& indices)
+    {
+        std::vector<cv::Rect> rects;
+        rects.reserve(boxes.size());
+        for (const auto& b : boxes)
+            rects.emplace_back(b.x, b.y, b.width, b.height);
+        indices.clear();
+        cv::dnn::NMSBoxes(rects, scores, scoreThreshold, nmsThreshold, indices);
+    }
+
+    std::vector<int> nmsRotatedLazy(const std::vector<OrientedBoundingBox>& boxes,
+        const std::vector<float>& scores, float threshold)
+    {
+        std::vector<int> order(boxes.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&scores](int a, int b) { return scores[a] > scores[b]; });
+
+        // Per-box covariance terms in score order
+        struct Cov { float x, y, a, b, c, det; };
+        std::vector<Cov> cov(order.size());
+        for (size_t k = 0; k < order.size(); ++k) {
+            const OrientedBoundingBox& box = boxes[order[k]];
+            Cov& v = cov[k];
+            v.x = box.x;
+            v.y = box.y;
+            utils::getCovarianceComponents(box, v.a, v.b, v.c);
+            v.det = std::max(v.a * v.b - v.c * v.c, 0.0f);
+        }
+
+        // Same rule as nmsRotatedImpl: j survives unless any higher-scored box overlaps it
+        std::vector<int> keep;
+        for (size_t j = 0; j < cov.size(); ++j) {
+            const Cov& q = cov[j];
+            bool keepJ = true;
+            for (size_t i = 0; i < j; ++i) {
+                const Cov& p = cov[i];
+                const float sa = p.a + q.a;
+                const float sb = p.b + q.b;
+                const float sc = p.c + q.c;
+                const float num = sa * sb - sc * sc;
+                const float denom = num + EPS;
+                const float dx = p.x - q.x;
+                const float dy = p.y - q.y;
+                const float t1 = (sa * dy * dy + sb * dx * dx) * 0.25f / denom;
+                const float t2 = (sc * -dx * dy) * 0.5f / denom;
+                const float t3 = 0.5f * std::log(num / (4.0f * std::sqrt(p.det * q.det) + EPS) + EPS);
+                const float bd = std::clamp(t1 + t2 + t3, EPS, 100.0f);
+                const float iou = 1.0f - std::sqrt(1.0f - std::exp(-bd) + EPS);
+                if (iou >= threshold) {
+                    keepJ = false;
+                    break;
+                }
+            }
+            if (keepJ)
+                keep.push_back(order[j]);
+        }
+        return keep;
+    }
+
+    // ------------------------------------------------------------------------
+    // Detect head decode
+    // ------------------------------------------------------------------------
+
+    static inline void emitDetection(float cx, float cy, float w, float h, float score, int classId,
+        const cv::Size& letterboxShape, const cv::Size& originalShape, Decoded& out)
+    {
+        // Mirrors YOLOv11Detector::postprocess, including BoundingBox's int conversion
+        const float left = cx - w / 2.0f;
+        const float top = cy - h / 2.0f;
+        BoundingBox scaled = utils::scaleCoords(letterboxShape,
+            BoundingBox(static_cast<int>(left), static_cast<int>(top), static_cast<int>(w), static_cast<int>(h)),
+            originalShape, true);
+        out.boxes.push_back(scaled);
+        out.scores.push_back(score);
+        out.classIds.push_back(classId);
+    }
+
+    void decodeReference(const float* output, int numClasses, int anchors, float confThreshold,
+        const cv::Size& letterboxShape, const cv::Size& originalShape, Decoded& out)
+    {
+        out.clear();
+        const size_t n = static_cast<size_t>(anchors);
+        for (size_t d = 0; d < n; ++d) {
+            int classId = -1;
+            float maxScore = -FLT_MAX;
+            for (int c = 0; c < numClasses; ++c) {
+                const float score = output[d + (4 + c) * n];
+                if (score > maxScore) {
+                    maxScore = score;
+                    classId = c;
+                }
+            }
+            if (maxScore > confThreshold) {
+                emitDetection(output[d], output[n + d], output[2 * n + d], output[3 * n + d],
+                    maxScore, classId, letterboxShape, originalShape, out);
+            }
+        }
+    }
+
+    void decodeClassMajor(const float* output, int numClasses, int anchors, float confThreshold,
+        const cv::Size& letterboxShape, const cv::Size& originalShape, Decoded& out)
+    {
+        out.clear();
+        const size_t n = static_cast<size_t>(anchors);
+        out.best.assign(n, -FLT_MAX);
+        out.bestId.assign(n, -1);
+        float* best = out.best.data();
+        int* bestId = out.bestId.data();
+
+        for (int c = 0; c < numClasses; ++c) {
+            const float* row = output + (4 + c) * n;
+            for (size_t d = 0; d < n; ++d) {
+                if (row[d] > best[d]) {
+                    best[d] = row[d];
+                    bestId[d] = c;
+                }
+            }
+        }
+        for (size_t d = 0; d < n; ++d) {
+            if (best[d] > confThreshold) {
+                emitDetection(output[d], output[n + d], output[2 * n + d], output[3 * n + d],
+                    best[d], bestId[d], letterboxShape, originalShape, out);
+            }
+        }
+    }
+
+    void decodeTransposed(const float* output, int numClasses, int anchors, float confThreshold,
+        const cv::Size& letterboxShape, const cv::Size& originalShape, Decoded& out)
+    {
+        out.clear();
+        const cv::Mat raw(4 + numClasses, anchors, CV_32F, const_cast<float*>(output));
+        cv::transpose(raw, out.transposed);
+
+        for (int d = 0; d < anchors; ++d) {
+            const float* row = out.transposed.ptr<float>(d);
+            const float* scores = row + 4;
+            const float* top = std::max_element(scores, scores + numClasses);
+            if (*top > confThreshold) {
+                emitDetection(row[0], row[1], row[2], row[3], *top, static_cast<int>(top - scores),
+                    letterboxShape, originalShape, out);
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Activation
+    // ------------------------------------------------------------------------
+
+    void sigmoidInPlace(cv::Mat& m)
+    {
+        CV_Assert(m.type() == CV_32F);
+        const int rows = m.isContinuous() ? 1 : m.rows;
+        const int cols = m.isContinuous() ? static_cast<int>(m.total()) : m.cols;
+        for (int r = 0; r < rows; ++r) {
+            float* p = m.ptr<float>(r);
+            for (int c = 0; c < cols; ++c)
+                p[c] = 1.0f / (1.0f + std::exp(-p[c]));
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Segmentation mask assembly
+    // ------------------------------------------------------------------------
+
+    // Letterbox-unpadded region of the prototype grid, as computed by the seg detector
+    static cv::Rect protoCropRect(const MaskJob& job)
+    {
+        const cv::Size& lb = job.letterboxShape;
+        const cv::Size& orig = job.originalShape;
+        const int maskW = job.maskSize.width;
+        const int maskH = job.maskSize.height;
+
+        const float gain = std::min(static_cast<float>(lb.height) / orig.height,
+            static_cast<float>(lb.width) / orig.width);
+        const int scaledW = static_cast<int>(orig.width * gain);
+        const int scaledH = static_cast<int>(orig.height * gain);
+        const float padW = (lb.width - scaledW) / 2.0f;
+        const float padH = (lb.height - scaledH) / 2.0f;
+        const float maskScaleX = static_cast<float>(maskW) / lb.width;
+        const float maskScaleY = static_cast<float>(maskH) / lb.height;
+
+        int x1 = static_cast<int>(std::round((padW - 0.1f) * maskScaleX));
+        int y1 = static_cast<int>(std::round((padH - 0.1f) * maskScaleY));
+        int x2 = static_cast<int>(std::round((lb.width - padW + 0.1f) * maskScaleX));
+        int y2 = static_cast<int>(std::round((lb.height - padH + 0.1f) * maskScaleY));
+        x1 = std::max(0, std::min(x1, maskW - 1));
+        y1 = std::max(0, std::min(y1, maskH - 1));
+        x2 = std::max(x1, std::min(x2, maskW));
+        y2 = std::max(y1, std::min(y2, maskH));
+        return cv::Rect(x1, y1, x2 - x1, y2 - y1);
+    }
+
+    void assembleMasksReference(const MaskJob& job, std::vector<cv::Mat>& masks)
+    {
+        masks.clear();
+        const int maskW = job.maskSize.width;
+        const int maskH = job.maskSize.height;
+        const int numProtos = job.protos.rows;
+
+        std::vector<cv::Mat> prototypeMasks;
+        prototypeMasks.reserve(numProtos);
+        for (int m = 0; m < numProtos; ++m) {
+            cv::Mat proto(maskH, maskW, CV_32F, const_cast<float*>(job.protos.ptr<float>(m)));
+            prototypeMasks.emplace_back(proto.clone());
+        }
+
+        const cv::Rect cropRect = protoCropRect(job);
+        for (size_t i = 0; i < job.boxes.size(); ++i) {
+            const BoundingBox box = utils::scaleCoordsSeg(job.letterboxShape, job.boxes[i], job.originalShape, true);
+            const float* coeffs = job.coeffs.ptr<float>(static_cast<int>(i));
+
+            cv::Mat finalMask = cv::Mat::zeros(maskH, maskW, CV_32F);
+            for (int m = 0; m < numProtos; ++m)
+                finalMask += coeffs[m] * prototypeMasks[m];
+            finalMask = utils::sigmoid(finalMask);
+
+            cv::Mat croppedMask = finalMask(cropRect).clone();
+            cv::Mat resizedMask;
+            cv::resize(croppedMask, resizedMask, job.originalShape, 0, 0, cv::INTER_LINEAR);
+            cv::Mat binaryMask;
+            cv::threshold(resizedMask, binaryMask, 0.5, 255.0, cv::THRESH_BINARY);
+            binaryMask.convertTo(binaryMask, CV_8U);
+
+            cv::Mat finalBinaryMask = cv::Mat::zeros(job.originalShape, CV_8U);
+            cv::Rect roi(box.x, box.y, box.width, box.height);
+            roi &= cv::Rect(0, 0, binaryMask.cols, binaryMask.rows);
+            if (roi.area() > 0)
+                binaryMask(roi).copyTo(finalBinaryMask(roi));
+            masks.push_back(finalBinaryMask);
+        }
+    }
+
+    void assembleMasksGemm(const MaskJob& job, std::vector<cv::Mat>& masks)
+    {
+        masks.clear();
+        if (job.boxes.empty())
+            return;
+
+        // [boxes, 32] x [32, maskH * maskW] -> one logit map per row
+        cv::Mat logits;
+        cv::gemm(job.coeffs, job.protos, 1.0, cv::noArray(), 0.0, logits);
+
+        const cv::Rect cropRect = protoCropRect(job);
+        const cv::Size& orig = job.originalShape;
+        const double sx = static_cast<double>(cropRect.width) / orig.width;
+        const double sy = static_cast<double>(cropRect.height) / orig.height;
+
+        cv::Mat patch;
+        for (size_t i = 0; i < job.boxes.size(); ++i) {
+            const BoundingBox box = utils::scaleCoordsSeg(job.letterboxShape, job.boxes[i], orig, true);
+            cv::Mat mask = cv::Mat::zeros(orig, CV_8U);
+            cv::Rect roi(box.x, box.y, box.width, box.height);
+            roi &= cv::Rect(0, 0, orig.width, orig.height);
+            if (roi.area() > 0) {
+                const cv::Mat grid = logits.row(static_cast<int>(i)).reshape(1, job.maskSize.height)(cropRect);
+                // Same pixel-centre mapping cv::resize uses for the full frame, restricted to roi
+                const cv::Matx23d inv(sx, 0.0, (roi.x + 0.5) * sx - 0.5,
+                    0.0, sy, (roi.y + 0.5) * sy - 0.5);
+                cv::warpAffine(grid, patch, inv, roi.size(), cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_REPLICATE);
+                cv::Mat dst = mask(roi);
+                cv::compare(patch, 0.0, dst, cv::CMP_GT);
+            }
+            masks.push_back(mask);
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Letterbox / coordinate scaling
+    // ------------------------------------------------------------------------
+
+    void letterBoxInto(const cv::Mat& image, cv::Mat& out, const cv::Size& newShape, const cv::Scalar& color)
+    {
+        const float ratio = std::min(static_cast<float>(newShape.height) / image.rows,
+            static_cast<float>(newShape.width) / image.cols);
+        const int newUnpadW = static_cast<int>(std::round(image.cols * ratio));
+        const int newUnpadH = static_cast<int>(std::round(image.rows * ratio));
+        const int padLeft = (newShape.width - newUnpadW) / 2;
+        const int padTop = (newShape.height - newUnpadH) / 2;
+
+        out.create(newShape, image.type());
+        const cv::Rect inner(padLeft, padTop, newUnpadW, newUnpadH);
+
+        // Paint only the borders, the inner region is overwritten by the resize
+        if (padTop > 0)
+            out(cv::Rect(0, 0, newShape.width, padTop)).setTo(color);
+        if (inner.br().y < newShape.height)
+            out(cv::Rect(0, inner.br().y, newShape.width, newShape.height - inner.br().y)).setTo(color);
+        if (padLeft > 0)
+            out(cv::Rect(0, padTop, padLeft, newUnpadH)).setTo(color);
+        if (inner.br().x < newShape.width)
+            out(cv::Rect(inner.br().x, padTop, newShape.width - inner.br().x, newUnpadH)).setTo(color);
+
+        cv::Mat dst = out(inner);
+        if (image.size() == inner.size())
+            image.copyTo(dst);
+        else
+            cv::resize(image, dst, inner.size(), 0, 0, cv::INTER_LINEAR);
+    }
+
+    void scaleCoordsBatch(const std::vector<BoundingBox>& in, const cv::Size& letterboxShape,
+        const cv::Size& originalShape, std::vector<BoundingBox>& out)
+    {
+        const float gain = std::min(static_cast<float>(letterboxShape.height) / static_cast<float>(originalShape.height),
+            static_cast<float>(letterboxShape.width) / static_cast<float>(originalShape.width));
+        const float inv = 1.0f / gain;
+        const int padX = static_cast<int>(std::round((letterboxShape.width - originalShape.width * gain) / 2.0f));
+        const int padY = static_cast<int>(std::round((letterboxShape.height - originalShape.height * gain) / 2.0f));
+        const int maxW = originalShape.width;
+        const int maxH = originalShape.height;
+
+        out.resize(in.size());
+        for (size_t i = 0; i < in.size(); ++i) {
+            const BoundingBox& c = in[i];
+            BoundingBox& r = out[i];
+            r.x = utils::clamp(static_cast<int>(std::round((c.x - padX) * inv)), 0, maxW);
+            r.y = utils::clamp(static_cast<int>(std::round((c.y - padY) * inv)), 0, maxH);
+            r.width = utils::clamp(static_cast<int>(std::round(c.width * inv)), 0, maxW - r.x);
+            r.height = utils::clamp(static_cast<int>(std::round(c.height * inv)), 0, maxH - r.y);
+        }
+    }
+
+} // namespace variants
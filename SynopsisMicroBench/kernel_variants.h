@@ -0,0 +1,102 @@
+#pragma once
+#include <vector>
+#include "YOLO-common.h"
+
+/**
+ * @brief Alternative implementations of the utils:: kernels, benchmarked side by side
+ *        with the versions the detectors use today.
+ *
+ * Each *Reference function is a verbatim copy of logic that lives inline in a
+ * detector's postprocess (and therefore cannot be called on its own); everything
+ * else is a candidate replacement producing the same result unless noted.
+ */
+namespace variants {
+
+    // ------------------------------------------------------------------------
+    // NMS
+    // ------------------------------------------------------------------------
+
+    // Same greedy result as utils::NMSBoxes; candidates are tested only against kept
+    // boxes whose corners are precomputed in flat float arrays.
+    void nmsBoxesFlat(const std::vector<BoundingBox>& boxes, const std::vector<float>& scores,
+        float scoreThreshold, float nmsThreshold, std::vector<int>& indices);
+
+    // cv::dnn::NMSBoxes on the same input, as an external reference point
+    void nmsBoxesOpenCV(const std::vector<BoundingBox>& boxes, const std::vector<float>& scores,
+        float scoreThreshold, float nmsThreshold, std::vector<int>& indices);
+
+    // Same keep set as utils::nmsRotated, without the N x N probiou matrix: covariances
+    // are computed once per box and pairs are evaluated lazily until the first hit.
+    std::vector<int> nmsRotatedLazy(const std::vector<OrientedBoundingBox>& boxes,
+        const std::vector<float>& scores, float threshold);
+
+    // ------------------------------------------------------------------------
+    // Detect head decode (output0 = [4 + classes, anchors], channel-major)
+    // ------------------------------------------------------------------------
+
+    struct Decoded {
+        std::vector<BoundingBox> boxes;
+        std::vector<float> scores;
+        std::vector<int> classIds;
+        // scratch reused across calls by the alternative decoders
+        std::vector<float> best;
+        std::vector<int> bestId;
+        cv::Mat transposed;
+
+        void clear() { boxes.clear(); scores.clear(); classIds.clear(); }
+    };
+
+    // Loop of YOLOv11Detector::postprocess: per anchor, strided argmax over classes
+    void decodeReference(const float* output, int numClasses, int anchors, float confThreshold,
+        const cv::Size& letterboxShape, const cv::Size& originalShape, Decoded& out);
+
+    // Argmax with classes in the outer loop, so every read is a contiguous row
+    void decodeClassMajor(const float* output, int numClasses, int anchors, float confThreshold,
+        const cv::Size& letterboxShape, const cv::Size& originalShape, Decoded& out);
+
+    // cv::transpose to [anchors, channels] first, then a row-wise scan
+    void decodeTransposed(const float* output, int numClasses, int anchors, float confThreshold,
+        const cv::Size& letterboxShape, const cv::Size& originalShape, Decoded& out);
+
+    // ------------------------------------------------------------------------
+    // Activation
+    // ------------------------------------------------------------------------
+
+    // Scalar in-place logistic, no temporaries (utils::sigmoid allocates two)
+    void sigmoidInPlace(cv::Mat& m);
+
+    // ------------------------------------------------------------------------
+    // Segmentation mask assembly
+    // ------------------------------------------------------------------------
+
+    struct MaskJob {
+        cv::Mat protos;                 // [32, maskH * maskW] CV_32F, as output1
+        cv::Size maskSize;              // prototype resolution, usually 160x160
+        cv::Size letterboxShape;
+        cv::Size originalShape;
+        std::vector<BoundingBox> boxes; // letterbox coordinates, after NMS
+        cv::Mat coeffs;                 // [boxes, 32] CV_32F
+    };
+
+    // Loop of YOLOv11SegDetector::postprocess: 32 weighted adds, sigmoid, crop,
+    // full-frame resize and threshold per detection
+    void assembleMasksReference(const MaskJob& job, std::vector<cv::Mat>& masks);
+
+    // One GEMM for all detections, then only each box's region is resampled straight
+    // from the logits (sigmoid(x) > 0.5 <=> x > 0). Interpolating logits rather than
+    // probabilities can flip a few boundary pixels; kernel_bench reports how many.
+    void assembleMasksGemm(const MaskJob& job, std::vector<cv::Mat>& masks);
+
+    // ------------------------------------------------------------------------
+    // Letterbox / coordinate scaling
+    // ------------------------------------------------------------------------
+
+    // Same output as utils::letterBox(auto_ = false), resizing straight into the padded
+    // buffer so a reused `out` never reallocates
+    void letterBoxInto(const cv::Mat& image, cv::Mat& out, const cv::Size& newShape, const cv::Scalar& color);
+
+    // utils::scaleCoords over a batch with gain and padding computed once
+    void scaleCoordsBatch(const std::vector<BoundingBox>& in, const cv::Size& letterboxShape,
+        const cv::Size& originalShape, std::vector<BoundingBox>& out);
+
+} // namespace variants
@@ -0,0 +1,85 @@
+#include "micro_harness.h"
+#include <algorithm>
+#include <cstdio>
+
+static volatile size_t g_sink = 0;
+
+void MicroHarness::sink(size_t v)
+{
+    g_sink = g_sink + v;
+}
+
+void MicroHarness::add(const std::string& group, const std::string& name, const std::string& param,
+    size_t items, uint64_t calls, std::vector<double>& perCall)
+{
+    std::sort(perCall.begin(), perCall.end());
+    CaseResult r;
+    r.group = group;
+    r.name = name;
+    r.param = param;
+    r.items = items;
+    r.calls = calls;
+    r.medianNs = perCall[perCall.size() / 2];
+    r.minNs = perCall.front();
+    results_.push_back(r);
+
+    std::fprintf(stderr, "  %-10s %-34s %-28s %12.1f ns\n", group.c_str(), name.c_str(), param.c_str(), r.medianNs);
+}
+
+static const CaseResult* findBaseline(const std::vector<CaseResult>& all, const CaseResult& r)
+{
+    for (const auto& c : all) {
+        if (c.group == r.group && c.param == r.param)
+            return &c;
+    }
+    return nullptr;
+}
+
+static std::string formatNs(double ns)
+{
+    char buf[32];
+    if (ns >= 1e6)
+        std::snprintf(buf, sizeof(buf), "%.2f ms", ns / 1e6);
+    else if (ns >= 1e3)
+        std::snprintf(buf, sizeof(buf), "%.2f us", ns / 1e3);
+    else
+        std::snprintf(buf, sizeof(buf), "%.1f ns", ns);
+    return buf;
+}
+
+void MicroHarness::printTable(std::ostream& os) const
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-10s %-34s %-28s %12s %12s %8s\n",
+        "group", "implementation", "param", "median", "min", "speedup");
+    os << line;
+    std::string lastKey;
+    for (const auto& r : results_) {
+        const std::string key = r.group + "|" + r.param;
+        if (!lastKey.empty() && key != lastKey)
+            os << "\n";
+        lastKey = key;
+
+        const CaseResult* base = findBaseline(results_, r);
+        const double speedup = (base && r.medianNs > 0.0) ? base->medianNs / r.medianNs : 1.0;
+        std::snprintf(line, sizeof(line), "%-10s %-34s %-28s %12s %12s %7.2fx\n",
+            r.group.c_str(), r.name.c_str(), r.param.c_str(),
+            formatNs(r.medianNs).c_str(), formatNs(r.minNs).c_str(), speedup);
+        os << line;
+    }
+}
+
+void MicroHarness::writeJson(std::ostream& os) const
+{
+    os << "[";
+    for (size_t i = 0; i < results_.size(); ++i) {
+        const auto& r = results_[i];
+        const double ips = r.medianNs > 0.0 ? r.items * 1e9 / r.medianNs : 0.0;
+        os << (i ? ",\n " : "\n ")
+            << "{\"group\":\"" << r.group << "\",\"name\":\"" << r.name << "\",\"param\":\"" << r.param
+            << "\",\"items\":" << r.items << ",\"calls\":" << r.calls
+            << ",\"median_ns\":" << r.medianNs << ",\"min_ns\":" << r.minNs
+            << ",\"items_per_sec\":" << ips << "}";
+    }
+    os << "\n]\n";
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstdint>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Result of one benchmark case (one implementation at one size).
+ */
+struct CaseResult {
+    std::string group;      // kernel family, e.g. "nms"
+    std::string name;       // implementation, e.g. "utils::NMSBoxes"
+    std::string param;      // sweep point, e.g. "n=4000 overlap=0.5"
+    size_t items = 0;       // work items per call, used for throughput
+    uint64_t calls = 0;     // total timed calls
+    double medianNs = 0.0;  // median ns per call over the timed batches
+    double minNs = 0.0;     // best batch ns per call
+};
+
+/**
+ * @brief Minimal in-process timing harness for kernel_bench.
+ *
+ * Each case is warmed up once, calibrated so one batch takes roughly a millisecond,
+ * then timed in batches until minTimeMs elapsed (at least 5 batches). The first
+ * implementation registered for a (group, param) pair is the baseline the others
+ * are compared against in the table.
+ *
+ * The callable returns a checksum that is folded into a volatile sink so the
+ * compiler cannot drop the work.
+ */
+class MicroHarness {
+public:
+    MicroHarness(double minTimeMs, const std::string& filter) : minTimeMs_(minTimeMs), filter_(filter) {}
+
+    bool enabled(const std::string& group, const std::string& name) const {
+        return filter_.empty() || group.find(filter_) != std::string::npos || name.find(filter_) != std::string::npos;
+    }
+
+    template <typename Fn>
+    void run(const std::string& group, const std::string& name, const std::string& param, size_t items, Fn&& fn) {
+        if (!enabled(group, name))
+            return;
+        using Clock = std::chrono::steady_clock;
+
+        sink(fn());
+
+        // Calibrate the batch size to ~1 ms
+        uint64_t batch = 1;
+        for (;;) {
+            const auto t0 = Clock::now();
+            for (uint64_t i = 0; i < batch; ++i)
+                sink(fn());
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+            if (ns >= 1e6 || batch >= (1u << 24))
+                break;
+            batch *= (ns < 1e5) ? 10 : 2;
+        }
+
+        std::vector<double> perCall;
+        double elapsedMs = 0.0;
+        while (perCall.size() < 5 || elapsedMs < minTimeMs_) {
+            const auto t0 = Clock::now();
+            for (uint64_t i = 0; i < batch; ++i)
+                sink(fn());
+            const double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+            perCall.push_back(ns / batch);
+            elapsedMs += ns / 1e6;
+        }
+        add(group, name, param, items, batch * perCall.size(), perCall);
+    }
+
+    const std::vector<CaseResult>& results() const { return results_; }
+
+    // Human readable table with speedup against each (group, param) baseline
+    void printTable(std::ostream& os) const;
+    // [{"group":..,"name":..,"param":..,"items":..,"calls":..,"median_ns":..,"min_ns":..,"items_per_sec":..}, ...]
+    void writeJson(std::ostream& os) const;
+
+private:
+    static void sink(size_t v);
+    void add(const std::string& group, const std::string& name, const std::string& param,
+        size_t items, uint64_t calls, std::vector<double>& perCall);
+
+    double minTimeMs_;
+    std::string filter_;
+    std::vector<CaseResult> results_;
+};
@@ -0,0 +1,147 @@
+#include "synthetic_data.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace synth {
+
+    namespace {
+        struct Proto {
+            float cx, cy, w, h, angle;
+        };
+
+        // Cluster centres plus per-box jitter; the same model drives both box kinds
+        template <typename Emit>
+        void generate(int count, float overlap, const cv::Size& canvas, float minSide, float maxSide,
+            bool rotated, uint32_t seed, Emit&& emit)
+        {
+            std::mt19937 rng(seed);
+            std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+            std::uniform_real_distribution<float> score(0.05f, 1.0f);
+
+            overlap = std::min(std::max(overlap, 0.0f), 0.99f);
+            const int clusters = std::max(1, static_cast<int>(std::lround(count * (1.0f - overlap))));
+            std::vector<Proto> centres(clusters);
+            for (auto& c : centres) {
+                c.w = minSide + (maxSide - minSide) * u01(rng);
+                c.h = minSide + (maxSide - minSide) * u01(rng);
+                c.cx = c.w / 2 + (canvas.width - c.w) * u01(rng);
+                c.cy = c.h / 2 + (canvas.height - c.h) * u01(rng);
+                c.angle = rotated ? static_cast<float>(CV_PI) * u01(rng) : 0.0f;
+            }
+
+            std::normal_distribution<float> jitter(0.0f, 0.06f);
+            for (int i = 0; i < count; ++i) {
+                // The first `clusters` boxes are the centres themselves, the rest are duplicates
+                const Proto& c = centres[i < clusters ? i : rng() % clusters];
+                Proto p = c;
+                if (i >= clusters) {
+                    p.cx += c.w * jitter(rng);
+                    p.cy += c.h * jitter(rng);
+                    p.w *= 1.0f + jitter(rng);
+                    p.h *= 1.0f + jitter(rng);
+                    if (rotated)
+                        p.angle += 0.5f * jitter(rng);
+                }
+                emit(p, score(rng));
+            }
+        }
+    }
+
+    BoxSet makeBoxes(int count, float overlap, const cv::Size& canvas, uint32_t seed)
+    {
+        BoxSet set;
+        set.boxes.reserve(count);
+        set.scores.reserve(count);
+        const float side = static_cast<float>(std::min(canvas.width, canvas.height));
+        generate(count, overlap, canvas, side * 0.03f, side * 0.3f, false, seed,
+            [&](const Proto& p, float s) {
+                set.boxes.emplace_back(
+                    static_cast<int>(std::lround(p.cx - p.w / 2)), static_cast<int>(std::lround(p.cy - p.h / 2)),
+                    static_cast<int>(std::lround(p.w)), static_cast<int>(std::lround(p.h)));
+                set.scores.push_back(s);
+            });
+        return set;
+    }
+
+    ObbSet makeObbCloud(int count, float overlap, const cv::Size& canvas, uint32_t seed)
+    {
+        ObbSet set;
+        set.boxes.reserve(count);
+        set.scores.reserve(count);
+        const float side = static_cast<float>(std::min(canvas.width, canvas.height));
+        generate(count, overlap, canvas, side * 0.01f, side * 0.08f, true, seed,
+            [&](const Proto& p, float s) {
+                set.boxes.emplace_back(p.cx, p.cy, p.w, p.h, p.angle);
+                set.scores.push_back(s);
+            });
+        return set;
+    }
+
+    std::vector<float> makeDetectOutput(int numClasses, int anchors, int objects,
+        int extraChannels, const cv::Size& inputShape, uint32_t seed)
+    {
+        const int channels = 4 + numClasses + extraChannels;
+        std::vector<float> out(static_cast<size_t>(channels) * anchors);
+        auto at = [&](int ch, int a) -> float& { return out[static_cast<size_t>(ch) * anchors + a]; };
+
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> u01(0.0f, 1.0f);
+        std::normal_distribution<float> coeff(0.0f, 1.0f);
+
+        // Background: random small boxes and near-zero class scores
+        for (int a = 0; a < anchors; ++a) {
+            at(0, a) = inputShape.width * u01(rng);
+            at(1, a) = inputShape.height * u01(rng);
+            at(2, a) = 4.0f + 60.0f * u01(rng);
+            at(3, a) = 4.0f + 60.0f * u01(rng);
+            for (int c = 0; c < numClasses; ++c)
+                at(4 + c, a) = 0.02f * u01(rng);
+            for (int e = 0; e < extraChannels; ++e)
+                at(4 + numClasses + e, a) = coeff(rng);
+        }
+
+        // Objects: ~8 anchors each, one dominant class
+        for (int o = 0; o < objects; ++o) {
+            const float w = 20.0f + 200.0f * u01(rng);
+            const float h = 20.0f + 200.0f * u01(rng);
+            const float cx = w / 2 + (inputShape.width - w) * u01(rng);
+            const float cy = h / 2 + (inputShape.height - h) * u01(rng);
+            const int cls = static_cast<int>(rng() % numClasses);
+            const float peak = 0.4f + 0.55f * u01(rng);
+            for (int k = 0; k < 8; ++k) {
+                const int a = static_cast<int>(rng() % anchors);
+                at(0, a) = cx + w * 0.05f * (u01(rng) - 0.5f);
+                at(1, a) = cy + h * 0.05f * (u01(rng) - 0.5f);
+                at(2, a) = w * (0.95f + 0.1f * u01(rng));
+                at(3, a) = h * (0.95f + 0.1f * u01(rng));
+                at(4 + cls, a) = peak * (0.7f + 0.3f * u01(rng));
+            }
+        }
+        return out;
+    }
+
+    cv::Mat makePrototypes(int count, const cv::Size& size, uint32_t seed)
+    {
+        cv::RNG rng(seed);
+        cv::Mat protos(count, size.area(), CV_32F);
+        cv::Mat field(size, CV_32F);
+        for (int m = 0; m < count; ++m) {
+            rng.fill(field, cv::RNG::NORMAL, 0.0, 1.0);
+            cv::GaussianBlur(field, field, cv::Size(0, 0), 4.0 + (m % 4) * 2.0);
+            cv::normalize(field, field, -2.0, 2.0, cv::NORM_MINMAX);
+            field.reshape(1, 1).copyTo(protos.row(m));
+        }
+        return protos;
+    }
+
+    cv::Mat makeFrame(const cv::Size& size, uint32_t seed)
+    {
+        cv::RNG rng(seed);
+        cv::Mat frame(size, CV_8UC3);
+        rng.fill(frame, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(255));
+        cv::GaussianBlur(frame, frame, cv::Size(0, 0), 2.0);
+        return frame;
+    }
+
+} // namespace synth
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "YOLO-common.h"
+
+/**
+ * @brief Synthetic inputs for kernel_bench, all deterministic for a given seed.
+ *
+ * "overlap" is the fraction of boxes that are jittered duplicates of another box:
+ * 0 scatters every box independently, 0.9 packs the set into n/10 clusters of
+ * near-identical boxes, which is what NMS sees on crowded scenes.
+ */
+namespace synth {
+
+    struct BoxSet {
+        std::vector<BoundingBox> boxes;
+        std::vector<float> scores;
+    };
+
+    struct ObbSet {
+        std::vector<OrientedBoundingBox> boxes;
+        std::vector<float> scores;
+    };
+
+    // Axis-aligned boxes on a canvas, scores uniform in [0.05, 1)
+    BoxSet makeBoxes(int count, float overlap, const cv::Size& canvas, uint32_t seed);
+
+    // Rotated boxes (aerial-style: small, arbitrary angle) with the same clustering model
+    ObbSet makeObbCloud(int count, float overlap, const cv::Size& canvas, uint32_t seed);
+
+    /**
+     * @brief Raw detector output laid out like YOLO11's output0: [channels, anchors],
+     *        channel-major, channels = 4 box + numClasses scores + extraChannels.
+     *
+     * Most anchors carry background scores below 0.02; each object lights up a
+     * handful of neighbouring anchors with one strong class, as a real head does.
+     * Extra channels (mask coefficients for seg) are N(0, 1).
+     */
+    std::vector<float> makeDetectOutput(int numClasses, int anchors, int objects,
+        int extraChannels, const cv::Size& inputShape, uint32_t seed);
+
+    /**
+     * @brief Prototype masks laid out like YOLO11-seg's output1: [count, h * w] CV_32F.
+     *        Each prototype is a smooth random field so mask sums have realistic structure.
+     */
+    cv::Mat makePrototypes(int count, const cv::Size& size, uint32_t seed);
+
+    // BGR frame with a textured background for the letterbox cases
+    cv::Mat makeFrame(const cv::Size& size, uint32_t seed);
+
+} // namespace synth
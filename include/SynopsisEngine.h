@@ -1,17 +1,48 @@
 #ifndef __SYNOPSIS_ENGINE_H__
 #define __SYNOPSIS_ENGINE_H__
-#include <tchar.h>
+#include "vs_platform.h"
 #include "yolo_define.h"
-
-#define VSENGINE_API __declspec(dllexport)
+#include "vs_result.h"
+#include "vs_metrics.h"
+#include "vs_video.h"
+#include "vs_scheduler.h"
+#include "vs_synopsis.h"
+#include "vs_events.h"
 
 typedef enum error_code {
 	VS_SUCCESS = 0,
 	VS_ERROR_INITIALIZATION_FAILED = 1,
 	VS_ERROR_INVALID_HANDLE = 2,
+	VS_ERROR_TASK_MISMATCH = 3,
+	VS_ERROR_OPEN_FAILED = 4,
+	VS_ERROR_TIMEOUT = 5,
+	VS_ERROR_END_OF_STREAM = 6,
+	VS_ERROR_NO_MATCHES = 7,
 	VS_ERROR_UNKNOWN = 99
 }vsCode;
 
+// Model variant to load. FP16/INT8 select "<model>-fp16.onnx" / "<model>-int8.onnx" next to the
+// FP32 file; the variant must keep float32 inputs and outputs.
+typedef enum vsPrecision {
+	VS_PRECISION_FP32 = 0,
+	VS_PRECISION_FP16,
+	VS_PRECISION_INT8
+}vsPrec;
+
+typedef struct vsModelOptions {
+	YoloTask    task;
+	int         intraOpThreads;  // 0 = engine default
+	int         useGPU;          // falls back to CPU when the CUDA provider is missing
+	vsPrecision precision;
+}vsModelOpts;
+
+// What a handle's results depend on, for callers that cache them (see vsGetModelInfo)
+typedef struct vsModelInfo {
+	char  modelPathUtf8[1024];   // ONNX file the handle loaded
+	float confThreshold;         // score and NMS thresholds applied to every result
+	float iouThreshold;
+}vsModelInf;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -21,12 +52,102 @@ typedef void* vsHandle;
 // vsCode VSENGINE_API vsInitializeEngine(vsHandle* outHandle, const TCHAR* app_path);
 // vsCode VSENGINE_API vsShutdownEngine(vsHandle handle);
 
-// vsCode VSENGINE_API vsOpenVideo(vsHandle handle, int source_id, const TCHAR* url);
-// vsCode VSENGINE_API vsCloseVideo(vsHandle handle, int source_id);
-
 vsCode VSENGINE_API vsInitYoloModel(vsHandle* outYolo, const TCHAR* appPath, YoloTask task = YT_DETECT);
+vsCode VSENGINE_API vsInitYoloModelEx(vsHandle* outYolo, const TCHAR* appPath, const vsModelOptions* options);
 vsCode VSENGINE_API vsReleaseYoloModel(vsHandle yoloHandle);
+// VS_ERROR_UNKNOWN if the model path does not fit modelPathUtf8
+vsCode VSENGINE_API vsGetModelInfo(vsHandle yoloHandle, vsModelInfo* outInfo);
+// Releases every model, video source, scheduler and event engine still open and stops the
+// engine's worker threads, the log writer included. Required before FreeLibrary, with no other
+// call still running: threads cannot be joined while the DLL unloads, so unloading with the
+// writer alive asserts in debug builds. Log lines after this are written synchronously.
+vsCode VSENGINE_API vsShutdown();
 vsCode VSENGINE_API vsDetectObjects(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, Detection** outDetections, int* outCount);
+vsCode VSENGINE_API vsReleaseDetections(Detection* detections);
+
+// Task specific entry points. Each returns one contiguous block (see vs_result.h) that must be
+// released with vsReleaseResult. The handle must have been created with the matching YoloTask.
+vsCode VSENGINE_API vsSegment(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsMaskEncoding maskEncoding, vsResultHeader** outResult);
+vsCode VSENGINE_API vsEstimatePose(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsResultHeader** outResult);
+vsCode VSENGINE_API vsDetectOriented(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsResultHeader** outResult);
+vsCode VSENGINE_API vsClassify(vsHandle yoloHandle, const unsigned char* imgData, int width, int height, int channels, vsResultHeader** outResult);
+vsCode VSENGINE_API vsReleaseResult(vsResultHeader* result);
+
+// Metrics (see vs_metrics.h). Every call on a handle records its stage latencies under the
+// stream id set for the calling thread with vsSetThreadStream (default 0).
+// streamId may be VS_METRICS_ALL_STREAMS for the aggregate over all streams.
+vsCode VSENGINE_API vsSetThreadStream(int streamId);
+vsCode VSENGINE_API vsGetMetrics(vsHandle yoloHandle, int streamId, vsMetricsSnapshot* outSnapshot);
+// Writes a NUL terminated JSON document. outLength receives the length without the terminator;
+// if bufferSize is too small (or buffer is NULL) nothing is written and VS_ERROR_UNKNOWN is returned.
+vsCode VSENGINE_API vsGetMetricsJson(vsHandle yoloHandle, int streamId, char* buffer, int bufferSize, int* outLength);
+vsCode VSENGINE_API vsResetMetrics(vsHandle yoloHandle, int streamId);
+// Samples measured by the caller, e.g. queue wait before the frame reached the engine
+vsCode VSENGINE_API vsRecordMetric(vsHandle yoloHandle, int streamId, vsMetricStage stage, double micros);
+vsCode VSENGINE_API vsRecordDrops(vsHandle yoloHandle, int streamId, unsigned int count);
+
+// Video ingestion (see vs_video.h). source_id is chosen by the caller and must be unique per
+// handle; frames of a source are recorded in the metrics under stream source_id (0 if >= 64).
+// vsOpenVideo uses default options and polling. With a callback, vsPollVideo is not available.
+vsCode VSENGINE_API vsOpenVideo(vsHandle handle, int source_id, const TCHAR* url);
+vsCode VSENGINE_API vsOpenVideoEx(vsHandle handle, int source_id, const TCHAR* url, const vsVideoOptions* options,
+	vsFrameResultCallback callback, void* userData);
+// Waits up to timeoutMs (-1 = forever) for the next result. Returns VS_ERROR_TIMEOUT if none
+// arrived and VS_ERROR_END_OF_STREAM once the source is exhausted and every result was taken.
+vsCode VSENGINE_API vsPollVideo(vsHandle handle, int source_id, vsFrameResult* outFrame, int timeoutMs);
+vsCode VSENGINE_API vsGetVideoInfo(vsHandle handle, int source_id, vsVideoInfo* outInfo);
+// Encoder backlog and counters of the annotated output (VS_ERROR_INVALID_HANDLE if there is none)
+vsCode VSENGINE_API vsGetVideoWriterStats(vsHandle handle, int source_id, vsWriterStats* outStats);
+// Stops decoding and inference and frees results that were not taken yet
+vsCode VSENGINE_API vsCloseVideo(vsHandle handle, int source_id);
+
+// Multi-stream scheduler (see vs_scheduler.h). The scheduler loads options->sessions copies of
+// the model and is a handle of its own: pass it only to the vsScheduler* / stream calls below.
+vsCode VSENGINE_API vsCreateScheduler(vsHandle* outScheduler, const TCHAR* appPath, const vsModelOptions* model,
+	const vsSchedulerOptions* options);
+vsCode VSENGINE_API vsDestroyScheduler(vsHandle scheduler);
+// streamId 0..63; it is also the metrics stream and the sourceId of the delivered results
+vsCode VSENGINE_API vsAddStream(vsHandle scheduler, int streamId, const vsStreamOptions* options);
+// Returns after the stream's last result and its endOfStream notification were delivered.
+// Must not be called from that stream's own callback.
+vsCode VSENGINE_API vsRemoveStream(vsHandle scheduler, int streamId);
+// Copies the image and queues it. A VS_DROP_NONE stream with a full queue waits up to
+// timeoutMs (-1 = forever) and returns VS_ERROR_TIMEOUT if no room was made. A VS_DROP_OLDEST
+// stream whose every slot is taken by concurrent calls still copying drops this frame and
+// returns VS_ERROR_TIMEOUT.
+vsCode VSENGINE_API vsSubmitFrame(vsHandle scheduler, int streamId, const unsigned char* imgData, int width, int height,
+	int channels, int64_t frameIndex, double timestampMs, int timeoutMs);
+// streamId VS_METRICS_ALL_STREAMS sums every stream
+vsCode VSENGINE_API vsGetStreamStats(vsHandle scheduler, int streamId, vsStreamStats* outStats);
+vsCode VSENGINE_API vsGetSchedulerMetricsJson(vsHandle scheduler, int streamId, char* buffer, int bufferSize, int* outLength);
+
+// Offline synopsis (see vs_synopsis.h): analyses url with the handle's model, then places and
+// renders the tubes. Blocks until the output is written. An interrupted or stopped job resumes
+// when called again with the same work directory and url. Returns VS_ERROR_UNKNOWN if the job
+// failed or was stopped by the progress callback (the log says which), VS_ERROR_NO_MATCHES
+// (and writes no output) if the options select no tube. Each segment past the
+// first loads another session of the handle's model for the length of the call; the handle
+// must not be released before the call returns. options->reid loads <appPath>/model/reid.onnx
+// the same way (VS_ERROR_INITIALIZATION_FAILED if it cannot be loaded).
+vsCode VSENGINE_API vsRunSynopsis(vsHandle handle, const TCHAR* url, const vsSynopsisOptions* options,
+	vsSynopsisProgressCallback progress, void* userData);
+
+// Line-crossing / zone-intrusion events (see vs_events.h). An event engine is a handle of its
+// own and needs no model; options may be NULL for the defaults.
+vsCode VSENGINE_API vsCreateEventEngine(vsHandle* outEngine, const vsEventEngineOptions* options);
+vsCode VSENGINE_API vsDestroyEventEngine(vsHandle engine);
+// Adds or replaces (same ruleId) a rule of the stream; VS_ERROR_UNKNOWN for too few points
+vsCode VSENGINE_API vsSetEventRule(vsHandle engine, int streamId, const vsEventRule* rule);
+vsCode VSENGINE_API vsRemoveEventRule(vsHandle engine, int streamId, int ruleId);
+// One frame of the stream's tracked boxes. Frames of a stream come in order, from one thread at a time.
+vsCode VSENGINE_API vsUpdateTracks(vsHandle engine, int streamId, int64_t frameIndex, double timestampMs,
+	const vsTrackBox* tracks, int count);
+// Same for a detect / segment / pose / OBB result block; the engine tracks its boxes itself
+vsCode VSENGINE_API vsUpdateEventsFromResult(vsHandle engine, int streamId, int64_t frameIndex, double timestampMs,
+	const vsResultHeader* result);
+// Takes up to maxEvents queued events without waiting; one polling thread per engine
+vsCode VSENGINE_API vsPollEvents(vsHandle engine, vsEvent* outEvents, int maxEvents, int* outCount);
+vsCode VSENGINE_API vsGetEventStats(vsHandle engine, vsEventStats* outStats);
 
 
 #ifdef __cplusplus
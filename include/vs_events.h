@@ -0,0 +1,83 @@
+#ifndef __VS_EVENTS_H__
+#define __VS_EVENTS_H__
+#include <stdint.h>
+#include "vs_result.h"
+
+/**
+ * Line-crossing and zone-intrusion events on tracked objects (vsCreateEventEngine).
+ *
+ * Every stream (camera) has its own rules: polylines an object may cross and polygons it
+ * may enter, leave or dwell in. Each frame the caller passes the stream's tracked boxes
+ * (or a result block, tracked by the engine); the anchor point of each box is tested
+ * against the rules and every track keeps, per zone, whether it is inside and since when.
+ * Events carry the frame index and timestamp of the frame that caused them and are queued
+ * without locks; when the queue is full new events are dropped and counted.
+ *
+ * A stream is updated from one thread at a time; different streams and vsPollEvents may
+ * run concurrently.
+ */
+
+typedef enum vsRuleKind {
+	VS_RULE_LINE = 0,           // polyline; Cross events
+	VS_RULE_ZONE = 1            // closed polygon; Enter, Exit and Dwell events
+}vsRuleKind;
+
+typedef enum vsEventType {
+	VS_EVENT_ENTER = 1,         // first frame inside a zone (also when a track appears inside)
+	VS_EVENT_EXIT = 2,          // first frame outside again, or the track was lost while inside
+	VS_EVENT_CROSS = 3,         // anchor moved across a line since the track's previous frame
+	VS_EVENT_DWELL = 4          // inside a zone for dwellSeconds; once per visit
+}vsEventType;
+
+typedef enum vsAnchor {
+	VS_ANCHOR_BOTTOM = 0,       // bottom centre of the box, where the object meets the ground
+	VS_ANCHOR_CENTER = 1
+}vsAnchor;
+
+typedef struct vsEventRule {
+	int32_t        ruleId;             // reported in events; setting an existing id replaces the rule
+	vsRuleKind     kind;
+	const float*   pointsXY;           // x, y pairs in image pixels
+	int32_t        pointCount;         // >= 2 for lines, >= 3 for zones
+	const int32_t* classIds;           // classes the rule applies to, NULL = all
+	int32_t        classCount;
+	int32_t        direction;          // lines: 0 = both ways, 1 = right to left of the drawn
+	                                   // direction only, -1 = left to right only
+	double         dwellSeconds;       // zones: 0 = no Dwell events
+}vsEvRule;
+
+typedef struct vsTrackBox {
+	int32_t trackId;
+	int32_t classId;
+	vsRect  box;
+}vsTrkBox;
+
+typedef struct vsEvent {
+	int32_t streamId;
+	int32_t ruleId;
+	int32_t trackId;
+	int32_t classId;
+	int32_t type;                      // vsEventType
+	int32_t direction;                 // Cross: 1 = right to left of the line, -1 = left to right
+	int64_t frameIndex;
+	double  timestampMs;
+	double  insideSeconds;             // Exit and Dwell: time since the Enter
+	float   x;                         // anchor point at the event
+	float   y;
+}vsEv;
+
+typedef struct vsEventEngineOptions {
+	int32_t  queueCapacity;            // events waiting for vsPollEvents, rounded up to a power of two, 0 = 4096
+	int32_t  maxAge;                   // frames a track may go unseen before it is dropped, 0 = 30
+	vsAnchor anchor;
+}vsEvEngOpts;
+
+typedef struct vsEventStats {
+	int64_t frames;                    // updates processed, all streams
+	int64_t events;                    // events queued
+	int64_t dropped;                   // events lost to a full queue
+	double  avgUpdateMicros;           // rule evaluation per update
+	double  maxUpdateMicros;
+}vsEvStats;
+
+#endif//__VS_EVENTS_H__
@@ -0,0 +1,44 @@
+#ifndef __VS_METRICS_H__
+#define __VS_METRICS_H__
+#include <stdint.h>
+
+/**
+ * Hot-path metrics exposed through vsGetMetrics / vsGetMetricsJson.
+ *
+ * Every model handle keeps always-on latency histograms per stage and per stream.
+ * Latencies are recorded in nanoseconds into log-linear buckets (~6% relative error),
+ * percentiles below are the bucket midpoints converted to microseconds.
+ */
+
+#define VS_METRICS_VERSION 1
+#define VS_METRICS_ALL_STREAMS (-1)
+
+typedef enum vsMetricStage {
+	VS_STAGE_PREPROCESS = 0,  // letterbox, normalisation, HWC->CHW
+	VS_STAGE_INFERENCE,       // Ort::Session::Run
+	VS_STAGE_POSTPROCESS,     // decode + NMS + mask assembly
+	VS_STAGE_NMS,             // NMS only (subset of postprocess)
+	VS_STAGE_QUEUE_WAIT,      // time a frame waited between enqueue and dequeue
+	VS_STAGE_TOTAL,           // whole detect/segment/... call
+	VS_STAGE_MAX
+}vsStage;
+
+typedef struct vsLatencyStats {
+	uint64_t count;
+	double   meanUs;
+	double   p50Us;
+	double   p90Us;
+	double   p99Us;
+	double   p999Us;
+	double   maxUs;
+}vsLatStats;
+
+typedef struct vsMetricsSnapshot {
+	uint32_t       version;     // VS_METRICS_VERSION
+	int32_t        streamId;    // VS_METRICS_ALL_STREAMS for the aggregate
+	uint64_t       frames;      // completed calls (same as stages[VS_STAGE_TOTAL].count)
+	uint64_t       dropped;     // frames dropped before inference
+	vsLatencyStats stages[VS_STAGE_MAX];
+}vsMetrics;
+
+#endif//__VS_METRICS_H__
@@ -0,0 +1,23 @@
+#ifndef __VS_PLATFORM_H__
+#define __VS_PLATFORM_H__
+
+/**
+ * Minimal platform layer for the public headers and the engine core.
+ * On Windows this is tchar.h + dllexport; elsewhere TCHAR is plain char so the
+ * engine and the headless tools (synopsis_bench) build against a CPU-only onnxruntime.
+ */
+
+#ifdef _WIN32
+#include <tchar.h>
+#define VSENGINE_API __declspec(dllexport)
+#define VS_PATH_SEP _T('\\')
+#else
+#ifndef _T
+typedef char TCHAR;
+#define _T(x) x
+#endif
+#define VSENGINE_API __attribute__((visibility("default")))
+#define VS_PATH_SEP '/'
+#endif
+
+#endif//__VS_PLATFORM_H__
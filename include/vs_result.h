@@ -0,0 +1,116 @@
+#ifndef __VS_RESULT_H__
+#define __VS_RESULT_H__
+#include <stdint.h>
+
+/**
+ * Flat result blocks returned by vsSegment / vsEstimatePose / vsDetectOriented / vsClassify
+ * and delivered per frame by the video pipeline (vs_video.h).
+ *
+ * Every call returns ONE contiguous allocation laid out as
+ *
+ *   [vsResultHeader][object records ...][payload bytes ...]
+ *
+ * All offsets are in bytes from the start of the block and are 8-byte aligned.
+ * Object records have a fixed size (header.objectStride) so callers can index them
+ * directly; variable-size data (keypoints, masks, class names) lives in the payload
+ * and is referenced from the records by offset. The block is plain C data: no C++
+ * types cross the DLL boundary and no per-object allocation is needed.
+ * Release it with vsReleaseResult().
+ */
+
+#define VS_RESULT_MAGIC   0x42525356u  // 'VSRB'
+#define VS_RESULT_VERSION 1
+
+typedef enum vsMaskEncoding {
+	VS_MASK_NONE = 0,
+	VS_MASK_RLE = 1,    // uint32 run lengths over the ROI, row-major, starting with a background run
+	VS_MASK_ROI = 2     // uint8 0/255 bitmap of maskW x maskH, row-major, no padding
+}vsMaskEnc;
+
+typedef struct vsResultHeader {
+	uint32_t magic;          // VS_RESULT_MAGIC
+	uint16_t version;        // VS_RESULT_VERSION
+	uint16_t task;           // YoloTask that produced the block
+	uint32_t totalSize;      // size of the whole block in bytes
+	int32_t  imageWidth;     // size of the analysed image
+	int32_t  imageHeight;
+	int32_t  count;          // number of object records
+	uint32_t objectsOffset;  // offset of the first object record
+	uint32_t objectStride;   // sizeof one object record
+	uint32_t payloadOffset;  // offset of the payload area
+	uint32_t payloadSize;    // size of the payload area in bytes
+}vsResHeader;
+
+typedef struct vsRect {
+	int32_t x;
+	int32_t y;
+	int32_t width;
+	int32_t height;
+}vsRc;
+
+typedef struct vsKeypoint {
+	float x;
+	float y;
+	float conf;
+}vsKpt;
+
+/**
+ * @brief Detection record (YT_DETECT blocks, no payload).
+ */
+typedef struct vsDetObject {
+	vsRect   box;
+	float    conf;
+	int32_t  classId;
+}vsDetObj;
+
+/**
+ * @brief Segmentation record. The mask covers maskRoi (image coordinates).
+ */
+typedef struct vsSegObject {
+	vsRect   box;
+	float    conf;
+	int32_t  classId;
+	vsRect   maskRoi;
+	uint32_t maskEncoding;   // vsMaskEncoding
+	uint32_t maskOffset;     // offset of the mask data in the block
+	uint32_t maskSize;       // mask data size in bytes (RLE: runs * 4)
+	uint32_t reserved;
+}vsSegObj;
+
+/**
+ * @brief Pose record. Keypoints are packed as vsKeypoint[keypointCount] at keypointOffset.
+ */
+typedef struct vsPoseObject {
+	vsRect   box;
+	float    conf;
+	int32_t  classId;
+	uint32_t keypointOffset;
+	uint32_t keypointCount;
+}vsPoseObj;
+
+/**
+ * @brief Oriented box record in xywhr plus its 4 corner polygon (x0,y0 .. x3,y3).
+ */
+typedef struct vsObbObject {
+	float    cx;
+	float    cy;
+	float    width;
+	float    height;
+	float    angle;          // radians
+	float    conf;
+	int32_t  classId;
+	float    corners[8];
+	uint32_t reserved;
+}vsObbObj;
+
+/**
+ * @brief Classification record. The class name is UTF-8 (not NUL terminated) in the payload.
+ */
+typedef struct vsClassObject {
+	int32_t  classId;
+	float    conf;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+}vsClassObj;
+
+#endif//__VS_RESULT_H__
@@ -0,0 +1,50 @@
+#ifndef __VS_SCHEDULER_H__
+#define __VS_SCHEDULER_H__
+#include <stdint.h>
+#include "vs_video.h"
+
+/**
+ * Multi-stream scheduler (vsCreateScheduler / vsSubmitFrame).
+ *
+ * One scheduler owns a pool of inference sessions loaded from the same model and
+ * accepts frames from many streams (cameras). Each session thread forms a micro-batch
+ * across streams: it waits at most batchWindowUs for the batch to fill up to maxBatch
+ * frames, then runs it with one inference call (detect models exported with a dynamic
+ * batch axis; other models run the frames of the batch back to back). Streams share
+ * the batches in weighted round robin, so a busy stream cannot starve a quiet one.
+ *
+ * Results are delivered per frame through the stream's vsFrameResultCallback, on a
+ * session thread. Stage latencies, queue wait and drops are recorded per stream and
+ * read with vsGetSchedulerMetricsJson.
+ */
+
+typedef enum vsDropPolicy {
+	VS_DROP_NONE = 0,           // Timed: every frame is analysed, vsSubmitFrame waits for room
+	VS_DROP_OLDEST = 1          // Continuous: a full queue discards its oldest frame
+}vsDrop;
+
+typedef struct vsSchedulerOptions {
+	int sessions;               // inference sessions working in parallel, 0 = 1
+	int maxBatch;               // frames per inference call, 0 = 8
+	int batchWindowUs;          // latency budget for filling a batch, 0 = 5000, < 0 = never wait
+}vsSchedOpts;
+
+typedef struct vsStreamOptions {
+	int                   weight;       // share of the batches when streams compete, 0 = 1
+	int                   queueDepth;   // frames buffered for this stream, 0 = 4
+	vsDropPolicy          dropPolicy;
+	vsMaskEncoding        maskEncoding; // segmentation models only
+	vsFrameResultCallback callback;     // required
+	void*                 userData;
+}vsStreamOpts;
+
+typedef struct vsStreamStats {
+	int64_t submitted;
+	int64_t analysed;
+	int64_t dropped;            // discarded by the drop policy or still queued on removal
+	int32_t queued;
+	int64_t batches;            // inference calls that carried frames of this stream
+	int64_t batchedFrames;      // frames in those calls, all streams included
+}vsStrmStats;
+
+#endif//__VS_SCHEDULER_H__
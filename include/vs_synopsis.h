@@ -0,0 +1,88 @@
+#ifndef __VS_SYNOPSIS_H__
+#define __VS_SYNOPSIS_H__
+#include <stdint.h>
+#include "vs_result.h"
+
+/**
+ * Offline synopsis of a long recording (vsRunSynopsis), in two passes over bounded memory.
+ *
+ * Pass one decodes the source once and runs the handle's model on it. Object tubes go to
+ * "tubes.vstube" in the work directory chunk by chunk, background plates to "plates/" as
+ * they change, so only the tubes open at the current frame stay in memory. A checkpoint
+ * ("job.ckpt") is written every checkpointSeconds of source. With segments > 1 a file is
+ * split at keyframes and the parts are analysed at once, each by its own decoder and model
+ * session; tracks crossing a split are joined before pass two. With reid set, the tubes are
+ * then embedded by the appearance model "model/reid.onnx" and fragments of one object whose
+ * track broke (occlusions, missed detections) are merged into one tube.
+ *
+ * Pass two looks the wanted tubes up in an index over the store (class, time window, zone),
+ * places them in batches of consecutive source time sized to fit memoryLimitMB, saving
+ * every batch's placements ("placements.bin"), then renders the batches one after another
+ * into the output video.
+ *
+ * Running again with the same work directory and source resumes from the last checkpoint:
+ * analysis continues after the last checkpointed frame, finished batches are not placed
+ * again. The checkpoint keeps a hash of the query and batch settings; if they changed in
+ * between, placement starts over on the same tubes. Rendering, being the short part,
+ * restarts from the beginning of the output.
+ */
+
+enum {
+	VS_SYNOPSIS_ANALYSE = 1,    // progress pass numbers
+	VS_SYNOPSIS_PLACE = 2,
+	VS_SYNOPSIS_RENDER = 3,
+	VS_SYNOPSIS_MERGE = 4       // re-ID fragment merge, between analyse and place
+};
+
+// Colour bins of the per-tube colour histogram: twelve hues 30 degrees apart, then the
+// achromatic shades. vsSynopsisOptions::colorMask takes (1 << VS_COLOR_*) bits.
+enum {
+	VS_COLOR_RED = 0,
+	VS_COLOR_ORANGE,
+	VS_COLOR_YELLOW,
+	VS_COLOR_LIME,
+	VS_COLOR_GREEN,
+	VS_COLOR_TEAL,
+	VS_COLOR_CYAN,
+	VS_COLOR_AZURE,
+	VS_COLOR_BLUE,
+	VS_COLOR_VIOLET,
+	VS_COLOR_MAGENTA,
+	VS_COLOR_PINK,
+	VS_COLOR_BLACK,
+	VS_COLOR_DARK_GREY,
+	VS_COLOR_LIGHT_GREY,
+	VS_COLOR_WHITE,
+	VS_COLOR_COUNT
+};
+
+typedef struct vsSynopsisOptions {
+	const char*    workDirUtf8;        // spill and checkpoint directory, created if missing
+	const char*    outputUtf8;         // synopsis video; the container follows the extension
+	int32_t        frameStride;        // analyse every Nth frame, 0 or 1 = all
+	int32_t        memoryLimitMB;      // pass two working set, 0 = 1024
+	int32_t        checkpointSeconds;  // source time between checkpoints, 0 = 300
+	double         batchSeconds;       // synopsis length of one batch, 0 = its longest tube
+	vsMaskEncoding maskEncoding;       // segmentation models only
+	int32_t        segments;           // parallel analysis of a file, 0 or 1 = one pass; one model session each
+
+	// Which tubes go into the synopsis; zeroed fields select everything
+	const int32_t* classIds;           // any of these classes
+	int32_t        classCount;
+	double         fromSeconds;        // source window the tubes must overlap, toSeconds 0 = to the end
+	double         toSeconds;
+	const int32_t* zoneXY;             // polygon (x, y pairs, source pixels) the trajectory must touch
+	int32_t        zonePointCount;
+	uint32_t       colorMask;          // main colour any of these VS_COLOR_* bits
+
+	// Fragment merging by appearance
+	int32_t        reid;               // 1 = merge fragments with the re-ID model
+	float          reidMinSimilarity;  // cosine similarity of two fragments, 0 = 0.7
+	double         reidMaxGapSeconds;  // longest gap between two fragments, 0 = 10
+}vsSynOpts;
+
+// Called on the thread running vsRunSynopsis; fraction is 0..1 within the pass.
+// Returning 0 stops the job; it writes a checkpoint first and can be resumed later.
+typedef int (*vsSynopsisProgressCallback)(void* userData, int pass, double fraction);
+
+#endif//__VS_SYNOPSIS_H__
@@ -0,0 +1,100 @@
+#ifndef __VS_VIDEO_H__
+#define __VS_VIDEO_H__
+#include <stdint.h>
+#include "vs_result.h"
+
+/**
+ * Engine-side video ingestion (vsOpenVideo / vsOpenVideoEx).
+ *
+ * Every opened source gets a decode thread that fills a bounded ring of prefetched
+ * frames and an inference thread that runs the handle's task on them. Results are
+ * handed out either through a callback or by polling with vsPollVideo. Memory is
+ * bounded by prefetchFrames decoded frames plus maxPendingResults result blocks,
+ * whatever the length of the source. No GUI or message loop is involved.
+ */
+
+typedef enum vsVideoPacing {
+	VS_VIDEO_ALL_FRAMES = 0,    // files: every frame is analysed, decoding waits for inference
+	VS_VIDEO_LATEST = 1         // live sources: inference skips to the newest decoded frame and a
+	                            // full prefetch replaces its newest frame instead of stalling the
+	                            // decoder; skipped, replaced and overflowing results count as drops
+}vsPacing;
+
+typedef enum vsVideoState {
+	VS_VIDEO_RUNNING = 0,
+	VS_VIDEO_ENDED,             // source exhausted and every frame delivered
+	VS_VIDEO_FAILED             // decode stopped on an error before the end of the source
+}vsVidState;
+
+typedef enum vsDrawFlags {
+	VS_DRAW_BOXES = 1,
+	VS_DRAW_LABELS = 2,         // class id (or name for classification) and confidence
+	VS_DRAW_MASKS = 4,
+	VS_DRAW_KEYPOINTS = 8,      // pose keypoints and the COCO skeleton
+	VS_DRAW_ALL = 15
+}vsDrawFl;
+
+/**
+ * @brief Annotated copy of an analysed source, written by the engine (vsVideoOptions::output).
+ *
+ * Each analysed frame is copied into a pooled buffer together with its result block and
+ * handed to an encoder thread, which draws the overlays and feeds cv::VideoWriter. The
+ * hand-off never waits: when queueDepth frames are already waiting, the frame is left out
+ * of the output and counted in vsWriterStats::framesDropped.
+ */
+typedef struct vsWriterOptions {
+	const char*    pathUtf8;           // output file; the container follows the extension
+	int32_t        fourcc;             // 0 = 'mp4v'
+	double         fps;                // 0 = source fps / frameStride (25 if unknown)
+	int32_t        queueDepth;         // frames waiting for the encoder, 0 = 32
+	int32_t        drawFlags;          // vsDrawFlags, 0 = VS_DRAW_ALL
+	float          maskAlpha;          // mask opacity, 0 = 0.4
+}vsWriterOpts;
+
+typedef struct vsWriterStats {
+	int64_t framesSubmitted;
+	int64_t framesWritten;
+	int64_t framesDropped;             // encoder backlog was full
+	int32_t backlog;                   // frames waiting for the encoder right now
+	int32_t peakBacklog;
+	double  avgEncodeMs;               // drawing + encoding per frame
+	int32_t failed;                    // 1 if the writer could not be opened or stopped on an error
+}vsWrStats;
+
+typedef struct vsVideoOptions {
+	int            prefetchFrames;     // decoded frames buffered ahead of inference, 0 = 8
+	int            maxPendingResults;  // results held for vsPollVideo, 0 = 32 (unused with a callback)
+	int            frameStride;        // analyse every Nth frame, 0 or 1 = all
+	vsVideoPacing  pacing;
+	vsMaskEncoding maskEncoding;       // segmentation handles only
+	const vsWriterOptions* output;     // optional annotated output, NULL = none (copied on open)
+}vsVideoOpts;
+
+/**
+ * @brief One analysed frame. The receiver owns result and releases it with vsReleaseResult.
+ *        The last notification of a source has endOfStream = 1 and result = NULL.
+ */
+typedef struct vsFrameResult {
+	int32_t         sourceId;
+	int32_t         endOfStream;
+	int64_t         frameIndex;        // 0-based position in the source
+	double          timestampMs;       // presentation time reported by the decoder
+	vsResultHeader* result;            // NULL if the task failed on this frame
+	int32_t         status;            // vsCode: VS_SUCCESS, or why result is NULL
+}vsFrameRes;
+
+// Called on the source's inference thread; must not call vsCloseVideo for its own source.
+typedef void (*vsFrameResultCallback)(void* userData, const vsFrameResult* frame);
+
+typedef struct vsVideoInfo {
+	int32_t width;
+	int32_t height;
+	double  fps;                       // 0 if the container does not say
+	int64_t frameCount;                // -1 if unknown (live streams)
+	int32_t state;                     // vsVideoState
+	int64_t framesDecoded;
+	int64_t framesAnalysed;
+	int64_t framesDropped;
+}vsVidInfo;
+
+#endif//__VS_VIDEO_H__